@@ -500,7 +500,7 @@ void kvz_cabac_write_unary_max_symbol(cabac_data_t * const data,
   uint32_t symbol,
   const int32_t offset,
   const uint32_t max_symbol, 
-  double* bits_out)
+  rd_bits_t* bits_out)
 {
   int8_t code_last = max_symbol > symbol;
 
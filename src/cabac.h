@@ -124,14 +124,20 @@ uint32_t kvz_cabac_write_ep_ex_golomb(struct encoder_state_t * const state, caba
                                   uint32_t symbol, uint32_t count);
 void kvz_cabac_write_unary_max_symbol(cabac_data_t *data, cabac_ctx_t *ctx,
                                       uint32_t symbol, int32_t offset,
-                                      uint32_t max_symbol, double* bits_out);
+                                      uint32_t max_symbol, rd_bits_t* bits_out);
 void kvz_cabac_write_unary_max_symbol_ep(cabac_data_t *data, unsigned int symbol, unsigned int max_symbol);
 
 extern const float kvz_f_entropy_bits[128];
+#if KVZ_FIXED_POINT_COST
+// Fractional bits with RD_FRAC_BITS fractional bits, defined in rdo.c.
+extern const uint32_t kvz_entropy_bits[128];
+#define CTX_ENTROPY_FBITS(ctx, val) ((rd_bits_t)kvz_entropy_bits[(ctx)->uc_state ^ (val)])
+#else
 #define CTX_ENTROPY_FBITS(ctx, val) kvz_f_entropy_bits[(ctx)->uc_state ^ (val)]
+#endif
 
 #define CABAC_FBITS_UPDATE(cabac, ctx, val, bits, name) do { \
-  if((cabac)->only_count) (bits) += kvz_f_entropy_bits[(ctx)->uc_state ^ (val)]; \
+  if((cabac)->only_count) (bits) += CTX_ENTROPY_FBITS((ctx), (val)); \
   if((cabac)->update) {\
     (cabac)->cur_ctx = ctx;\
     CABAC_BIN((cabac), (val), (name));\
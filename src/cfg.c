@@ -191,6 +191,40 @@ int kvz_config_init(kvz_config *cfg)
 
   cfg->enable_logging_output = 1;
 
+  cfg->auto_parallelism = 0;
+  cfg->max_latency_frames = 0;
+
+  cfg->adaptive_mv_range = 0;
+
+  cfg->latency_budget = 0;
+
+  cfg->gdr_period = 0;
+
+  cfg->vbv_bufsize = 0;
+  cfg->vbv_maxrate = 0;
+  cfg->vbv_init = 0.9;
+
+  for (int i = 0; i < 4; i++) {
+    cfg->quant_modes[i] = KVZ_QUANT_RDOQ;
+  }
+  cfg->fast_rdoq_table_fn = NULL;
+  cfg->fast_tr_split = 0;
+  cfg->dct32_lowfreq = 0;
+
+  cfg->deterministic = 0;
+
+  cfg->ml_pu_depth_inter = 0;
+  cfg->ml_inter_samples_fn = NULL;
+  cfg->ml_model_fn = NULL;
+
+  cfg->fastrd_online_interval = 0;
+
+  cfg->bipred_refine = 0;
+
+  cfg->huge_pages = 0;
+
+  cfg->calc_ssim = 0;
+
   return 1;
 }
 
@@ -200,11 +234,14 @@ int kvz_config_destroy(kvz_config *cfg)
     FREE_POINTER(cfg->cqmfile);
     FREE_POINTER(cfg->roi.file_path);
     FREE_POINTER(cfg->fast_coeff_table_fn);
+    FREE_POINTER(cfg->fast_rdoq_table_fn);
     FREE_POINTER(cfg->tiles_width_split);
     FREE_POINTER(cfg->tiles_height_split);
     FREE_POINTER(cfg->slice_addresses_in_ts);
     FREE_POINTER(cfg->optional_key);
     FREE_POINTER(cfg->fastrd_learning_outdir_fn);
+    FREE_POINTER(cfg->ml_inter_samples_fn);
+    FREE_POINTER(cfg->ml_model_fn);
   }
   free(cfg);
 
@@ -388,6 +425,36 @@ static int parse_pu_depth_list( const char *array, int32_t *depths_min, int32_t
     return retval;
 }
 
+/**
+ * \brief Parse a quantizer for each transform size.
+ *
+ * Accepts either a single quantizer name, used for all sizes, or four
+ * comma separated names for 4x4, 8x8, 16x16 and 32x32 transforms.
+ */
+static int parse_quant_modes(const char *arg, const char * const *names,
+                             enum kvz_quant_mode *modes)
+{
+  char *list = strdup(arg);
+  char *token = strtok(list, ",");
+  int8_t parsed[4];
+  int count = 0;
+
+  while (token != NULL && count < 4 && parse_enum(token, names, &parsed[count])) {
+    count++;
+    token = strtok(NULL, ",");
+  }
+  free(list);
+
+  if (token != NULL || (count != 1 && count != 4)) {
+    return 0;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    modes[i] = parsed[count == 1 ? 0 : i];
+  }
+  return 1;
+}
+
 static int parse_slice_specification(const char* const arg, int32_t * const nslices, int32_t** const array) {
   const char* current_arg = NULL;
   int32_t current_value;
@@ -465,7 +532,7 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
   static const char * const colormatrix_names[] = { "GBR", "bt709", "undef", "", "fcc", "bt470bg", "smpte170m",
                                                     "smpte240m", "YCgCo", "bt2020nc", "bt2020c", NULL };
   static const char * const mv_constraint_names[] = { "none", "frame", "tile", "frametile", "frametilemargin", NULL };
-  static const char * const hash_names[] = { "none", "checksum", "md5", NULL };
+  static const char * const hash_names[] = { "none", "checksum", "md5", "crc", NULL };
 
   static const char * const cu_split_termination_names[] = { "zero", "off", NULL };
   static const char * const crypto_toggle_names[] = { "off", "on", NULL };
@@ -897,6 +964,9 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
   else if OPT("fastrd-accuracy-check") {
     cfg->fastrd_accuracy_check_on = 1;
   }
+  else if OPT("fastrd-online") {
+    cfg->fastrd_online_interval = atoi(value);
+  }
   else if OPT("fastrd-outdir") {
     char *fastrd_learning_outdir_fn = strdup(value);
     if (!fastrd_learning_outdir_fn) {
@@ -1128,6 +1198,8 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
     cfg->mv_rdo = atobool(value);
   else if OPT("psnr")
     cfg->calc_psnr = (bool)atobool(value);
+  else if OPT("ssim")
+    cfg->calc_ssim = (bool)atobool(value);
   else if OPT("hash")
   {
     int8_t hash;
@@ -1349,6 +1421,27 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
   else if OPT("ml-pu-depth-intra") {
     cfg->ml_pu_depth_intra = (bool)atobool(value);
   }
+  else if OPT("ml-pu-depth-inter") {
+    cfg->ml_pu_depth_inter = (bool)atobool(value);
+  }
+  else if OPT("ml-inter-samples") {
+    char *ml_inter_samples_fn = strdup(value);
+    if (!ml_inter_samples_fn) {
+      fprintf(stderr, "Failed to allocate memory for ML inter sample file name.\n");
+      return 0;
+    }
+    FREE_POINTER(cfg->ml_inter_samples_fn);
+    cfg->ml_inter_samples_fn = ml_inter_samples_fn;
+  }
+  else if OPT("ml-model") {
+    char *ml_model_fn = strdup(value);
+    if (!ml_model_fn) {
+      fprintf(stderr, "Failed to allocate memory for ML model file name.\n");
+      return 0;
+    }
+    FREE_POINTER(cfg->ml_model_fn);
+    cfg->ml_model_fn = ml_model_fn;
+  }
   else if OPT("partial-coding") {
     uint32_t firstCTU_x;
     uint32_t firstCTU_y;
@@ -1410,6 +1503,62 @@ int kvz_config_parse(kvz_config *cfg, const char *name, const char *value)
   else if OPT("fast-bipred") {
     cfg->fast_bipred = atobool(value);
   }
+  else if OPT("bipred-refine") {
+    cfg->bipred_refine = atoi(value);
+  }
+  else if OPT("auto-parallelism") {
+    cfg->auto_parallelism = atobool(value);
+  }
+  else if OPT("max-latency") {
+    cfg->max_latency_frames = atoi(value);
+  }
+  else if OPT("adaptive-mv-range") {
+    cfg->adaptive_mv_range = atobool(value);
+  }
+  else if OPT("latency-budget") {
+    cfg->latency_budget = atoi(value);
+  }
+  else if OPT("gdr") {
+    cfg->gdr_period = atoi(value);
+  }
+  else if OPT("vbv-bufsize") {
+    cfg->vbv_bufsize = atoi(value);
+  }
+  else if OPT("vbv-maxrate") {
+    cfg->vbv_maxrate = atoi(value);
+  }
+  else if OPT("vbv-init") {
+    cfg->vbv_init = atof(value);
+  }
+  else if OPT("quant-modes") {
+    static const char * const quant_mode_names[] = { "plain", "approx", "rdoq", NULL };
+
+    if (!parse_quant_modes(value, quant_mode_names, cfg->quant_modes)) {
+      fprintf(stderr, "Invalid quant-modes value: %s\n", value);
+      return 0;
+    }
+  }
+  else if OPT("fast-rdoq-table") {
+    char* fast_rdoq_table_fn = strdup(value);
+    if (!fast_rdoq_table_fn) {
+      fprintf(stderr, "Failed to allocate memory for fast RDOQ table file name.\n");
+      return 0;
+    }
+    FREE_POINTER(cfg->fast_rdoq_table_fn);
+    cfg->fast_rdoq_table_fn = fast_rdoq_table_fn;
+  }
+  else if OPT("fast-tr-split") {
+    cfg->fast_tr_split = atobool(value);
+  }
+  else if OPT("dct32-lowfreq") {
+    cfg->dct32_lowfreq = atobool(value);
+  }
+  else if OPT("deterministic") {
+    cfg->deterministic = atobool(value);
+  }
+  else if OPT("huge-pages") {
+    cfg->huge_pages = atobool(value);
+  }
   else {
     return 0;
   }
@@ -1527,6 +1676,21 @@ int kvz_config_validate(const kvz_config *const cfg)
     error = 1;
   }
 
+  if (cfg->bipred_refine < 0) {
+    fprintf(stderr, "bipred-refine must be non-negative\n");
+    error = 1;
+  }
+
+  if (cfg->fastrd_online_interval < 0) {
+    fprintf(stderr, "fastrd-online interval must be non-negative\n");
+    error = 1;
+  }
+
+  if (cfg->fastrd_online_interval > 0 && cfg->fastrd_sampling_on) {
+    fprintf(stderr, "--fastrd-online cannot be used with --fastrd-sampling\n");
+    error = 1;
+  }
+
   if (cfg->width <= 0) {
     fprintf(stderr, "Input error: width must be positive\n");
     error = 1;
@@ -1627,6 +1791,41 @@ int kvz_config_validate(const kvz_config *const cfg)
     error = 1;
   }
 
+  if (cfg->max_latency_frames < 0) {
+    fprintf(stderr, "Input error: --max-latency must be nonnegative\n");
+    error = 1;
+  }
+
+  if (cfg->latency_budget < 0) {
+    fprintf(stderr, "Input error: --latency-budget must be nonnegative\n");
+    error = 1;
+  }
+
+  if (cfg->gdr_period < 0) {
+    fprintf(stderr, "Input error: --gdr must be nonnegative\n");
+    error = 1;
+  }
+
+  if (cfg->vbv_bufsize < 0 || cfg->vbv_maxrate < 0) {
+    fprintf(stderr, "Input error: --vbv-bufsize and --vbv-maxrate must be nonnegative\n");
+    error = 1;
+  }
+
+  if (cfg->vbv_bufsize > 0 && cfg->target_bitrate <= 0) {
+    fprintf(stderr, "Input error: --vbv-bufsize requires --bitrate\n");
+    error = 1;
+  }
+
+  if (cfg->vbv_maxrate > 0 && cfg->vbv_bufsize == 0) {
+    fprintf(stderr, "Input error: --vbv-maxrate requires --vbv-bufsize\n");
+    error = 1;
+  }
+
+  if (cfg->vbv_init <= 0.0 || cfg->vbv_init > 1.0) {
+    fprintf(stderr, "Input error: --vbv-init must be in range (0..1]\n");
+    error = 1;
+  }
+
   if (cfg->qp != CLIP_TO_QP(cfg->qp)) {
       fprintf(stderr, "Input error: --qp parameter out of range [0..51]\n");
       error = 1;
@@ -1867,6 +2066,12 @@ static int validate_hevc_level(kvz_config *const cfg) {
     level_error = 1;
   }
 
+  if (cfg->vbv_maxrate > cfg->max_bitrate) {
+    fprintf(stderr, "%s: VBV maximum rate exceeds %i, which is the maximum %s tier level %g bitrate\n",
+      level_err_prefix, cfg->max_bitrate, cfg->high_tier?"high":"main", lvl);
+    level_error = 1;
+  }
+
   // check the conformance to the level limits
 
   // luma samples
@@ -113,6 +113,8 @@ static const struct option long_options[] = {
   { "no-mv-rdo",                no_argument, NULL, 0 },
   { "psnr",                     no_argument, NULL, 0 },
   { "no-psnr",                  no_argument, NULL, 0 },
+  { "ssim",                     no_argument, NULL, 0 },
+  { "no-ssim",                  no_argument, NULL, 0 },
   { "version",                  no_argument, NULL, 0 },
   { "help",                     no_argument, NULL, 0 },
   { "loop-input",               no_argument, NULL, 0 },
@@ -153,6 +155,10 @@ static const struct option long_options[] = {
   { "early-skip",               no_argument, NULL, 0 },
   { "no-early-skip",            no_argument, NULL, 0 },
   { "ml-pu-depth-intra",        no_argument, NULL, 0 },
+  { "ml-pu-depth-inter",        no_argument, NULL, 0 },
+  { "no-ml-pu-depth-inter",     no_argument, NULL, 0 },
+  { "ml-inter-samples",   required_argument, NULL, 0 },
+  { "ml-model",           required_argument, NULL, 0 },
   { "partial-coding",     required_argument, NULL, 0 },
   { "zero-coeff-rdo",           no_argument, NULL, 0 },
   { "no-zero-coeff-rdo",        no_argument, NULL, 0 },
@@ -168,6 +174,7 @@ static const struct option long_options[] = {
   { "fastrd-sampling",          no_argument, NULL, 0 },
   { "fastrd-accuracy-check",    no_argument, NULL, 0 },
   { "fastrd-outdir",      required_argument, NULL, 0 },
+  { "fastrd-online",      required_argument, NULL, 0 },
   { "combine-intra-cus",        no_argument, NULL, 0 },
   { "no-combine-intra-cus",     no_argument, NULL, 0 },
   { "force-inter",              no_argument, NULL, 0 },
@@ -176,6 +183,27 @@ static const struct option long_options[] = {
   { "no-intra-chroma-search",   no_argument, NULL, 0 },
   { "fast-bipred",              no_argument, NULL, 0 },
   { "no-fast-bipred",           no_argument, NULL, 0 },
+  { "bipred-refine",      required_argument, NULL, 0 },
+  { "auto-parallelism",         no_argument, NULL, 0 },
+  { "no-auto-parallelism",      no_argument, NULL, 0 },
+  { "max-latency",        required_argument, NULL, 0 },
+  { "adaptive-mv-range",        no_argument, NULL, 0 },
+  { "no-adaptive-mv-range",     no_argument, NULL, 0 },
+  { "latency-budget",     required_argument, NULL, 0 },
+  { "gdr",                required_argument, NULL, 0 },
+  { "vbv-bufsize",        required_argument, NULL, 0 },
+  { "vbv-maxrate",        required_argument, NULL, 0 },
+  { "vbv-init",           required_argument, NULL, 0 },
+  { "quant-modes",        required_argument, NULL, 0 },
+  { "fast-rdoq-table",    required_argument, NULL, 0 },
+  { "fast-tr-split",            no_argument, NULL, 0 },
+  { "no-fast-tr-split",         no_argument, NULL, 0 },
+  { "dct32-lowfreq",            no_argument, NULL, 0 },
+  { "no-dct32-lowfreq",         no_argument, NULL, 0 },
+  { "deterministic",            no_argument, NULL, 0 },
+  { "no-deterministic",         no_argument, NULL, 0 },
+  { "huge-pages",               no_argument, NULL, 0 },
+  { "no-huge-pages",            no_argument, NULL, 0 },
   {0, 0, 0, 0}
 };
 
@@ -445,7 +473,10 @@ void print_help(void)
     "                                   - none: 0 bytes\n"
     "                                   - checksum: 18 bytes\n"
     "                                   - md5: 56 bytes\n"
+    "                                   - crc: 12 bytes\n"
     "      --(no-)psnr            : Calculate PSNR for frames. [enabled]\n"
+    "      --(no-)ssim            : Calculate SSIM and MS-SSIM of the luma\n"
+    "                               for frames. [disabled]\n"
     "      --(no-)info            : Add encoder info SEI. [enabled]\n"
     "      --crypto <string>      : Selective encryption. Crypto support must be\n"
     "                               enabled at compile-time. Can be 'on' or 'off' or\n"
@@ -473,7 +504,15 @@ void print_help(void)
     "                                   - N: Every Nth picture is intra.\n"
     "      --vps-period <integer> : How often the video parameter set is re-sent [0]\n"
     "                                   - 0: Only send VPS with the first frame.\n"
-    "                                   - N: Send VPS with every Nth intra frame.\n"
+    "                                   - N: Send VPS with every Nth intra frame\n"
+    "                                            or GDR recovery point.\n"
+    "      --gdr <integer>        : Gradual decoding refresh period [0]\n"
+    "                               Refresh the picture a band of CTU rows\n"
+    "                               at a time instead of using intra\n"
+    "                               pictures. Disables --period, TMVP and\n"
+    "                               frame reordering.\n"
+    "                                   - 0: Disabled.\n"
+    "                                   - N: Refresh every N frames.\n"
     "  -r, --ref <integer>        : Number of reference frames, in range 1..15 [4]\n"
     "      --gop <string>         : GOP structure [lp-g4d3t1]\n"
     "                                   -  0: Disabled\n"
@@ -498,6 +537,17 @@ void print_help(void)
     "                                   - lambda: rate control from:\n"
     "                                     DOI: 10.1109/TIP.2014.2336550 \n"
     "                                   - oba: DOI: 10.1109/TCSVT.2016.2589878\n"
+    "      --vbv-bufsize <integer> : VBV buffer size in bits [0]\n"
+    "                               Limits picture sizes so that the decoder\n"
+    "                               buffer does not underflow and signals the\n"
+    "                               buffer with HRD parameters and buffering\n"
+    "                               period and picture timing SEI messages.\n"
+    "                               Requires --bitrate.\n"
+    "                                   - 0: Disable VBV.\n"
+    "      --vbv-maxrate <integer> : VBV buffer fill rate in bits per second.\n"
+    "                               [same as --bitrate]\n"
+    "      --vbv-init <float>     : Initial VBV buffer fullness as a fraction\n"
+    "                               of the buffer size. [0.9]\n"
     "      --(no-)intra-bits      : Use Hadamard cost based allocation for intra\n"
     "                               frames. Default on for gop 8 and off for lp-gop\n"
     "      --(no-)clip-neighbour  : On oba based rate control whether to clip \n"
@@ -551,6 +601,13 @@ void print_help(void)
     "                                   - full: Full SAO\n"
     "      --(no-)rdoq            : Rate-distortion optimized quantization [enabled]\n"
     "      --(no-)rdoq-skip       : Skip RDOQ for 4x4 blocks. [disabled]\n"
+    "      --quant-modes <list>   : Quantizer used with --rdoq for 4x4, 8x8,\n"
+    "                               16x16 and 32x32 transforms. A single value\n"
+    "                               is used for all sizes. [rdoq]\n"
+    "                                   - rdoq: Full RDOQ.\n"
+    "                                   - approx: Quantize with trained deadzone\n"
+    "                                             and rounding offsets.\n"
+    "                                   - plain: Plain quantization.\n"
     "      --(no-)signhide        : Sign hiding [disabled]\n"
     "      --(no-)smp             : Symmetric motion partition [disabled]\n"
     "      --(no-)amp             : Asymmetric motion partition [disabled]\n"
@@ -586,6 +643,10 @@ void print_help(void)
     "                                   - 3: + 1/4-pixel horizontal and vertical\n"
     "                                   - 4: + 1/4-pixel diagonal\n"
     "      --(no-)fast-bipred     : Only perform fast bipred search. [enabled]\n"
+    "      --bipred-refine <int>  : Refine the bipred motion vectors by\n"
+    "                               searching one list at a time with the\n"
+    "                               other list fixed, for the given number\n"
+    "                               of iterations. 0 to disable. [0]\n"
     "      --pu-depth-inter <int>-<int> : Inter prediction units sizes [0-3]\n"
     "                                   - 0, 1, 2, 3: from 64x64 to 8x8\n"
     "                                   - Accepts a list of values separated by ','\n"
@@ -601,6 +662,17 @@ void print_help(void)
     "      --ml-pu-depth-intra    : Predict the pu-depth-intra using machine\n"
     "                                learning trees, overrides the\n"
     "                                --pu-depth-intra parameter. [disabled]\n"
+    "      --(no-)ml-pu-depth-inter : Skip the search of CU splits in inter\n"
+    "                                 frames when a decision tree predicts\n"
+    "                                 that splitting does not pay off.\n"
+    "                                 [disabled]\n"
+    "      --ml-inter-samples <file> : Write the features and split decisions\n"
+    "                                  of inter CUs to a file for training\n"
+    "                                  the --ml-pu-depth-inter classifier.\n"
+    "      --ml-model <file>      : Load decision trees for --ml-pu-depth-intra\n"
+    "                               and --ml-pu-depth-inter from a file.\n"
+    "                               See tools/ml-model.py for the format.\n"
+    "                               [built-in trees]\n"
     "      --(no-)combine-intra-cus: Whether the encoder tries to code a cu\n"
     "                                   on lower depth even when search is not\n"
     "                                   performed on said depth. Should only\n"
@@ -612,6 +684,14 @@ void print_help(void)
     "                               guaranteed to produce sensible bitstream or\n"
     "                               work at all. [disabled]\n"
     "      --tr-depth-intra <int> : Transform split depth for intra blocks [0]\n"
+    "      --(no-)fast-tr-split   : Skip the transform split search for intra\n"
+    "                               modes when an estimate of the transform\n"
+    "                               costs prefers no split. Only has an effect\n"
+    "                               with --tr-depth-intra. [disabled]\n"
+    "      --(no-)dct32-lowfreq   : Only compute the low frequency 16x16\n"
+    "                               coefficients of 32x32 transforms when the\n"
+    "                               rest are predicted to quantize to zero.\n"
+    "                               [disabled]\n"
     "      --(no-)bipred          : Bi-prediction [disabled]\n"
     "      --cu-split-termination <string> : CU split search termination [zero]\n"
     "                                   - off: Don't terminate early.\n"
@@ -625,6 +705,9 @@ void print_help(void)
     "      --fast-coeff-table <string> : Read custom weights for residual\n"
     "                                    coefficients from a file instead of using\n"
     "                                    defaults [default]\n"
+    "      --fast-rdoq-table <string> : Read deadzone and rounding offsets for\n"
+    "                                   --quant-modes approx from a file\n"
+    "                                   instead of using defaults [default]\n"
     "      --fast-rd-sampling : Enable learning data sampling for fast coefficient\n"
     "                           table generation\n"
     "      --fastrd-accuracy-check : Evaluate the accuracy of fast coefficient\n"
@@ -632,6 +715,10 @@ void print_help(void)
     "      --fastrd-outdir : Directory to which to output sampled data or accuracy\n"
     "                        data, into <fastrd-outdir>/0.txt to 50.txt, one file\n"
     "                        for each QP that blocks were estimated on\n"
+    "      --fastrd-online <int> : Refit the fast coefficient cost weights\n"
+    "                              during encoding from every n-th block\n"
+    "                              estimated by --fast-residual-cost,\n"
+    "                              costed with CABAC. 0 to disable. [0]\n"
     "      --(no-)intra-rdo-et    : Check intra modes in rdo stage only until\n"
     "                               a zero coefficient CU is found. [disabled]\n"
     "      --(no-)early-skip      : Try to find skip cu from merge candidates.\n"
@@ -674,6 +761,34 @@ void print_help(void)
     "                                   - tiles: Put tiles in independent slices.\n"
     "                                   - wpp: Put rows in dependent slices.\n"
     "                                   - tiles+wpp: Do both.\n"
+    "      --(no-)auto-parallelism : Select WPP, uniform tiles and OWF from a\n"
+    "                               throughput model of the frame and thread\n"
+    "                               count and adjust the number of frames in\n"
+    "                               flight based on measured thread idle and\n"
+    "                               job wait times. [disabled]\n"
+    "      --max-latency <integer> : Maximum number of frames in flight for\n"
+    "                               --auto-parallelism. [0]\n"
+    "                                   - 0: No limit.\n"
+    "      --(no-)adaptive-mv-range : Limit motion vectors by how much of each\n"
+    "                               reference frame has been reconstructed\n"
+    "                               instead of a fixed bound when using WPP\n"
+    "                               and OWF. Output depends on thread timing.\n"
+    "                               Requires WPP without tiles or slices.\n"
+    "                               [disabled]\n"
+    "      --latency-budget <integer> : Target latency in milliseconds. [0]\n"
+    "                               Disables frame reordering, limits OWF,\n"
+    "                               splits frames into rows of tiles with a\n"
+    "                               slice each and writes each slice as soon\n"
+    "                               as it is done.\n"
+    "                                   - 0: No limit.\n"
+    "      --(no-)deterministic   : Produce the same output regardless of the\n"
+    "                               number of threads. Automatic OWF and\n"
+    "                               --auto-parallelism assume 8 threads and\n"
+    "                               slices of a tile are coded one at a time.\n"
+    "                               Disables --adaptive-mv-range. [disabled]\n"
+    "      --(no-)huge-pages      : Back the reconstructed pictures with\n"
+    "                               transparent huge pages where the system\n"
+    "                               supports them. [disabled]\n"
     "      --partial-coding <x-offset>!<y-offset>!<slice-width>!<slice-height>\n"
     "                             : Encode partial frame.\n" 
     "                               Parts must be merged to form a valid bitstream.\n"
@@ -712,9 +827,10 @@ void print_help(void)
 
 
 void print_frame_info(const kvz_frame_info *const info,
-                      const double frame_psnr[3],
                       const uint32_t bytes,
                       const bool print_psnr,
+                      const bool print_ssim,
+                      const bool print_latency,
                       const double avg_qp)
 {
   fprintf(stderr, "POC %4d QP %2d AVG QP %.1f (%c-frame) %10d bits",
@@ -726,7 +842,15 @@ void print_frame_info(const kvz_frame_info *const info,
 
   if (print_psnr) {
     fprintf(stderr, " PSNR Y %2.4f U %2.4f V %2.4f",
-            frame_psnr[0], frame_psnr[1], frame_psnr[2]);
+            info->psnr[0], info->psnr[1], info->psnr[2]);
+  }
+
+  if (print_ssim) {
+    fprintf(stderr, " SSIM %1.4f MS-SSIM %1.4f", info->ssim, info->ms_ssim);
+  }
+
+  if (print_latency) {
+    fprintf(stderr, " latency %.1f ms", info->latency * 1000.0);
   }
 
   if (info->slice_type != KVZ_SLICE_I) {
@@ -68,9 +68,10 @@ void print_usage(void);
 void print_version(void);
 void print_help(void);
 void print_frame_info(const kvz_frame_info *const info,
-                      const double frame_psnr[3],
                       const uint32_t bytes,
                       const bool print_psnr,
+                      const bool print_ssim,
+                      const bool print_latency,
                       const double avg_qp);
 
 #endif
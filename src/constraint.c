@@ -51,7 +51,8 @@ void * kvz_init_constraint(encoder_state_t* state, const encoder_control_t * con
   constr->ml_intra_depth_ctu = NULL;
   if (encoder->cfg.ml_pu_depth_intra) // TODO: Change this by a new param !!
   {
-    constr->ml_intra_depth_ctu = kvz_init_ml_intra_depth_const();
+    constr->ml_intra_depth_ctu = kvz_init_ml_intra_depth_const(encoder->ml_models,
+                                                               encoder->in.width * encoder->in.height);
   }
   return constr;
 }
@@ -227,3 +227,99 @@ void kvz_cu_array_copy_from_lcu(cu_array_t* dst, int dst_x, int dst_y, const lcu
     }
   }
 }
+
+
+/**
+ * \brief Allocate a motion field.
+ *
+ * \param width   width of the picture in luma pixels
+ * \param height  height of the picture in luma pixels
+ */
+cu_motion_field_t * kvz_cu_motion_field_alloc(const int width, const int height)
+{
+  cu_motion_field_t *field = MALLOC(cu_motion_field_t, 1);
+  if (!field) return NULL;
+
+  // Round up to a multiple of LCU width so that whole LCUs can be copied.
+  field->width    = CEILDIV(width,  LCU_WIDTH) * (LCU_WIDTH >> MOTION_FIELD_LOG2_WIDTH);
+  field->height   = CEILDIV(height, LCU_WIDTH) * (LCU_WIDTH >> MOTION_FIELD_LOG2_WIDTH);
+  field->data     = calloc(field->width * field->height, sizeof(cu_motion_t));
+  field->refcount = 1;
+
+  if (!field->data) {
+    FREE_POINTER(field);
+  }
+  return field;
+}
+
+
+void kvz_cu_motion_field_free(cu_motion_field_t **field_ptr)
+{
+  cu_motion_field_t *field = *field_ptr;
+  if (field == NULL) return;
+  *field_ptr = NULL;
+
+  int new_refcount = KVZ_ATOMIC_DEC(&field->refcount);
+  if (new_refcount > 0) {
+    // Still we have some references, do nothing.
+    return;
+  }
+
+  assert(new_refcount == 0);
+
+  FREE_POINTER(field->data);
+  FREE_POINTER(field);
+}
+
+
+/**
+ * \brief Get a new pointer to a motion field.
+ *
+ * Increment reference count and return the motion field.
+ */
+cu_motion_field_t * kvz_cu_motion_field_copy_ref(cu_motion_field_t *field)
+{
+  int32_t new_refcount = KVZ_ATOMIC_INC(&field->refcount);
+  // The caller should have had another reference and we added one
+  // reference so refcount should be at least 2.
+  assert(new_refcount >= 2);
+  return field;
+}
+
+
+/**
+ * \brief Copy the motion of an lcu to a motion field.
+ *
+ * All values are in luma pixels.
+ *
+ * \param dst       destination field
+ * \param dst_x     x-coordinate of the left edge of the lcu in dst
+ * \param dst_y     y-coordinate of the top edge of the lcu in dst
+ * \param src       source lcu
+ * \param ref_pocs  POCs of the pictures in L0 and L1
+ */
+void kvz_cu_motion_field_copy_from_lcu(cu_motion_field_t *dst,
+                                       int dst_x, int dst_y,
+                                       const lcu_t *src,
+                                       const int32_t ref_pocs[2][16])
+{
+  const int block = 1 << MOTION_FIELD_LOG2_WIDTH;
+  for (int y = 0; y < LCU_WIDTH; y += block) {
+    for (int x = 0; x < LCU_WIDTH; x += block) {
+      const cu_info_t *from_cu = LCU_GET_CU_AT_PX(src, x, y);
+      cu_motion_t *to = &dst->data[((dst_x + x) >> MOTION_FIELD_LOG2_WIDTH) +
+                                   ((dst_y + y) >> MOTION_FIELD_LOG2_WIDTH) * dst->width];
+
+      memset(to, 0, sizeof(*to));
+      if (from_cu->type != CU_INTER) continue;
+
+      to->mv_dir = from_cu->mv_dir;
+      for (int list = 0; list < 2; list++) {
+        if (!(from_cu->mv_dir & (1 << list))) continue;
+        to->mv[list][0]   = from_cu->inter.mv[list][0];
+        to->mv[list][1]   = from_cu->inter.mv[list][1];
+        to->ref_poc[list] = ref_pocs[list][from_cu->inter.mv_ref[list]];
+      }
+    }
+  }
+}
@@ -125,6 +125,11 @@ typedef struct {
 
 /**
  * \brief Struct for CU info
+ *
+ * CU info is stored for every 4x4 block, so the struct is kept at 16 bytes
+ * to fit four blocks in a cache line without any of them crossing a line.
+ * The inter fields that fit in bit-fields are kept outside the union for
+ * that reason.
  */
 typedef struct
 {
@@ -136,8 +141,9 @@ typedef struct
   uint8_t merged    : 1; //!< \brief flag to indicate this block is merged
   uint8_t merge_idx : 3; //!< \brief merge index
   uint8_t tr_skip   : 1; //!< \brief transform skip flag
-
-  uint16_t cbf;
+  uint8_t mv_dir    : 2; //!< \brief inter prediction lists, 1 for L0, 2 for L1 and 3 for both
+  uint8_t mv_cand0  : 1; //!< \brief selected L0 MV candidate, use CU_GET_MV_CAND
+  uint8_t mv_cand1  : 1; //!< \brief selected L1 MV candidate, use CU_GET_MV_CAND
 
   /**
    * \brief QP used for the CU.
@@ -146,6 +152,8 @@ typedef struct
    */
   uint8_t qp;
 
+  uint16_t cbf;
+
   union {
     struct {
       int8_t mode;
@@ -157,22 +165,24 @@ typedef struct
     struct {
       int16_t mv[2][2];  // \brief Motion vectors for L0 and L1
       uint8_t mv_ref[2]; // \brief Index of the L0 and L1 array.
-      uint8_t mv_cand0 : 3; // \brief selected MV candidate
-      uint8_t mv_cand1 : 3; // \brief selected MV candidate
-      uint8_t mv_dir   : 2; // \brief Probably describes if mv_ref is L0, L1 or both (bi-pred)
     } inter;
   };
 } cu_info_t;
 
+// Fail the build if cu_info_t grows past 16 bytes. The array size is
+// negative if the check fails. _Static_assert is not available in the C
+// mode of Visual Studio 2015.
+typedef char cu_info_t_size_check[sizeof(cu_info_t) == 16 ? 1 : -1];
+
 #define CU_GET_MV_CAND(cu_info_ptr, reflist) \
-  (((reflist) == 0) ? (cu_info_ptr)->inter.mv_cand0 : (cu_info_ptr)->inter.mv_cand1)
+  (((reflist) == 0) ? (cu_info_ptr)->mv_cand0 : (cu_info_ptr)->mv_cand1)
 
 #define CU_SET_MV_CAND(cu_info_ptr, reflist, value) \
   do { \
     if ((reflist) == 0) { \
-      (cu_info_ptr)->inter.mv_cand0 = (value); \
+      (cu_info_ptr)->mv_cand0 = (value); \
     } else { \
-      (cu_info_ptr)->inter.mv_cand1 = (value); \
+      (cu_info_ptr)->mv_cand1 = (value); \
     } \
   } while (0)
 
@@ -183,7 +193,7 @@ typedef struct
   "intra[2].cost=%u intra[2].bitcost=%u intra[2].mode=%d intra[2].mode_chroma=%d intra[2].tr_skip=%d " \
   "intra[3].cost=%u intra[3].bitcost=%u intra[3].mode=%d intra[3].mode_chroma=%d intra[3].tr_skip=%d " \
   "inter.cost=%u inter.bitcost=%u inter.mv[0]=%d inter.mv[1]=%d inter.mvd[0]=%d inter.mvd[1]=%d " \
-  "inter.mv_cand=%d inter.mv_ref=%d inter.mv_dir=%d inter.mode=%d" \
+  "inter.mv_cand=%d inter.mv_ref=%d mv_dir=%d inter.mode=%d" \
   , (cu).type, (cu).depth, (cu).part_size, (cu).tr_depth, (cu).coded, \
   (cu).skipped, (cu).merged, (cu).merge_idx, (cu).cbf.y, (cu).cbf.u, (cu).cbf.v, \
   (cu).intra[0].cost, (cu).intra[0].bitcost, (cu).intra[0].mode, (cu).intra[0].mode_chroma, (cu).intra[0].tr_skip, \
@@ -191,7 +201,7 @@ typedef struct
   (cu).intra[2].cost, (cu).intra[2].bitcost, (cu).intra[2].mode, (cu).intra[2].mode_chroma, (cu).intra[2].tr_skip, \
   (cu).intra[3].cost, (cu).intra[3].bitcost, (cu).intra[3].mode, (cu).intra[3].mode_chroma, (cu).intra[3].tr_skip, \
   (cu).inter.cost, (cu).inter.bitcost, (cu).inter.mv[0], (cu).inter.mv[1], (cu).inter.mvd[0], (cu).inter.mvd[1], \
-  (cu).inter.mv_cand, (cu).inter.mv_ref, (cu).inter.mv_dir, (cu).inter.mode)
+  (cu).inter.mv_cand, (cu).inter.mv_ref, (cu).mv_dir, (cu).inter.mode)
 
 typedef struct cu_array_t {
   struct cu_array_t *base; //!< \brief base cu array or NULL
@@ -338,6 +348,51 @@ typedef struct {
 
 void kvz_cu_array_copy_from_lcu(cu_array_t* dst, int dst_x, int dst_y, const lcu_t *src);
 
+//! \brief Log2 of the width of the blocks in a motion field.
+#define MOTION_FIELD_LOG2_WIDTH 4
+
+/**
+ * \brief Motion of a 16x16 block of a picture for temporal MV prediction.
+ *
+ * Only the motion of the top-left 4x4 block of each 16x16 block is kept,
+ * as in the HEVC motion data storage reduction.
+ */
+typedef struct {
+  int16_t mv[2][2];
+  //! \brief POC of the picture referenced by each list.
+  int32_t ref_poc[2];
+  //! \brief Lists used by the block, 0 for intra blocks.
+  uint8_t mv_dir;
+} cu_motion_t;
+
+typedef struct {
+  cu_motion_t *data;
+  int32_t width;    //!< \brief width of the field in 16x16 blocks
+  int32_t height;   //!< \brief height of the field in 16x16 blocks
+  int32_t refcount; //!< \brief number of references to this field
+} cu_motion_field_t;
+
+cu_motion_field_t * kvz_cu_motion_field_alloc(const int width, const int height);
+void kvz_cu_motion_field_free(cu_motion_field_t **field_ptr);
+cu_motion_field_t * kvz_cu_motion_field_copy_ref(cu_motion_field_t *field);
+void kvz_cu_motion_field_copy_from_lcu(cu_motion_field_t *dst,
+                                       int dst_x, int dst_y,
+                                       const lcu_t *src,
+                                       const int32_t ref_pocs[2][16]);
+
+/**
+ * \brief Return the motion of the 16x16 block containing a pixel.
+ */
+static INLINE const cu_motion_t * kvz_cu_motion_field_at(const cu_motion_field_t *field,
+                                                         unsigned x_px,
+                                                         unsigned y_px)
+{
+  assert((x_px >> MOTION_FIELD_LOG2_WIDTH) < field->width);
+  assert((y_px >> MOTION_FIELD_LOG2_WIDTH) < field->height);
+  return &field->data[(x_px >> MOTION_FIELD_LOG2_WIDTH) +
+                      (y_px >> MOTION_FIELD_LOG2_WIDTH) * field->width];
+}
+
 /**
  * \brief Return pointer to the top right reference CU.
  */
@@ -46,7 +46,6 @@
 #include <io.h>       /* _setmode() */
 #endif
 
-#include <math.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -97,49 +96,6 @@ static unsigned get_padding(unsigned width_or_height){
   }
 }
 
-/**
- * \brief Value that is printed instead of PSNR when SSE is zero.
- */
-static const double MAX_PSNR = 999.99;
-static const double MAX_SQUARED_ERROR = (double)PIXEL_MAX * (double)PIXEL_MAX;
-
-/**
- * \brief Calculates image PSNR value
- *
- * \param src   source picture
- * \param rec   reconstructed picture
- * \prama psnr  returns the PSNR
- */
-static void compute_psnr(const kvz_picture *const src,
-                         const kvz_picture *const rec,
-                         double psnr[3])
-{
-  assert(src->width  == rec->width);
-  assert(src->height == rec->height);
-
-  int32_t pixels = src->width * src->height;
-  int colors = rec->chroma_format == KVZ_CSP_400 ? 1 : 3;
-  double sse[3] = { 0.0 };
-
-  for (int32_t c = 0; c < colors; ++c) {
-    int32_t num_pixels = pixels;
-    if (c != COLOR_Y) {
-      num_pixels >>= 2;
-    }
-    for (int32_t i = 0; i < num_pixels; ++i) {
-      const int32_t error = src->data[c][i] - rec->data[c][i];
-      sse[c] += error * error;
-    }
-
-    // Avoid division by zero
-    if (sse[c] == 0.0) {
-      psnr[c] = MAX_PSNR;
-    } else {
-      psnr[c] = 10.0 * log10(num_pixels * MAX_SQUARED_ERROR / sse[c]);
-    }
-  }
-}
-
 typedef struct {
   // Semaphores for synchronization.
   kvz_sem_t* available_input_slots;
@@ -321,6 +277,38 @@ void output_recon_pictures(const kvz_api *const api,
   } while (picture_written);
 }
 
+typedef struct {
+  const kvz_api *api;
+  FILE *output;
+  bool failed;
+} slice_output_t;
+
+/**
+ * \brief Write encoded slices to the output file as soon as they are done.
+ *
+ * Used with --latency-budget.
+ */
+static void write_slice(void *opaque,
+                        kvz_data_chunk *data,
+                        uint32_t len,
+                        int32_t poc,
+                        int end_of_picture)
+{
+  slice_output_t *const out = opaque;
+
+  for (kvz_data_chunk *chunk = data; chunk != NULL; chunk = chunk->next) {
+    if (!out->failed &&
+        fwrite(chunk->data, sizeof(uint8_t), chunk->len, out->output) != chunk->len)
+    {
+      fprintf(stderr, "Failed to write data to file.\n");
+      out->failed = true;
+    }
+  }
+  fflush(out->output);
+
+  out->api->chunk_free(data);
+}
+
 static double calc_avg_qp(uint64_t qp_sum, uint32_t frames_done)
 {
   return (double)qp_sum / (double)frames_done;
@@ -527,6 +515,14 @@ int main(int argc, char *argv[])
 
   const encoder_control_t *encoder = enc->control;
 
+  slice_output_t slice_output = { api, output, false };
+  if (encoder->cfg.latency_budget > 0 &&
+      !api->encoder_set_slice_callback(enc, write_slice, &slice_output))
+  {
+    fprintf(stderr, "Failed to set slice callback.\n");
+    goto exit_failure;
+  }
+
   fprintf(stderr, "Input: %s, output: %s\n", opts->input, opts->output);
   fprintf(stderr, "  Video size: %dx%d (input=%dx%d)\n",
          encoder->in.width, encoder->in.height,
@@ -546,6 +542,8 @@ int main(int argc, char *argv[])
     uint64_t bitstream_length = 0;
     uint32_t frames_done = 0;
     double psnr_sum[3] = { 0.0, 0.0, 0.0 };
+    double ssim_sum = 0.0;
+    double ms_ssim_sum = 0.0;
     uint64_t qp_sum = 0;
 
     // how many bits have been written this second? used for checking if framerate exceeds level's limits
@@ -612,7 +610,6 @@ int main(int argc, char *argv[])
 
       kvz_data_chunk* chunks_out = NULL;
       kvz_picture *img_rec = NULL;
-      kvz_picture *img_src = NULL;
       uint32_t len_out = 0;
       kvz_frame_info info_out;
       if (!api->encoder_encode(enc,
@@ -620,19 +617,27 @@ int main(int argc, char *argv[])
                                &chunks_out,
                                &len_out,
                                &img_rec,
-                               &img_src,
+                               NULL,
                                &info_out)) {
         fprintf(stderr, "Failed to encode image.\n");
         api->picture_free(cur_in_img);
         goto exit_failure;
       }
 
-      if (chunks_out == NULL && cur_in_img == NULL) {
+      if (slice_output.failed) {
+        api->picture_free(cur_in_img);
+        api->picture_free(img_rec);
+        goto exit_failure;
+      }
+
+      if (len_out == 0 && cur_in_img == NULL) {
         // We are done since there is no more input and output left.
         break;
       }
 
-      if (chunks_out != NULL) {
+      if (len_out > 0) {
+        // With --latency-budget, the data has already been written by
+        // write_slice and chunks_out is NULL.
         uint64_t written = 0;
         // Write data into the output file.
         for (kvz_data_chunk *chunk = chunks_out;
@@ -686,15 +691,15 @@ int main(int argc, char *argv[])
 
         // Compute and print stats.
 
-        double frame_psnr[3] = { 0.0, 0.0, 0.0 };
-        if (encoder->cfg.calc_psnr && encoder->cfg.source_scan_type == KVZ_INTERLACING_NONE) {
-          // Do not compute PSNR for interlaced frames, because img_rec does not contain
-          // the deinterlaced frame yet.
-          compute_psnr(img_src, img_rec, frame_psnr);
+        if (encoder->cfg.source_scan_type != KVZ_INTERLACING_NONE) {
+          // Do not report quality for interlaced frames, because the encoder
+          // only measures the first field.
+          info_out.psnr[0] = info_out.psnr[1] = info_out.psnr[2] = 0.0;
+          info_out.ssim = info_out.ms_ssim = 0.0;
         }
 
         if (recout) {
-          // Since chunks_out was not NULL, img_rec should have been set.
+          // Since a frame was output, img_rec should have been set.
           assert(img_rec);
 
           // Move img_rec to the recon buffer.
@@ -715,18 +720,21 @@ int main(int argc, char *argv[])
         qp_sum      += info_out.qp;
         frames_done += 1;
 
-        psnr_sum[0] += frame_psnr[0];
-        psnr_sum[1] += frame_psnr[1];
-        psnr_sum[2] += frame_psnr[2];
+        psnr_sum[0] += info_out.psnr[0];
+        psnr_sum[1] += info_out.psnr[1];
+        psnr_sum[2] += info_out.psnr[2];
+        ssim_sum    += info_out.ssim;
+        ms_ssim_sum += info_out.ms_ssim;
 
-        print_frame_info(&info_out, frame_psnr, len_out, encoder->cfg.calc_psnr,
+        print_frame_info(&info_out, len_out, encoder->cfg.calc_psnr,
+                         encoder->cfg.calc_ssim,
+                         encoder->cfg.latency_budget > 0,
                          calc_avg_qp(qp_sum, frames_done));
       }
 
       api->picture_free(cur_in_img);
       api->chunk_free(chunks_out);
       api->picture_free(img_rec);
-      api->picture_free(img_src);
     }
 
     KVZ_GET_TIME(&encoding_end_real_time);
@@ -746,6 +754,11 @@ int main(int argc, char *argv[])
               psnr_sum[1] / frames_done,
               psnr_sum[2] / frames_done);
     }
+    if (encoder->cfg.calc_ssim && frames_done > 0) {
+      fprintf(stderr, " AVG SSIM %1.4f MS-SSIM %1.4f",
+              ssim_sum / frames_done,
+              ms_ssim_sum / frames_done);
+    }
     fprintf(stderr, "\n");
     fprintf(stderr, " Total CPU time: %.3f s.\n", ((float)(clock() - start_time)) / CLOCKS_PER_SEC);
 
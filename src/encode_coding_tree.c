@@ -63,12 +63,12 @@
 void kvz_encode_last_significant_xy(cabac_data_t * const cabac,
                                     uint8_t lastpos_x, uint8_t lastpos_y,
                                     uint8_t width, uint8_t height,
-                                    uint8_t type, uint8_t scan, double* bits_out)
+                                    uint8_t type, uint8_t scan, rd_bits_t* bits_out)
 {
   const int index = kvz_math_floor_log2(width) - 2;
   uint8_t ctx_offset = type ? 0 : (index * 3 + (index + 1) / 4);
   uint8_t shift = type ? index : (index + 3) / 4;
-  double bits = 0;
+  rd_bits_t bits = 0;
 
   cabac_ctx_t *base_ctx_x = (type ? cabac->ctx.cu_ctx_last_x_chroma : cabac->ctx.cu_ctx_last_x_luma);
   cabac_ctx_t *base_ctx_y = (type ? cabac->ctx.cu_ctx_last_y_chroma : cabac->ctx.cu_ctx_last_y_luma);
@@ -101,7 +101,7 @@ void kvz_encode_last_significant_xy(cabac_data_t * const cabac,
     const int suffix = lastpos_x - g_min_in_group[group_idx_x];
     const int write_bits = (group_idx_x - 2) / 2;
     CABAC_BINS_EP(cabac, suffix, write_bits, "last_sig_coeff_x_suffix");
-    if (cabac->only_count) bits += write_bits;
+    if (cabac->only_count) bits += RD_BITS(write_bits);
   }
 
   // last_sig_coeff_y_suffix
@@ -109,7 +109,7 @@ void kvz_encode_last_significant_xy(cabac_data_t * const cabac,
     const int suffix = lastpos_y - g_min_in_group[group_idx_y];
     const int write_bits = (group_idx_y - 2) / 2;
     CABAC_BINS_EP(cabac, suffix, write_bits, "last_sig_coeff_y_suffix");
-    if (cabac->only_count) bits += write_bits;
+    if (cabac->only_count) bits += RD_BITS(write_bits);
   }
   if (cabac->only_count && bits_out) *bits_out += bits;
 }
@@ -312,11 +312,11 @@ void kvz_encode_inter_prediction_unit(encoder_state_t * const state,
                                       cabac_data_t * const cabac,
                                       const cu_info_t * const cur_cu,
                                       int x, int y, int width, int height,
-                                      int depth, lcu_t* lcu, double* bits_out)
+                                      int depth, lcu_t* lcu, rd_bits_t* bits_out)
 {
   // Mergeflag
   int16_t num_cand = 0;
-  double bits = 0;
+  rd_bits_t bits = 0;
 
   CABAC_FBITS_UPDATE(cabac, &(cabac->ctx.cu_merge_flag_ext_model), cur_cu->merged, bits, "MergeFlag");
 
@@ -330,7 +330,7 @@ void kvz_encode_inter_prediction_unit(encoder_state_t * const state,
           CABAC_FBITS_UPDATE(cabac, &(cabac->ctx.cu_merge_idx_ext_model), symbol, bits, "MergeIndex");
         } else {
           CABAC_BIN_EP(cabac,symbol,"MergeIndex");
-          if(cabac->only_count) bits += 1;
+          if(cabac->only_count) bits += RD_BITS(1);
         }
         if (symbol == 0) break;
       }
@@ -338,7 +338,7 @@ void kvz_encode_inter_prediction_unit(encoder_state_t * const state,
   } else {
     if (state->frame->slicetype == KVZ_SLICE_B) {
       // Code Inter Dir
-      uint8_t inter_dir = cur_cu->inter.mv_dir-1;
+      uint8_t inter_dir = cur_cu->mv_dir-1;
 
       if (cur_cu->part_size == SIZE_2Nx2N || (LCU_WIDTH >> depth) != 8) {
         CABAC_FBITS_UPDATE(cabac, &(cabac->ctx.inter_dir[depth]), inter_dir == 2, bits, "inter_pred_idc");
@@ -349,7 +349,7 @@ void kvz_encode_inter_prediction_unit(encoder_state_t * const state,
     }
 
     for (uint32_t ref_list_idx = 0; ref_list_idx < 2; ref_list_idx++) {
-      if (!(cur_cu->inter.mv_dir & (1 << ref_list_idx))) {
+      if (!(cur_cu->mv_dir & (1 << ref_list_idx))) {
         continue;
       }
 
@@ -375,14 +375,14 @@ void kvz_encode_inter_prediction_unit(encoder_state_t * const state,
               CABAC_FBITS_UPDATE(cabac, &cabac->ctx.cu_ref_pic_model[1], symbol, bits, "ref_idx_lX");
             } else {
               CABAC_BIN_EP(cabac, symbol, "ref_idx_lX");
-              if (cabac->only_count) bits += 1;
+              if (cabac->only_count) bits += RD_BITS(1);
             }
             if (symbol == 0) break;
           }
         }
       }
 
-      if (state->frame->ref_list != REF_PIC_LIST_1 || cur_cu->inter.mv_dir != 3) {
+      if (state->frame->ref_list != REF_PIC_LIST_1 || cur_cu->mv_dir != 3) {
 
         int16_t mv_cand[2][2];
         if (lcu) {
@@ -467,7 +467,7 @@ static INLINE uint8_t intra_mode_encryption(encoder_state_t * const state,
 static void encode_intra_coding_unit(encoder_state_t * const state,
                                      cabac_data_t * const cabac,
                                      const cu_info_t * const cur_cu,
-                                     int x, int y, int depth, lcu_t* lcu, double* bits_out)
+                                     int x, int y, int depth, lcu_t* lcu, rd_bits_t* bits_out)
 {
   const videoframe_t * const frame = state->tile->frame;
   uint8_t intra_pred_mode_actual[4];
@@ -579,10 +579,10 @@ static void encode_intra_coding_unit(encoder_state_t * const state,
     // Signal index of the prediction mode in the prediction list.
     if (flag[j]) {
       CABAC_BIN_EP(cabac, (mpm_preds[j] == 0 ? 0 : 1), "mpm_idx");
-      if (cabac->only_count) *bits_out += 1;
+      if (cabac->only_count) *bits_out += RD_BITS(1);
       if (mpm_preds[j] != 0) {
         CABAC_BIN_EP(cabac, (mpm_preds[j] == 1 ? 0 : 1), "mpm_idx");
-        if (cabac->only_count) *bits_out += 1;
+        if (cabac->only_count) *bits_out += RD_BITS(1);
       }
     } else {
       // Signal the actual prediction mode.
@@ -601,7 +601,7 @@ static void encode_intra_coding_unit(encoder_state_t * const state,
       }
 
       CABAC_BINS_EP(cabac, tmp_pred, 5, "rem_intra_luma_pred_mode");
-      if (cabac->only_count) *bits_out += 5;
+      if (cabac->only_count) *bits_out += RD_BITS(5);
     }
   }
 
@@ -646,7 +646,7 @@ static void encode_intra_coding_unit(encoder_state_t * const state,
     } else {
       CABAC_FBITS_UPDATE(cabac, &(cabac->ctx.chroma_pred_model[0]), 1, *bits_out,"intra_chroma_pred_mode");
       CABAC_BINS_EP(cabac, pred_mode, 2, "intra_chroma_pred_mode");
-      if (cabac->only_count) *bits_out += 2;
+      if (cabac->only_count) *bits_out += RD_BITS(2);
     }
   }
 
@@ -656,7 +656,7 @@ static void encode_intra_coding_unit(encoder_state_t * const state,
     encode_transform_coeff(state, x, y, depth, 0, 0, 0);
 }
 
-double kvz_encode_part_mode(encoder_state_t * const state,
+rd_bits_t kvz_encode_part_mode(encoder_state_t * const state,
                              cabac_data_t * const cabac,
                              const cu_info_t * const cur_cu,
                              int depth)
@@ -691,7 +691,7 @@ double kvz_encode_part_mode(encoder_state_t * const state,
   //  log2CbSize == MinCbLog2SizeY |  0  1  2  bypass
   //  log2CbSize >  MinCbLog2SizeY |  0  1  3  bypass
   // ------------------------------+------------------
-  double bits = 0;
+  rd_bits_t bits = 0;
   if (cur_cu->type == CU_INTRA) {
     if (depth == MAX_DEPTH) {
       cabac->cur_ctx = &(cabac->ctx.part_size_model[0]);
@@ -732,10 +732,10 @@ double kvz_encode_part_mode(encoder_state_t * const state,
       if (cur_cu->part_size == SIZE_2NxnU ||
           cur_cu->part_size == SIZE_nLx2N) {
         CABAC_BINS_EP(cabac, 0, 1, "part_mode AMP");
-        if(cabac->only_count) bits += 1;
+        if(cabac->only_count) bits += RD_BITS(1);
       } else {
         CABAC_BINS_EP(cabac, 1, 1, "part_mode AMP");
-        if(cabac->only_count) bits += 1;
+        if(cabac->only_count) bits += RD_BITS(1);
       }
     }
   }
@@ -945,12 +945,12 @@ end:
   }
 }
 
-double kvz_mock_encode_coding_unit(
+rd_bits_t kvz_mock_encode_coding_unit(
   encoder_state_t* const state,
   cabac_data_t* cabac,
   int x, int y, int depth,
   lcu_t* lcu, cu_info_t* cur_cu) {
-  double bits = 0;
+  rd_bits_t bits = 0;
   const encoder_control_t* const ctrl = state->encoder_control;
 
   int x_local = SUB_SCU(x);
@@ -1021,7 +1021,7 @@ double kvz_mock_encode_coding_unit(
           }
           else {
             CABAC_BIN_EP(cabac, symbol, "MergeIndex");
-            if(cabac->only_count) bits += 1;
+            if(cabac->only_count) bits += RD_BITS(1);
           }
           if (symbol == 0) {
             break;
@@ -1062,7 +1062,7 @@ double kvz_mock_encode_coding_unit(
 void kvz_encode_mvd(encoder_state_t * const state,
                     cabac_data_t *cabac,
                     int32_t mvd_hor,
-                    int32_t mvd_ver, double* bits_out)
+                    int32_t mvd_ver, rd_bits_t* bits_out)
 {
   const int8_t hor_abs_gr0 = mvd_hor != 0;
   const int8_t ver_abs_gr0 = mvd_ver != 0;
@@ -1084,7 +1084,7 @@ void kvz_encode_mvd(encoder_state_t * const state,
   if (hor_abs_gr0) {
     if (mvd_hor_abs > 1) {
       uint32_t bits = kvz_cabac_write_ep_ex_golomb(state, cabac, mvd_hor_abs - 2, 1);
-      if(cabac->only_count) *bits_out += bits;
+      if(cabac->only_count) *bits_out += RD_BITS(bits);
     }
     uint32_t mvd_hor_sign = (mvd_hor > 0) ? 0 : 1;
     if (!state->cabac.only_count &&
@@ -1093,12 +1093,12 @@ void kvz_encode_mvd(encoder_state_t * const state,
       mvd_hor_sign = mvd_hor_sign ^ kvz_crypto_get_key(state->crypto_hdl, 1);
     }
     CABAC_BIN_EP(cabac, mvd_hor_sign, "mvd_sign_flag_hor");
-    if (cabac->only_count) *bits_out += 1;
+    if (cabac->only_count) *bits_out += RD_BITS(1);
   }
   if (ver_abs_gr0) {
     if (mvd_ver_abs > 1) {
       uint32_t bits = kvz_cabac_write_ep_ex_golomb(state, cabac, mvd_ver_abs - 2, 1);
-      if (cabac->only_count) *bits_out += bits;
+      if (cabac->only_count) *bits_out += RD_BITS(bits);
     }
     uint32_t mvd_ver_sign = mvd_ver > 0 ? 0 : 1;
     if (!state->cabac.only_count &&
@@ -1107,6 +1107,6 @@ void kvz_encode_mvd(encoder_state_t * const state,
       mvd_ver_sign = mvd_ver_sign^kvz_crypto_get_key(state->crypto_hdl, 1);
     }
     CABAC_BIN_EP(cabac, mvd_ver_sign, "mvd_sign_flag_ver");
-    if (cabac->only_count) *bits_out += 1;
+    if (cabac->only_count) *bits_out += RD_BITS(1);
   }
 }
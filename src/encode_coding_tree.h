@@ -50,15 +50,15 @@ void kvz_encode_mvd(encoder_state_t * const state,
                     cabac_data_t *cabac,
                     int32_t mvd_hor,
                     int32_t mvd_ver,
-                    double* bits_out);
+                    rd_bits_t* bits_out);
 
-double kvz_mock_encode_coding_unit(
+rd_bits_t kvz_mock_encode_coding_unit(
   encoder_state_t* const state,
   cabac_data_t* cabac,
   int x, int y, int depth,
   lcu_t* lcu, cu_info_t* cur_cu);
 
-double kvz_encode_part_mode(encoder_state_t* const state,
+rd_bits_t kvz_encode_part_mode(encoder_state_t* const state,
   cabac_data_t* const cabac,
   const cu_info_t* const cur_cu,
   int depth);
@@ -69,11 +69,11 @@ void kvz_encode_inter_prediction_unit(encoder_state_t* const state,
                                       int x, int y, int width, int height,
                                       int depth, 
                                       lcu_t* lcu,
-                                      double* bits_out);
+                                      rd_bits_t* bits_out);
 
 void kvz_encode_last_significant_xy(cabac_data_t * const cabac,
                                     uint8_t lastpos_x, uint8_t lastpos_y,
                                     uint8_t width, uint8_t height,
-                                    uint8_t type, uint8_t scan, double* bits_out);
+                                    uint8_t type, uint8_t scan, rd_bits_t* bits_out);
 
 #endif // ENCODE_CODING_TREE_H_
@@ -32,6 +32,7 @@
 
 #include "encoder.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -41,9 +42,14 @@
 #include "strategyselector.h"
 #include "kvz_math.h"
 #include "fast_coeff_cost.h"
+#include "ml_inter_cu_depth_pred.h"
 
 static int encoder_control_init_gop_layer_weights(encoder_control_t * const);
 
+// Number of threads assumed by the automatic parallelism settings with
+// --deterministic so that they don't depend on the machine.
+#define DETERMINISTIC_NUM_THREADS 8
+
 static unsigned cfg_num_threads(void)
 {
   if (kvz_g_hardware_flags.logical_cpu_count == 0) {
@@ -125,6 +131,185 @@ static int get_max_parallelism(const encoder_control_t *const encoder)
 }
 
 
+/**
+ * \brief Select WPP, uniform tiles and OWF for the available threads.
+ *
+ * Candidates are evaluated with the same parallelism model as the automatic
+ * OWF selection. The candidate that keeps the most threads busy is chosen.
+ * Ties are broken in favor of WPP, then fewer tiles (less coding loss) and
+ * then fewer frames in flight (less latency).
+ *
+ * The OWF is selected only if it was left to automatic selection. Explicit
+ * tile splits are kept as they are.
+ *
+ * \param encoder       encoder control with the config to update
+ * \param max_threads   number of threads available
+ */
+static void encoder_control_select_parallelism(encoder_control_t *const encoder,
+                                               int max_threads)
+{
+  kvz_config *const cfg = &encoder->cfg;
+
+  const int height_lcu = CEILDIV(cfg->height, LCU_WIDTH);
+  const bool select_owf   = cfg->owf < 0;
+  const bool select_tiles = !cfg->tiles_width_split && !cfg->tiles_height_split;
+  // WPP substreams in slices need WPP.
+  const bool wpp_required = cfg->slices & KVZ_SLICES_WPP;
+
+  // Frames in flight are owf + 1 and two frames are added on top of the
+  // selected value below for buffering.
+  int min_owf = cfg->owf;
+  int max_owf = cfg->owf;
+  if (select_owf) {
+    min_owf = 0;
+    max_owf = max_threads;
+    if (cfg->max_latency_frames > 0) {
+      max_owf = MIN(max_owf, MAX(0, cfg->max_latency_frames - 3));
+    }
+  }
+
+  int best_threads = -1;
+  int best_wpp     = cfg->wpp;
+  int best_tiles_w = cfg->tiles_width_count;
+  int best_tiles_h = cfg->tiles_height_count;
+  int best_owf     = min_owf;
+
+  // Tile columns must be at least 256 and tile rows at least 64 luma
+  // samples high.
+  int min_tiles_w = cfg->tiles_width_count;
+  int min_tiles_h = cfg->tiles_height_count;
+  int max_tiles_w = cfg->tiles_width_count;
+  int max_tiles_h = cfg->tiles_height_count;
+  if (select_tiles) {
+    min_tiles_w = 1;
+    min_tiles_h = 1;
+    max_tiles_w = CLIP(1, max_threads, cfg->width / 256);
+    max_tiles_h = CLIP(1, max_threads, height_lcu);
+  }
+  const int max_tiles = select_tiles ?
+    MAX(1, max_threads) : max_tiles_w * max_tiles_h;
+
+  for (int wpp = 1; wpp >= 0; --wpp) {
+    if (!wpp && wpp_required) break;
+
+    for (int tiles = 1; tiles <= max_tiles; ++tiles) {
+      for (int tiles_w = min_tiles_w; tiles_w <= max_tiles_w; ++tiles_w) {
+        if (tiles % tiles_w != 0) continue;
+        const int tiles_h = tiles / tiles_w;
+        if (tiles_h < min_tiles_h || tiles_h > max_tiles_h) continue;
+        // Tiles and WPP together are not supported by any profile.
+        if (wpp && tiles > 1) continue;
+
+        int prev_threads = -1;
+        for (int owf = min_owf; owf <= max_owf; ++owf) {
+          cfg->wpp = wpp;
+          cfg->tiles_width_count  = tiles_w;
+          cfg->tiles_height_count = tiles_h;
+          cfg->owf = owf;
+
+          const int threads = MIN(max_threads, get_max_parallelism(encoder));
+          if (threads <= prev_threads) {
+            // No improvement from more frames in flight.
+            break;
+          }
+          prev_threads = threads;
+
+          if (threads > best_threads) {
+            best_threads = threads;
+            best_wpp     = wpp;
+            best_tiles_w = tiles_w;
+            best_tiles_h = tiles_h;
+            best_owf     = owf;
+          }
+        }
+      }
+    }
+  }
+
+  cfg->wpp                = best_wpp;
+  cfg->tiles_width_count  = best_tiles_w;
+  cfg->tiles_height_count = best_tiles_h;
+  cfg->owf                = best_owf;
+
+  if (select_owf) {
+    // Add two frames so that we have frames ready to be coded when one is
+    // completed.
+    cfg->owf += 2;
+    if (cfg->max_latency_frames > 0) {
+      cfg->owf = MIN(cfg->owf, cfg->max_latency_frames - 1);
+    }
+  }
+
+  if (cfg->enable_logging_output) {
+    fprintf(stderr,
+            "--auto-parallelism selected %s, %dx%d tiles and --owf=%d "
+            "(estimated %d parallel jobs).\n",
+            cfg->wpp ? "WPP" : "no WPP",
+            cfg->tiles_width_count, cfg->tiles_height_count,
+            cfg->owf, best_threads);
+  }
+}
+
+
+/**
+ * \brief Limit OWF and split frames into slices to meet --latency-budget.
+ *
+ * Every frame in flight adds about one frame period of latency, so OWF is
+ * limited to the number of whole frame periods that fit in the budget.
+ * Slices are output as soon as they are done, so frames are split into
+ * enough slices that waiting for one takes at most half of the budget,
+ * assuming that a frame takes one frame period to encode. WPP substreams
+ * can't be output on their own because their entry points are written in
+ * the slice header.
+ *
+ * The slices are made from rows of tiles with one slice per tile. Slices
+ * inside a tile are not used because the loop filters of the encoder don't
+ * stop at slice boundaries and because they don't work with WPP when a
+ * slice is only one CTU row high.
+ *
+ * Explicit slice and tile settings are kept as they are, but tiles are put
+ * in their own slices.
+ *
+ * \param encoder   encoder control with the config to update
+ */
+static void encoder_control_apply_latency_budget(encoder_control_t *const encoder)
+{
+  kvz_config *const cfg = &encoder->cfg;
+
+  const double framerate = cfg->framerate_num != 0 ?
+    cfg->framerate_num / (double)cfg->framerate_denom : cfg->framerate;
+  const double frame_ms = 1000.0 / framerate;
+
+  const int max_owf = MAX(0, (int)(cfg->latency_budget / frame_ms) - 1);
+  if (cfg->owf > max_owf) {
+    cfg->owf = max_owf;
+  }
+
+  const int height_lcu = CEILDIV(cfg->height, LCU_WIDTH);
+  const int num_slices = CLIP(1, height_lcu,
+                              (int)ceil(2.0 * frame_ms / cfg->latency_budget));
+
+  if (cfg->tiles_width_count * cfg->tiles_height_count == 1 &&
+      cfg->slice_count == 1)
+  {
+    cfg->tiles_height_count = num_slices;
+  }
+
+  const int num_tiles = cfg->tiles_width_count * cfg->tiles_height_count;
+  if (num_tiles > 1) {
+    cfg->slices |= KVZ_SLICES_TILES;
+  }
+
+  if (cfg->enable_logging_output) {
+    fprintf(stderr,
+            "--latency-budget=%d: using --owf=%d and %d slices.\n",
+            cfg->latency_budget,
+            cfg->owf,
+            num_tiles > 1 ? num_tiles : cfg->slice_count);
+  }
+}
+
+
 /**
  * \brief Allocate and initialize an encoder control structure.
  *
@@ -159,6 +344,34 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
   encoder->cfg.tiles_height_split = NULL;
   encoder->cfg.slice_addresses_in_ts = NULL;
   encoder->cfg.fast_coeff_table_fn = NULL;
+  encoder->cfg.fast_rdoq_table_fn = NULL;
+  encoder->cfg.ml_model_fn = NULL;
+
+  if (encoder->cfg.latency_budget > 0 &&
+      encoder->cfg.gop_len > 0 &&
+      !encoder->cfg.gop_lowdelay)
+  {
+    // Reordering frames would add at least a GOP of latency.
+    encoder->cfg.gop_len = 0;
+    if (cfg->enable_logging_output) {
+      fprintf(stderr, "Disabling random access GOP because of --latency-budget.\n");
+    }
+  }
+
+  if (encoder->cfg.gdr_period > 0) {
+    // The refreshed area is tracked by frame number, which requires that
+    // frames are coded in output order and that POC is never reset.
+    if (encoder->cfg.gop_len > 0 && !encoder->cfg.gop_lowdelay) {
+      encoder->cfg.gop_len = 0;
+      if (cfg->enable_logging_output) {
+        fprintf(stderr, "Disabling random access GOP because of --gdr.\n");
+      }
+    }
+    encoder->cfg.intra_period = 0;
+    // Collocated motion vectors of pictures preceding the recovery point
+    // are not available to a decoder starting from it.
+    encoder->cfg.tmvp_enable = 0;
+  }
 
   if (encoder->cfg.gop_len > 0) {
     if (encoder->cfg.gop_lowdelay) {
@@ -192,8 +405,14 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
   }
   max_threads = MAX(1, max_threads);
 
+  // Threads that the automatic parallelism settings are selected for.
+  const int select_threads =
+    encoder->cfg.deterministic ? DETERMINISTIC_NUM_THREADS : max_threads;
+
   // Need to set owf before initializing threadqueue.
-  if (encoder->cfg.owf < 0) {
+  if (encoder->cfg.auto_parallelism) {
+    encoder_control_select_parallelism(encoder, select_threads);
+  } else if (encoder->cfg.owf < 0) {
     int best_parallelism = 0;
 
     for (encoder->cfg.owf = 0; true; encoder->cfg.owf++) {
@@ -206,7 +425,7 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
       }
 
       best_parallelism = parallelism;
-      if (parallelism >= max_threads) {
+      if (parallelism >= select_threads) {
         // Cannot have more parallelism than there are threads.
         break;
       }
@@ -224,6 +443,30 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
     if (cfg->enable_logging_output) fprintf(stderr, "--threads=auto value set to %d.\n", encoder->cfg.threads);
   }
 
+  if (encoder->cfg.latency_budget > 0) {
+    encoder_control_apply_latency_budget(encoder);
+  }
+
+  if (encoder->cfg.adaptive_mv_range &&
+      (!encoder->cfg.wpp ||
+       encoder->cfg.tiles_width_count * encoder->cfg.tiles_height_count > 1 ||
+       encoder->cfg.slice_count > 1))
+  {
+    // Reconstruction progress is tracked as whole CTU rows of the frame.
+    encoder->cfg.adaptive_mv_range = 0;
+    if (cfg->enable_logging_output) {
+      fprintf(stderr, "Disabling --adaptive-mv-range because it requires WPP without tiles or slices.\n");
+    }
+  }
+
+  if (encoder->cfg.adaptive_mv_range && encoder->cfg.deterministic) {
+    // The search range depends on how far the reference frame has progressed.
+    encoder->cfg.adaptive_mv_range = 0;
+    if (cfg->enable_logging_output) {
+      fprintf(stderr, "Disabling --adaptive-mv-range because of --deterministic.\n");
+    }
+  }
+
   if (encoder->cfg.source_scan_type != KVZ_INTERLACING_NONE) {
     // If using interlaced coding with OWF, the OWF has to be an even number
     // to ensure that the pair of fields will be output for the same picture.
@@ -291,6 +534,30 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
     kvz_fast_coeff_use_default_table(&encoder->fast_coeff_table);
   }
 
+  if (cfg->fastrd_online_interval > 0) {
+    encoder->fast_coeff_online = kvz_fast_coeff_online_alloc(&encoder->fast_coeff_table,
+                                                             encoder->threadqueue);
+    if (!encoder->fast_coeff_online) {
+      fprintf(stderr, "Could not allocate fast coeff cost statistics.\n");
+      goto init_failed;
+    }
+  }
+
+  if (cfg->fast_rdoq_table_fn) {
+    FILE *fast_rdoq_table_f = fopen(cfg->fast_rdoq_table_fn, "rb");
+    if (fast_rdoq_table_f == NULL) {
+      fprintf(stderr, "Could not open fast RDOQ table file.\n");
+      goto init_failed;
+    }
+    if (kvz_fast_rdoq_table_parse(&encoder->fast_rdoq_table, fast_rdoq_table_f) != 0) {
+      fprintf(stderr, "Failed to parse fast RDOQ table, using default\n");
+      kvz_fast_rdoq_use_default_table(&encoder->fast_rdoq_table);
+    }
+    fclose(fast_rdoq_table_f);
+  } else {
+    kvz_fast_rdoq_use_default_table(&encoder->fast_rdoq_table);
+  }
+
   if (cfg->fastrd_sampling_on || cfg->fastrd_accuracy_check_on) {
     if (cfg->fastrd_learning_outdir_fn == NULL) {
       fprintf(stderr, "No output file defined for Fast RD sampling or accuracy check.\n");
@@ -301,6 +568,19 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
     }
   }
 
+  if (cfg->ml_model_fn) {
+    encoder->ml_models = kvz_ml_model_set_load(cfg->ml_model_fn);
+    if (!encoder->ml_models) {
+      goto init_failed;
+    }
+  }
+
+  if (cfg->ml_inter_samples_fn) {
+    if (kvz_ml_inter_init_samples(cfg->ml_inter_samples_fn) != 0) {
+      goto init_failed;
+    }
+  }
+
   kvz_scalinglist_process(&encoder->scaling_list, encoder->bitdepth);
 
   kvz_encoder_control_input_init(encoder, encoder->cfg.width, encoder->cfg.height);
@@ -313,6 +593,16 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
   }
   encoder->target_avg_bpp = encoder->target_avg_bppic / encoder->in.pixels_per_pic;
 
+  if (encoder->cfg.vbv_bufsize > 0) {
+    if (encoder->cfg.vbv_maxrate == 0) {
+      encoder->cfg.vbv_maxrate = encoder->cfg.target_bitrate;
+    }
+    // Round down to values that can be signaled in the HRD parameters with
+    // bit_rate_scale and cpb_size_scale equal to zero.
+    encoder->cfg.vbv_maxrate = MAX(64, encoder->cfg.vbv_maxrate & ~63);
+    encoder->cfg.vbv_bufsize = MAX(16, encoder->cfg.vbv_bufsize & ~15);
+  }
+
   if (encoder->cfg.target_bitrate > 0 &&
       !encoder_control_init_gop_layer_weights(encoder))
   {
@@ -584,8 +874,16 @@ encoder_control_t* kvz_encoder_control_init(const kvz_config *const cfg)
     }
   }
 
+  // The HRD is signaled only with the timing information.
+  encoder->vui.hrd_parameters_present_flag =
+    encoder->cfg.vbv_bufsize > 0 && encoder->vui.timing_info_present_flag;
+
   if (encoder->cfg.vps_period >= 0) {
-    encoder->cfg.vps_period = encoder->cfg.vps_period * encoder->cfg.intra_period;
+    // With GDR there are no intra frames after the first one so the
+    // parameter sets are re-sent with the recovery points.
+    const int32_t period = encoder->cfg.gdr_period > 0 ?
+                           encoder->cfg.gdr_period : encoder->cfg.intra_period;
+    encoder->cfg.vps_period = encoder->cfg.vps_period * period;
   } else {
     encoder->cfg.vps_period = -1;
   }
@@ -630,10 +928,14 @@ void kvz_encoder_control_free(encoder_control_t *const encoder)
 
   kvz_scalinglist_destroy(&encoder->scaling_list);
 
+  kvz_fast_coeff_online_free(encoder->fast_coeff_online);
+
   kvz_threadqueue_free(encoder->threadqueue);
   encoder->threadqueue = NULL;
 
   kvz_close_rdcost_outfiles();
+  kvz_ml_inter_close_samples();
+  kvz_ml_model_set_free(encoder->ml_models);
 
   if (encoder->roi_file) {
     fclose(encoder->roi_file);
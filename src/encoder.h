@@ -43,6 +43,8 @@
 #include "scalinglist.h"
 #include "threadqueue.h"
 #include "fast_coeff_cost.h"
+#include "fast_rdoq.h"
+#include "ml_model.h"
 
 /* Encoder control options, the main struct */
 typedef struct encoder_control_t
@@ -93,6 +95,7 @@ typedef struct encoder_control_t
     int8_t frame_field_info_present_flag;
 
     int8_t timing_info_present_flag;
+    int8_t hrd_parameters_present_flag;
   } vui;
 
   //scaling list
@@ -148,6 +151,12 @@ typedef struct encoder_control_t
   int32_t poc_lsb_bits;
 
   fast_coeff_table_t fast_coeff_table;
+  //! Online refitting of the fast coefficient cost weights, or NULL.
+  fast_coeff_online_t *fast_coeff_online;
+  fast_rdoq_table_t fast_rdoq_table;
+
+  //! Models loaded with --ml-model, or NULL to use the built-in ones.
+  ml_model_set_t *ml_models;
 
 } encoder_control_t;
 
@@ -223,6 +223,45 @@ static void encoder_state_write_bitstream_scaling_list(bitstream_t *stream,
 }
 
 
+// Lengths of the delay fields in the buffering period and picture timing
+// SEI messages.
+#define HRD_INITIAL_CPB_REMOVAL_DELAY_LENGTH 24
+#define HRD_AU_CPB_REMOVAL_DELAY_LENGTH 24
+#define HRD_DPB_OUTPUT_DELAY_LENGTH 24
+
+/**
+ * \brief Write NAL HRD parameters for the VBV buffer.
+ *
+ * The same buffer is signaled for all sub-layers with a single CPB and
+ * variable bitrate.
+ */
+static void encoder_state_write_bitstream_HRD(bitstream_t *stream,
+                                              encoder_state_t * const state)
+{
+  const encoder_control_t * const encoder = state->encoder_control;
+
+  WRITE_U(stream, 1, 1, "nal_hrd_parameters_present_flag");
+  WRITE_U(stream, 0, 1, "vcl_hrd_parameters_present_flag");
+  WRITE_U(stream, 0, 1, "sub_pic_hrd_params_present_flag");
+  WRITE_U(stream, 0, 4, "bit_rate_scale");
+  WRITE_U(stream, 0, 4, "cpb_size_scale");
+  WRITE_U(stream, HRD_INITIAL_CPB_REMOVAL_DELAY_LENGTH - 1, 5, "initial_cpb_removal_delay_length_minus1");
+  WRITE_U(stream, HRD_AU_CPB_REMOVAL_DELAY_LENGTH - 1, 5, "au_cpb_removal_delay_length_minus1");
+  WRITE_U(stream, HRD_DPB_OUTPUT_DELAY_LENGTH - 1, 5, "dpb_output_delay_length_minus1");
+
+  // One iteration for each sub-layer, see sps_max_sub_layers_minus1.
+  for (int i = 0; i < 2; ++i) {
+    WRITE_U(stream, 1, 1, "fixed_pic_rate_general_flag");
+    WRITE_UE(stream, 0, "elemental_duration_in_tc_minus1");
+    WRITE_UE(stream, 0, "cpb_cnt_minus1");
+
+    // sub_layer_hrd_parameters
+    WRITE_UE(stream, encoder->cfg.vbv_maxrate / 64 - 1, "bit_rate_value_minus1");
+    WRITE_UE(stream, encoder->cfg.vbv_bufsize / 16 - 1, "cpb_size_value_minus1");
+    WRITE_U(stream, 0, 1, "cbr_flag");
+  }
+}
+
 static void encoder_state_write_bitstream_VUI(bitstream_t *stream,
                                               encoder_state_t * const state)
 {
@@ -322,7 +361,10 @@ static void encoder_state_write_bitstream_VUI(bitstream_t *stream,
     WRITE_U(stream, encoder->vui.time_scale, 32, "vui_time_scale");
 
     WRITE_U(stream, 0, 1, "vui_poc_proportional_to_timing_flag");
-    WRITE_U(stream, 0, 1, "vui_hrd_parameters_present_flag");    
+    WRITE_U(stream, encoder->vui.hrd_parameters_present_flag, 1, "vui_hrd_parameters_present_flag");
+    if (encoder->vui.hrd_parameters_present_flag) {
+      encoder_state_write_bitstream_HRD(stream, state);
+    }
   }
   
   WRITE_U(stream, 0, 1, "bitstream_restriction_flag");
@@ -674,8 +716,20 @@ static void encoder_state_write_active_parameter_sets_sei_message(encoder_state_
 static void encoder_state_write_picture_timing_sei_message(encoder_state_t * const state) {
 
   bitstream_t * const stream = &state->stream;
+  const encoder_control_t * const encoder = state->encoder_control;
+
+  int payload_bits = 0;
+  if (encoder->vui.frame_field_info_present_flag) {
+    payload_bits += 4 + 2 + 1;
+  }
+  if (encoder->vui.hrd_parameters_present_flag) {
+    payload_bits += HRD_AU_CPB_REMOVAL_DELAY_LENGTH + HRD_DPB_OUTPUT_DELAY_LENGTH;
+  }
 
-  if (state->encoder_control->vui.frame_field_info_present_flag){
+  sei_write_payload_type(stream, SEI_PAYLOAD_TYPE_PIC_TIMING);
+  sei_write_payload_size(stream, (payload_bits + 7) / 8);
+
+  if (encoder->vui.frame_field_info_present_flag){
 
     int8_t odd_picture = state->frame->num % 2;
     int8_t pic_struct = 0; //0: progressive picture, 1: top field, 2: bottom field, 3...
@@ -699,14 +753,88 @@ static void encoder_state_write_picture_timing_sei_message(encoder_state_t * con
       break;
     }
 
-    sei_write_payload_type(stream, SEI_PAYLOAD_TYPE_PIC_TIMING);
-    sei_write_payload_size(stream, 1);
     WRITE_U(stream, pic_struct, 4, "pic_struct");
     WRITE_U(stream, source_scan_type, 2, "source_scan_type");
     WRITE_U(stream, 0, 1, "duplicate_flag");
+  }
 
-    kvz_bitstream_align(stream);
+  if (encoder->vui.hrd_parameters_present_flag) {
+    // Pictures are removed from the CPB one clock tick apart in decoding
+    // order. The delay of a picture with a buffering period SEI is counted
+    // from the previous one.
+    const int32_t bp_num = state->frame->hrd_bp_num == state->frame->num ?
+      state->frame->hrd_prev_bp_num : state->frame->hrd_bp_num;
+    const int32_t cpb_removal_delay = MAX(1, state->frame->num - bp_num);
+
+    // Pictures are output one clock tick apart in output order, after
+    // enough pictures have been decoded to fill the reordering delay.
+    const int32_t decode_idx = state->frame->num - state->frame->hrd_poc0_num;
+    const int32_t dpb_output_delay =
+      MAX(0, state->frame->poc - decode_idx + max_num_reorder_pics(encoder));
+
+    WRITE_U(stream, cpb_removal_delay - 1, HRD_AU_CPB_REMOVAL_DELAY_LENGTH, "au_cpb_removal_delay_minus1");
+    WRITE_U(stream, dpb_output_delay, HRD_DPB_OUTPUT_DELAY_LENGTH, "pic_dpb_output_delay");
   }
+
+  kvz_bitstream_align(stream);
+}
+
+/**
+ * \brief Write a buffering period SEI message.
+ *
+ * The initial removal delay is the time it takes to fill the CPB to the
+ * fullness of the VBV model at the maximum rate.
+ */
+static void encoder_state_write_buffering_period_sei_message(encoder_state_t * const state)
+{
+  bitstream_t * const stream = &state->stream;
+  const kvz_config * const cfg = &state->encoder_control->cfg;
+
+  const double fullness = state->frame->num == 0 ?
+    cfg->vbv_init * cfg->vbv_bufsize :
+    state->previous_encoder_state->frame->vbv_fullness;
+  const double max_delay = 90000.0 * cfg->vbv_bufsize / cfg->vbv_maxrate;
+  const uint32_t initial_cpb_removal_delay =
+    (uint32_t)CLIP(1.0, max_delay, 90000.0 * fullness / cfg->vbv_maxrate);
+
+  const int payload_bits = 1 + 1 + 1 + HRD_AU_CPB_REMOVAL_DELAY_LENGTH +
+                           2 * HRD_INITIAL_CPB_REMOVAL_DELAY_LENGTH;
+
+  sei_write_payload_type(stream, SEI_PAYLOAD_TYPE_BUFFERING_PERIOD);
+  sei_write_payload_size(stream, (payload_bits + 7) / 8);
+
+  WRITE_UE(stream, 0, "bp_seq_parameter_set_id");
+  WRITE_U(stream, 0, 1, "irap_cpb_params_present_flag");
+  WRITE_U(stream, 0, 1, "concatenation_flag");
+  WRITE_U(stream, 0, HRD_AU_CPB_REMOVAL_DELAY_LENGTH, "au_cpb_removal_delay_delta_minus1");
+  WRITE_U(stream, initial_cpb_removal_delay, HRD_INITIAL_CPB_REMOVAL_DELAY_LENGTH, "nal_initial_cpb_removal_delay");
+  WRITE_U(stream, 0, HRD_INITIAL_CPB_REMOVAL_DELAY_LENGTH, "nal_initial_cpb_removal_offset");
+
+  kvz_bitstream_align(stream);
+}
+
+/**
+ * \brief Write a recovery point SEI message for gradual decoding refresh.
+ *
+ * The picture gdr_period - 1 frames after this one is the first one that
+ * is fully refreshed.
+ */
+static void encoder_state_write_recovery_point_sei_message(encoder_state_t * const state)
+{
+  bitstream_t * const stream = &state->stream;
+
+  const int32_t recovery_poc_cnt = state->encoder_control->cfg.gdr_period - 1;
+  // Length of the se(v) code of recovery_poc_cnt.
+  const uint32_t code_num = recovery_poc_cnt <= 0 ? -recovery_poc_cnt << 1 : (recovery_poc_cnt << 1) - 1;
+  const int payload_bits = 2 * kvz_math_floor_log2(code_num + 1) + 1 + 2;
+
+  sei_write_payload_type(stream, SEI_PAYLOAD_TYPE_RECOVERY_POINT);
+  sei_write_payload_size(stream, (payload_bits + 7) / 8);
+  WRITE_SE(stream, recovery_poc_cnt, "recovery_poc_cnt");
+  WRITE_U(stream, 1, 1, "exact_match_flag");
+  WRITE_U(stream, 0, 1, "broken_link_flag");
+
+  kvz_bitstream_align(stream);
 }
 
 
@@ -962,42 +1090,68 @@ void kvz_encoder_state_write_bitstream_slice_header(
 static void add_checksum(encoder_state_t * const state)
 {
   bitstream_t * const stream = &state->stream;
-  const videoframe_t * const frame = state->tile->frame;
-  unsigned char checksum[3][SEI_HASH_MAX_LENGTH];
+  const encoder_control_t * const encoder = state->encoder_control;
 
   kvz_nal_write(stream, KVZ_NAL_SUFFIX_SEI_NUT, 0, 0);
 
   sei_write_payload_type(stream, SEI_PAYLOAD_TYPE_DECODED_PICTURE_HASH);
 
-  int num_colors = (state->encoder_control->chroma_format == KVZ_CSP_400 ? 1 : 3);
+  int num_colors = (encoder->chroma_format == KVZ_CSP_400 ? 1 : 3);
 
-  switch (state->encoder_control->cfg.hash)
+  // The checksums and CRCs of the parts of the picture have been computed
+  // when encoding the LCUs.
+  const int num_lcus = encoder->in.width_in_lcu * encoder->in.height_in_lcu;
+  uint32_t lcu_hashes[3] = { 0, 0, 0 };
+
+  switch (encoder->cfg.hash)
   {
   case KVZ_HASH_CHECKSUM:
-    kvz_image_checksum(frame->rec, checksum, state->encoder_control->bitdepth);
+    for (int lcu = 0; lcu < num_lcus; ++lcu) {
+      for (int i = 0; i < num_colors; ++i) {
+        lcu_hashes[i] += state->frame->lcu_stats[lcu].hash[i];
+      }
+    }
 
     sei_write_payload_size(stream, 1 + num_colors * 4);
     WRITE_U(stream, 2, 8, "hash_type");  // 2 = checksum
 
     for (int i = 0; i < num_colors; ++i) {
-      uint32_t checksum_val = (
-        (checksum[i][0] << 24) + (checksum[i][1] << 16) +
-        (checksum[i][2] << 8) + (checksum[i][3]));
+      uint32_t checksum_val = lcu_hashes[i];
       WRITE_U(stream, checksum_val, 32, "picture_checksum");
       CHECKPOINT("checksum[%d] = %u", i, checksum_val);
     }
 
     break;
 
-  case KVZ_HASH_MD5:
-    kvz_image_md5(frame->rec, checksum, state->encoder_control->bitdepth);
+  case KVZ_HASH_CRC:
+    for (int lcu = 0; lcu < num_lcus; ++lcu) {
+      for (int i = 0; i < num_colors; ++i) {
+        lcu_hashes[i] ^= state->frame->lcu_stats[lcu].hash[i];
+      }
+    }
 
+    sei_write_payload_size(stream, 1 + num_colors * 2);
+    WRITE_U(stream, 1, 8, "hash_type");  // 1 = crc
+
+    for (int i = 0; i < num_colors; ++i) {
+      const int shift = i == 0 ? 0 : 1;
+      uint16_t crc_val = kvz_crc_plane((uint16_t)lcu_hashes[i],
+                                       encoder->in.width >> shift,
+                                       encoder->in.height >> shift);
+      WRITE_U(stream, crc_val, 16, "picture_crc");
+      CHECKPOINT("crc[%d] = %u", i, crc_val);
+    }
+
+    break;
+
+  case KVZ_HASH_MD5:
+    // Computed by encoder_state_worker_picture_md5.
     sei_write_payload_size(stream, 1 + num_colors * 16);
     WRITE_U(stream, 0, 8, "hash_type");  // 0 = md5
 
     for (int i = 0; i < num_colors; ++i) {
       for (int b = 0; b < 16; ++b) {
-        WRITE_U(stream, checksum[i][b], 8, "picture_md5");
+        WRITE_U(stream, state->frame->picture_md5[i][b], 8, "picture_md5");
       }
     }
 
@@ -1027,31 +1181,58 @@ static void encoder_state_write_slice_header(
 }
 
 /**
- * \brief Move child state bitstreams to the parent stream.
+ * \brief Move the bitstream of a single child state to the parent stream.
  */
-static void encoder_state_write_bitstream_children(encoder_state_t * const state)
+static void encoder_state_write_bitstream_child(encoder_state_t * const state,
+                                                int i)
 {
   // Write Slice headers to the parent stream instead of the child stream
   // in case the child stream is a leaf with something in it already.
-  for (int i = 0; state->children[i].encoder_control; ++i) {
-    if (state->children[i].type == ENCODER_STATE_TYPE_SLICE) {
-      encoder_state_write_slice_header(&state->stream, &state->children[i], true);
-    } else if (state->children[i].type == ENCODER_STATE_TYPE_WAVEFRONT_ROW) {
-      if ((state->encoder_control->cfg.slices & KVZ_SLICES_WPP) && i != 0) {
-        // Add header for dependent WPP row slice.
-        encoder_state_write_slice_header(&state->stream, &state->children[i], false);
-      }
+  if (state->children[i].type == ENCODER_STATE_TYPE_SLICE) {
+    encoder_state_write_slice_header(&state->stream, &state->children[i], true);
+  } else if (state->children[i].type == ENCODER_STATE_TYPE_WAVEFRONT_ROW) {
+    if ((state->encoder_control->cfg.slices & KVZ_SLICES_WPP) && i != 0) {
+      // Add header for dependent WPP row slice.
+      encoder_state_write_slice_header(&state->stream, &state->children[i], false);
     }
-    kvz_encoder_state_write_bitstream(&state->children[i]);
-    kvz_bitstream_move(&state->stream, &state->children[i].stream);
   }
+  kvz_encoder_state_write_bitstream(&state->children[i]);
+  kvz_bitstream_move(&state->stream, &state->children[i].stream);
 }
 
-static void encoder_state_write_bitstream_main(encoder_state_t * const state)
+/**
+ * \brief Move child state bitstreams to the parent stream.
+ */
+static void encoder_state_write_bitstream_children(encoder_state_t * const state)
+{
+  for (int i = 0; state->children[i].encoder_control; ++i) {
+    encoder_state_write_bitstream_child(state, i);
+  }
+}
+
+/**
+ * \brief Pass the data written to the main stream to the slice callback.
+ */
+static void encoder_state_output_slice(encoder_state_t * const state,
+                                       bool end_of_picture)
+{
+  const uint32_t len = state->stream.len;
+  kvz_data_chunk *data = kvz_bitstream_take_chunks(&state->stream);
+  state->slice_output_bits += (uint64_t)len * 8;
+  state->slice_callback(state->slice_callback_opaque,
+                        data,
+                        len,
+                        state->frame->poc,
+                        end_of_picture);
+}
+
+/**
+ * \brief Write the NAL units that precede the first slice of a picture.
+ */
+static void encoder_state_write_bitstream_main_header(encoder_state_t * const state)
 {
   const encoder_control_t * const encoder = state->encoder_control;
   bitstream_t * const stream = &state->stream;
-  uint64_t curpos = kvz_bitstream_tell(stream);
 
   // The first NAL unit of the access unit must use a long start code.
   state->frame->first_nal = true;
@@ -1067,6 +1248,20 @@ static void encoder_state_write_bitstream_main(encoder_state_t * const state)
     kvz_encoder_state_write_parameter_sets(&state->stream, state);
   }
 
+  // Buffering period and picture timing come first so that a decoder knows
+  // the CPB removal time of the access unit.
+  if (encoder->vui.hrd_parameters_present_flag) {
+    kvz_nal_write(stream, KVZ_NAL_PREFIX_SEI_NUT, 0, state->frame->first_nal);
+    state->frame->first_nal = false;
+    if (state->frame->hrd_bp_num == state->frame->num) {
+      encoder_state_write_buffering_period_sei_message(state);
+    }
+    encoder_state_write_picture_timing_sei_message(state);
+
+    // spec:sei_rbsp() rbsp_trailing_bits
+    kvz_bitstream_add_rbsp_trailing_bits(stream);
+  }
+
   // Send Kvazaar version information only in the first frame.
   if (state->frame->num == 0 && encoder->cfg.add_encoder_info) {
     kvz_nal_write(stream, KVZ_NAL_PREFIX_SEI_NUT, 0, state->frame->first_nal);
@@ -1078,7 +1273,8 @@ static void encoder_state_write_bitstream_main(encoder_state_t * const state)
   }
 
   //SEI messages for interlacing
-  if (encoder->vui.frame_field_info_present_flag) {
+  if (encoder->vui.frame_field_info_present_flag &&
+      !encoder->vui.hrd_parameters_present_flag) {
     // These should be optional, needed for earlier versions
     // of HM decoder to accept bitstream
     //kvz_nal_write(stream, KVZ_NAL_PREFIX_SEI_NUT, 0, 0);
@@ -1093,7 +1289,31 @@ static void encoder_state_write_bitstream_main(encoder_state_t * const state)
     kvz_bitstream_add_rbsp_trailing_bits(stream);
   }
 
-  encoder_state_write_bitstream_children(state);
+  // Each refresh period after the first one starts from a recovery point.
+  if (encoder->cfg.gdr_period > 0 &&
+      state->frame->num > encoder->cfg.gdr_period &&
+      (state->frame->num - 1) % encoder->cfg.gdr_period == 0)
+  {
+    kvz_nal_write(stream, KVZ_NAL_PREFIX_SEI_NUT, 0, state->frame->first_nal);
+    state->frame->first_nal = false;
+    encoder_state_write_recovery_point_sei_message(state);
+
+    // spec:sei_rbsp() rbsp_trailing_bits
+    kvz_bitstream_add_rbsp_trailing_bits(stream);
+  }
+}
+
+static void encoder_state_write_bitstream_main(encoder_state_t * const state)
+{
+  bitstream_t * const stream = &state->stream;
+  uint64_t curpos = kvz_bitstream_tell(stream);
+
+  if (!state->slice_callback) {
+    encoder_state_write_bitstream_main_header(state);
+    encoder_state_write_bitstream_children(state);
+  }
+  // Otherwise the header and the slices have already been written and
+  // output by kvz_encoder_state_worker_write_slice.
 
   if (state->encoder_control->cfg.hash != KVZ_HASH_NONE) {
     // Calculate checksum
@@ -1101,20 +1321,31 @@ static void encoder_state_write_bitstream_main(encoder_state_t * const state)
   }
 
   //Get bitstream length for stats
-  uint64_t newpos = kvz_bitstream_tell(stream);
+  uint64_t newpos = kvz_bitstream_tell(stream) + state->slice_output_bits;
   state->stats_bitstream_length = (newpos >> 3) - (curpos >> 3);
 
   if (state->frame->num > 0) {
     state->frame->total_bits_coded = state->previous_encoder_state->frame->total_bits_coded;
   }
   state->frame->total_bits_coded += newpos - curpos;
-  if(state->encoder_control->cfg.rc_algorithm == KVZ_OBA || state->encoder_control->cfg.stats_file_prefix) {
+  kvz_update_vbv_fullness(state, newpos - curpos);
+  if((state->encoder_control->cfg.rc_algorithm == KVZ_OBA || state->encoder_control->cfg.stats_file_prefix) &&
+     !state->encoder_control->cfg.deterministic) {
+    // With --deterministic this is done in output order by kvazaar_encode.
     kvz_update_after_picture(state);
   }
 
   if(state->frame->gop_offset)
     state->frame->cur_gop_bits_coded = state->previous_encoder_state->frame->cur_gop_bits_coded;
   state->frame->cur_gop_bits_coded += newpos - curpos;
+
+  KVZ_CLOCK_T encode_end;
+  KVZ_GET_TIME(&encode_end);
+  state->frame->latency = KVZ_CLOCK_T_DIFF(state->frame->encode_start, encode_end);
+
+  if (state->slice_callback) {
+    encoder_state_output_slice(state, true);
+  }
 }
 
 void kvz_encoder_state_write_bitstream(encoder_state_t * const state)
@@ -1140,6 +1371,31 @@ void kvz_encoder_state_worker_write_bitstream(void * opaque)
   kvz_encoder_state_write_bitstream((encoder_state_t *) opaque);
 }
 
+/**
+ * \brief Write a child of the main state and pass it to the slice callback.
+ *
+ * Used instead of writing all children in kvz_encoder_state_write_bitstream
+ * when the main state has a slice callback. The jobs for the children of
+ * a frame must run in order.
+ */
+void kvz_encoder_state_worker_write_slice(void * opaque)
+{
+  encoder_state_t *const child = opaque;
+  encoder_state_t *const main_state = child->parent;
+  const int i = child - main_state->children;
+
+  assert(main_state->type == ENCODER_STATE_TYPE_MAIN);
+  assert(main_state->slice_callback);
+
+  if (i == 0) {
+    main_state->slice_output_bits = 0;
+    encoder_state_write_bitstream_main_header(main_state);
+  }
+
+  encoder_state_write_bitstream_child(main_state, i);
+  encoder_state_output_slice(main_state, false);
+}
+
 void kvz_encoder_state_write_parameter_sets(bitstream_t *stream,
                                             encoder_state_t * const state)
 {
@@ -54,6 +54,7 @@ void kvz_encoder_state_write_bitstream_slice_header(
 void kvz_encoder_state_write_bitstream(struct encoder_state_t * const state);
 void kvz_encoder_state_write_bitstream_leaf(struct encoder_state_t * const state);
 void kvz_encoder_state_worker_write_bitstream(void * opaque);
+void kvz_encoder_state_worker_write_slice(void * opaque);
 void kvz_encoder_state_write_parameter_sets(struct bitstream_t *stream,
                                             struct encoder_state_t * const state);
 
@@ -47,6 +47,7 @@
 #include "threadqueue.h"
 #include "videoframe.h"
 #include "rate_control.h"
+#include "search_inter.h"
 
 
 static int encoder_state_config_frame_init(encoder_state_t * const state) {
@@ -56,11 +57,18 @@ static int encoder_state_config_frame_init(encoder_state_t * const state) {
     return 0;
   }
   state->frame->ref_list = REF_PIC_LIST_0;
+  state->frame->motion_field = NULL;
   state->frame->num = 0;
   state->frame->poc = 0;
   state->frame->total_bits_coded = 0;
   state->frame->cur_frame_bits_coded = 0;
   state->frame->cur_gop_bits_coded = 0;
+  state->frame->vbv_fullness = 0;
+  state->frame->vbv_max_bits = 0;
+  state->frame->lcus_coded = 0;
+  state->frame->hrd_bp_num = 0;
+  state->frame->hrd_prev_bp_num = 0;
+  state->frame->hrd_poc0_num = 0;
   state->frame->prepared = 0;
   state->frame->done = 1;
 
@@ -75,6 +83,15 @@ static int encoder_state_config_frame_init(encoder_state_t * const state) {
   const int num_lcus = encoder->in.width_in_lcu * encoder->in.height_in_lcu;
   state->frame->lcu_stats = calloc(num_lcus, sizeof(lcu_stats_t));
   state->frame->aq_offsets = MALLOC(double, num_lcus);
+  state->frame->pre_analysis_jobs = calloc(encoder->in.height_in_lcu, sizeof(threadqueue_job_t *));
+  state->frame->pre_analysis_rows = calloc(encoder->in.height_in_lcu, sizeof(pre_analysis_row_t));
+  if (!state->frame->pre_analysis_jobs || !state->frame->pre_analysis_rows) {
+    return 0;
+  }
+  if (encoder->cfg.ml_pu_depth_intra) {
+    state->frame->ml_intra_sums = MALLOC(ml_intra_ctu_sums_t, num_lcus);
+    if (!state->frame->ml_intra_sums) return 0;
+  }
 
   for (int y = 0; y < encoder->in.height_in_lcu; y++) {
     for (int x = 0; x < encoder->in.width_in_lcu; x++) {
@@ -93,6 +110,7 @@ static int encoder_state_config_frame_init(encoder_state_t * const state) {
   }
 
   pthread_mutex_init(&state->frame->rc_lock, NULL);
+  pthread_mutex_init(&state->frame->fast_coeff_lock, NULL);
 
   state->frame->new_ratecontrol = kvz_get_rc_data(NULL);
 
@@ -103,12 +121,23 @@ static void encoder_state_config_frame_finalize(encoder_state_t * const state) {
   if (state->frame == NULL) return;
 
   pthread_mutex_destroy(&state->frame->rc_lock);
+  pthread_mutex_destroy(&state->frame->fast_coeff_lock);
   if (state->frame->c_para) FREE_POINTER(state->frame->c_para);
   if (state->frame->k_para) FREE_POINTER(state->frame->k_para);
 
   kvz_image_list_destroy(state->frame->ref);
+  kvz_cu_motion_field_free(&state->frame->motion_field);
   FREE_POINTER(state->frame->lcu_stats);
   FREE_POINTER(state->frame->aq_offsets);
+
+  if (state->frame->pre_analysis_jobs) {
+    for (int i = 0; i < state->encoder_control->in.height_in_lcu; i++) {
+      kvz_threadqueue_free_job(&state->frame->pre_analysis_jobs[i]);
+    }
+  }
+  FREE_POINTER(state->frame->pre_analysis_jobs);
+  FREE_POINTER(state->frame->pre_analysis_rows);
+  FREE_POINTER(state->frame->ml_intra_sums);
 }
 
 static int encoder_state_config_tile_init(encoder_state_t * const state, 
@@ -167,6 +196,22 @@ static int encoder_state_config_tile_init(encoder_state_t * const state,
   } else {
     state->tile->wf_jobs = NULL;
   }
+
+  for (int s = 0; s < MS_SSIM_SCALES; ++s) {
+    state->tile->ssim_scales[0][s] = NULL;
+    state->tile->ssim_scales[1][s] = NULL;
+  }
+  if (encoder->cfg.calc_ssim) {
+    for (int s = 1; s < MS_SSIM_SCALES; ++s) {
+      const int size = (width >> s) * (height >> s);
+      state->tile->ssim_scales[0][s] = MALLOC(kvz_pixel, size);
+      state->tile->ssim_scales[1][s] = MALLOC(kvz_pixel, size);
+      if (!state->tile->ssim_scales[0][s] || !state->tile->ssim_scales[1][s]) {
+        printf("Error allocating SSIM buffers!\n");
+        return 0;
+      }
+    }
+  }
   state->tile->id = encoder->tiles_tile_id[state->tile->lcu_offset_in_ts];
   return 1;
 }
@@ -189,6 +234,11 @@ static void encoder_state_config_tile_finalize(encoder_state_t * const state) {
   kvz_videoframe_free(state->tile->frame);
   state->tile->frame = NULL;
   FREE_POINTER(state->tile->wf_jobs);
+
+  for (int s = 0; s < MS_SSIM_SCALES; ++s) {
+    FREE_POINTER(state->tile->ssim_scales[0][s]);
+    FREE_POINTER(state->tile->ssim_scales[1][s]);
+  }
 }
 
 static int encoder_state_config_slice_init(encoder_state_t * const state,
@@ -360,6 +410,10 @@ int kvz_encoder_state_init(encoder_state_t * const child_state, encoder_state_t
   child_state->must_code_qp_delta = false;
   child_state->tqj_bitstream_written = NULL;
   child_state->tqj_recon_done = NULL;
+  child_state->slice_callback = NULL;
+  child_state->slice_callback_opaque = NULL;
+  child_state->slice_output_bits = 0;
+  child_state->fast_coeff_sample_count = 0;
   
   if (!parent_state) {
     const encoder_control_t * const encoder = child_state->encoder_control;
@@ -396,6 +450,21 @@ int kvz_encoder_state_init(encoder_state_t * const child_state, encoder_state_t
   // Intialization of the constraint structure
   child_state->constraint = kvz_init_constraint(child_state->constraint, child_state->encoder_control);
 
+  child_state->merge_satd_cache = calloc(1, sizeof(merge_satd_cache_t));
+  if (!child_state->merge_satd_cache) {
+    fprintf(stderr, "Could not allocate merge candidate cost cache!\n");
+    return 0;
+  }
+
+  child_state->unipred_cache = NULL;
+  if (child_state->encoder_control->cfg.bipred) {
+    child_state->unipred_cache = calloc(1, sizeof(unipred_cache_t));
+    if (!child_state->unipred_cache) {
+      fprintf(stderr, "Could not allocate unipred prediction cache!\n");
+      return 0;
+    }
+  }
+
   kvz_bitstream_init(&child_state->stream);
   
   // Set CABAC output bitstream
@@ -628,10 +697,13 @@ int kvz_encoder_state_init(encoder_state_t * const child_state, encoder_state_t
       lcu_start = MAX(lcu_start, child_state->slice->start_in_ts - child_state->tile->lcu_offset_in_ts);
       lcu_end = MIN(lcu_end, child_state->slice->end_in_ts - child_state->tile->lcu_offset_in_ts + 1);
       
-      //Restrict to the current wavefront row if needed
+      //Restrict to the current wavefront row if needed. Rows are counted
+      //from the first row of the slice.
       if (child_state->type == ENCODER_STATE_TYPE_WAVEFRONT_ROW) {
-        lcu_start = MAX(lcu_start, (child_state->wfrow->lcu_offset_y) * child_state->tile->frame->width_in_lcu);
-        lcu_end = MIN(lcu_end, (child_state->wfrow->lcu_offset_y + 1) * child_state->tile->frame->width_in_lcu);
+        const int width_in_lcu = child_state->tile->frame->width_in_lcu;
+        const int row = lcu_start / width_in_lcu + child_state->wfrow->lcu_offset_y;
+        lcu_start = MAX(lcu_start, row * width_in_lcu);
+        lcu_end = MIN(lcu_end, (row + 1) * width_in_lcu);
       }
       
       child_state->lcu_order_count = lcu_end - lcu_start;
@@ -758,6 +830,9 @@ void kvz_encoder_state_finalize(encoder_state_t * const state) {
     kvz_constraint_free(state);
   }
 
+  FREE_POINTER(state->merge_satd_cache);
+  FREE_POINTER(state->unipred_cache);
+
   kvz_bitstream_finalize(&state->stream);
 
   kvz_threadqueue_free_job(&state->tqj_recon_done);
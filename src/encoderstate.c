@@ -46,12 +46,15 @@
 #include "encoder_state-bitstream.h"
 #include "filter.h"
 #include "image.h"
+#include "nal.h"
+#include "quality.h"
 #include "rate_control.h"
 #include "sao.h"
 #include "search.h"
 #include "tables.h"
 #include "threadqueue.h"
 
+#include "strategies/strategies-nal.h"
 #include "strategies/strategies-picture.h"
 
 /**
@@ -426,6 +429,13 @@ static void encoder_sao_reconstruct(const encoder_state_t *const state,
       const sao_info_t *sao_luma   = &frame->sao_luma[lcu_index];
       const sao_info_t *sao_chroma = &frame->sao_chroma[lcu_index];
 
+      // The pixels on the far side of a missing neighbor LCU belong to
+      // another tile or slice or are outside the frame.
+      const bool above = lcu->above != NULL;
+      const bool below = y_offset_index == 0 || lcu->below != NULL;
+      const bool left  = lcu->left != NULL;
+      const bool right = x_offset_index == 0 || lcu->right != NULL;
+
       kvz_sao_reconstruct(state,
                           &sao_buf_y[x + y * SAO_BUF_WIDTH],
                           SAO_BUF_WIDTH,
@@ -434,7 +444,8 @@ static void encoder_sao_reconstruct(const encoder_state_t *const state,
                           width,
                           height,
                           sao_luma,
-                          COLOR_Y);
+                          COLOR_Y,
+                          above, below, left, right);
 
       if (state->encoder_control->chroma_format != KVZ_CSP_400) {
         // Coordinates in chroma pixels.
@@ -449,7 +460,8 @@ static void encoder_sao_reconstruct(const encoder_state_t *const state,
                             width / 2,
                             height / 2,
                             sao_chroma,
-                            COLOR_U);
+                            COLOR_U,
+                            above, below, left, right);
         kvz_sao_reconstruct(state,
                             &sao_buf_v[x_c + y_c * SAO_BUF_WIDTH_C],
                             SAO_BUF_WIDTH_C,
@@ -458,7 +470,8 @@ static void encoder_sao_reconstruct(const encoder_state_t *const state,
                             width / 2,
                             height / 2,
                             sao_chroma,
-                            COLOR_V);
+                            COLOR_V,
+                            above, below, left, right);
       }
     }
   }
@@ -633,6 +646,95 @@ static void set_cu_qps(encoder_state_t *state, int x, int y, int depth, int *las
 }
 
 
+/**
+ * \brief Return whether the statistics and hash of an LCU are computed after
+ *        the frame.
+ *
+ * The filters are applied across slice boundaries, but the slices of a tile
+ * are coded in parallel. Pixels that the LCU finishes in an earlier slice
+ * are final only after that slice is done as well. SSIM also needs the
+ * downscaled pixels and windows of the LCUs above and to the left, so with
+ * SSIM all LCUs of a slice that starts inside the tile are done later.
+ *
+ * \param state   encoder state
+ * \param lcu     LCU to check
+ */
+static bool lcu_stats_deferred(const encoder_state_t *const state,
+                               const lcu_order_element_t *const lcu)
+{
+  // Index of the first LCU of the slice in the tile.
+  const int slice_start = state->slice->start_in_ts - state->tile->lcu_offset_in_ts;
+  if (slice_start <= 0) return false;
+  if (state->encoder_control->cfg.calc_ssim) return true;
+
+  // The LCU above and to the left is the first one whose pixels are in the
+  // area finished by this LCU.
+  const int x = MAX(0, lcu->position.x - 1);
+  const int y = MAX(0, lcu->position.y - 1);
+  return x + y * state->tile->frame->width_in_lcu < slice_start;
+}
+
+/**
+ * \brief Compute the decoded picture hash of the pixels finished by an LCU.
+ *
+ * The checksum is a sum and the CRC is linear, so the values of the LCUs
+ * are combined into the hash of the picture when writing the SEI.
+ *
+ * \param state   encoder state
+ * \param lcu     LCU that has been filtered
+ */
+static void encoder_state_hash_lcu(encoder_state_t *const state,
+                                   const lcu_order_element_t *const lcu)
+{
+  const encoder_control_t *const encoder = state->encoder_control;
+  const kvz_picture *const rec = state->tile->frame->rec;
+  lcu_stats_t *const stats = kvz_get_lcu_stats(state, lcu->position.x, lcu->position.y);
+  const int num_colors = encoder->chroma_format == KVZ_CSP_400 ? 1 : 3;
+
+  vector2d_t start, end;
+  kvz_lcu_finished_area(state, lcu, &start, &end);
+
+  for (int c = 0; c < num_colors; ++c) {
+    const int shift = c == COLOR_Y ? 0 : 1;
+    const int stride = rec->stride >> shift;
+    const int x = start.x >> shift;
+    const int y = start.y >> shift;
+    const int width = (end.x - start.x) >> shift;
+    const int height = (end.y - start.y) >> shift;
+    const kvz_pixel *const data = &rec->data[c][x + y * stride];
+
+    // Position in the picture instead of the tile.
+    const int pic_x = x + (state->tile->offset_x >> shift);
+    const int pic_y = y + (state->tile->offset_y >> shift);
+
+    if (encoder->cfg.hash == KVZ_HASH_CHECKSUM) {
+      stats->hash[c] = kvz_array_checksum(data, height, width, stride,
+                                          pic_x, pic_y, encoder->bitdepth);
+    } else {
+      stats->hash[c] = kvz_crc_rect(data, stride, pic_x, pic_y, width, height,
+                                    encoder->in.width >> shift,
+                                    encoder->in.height >> shift);
+    }
+  }
+}
+
+/**
+ * \brief Compute the quality statistics and hash of an LCU, if enabled.
+ */
+static void encoder_state_lcu_stats(encoder_state_t *const state,
+                                    const lcu_order_element_t *const lcu)
+{
+  const kvz_config *const cfg = &state->encoder_control->cfg;
+
+  if (cfg->calc_psnr || cfg->calc_ssim) {
+    kvz_quality_lcu(state, lcu);
+  }
+
+  if (cfg->hash == KVZ_HASH_CHECKSUM || cfg->hash == KVZ_HASH_CRC) {
+    encoder_state_hash_lcu(state, lcu);
+  }
+}
+
 static void encoder_state_worker_encode_lcu(void * opaque)
 {
   const lcu_order_element_t * const lcu = opaque;
@@ -681,6 +783,10 @@ static void encoder_state_worker_encode_lcu(void * opaque)
     encoder_sao_reconstruct(state, lcu);
   }
 
+  if (!lcu_stats_deferred(state, lcu)) {
+    encoder_state_lcu_stats(state, lcu);
+  }
+
   //Now write data to bitstream (required to have a correct CABAC state)
   const uint64_t existing_bits = kvz_bitstream_tell(&state->stream);
 
@@ -741,6 +847,7 @@ static void encoder_state_worker_encode_lcu(void * opaque)
   pthread_mutex_lock(&state->frame->rc_lock);
   const uint32_t bits = kvz_bitstream_tell(&state->stream) - existing_bits;
   state->frame->cur_frame_bits_coded += bits;
+  state->frame->lcus_coded++;
   // This variable is used differently by intra and inter frames and shouldn't
   // be touched in intra frames here
   state->frame->remaining_weight -= !state->frame->is_irap ?
@@ -759,6 +866,15 @@ static void encoder_state_worker_encode_lcu(void * opaque)
   }
   kvz_get_lcu_stats(state, lcu->position.x, lcu->position.y)->skipped = !not_skip;
 
+  if (frame->rec_progress) {
+    // The pixels of this LCU are now final, except for the ones that will
+    // still be modified by deblocking and SAO of the following LCUs.
+    kvz_threadqueue_progress_publish(state->encoder_control->threadqueue,
+                                     frame->rec_progress,
+                                     lcu->position.y,
+                                     lcu->position.x + 1);
+  }
+
   //Wavefronts need the context to be copied to the next row
   if (state->type == ENCODER_STATE_TYPE_WAVEFRONT_ROW && lcu->index == 1) {
     int j;
@@ -772,6 +888,44 @@ static void encoder_state_worker_encode_lcu(void * opaque)
   }
 }
 
+/**
+ * \brief Make a job depend on the pre-analysis of LCU rows.
+ *
+ * \param job        job that uses the analysis
+ * \param first_row  first LCU row in frame coordinates
+ * \param end_row    LCU row after the last one
+ */
+static void add_pre_analysis_deps(const encoder_state_t * const state,
+                                  threadqueue_job_t *job,
+                                  int first_row,
+                                  int end_row)
+{
+  for (int row = first_row; row < end_row; ++row) {
+    if (state->frame->pre_analysis_jobs[row]) {
+      kvz_threadqueue_job_dep_add(job, state->frame->pre_analysis_jobs[row]);
+    }
+  }
+}
+
+
+/**
+ * \brief Wait for the pre-analysis of LCU rows.
+ *
+ * Used when LCUs are coded outside of jobs that depend on the analysis.
+ */
+static void wait_for_pre_analysis(const encoder_state_t * const state,
+                                  int first_row,
+                                  int end_row)
+{
+  for (int row = first_row; row < end_row; ++row) {
+    if (state->frame->pre_analysis_jobs[row]) {
+      kvz_threadqueue_waitfor(state->encoder_control->threadqueue,
+                              state->frame->pre_analysis_jobs[row]);
+    }
+  }
+}
+
+
 static void encoder_state_encode_leaf(encoder_state_t * const state)
 {
   assert(state->is_leaf);
@@ -796,6 +950,10 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
     // Encode every LCU in order and perform SAO reconstruction after every
     // frame is encoded. Deblocking and SAO search is done during LCU encoding.
 
+    wait_for_pre_analysis(state,
+                          state->tile->lcu_offset_y + state->lcu_order[0].position.y,
+                          state->tile->lcu_offset_y + state->lcu_order[state->lcu_order_count - 1].position.y + 1);
+
     for (int i = 0; i < state->lcu_order_count; ++i) {
       encoder_state_worker_encode_lcu(&state->lcu_order[i]);
     }
@@ -843,11 +1001,14 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
         // row to depend on the reconstruction status of the row below in the
         // previous frame.
         if (ref_state != NULL &&
+            ref_state != state &&
             state->previous_encoder_state->tqj_recon_done &&
             state->frame->slicetype != KVZ_SLICE_I)
         {
           // We need to wait until the CTUs whose pixels we refer to are
-          // done before we can start this CTU.
+          // done before we can start this CTU. Instead of depending on the
+          // jobs of those CTUs, wait for the reconstruction progress of
+          // the CTU row to reach them.
           const lcu_order_element_t *dep_lcu = lcu;
           for (int i = 0; dep_lcu->below && i < ctrl->max_inter_ref_lcu.down; i++) {
             dep_lcu = dep_lcu->below;
@@ -855,11 +1016,17 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
           for (int i = 0; dep_lcu->right && i < ctrl->max_inter_ref_lcu.right; i++) {
             dep_lcu = dep_lcu->right;
           }
-          kvz_threadqueue_job_dep_add(job[0], ref_state->tile->wf_jobs[dep_lcu->id]);
+          kvz_threadqueue_job_dep_add_progress(job[0],
+                                               ref_state->tile->frame->rec_progress,
+                                               dep_lcu->position.y,
+                                               dep_lcu->position.x + 1);
 
           //TODO: Preparation for the lock free implementation of the new rc
           if (ref_state->frame->slicetype == KVZ_SLICE_I && ref_state->frame->num != 0 && state->encoder_control->cfg.owf > 1 && true) {
-            kvz_threadqueue_job_dep_add(job[0], ref_state->previous_encoder_state->tile->wf_jobs[dep_lcu->id]);
+            kvz_threadqueue_job_dep_add_progress(job[0],
+                                                 ref_state->previous_encoder_state->tile->frame->rec_progress,
+                                                 dep_lcu->position.y,
+                                                 dep_lcu->position.x + 1);
           }
 
           // Very spesific bug that happens when owf length is longer than the
@@ -874,13 +1041,20 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
             while (ref_state->frame->poc != state->frame->poc - state->encoder_control->cfg.gop_len){
               ref_state = ref_state->previous_encoder_state;
             }
-            kvz_threadqueue_job_dep_add(job[0], ref_state->tile->wf_jobs[dep_lcu->id]);
+            kvz_threadqueue_job_dep_add_progress(job[0],
+                                                 ref_state->tile->frame->rec_progress,
+                                                 dep_lcu->position.y,
+                                                 dep_lcu->position.x + 1);
           }
         }
 
-        // Add local WPP dependancy to the LCU on the left.
+        // Add local WPP dependancy to the LCU on the left. The first LCU of
+        // the row depends on the pre-analysis of the row instead.
         if (lcu->left) {
           kvz_threadqueue_job_dep_add(job[0], job[-1]);
+        } else {
+          const int row = state->tile->lcu_offset_y + lcu->position.y;
+          add_pre_analysis_deps(state, job[0], row, row + 1);
         }
         // Add local WPP dependancy to the LCU on the top right.
         if (lcu->above) {
@@ -915,9 +1089,7 @@ static void encoder_state_worker_encode_children(void * opaque)
     // Set the last wavefront job of this row as the job that completes
     // the bitstream for this wavefront row state.
 
-    int wpp_row = sub_state->wfrow->lcu_offset_y;
-    int tile_width = sub_state->tile->frame->width_in_lcu;
-    int end_of_row = (wpp_row + 1) * tile_width - 1;
+    int end_of_row = sub_state->lcu_order[sub_state->lcu_order_count - 1].id;
     assert(!sub_state->tqj_bitstream_written);
     if (sub_state->tile->wf_jobs[end_of_row]) {
       sub_state->tqj_bitstream_written =
@@ -955,6 +1127,8 @@ static void encoder_state_encode(encoder_state_t * const main_state) {
 
         kvz_cu_array_free(&sub_state->tile->frame->cu_array);
 
+        kvz_threadqueue_progress_free(&sub_state->tile->frame->rec_progress);
+
         sub_state->tile->frame->source = kvz_image_make_subimage(
             main_state->tile->frame->source,
             offset_x,
@@ -976,6 +1150,10 @@ static void encoder_state_encode(encoder_state_t * const main_state) {
             sub_state->tile->frame->width_in_lcu * LCU_WIDTH,
             sub_state->tile->frame->height_in_lcu * LCU_WIDTH
         );
+        if (main_state->tile->frame->rec_progress) {
+          sub_state->tile->frame->rec_progress =
+            kvz_threadqueue_progress_create(sub_state->tile->frame->height_in_lcu);
+        }
       }
 
       //To be the last split, we require that every child is a chain
@@ -1010,6 +1188,20 @@ static void encoder_state_encode(encoder_state_t * const main_state) {
               }
             }
           }
+          if (main_state->encoder_control->cfg.deterministic &&
+              i > 0 &&
+              main_state->children[i].type == ENCODER_STATE_TYPE_SLICE &&
+              main_state->children[i].tile == main_state->children[i - 1].tile)
+          {
+            // Slices of a tile are not independent in the reconstruction
+            // that is used for prediction, so code them in order.
+            kvz_threadqueue_job_dep_add(main_state->children[i].tqj_recon_done, main_state->children[i - 1].tqj_recon_done);
+          }
+          add_pre_analysis_deps(main_state,
+                                main_state->children[i].tqj_recon_done,
+                                main_state->children[i].tile->lcu_offset_y,
+                                main_state->children[i].tile->lcu_offset_y +
+                                  main_state->children[i].tile->frame->height_in_lcu);
           kvz_threadqueue_submit(main_state->encoder_control->threadqueue, main_state->children[i].tqj_recon_done);
         } else {
           //Wavefront rows have parallelism at LCU level, so we should not launch multiple threads here!
@@ -1202,10 +1394,21 @@ static void encoder_set_source_picture(encoder_state_t * const state, kvz_pictur
     state->tile->frame->rec = kvz_image_copy_ref(frame);
   } else {
     state->tile->frame->rec = kvz_image_alloc(state->encoder_control->chroma_format, frame->width, frame->height);
+    if (state->encoder_control->cfg.huge_pages) {
+      kvz_image_use_huge_pages(state->tile->frame->rec);
+    }
     state->tile->frame->rec->dts = frame->dts;
     state->tile->frame->rec->pts = frame->pts;
   }
 
+  if (state->encoder_control->cfg.wpp) {
+    // Needed for inter frame dependencies between wavefront rows and for
+    // adaptive MV range.
+    assert(!state->tile->frame->rec_progress);
+    state->tile->frame->rec_progress =
+      kvz_threadqueue_progress_create(state->tile->frame->height_in_lcu);
+  }
+
   kvz_videoframe_set_poc(state->tile->frame, state->frame->poc);
 }
 
@@ -1249,19 +1452,176 @@ static void normalize_lcu_weights(encoder_state_t * const state)
   }
 }
 
-// Check if lcu is edge lcu. Return false if frame dimensions are 64 divisible
-static bool edge_lcu(int id, int lcus_x, int lcus_y, bool xdiv64, bool ydiv64)
+/**
+ * \brief Copy a block of the source picture to a buffer of a full LCU.
+ *
+ * Blocks at the right and bottom edges of the picture are extended to the
+ * full LCU size by replicating the last column and row.
+ */
+static void blit_lcu_extended(const kvz_pixel *src, int src_stride,
+                              kvz_pixel *dst, int dst_width,
+                              int width, int height)
 {
-  if (xdiv64 && ydiv64) {
-    return false;
+  kvz_pixels_blit(src, dst, width, height, src_stride, dst_width);
+
+  for (int y = 0; y < height; y++) {
+    kvz_pixel *row = &dst[y * dst_width];
+    for (int x = width; x < dst_width; x++) {
+      row[x] = row[width - 1];
+    }
   }
-  int last_row_first_id = (lcus_y - 1) * lcus_x;
-  if ((id % lcus_x == lcus_x - 1 && !xdiv64) || (id >= last_row_first_id && !ydiv64)) {
-    return true;
+  for (int y = height; y < dst_width; y++) {
+    memcpy(&dst[y * dst_width], &dst[(height - 1) * dst_width], dst_width * sizeof(kvz_pixel));
   }
-  else {
-    return false;
+}
+
+
+/**
+ * \brief Return the sum of the pixel variances of the planes of an LCU.
+ */
+static double lcu_source_variance(const encoder_state_t * const state, int lcu_x, int lcu_y)
+{
+  const kvz_picture *const source = state->tile->frame->source;
+  const int pxl_x = lcu_x * LCU_WIDTH;
+  const int pxl_y = lcu_y * LCU_WIDTH;
+
+  kvz_pixel tmp[LCU_LUMA_SIZE];
+  blit_lcu_extended(&source->y[pxl_x + pxl_y * source->stride], source->stride,
+                    tmp, LCU_WIDTH,
+                    MIN(LCU_WIDTH, source->width - pxl_x),
+                    MIN(LCU_WIDTH, source->height - pxl_y));
+  double lcu_var = kvz_pixel_var(tmp, LCU_LUMA_SIZE);
+
+  if (state->encoder_control->chroma_format != KVZ_CSP_400) {
+    const int c_stride = source->stride >> 1;
+    const int lcu_chroma_width = LCU_WIDTH >> 1;
+    const int c_pxl_x = pxl_x >> 1;
+    const int c_pxl_y = pxl_y >> 1;
+    const int c_width = MIN(lcu_chroma_width, (source->width >> 1) - c_pxl_x);
+    const int c_height = MIN(lcu_chroma_width, (source->height >> 1) - c_pxl_y);
+
+    kvz_pixel chroma_tmp[LCU_CHROMA_SIZE];
+    blit_lcu_extended(&source->u[c_pxl_x + c_pxl_y * c_stride], c_stride,
+                      chroma_tmp, lcu_chroma_width, c_width, c_height);
+    lcu_var += kvz_pixel_var(chroma_tmp, LCU_CHROMA_SIZE);
+    blit_lcu_extended(&source->v[c_pxl_x + c_pxl_y * c_stride], c_stride,
+                      chroma_tmp, lcu_chroma_width, c_width, c_height);
+    lcu_var += kvz_pixel_var(chroma_tmp, LCU_CHROMA_SIZE);
+  }
+
+  return lcu_var;
+}
+
+
+/**
+ * \brief Compute the luma sums of an LCU for the ML intra depth prediction.
+ */
+static void lcu_ml_intra_sums(const encoder_state_t * const state, int lcu_x, int lcu_y)
+{
+  const kvz_picture *const source = state->tile->frame->source;
+  const int pxl_x = lcu_x * LCU_WIDTH;
+  const int pxl_y = lcu_y * LCU_WIDTH;
+
+  kvz_pixel tmp[LCU_LUMA_SIZE];
+  blit_lcu_extended(&source->y[pxl_x + pxl_y * source->stride], source->stride,
+                    tmp, LCU_WIDTH,
+                    MIN(LCU_WIDTH, source->width - pxl_x),
+                    MIN(LCU_WIDTH, source->height - pxl_y));
+
+  const int index = lcu_x + lcu_y * state->tile->frame->width_in_lcu;
+  kvz_lcu_luma_sums(tmp, &state->frame->ml_intra_sums[index]);
+}
+
+
+/**
+ * \brief Compute the pixel variance of the whole source picture.
+ */
+static void encoder_state_worker_pre_analysis_frame(void *opaque)
+{
+  encoder_state_t *const state = opaque;
+  const kvz_picture *const source = state->tile->frame->source;
+
+  uint32_t len = state->tile->frame->width * state->tile->frame->height;
+  uint32_t c_len = len / 4;
+  double frame_var = kvz_pixel_var(source->y, len);
+  if (state->encoder_control->chroma_format != KVZ_CSP_400) {
+    frame_var += kvz_pixel_var(source->u, c_len);
+    frame_var += kvz_pixel_var(source->v, c_len);
   }
+  state->frame->source_variance = frame_var;
+}
+
+
+/**
+ * \brief Analyse one LCU row of the source picture.
+ *
+ * Computes the variance adaptive quantization offsets and the luma sums
+ * for the ML intra depth prediction of the row. With variance adaptive
+ * quantization, runs after encoder_state_worker_pre_analysis_frame.
+ */
+static void encoder_state_worker_pre_analysis_row(void *opaque)
+{
+  const pre_analysis_row_t *const job = opaque;
+  encoder_state_t *const state = job->state;
+  const int width_in_lcu = state->tile->frame->width_in_lcu;
+
+  if (state->encoder_control->cfg.vaq) {
+    // For each LCU calculate: D * (log(LCU pixel variance) - log(frame pixel variance))
+    const double d = state->encoder_control->cfg.vaq * 0.1; // Empirically decided constant. Affects delta-QP strength
+    const double log_frame_var = log(state->frame->source_variance);
+
+    for (int x = 0; x < width_in_lcu; ++x) {
+      const double lcu_var = lcu_source_variance(state, x, job->row);
+      state->frame->aq_offsets[x + job->row * width_in_lcu] = d * (log(lcu_var) - log_frame_var);
+    }
+  }
+
+  if (state->frame->ml_intra_sums) {
+    for (int x = 0; x < width_in_lcu; ++x) {
+      lcu_ml_intra_sums(state, x, job->row);
+    }
+  }
+}
+
+
+/**
+ * \brief Submit the pre-analysis jobs of a new frame.
+ */
+static void encoder_state_start_pre_analysis(encoder_state_t * const state)
+{
+  const int height_in_lcu = state->tile->frame->height_in_lcu;
+  threadqueue_queue_t *const threadqueue = state->encoder_control->threadqueue;
+
+  for (int row = 0; row < height_in_lcu; ++row) {
+    kvz_threadqueue_free_job(&state->frame->pre_analysis_jobs[row]);
+  }
+
+  // Variance adaptive quantization and the ML intra depth prediction are
+  // the users of the analysis.
+  if (!state->encoder_control->cfg.vaq && !state->frame->ml_intra_sums) return;
+
+  // The frame variance is only needed for the AQ offsets.
+  threadqueue_job_t *frame_job = NULL;
+  if (state->encoder_control->cfg.vaq) {
+    frame_job = kvz_threadqueue_job_create(encoder_state_worker_pre_analysis_frame, state);
+    kvz_threadqueue_submit(threadqueue, frame_job);
+  }
+
+  for (int row = 0; row < height_in_lcu; ++row) {
+    pre_analysis_row_t *const arg = &state->frame->pre_analysis_rows[row];
+    arg->state = state;
+    arg->row = row;
+
+    threadqueue_job_t *job =
+      kvz_threadqueue_job_create(encoder_state_worker_pre_analysis_row, arg);
+    if (frame_job) {
+      kvz_threadqueue_job_dep_add(job, frame_job);
+    }
+    kvz_threadqueue_submit(threadqueue, job);
+    state->frame->pre_analysis_jobs[row] = job;
+  }
+
+  kvz_threadqueue_free_job(&frame_job);
 }
 
 
@@ -1412,6 +1772,31 @@ static void next_roi_frame_from_file(kvz_picture *frame, FILE *file, enum kvz_ro
   }
 }
 
+/**
+ * \brief Get the CTU rows refreshed in a frame with gradual decoding refresh.
+ *
+ * The picture is divided into gdr_period bands of CTU rows that are
+ * refreshed from top to bottom. The first frame is intra so it does not
+ * belong to any refresh period.
+ */
+static void gdr_refresh_rows(const encoder_control_t *const encoder,
+                             int32_t num,
+                             int32_t *first,
+                             int32_t *end)
+{
+  const int32_t period = encoder->cfg.gdr_period;
+  const int32_t rows = encoder->in.height_in_lcu;
+
+  if (num == 0) {
+    *first = 0;
+    *end = rows;
+  } else {
+    const int32_t band = (num - 1) % period;
+    *first = band * rows / period;
+    *end = (band + 1) * rows / period;
+  }
+}
+
 static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_picture* frame) {
   assert(state->type == ENCODER_STATE_TYPE_MAIN);
 
@@ -1425,6 +1810,12 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_pict
       state->tile->frame->height
   );
 
+  assert(!state->frame->motion_field);
+  state->frame->motion_field = kvz_cu_motion_field_alloc(
+      state->tile->frame->width,
+      state->tile->frame->height
+  );
+
   // ROI / delta QP maps
   if (frame->roi.roi_array && cfg->roi.file_path) {
     assert(0 && "Conflict: Other ROI data was supplied when a ROI file was specified.");
@@ -1440,91 +1831,11 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_pict
     init_erp_aqp_roi(state->encoder_control, state->tile->frame->source);
   }
 
-  // Variance adaptive quantization
-  if (cfg->vaq) {
-    const bool has_chroma = state->encoder_control->chroma_format != KVZ_CSP_400;
-    double d = cfg->vaq * 0.1; // Empirically decided constant. Affects delta-QP strength
-    
-    // Calculate frame pixel variance
-    uint32_t len = state->tile->frame->width * state->tile->frame->height;
-    uint32_t c_len = len / 4;
-    double frame_var = kvz_pixel_var(state->tile->frame->source->y, len);
-    if (has_chroma) {
-      frame_var += kvz_pixel_var(state->tile->frame->source->u, c_len);
-      frame_var += kvz_pixel_var(state->tile->frame->source->v, c_len);
-    }
+  encoder_state_start_pre_analysis(state);
 
-    // Loop through LCUs
-    // For each LCU calculate: D * (log(LCU pixel variance) - log(frame pixel variance))
-    unsigned x_lim = state->tile->frame->width_in_lcu;
-    unsigned y_lim = state->tile->frame->height_in_lcu;
-    
-    unsigned id = 0;
-    for (int y = 0; y < y_lim; ++y) {
-      for (int x = 0; x < x_lim; ++x) {
-        kvz_pixel tmp[LCU_LUMA_SIZE];
-        int pxl_x = x * LCU_WIDTH;
-        int pxl_y = y * LCU_WIDTH;
-        int x_max = MIN(pxl_x + LCU_WIDTH, frame->width) - pxl_x;
-        int y_max = MIN(pxl_y + LCU_WIDTH, frame->height) - pxl_y;
-        
-        bool xdiv64 = false;
-        bool ydiv64 = false;
-        if (frame->width % 64 == 0) xdiv64 = true;
-        if (frame->height % 64 == 0) ydiv64 = true;
-
-        // Luma variance
-        if (!edge_lcu(id, x_lim, y_lim, xdiv64, ydiv64)) {
-          kvz_pixels_blit(&state->tile->frame->source->y[pxl_x + pxl_y * state->tile->frame->source->stride], tmp,
-            x_max, y_max, state->tile->frame->source->stride, LCU_WIDTH);
-        } else {
-          // Extend edge pixels for edge lcus
-          for (int y = 0; y < LCU_WIDTH; y++) {
-            for (int x = 0; x < LCU_WIDTH; x++) {
-              int src_y = CLIP(0, frame->height - 1, pxl_y + y);
-              int src_x = CLIP(0, frame->width - 1, pxl_x + x);
-              tmp[y * LCU_WIDTH + x] = state->tile->frame->source->y[src_y * state->tile->frame->source->stride + src_x];
-            }
-          }
-        }
-        
-        double lcu_var = kvz_pixel_var(tmp, LCU_LUMA_SIZE);
-
-        if (has_chroma) {
-          // Add chroma variance if not monochrome
-          int32_t c_stride = state->tile->frame->source->stride >> 1;
-          kvz_pixel chromau_tmp[LCU_CHROMA_SIZE];
-          kvz_pixel chromav_tmp[LCU_CHROMA_SIZE];
-          int lcu_chroma_width = LCU_WIDTH >> 1;
-          int c_pxl_x = x * lcu_chroma_width;
-          int c_pxl_y = y * lcu_chroma_width;
-          int c_x_max = MIN(c_pxl_x + lcu_chroma_width, frame->width >> 1) - c_pxl_x;
-          int c_y_max = MIN(c_pxl_y + lcu_chroma_width, frame->height >> 1) - c_pxl_y;
-
-          if (!edge_lcu(id, x_lim, y_lim, xdiv64, ydiv64)) {
-            kvz_pixels_blit(&state->tile->frame->source->u[c_pxl_x + c_pxl_y * c_stride], chromau_tmp, c_x_max, c_y_max, c_stride, lcu_chroma_width);
-            kvz_pixels_blit(&state->tile->frame->source->v[c_pxl_x + c_pxl_y * c_stride], chromav_tmp, c_x_max, c_y_max, c_stride, lcu_chroma_width);
-          }
-          else {
-            for (int y = 0; y < lcu_chroma_width; y++) {
-              for (int x = 0; x < lcu_chroma_width; x++) {
-                int src_y = CLIP(0, (frame->height >> 1) - 1, c_pxl_y + y);
-                int src_x = CLIP(0, (frame->width >> 1) - 1, c_pxl_x + x);
-                chromau_tmp[y * lcu_chroma_width + x] = state->tile->frame->source->u[src_y * c_stride + src_x];
-                chromav_tmp[y * lcu_chroma_width + x] = state->tile->frame->source->v[src_y * c_stride + src_x];
-              }
-            }
-          }
-          lcu_var += kvz_pixel_var(chromau_tmp, LCU_CHROMA_SIZE);
-          lcu_var += kvz_pixel_var(chromav_tmp, LCU_CHROMA_SIZE);
-        }
-                
-        state->frame->aq_offsets[id] = d * (log(lcu_var) - log(frame_var));
-        id++; 
-      }
-    }
+  if (state->encoder_control->fast_coeff_online) {
+    kvz_fast_coeff_online_start_frame(state);
   }
-  // Variance adaptive quantization - END
 
   if (cfg->target_bitrate > 0 || frame->roi.roi_array || cfg->set_qp_in_cu || cfg->vaq) {
     state->frame->max_qp_delta_depth = 0;
@@ -1624,10 +1935,35 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, kvz_pict
     state->frame->slicetype = KVZ_SLICE_P;
   }
 
+  if (cfg->gdr_period > 0) {
+    gdr_refresh_rows(state->encoder_control, state->frame->num,
+                     &state->frame->gdr_refresh_first,
+                     &state->frame->gdr_refresh_end);
+  } else {
+    state->frame->gdr_refresh_first = 0;
+    state->frame->gdr_refresh_end = 0;
+  }
+
+  if (state->frame->num == 0) {
+    state->frame->hrd_bp_num = 0;
+    state->frame->hrd_prev_bp_num = 0;
+    state->frame->hrd_poc0_num = 0;
+  } else {
+    // Buffering periods start at IRAP pictures.
+    const encoder_state_config_frame_t *const prev =
+      state->previous_encoder_state->frame;
+    const int32_t prev_bp_num = prev->hrd_bp_num;
+    const int32_t prev_poc0_num = prev->hrd_poc0_num;
+    state->frame->hrd_prev_bp_num = prev_bp_num;
+    state->frame->hrd_bp_num = state->frame->is_irap ? state->frame->num : prev_bp_num;
+    state->frame->hrd_poc0_num = state->frame->poc == 0 ? state->frame->num : prev_poc0_num;
+  }
+
   if (cfg->target_bitrate > 0 && state->frame->num > cfg->owf) {
     normalize_lcu_weights(state);
   }
   state->frame->cur_frame_bits_coded = 0;
+  state->frame->lcus_coded = 0;
 
   switch (state->encoder_control->cfg.rc_algorithm) {
     case KVZ_NO_RC:
@@ -1658,19 +1994,144 @@ static void _encode_one_frame_add_bitstream_deps(const encoder_state_t * const s
 }
 
 
+/**
+ * \brief Add jobs for writing and outputting each child of the main state.
+ *
+ * Each job waits for its own child only, so that the data of the first
+ * slices can be output while the rest of the frame is still being encoded.
+ *
+ * \return the job for the last child
+ */
+static threadqueue_job_t * encode_one_frame_add_slice_jobs(encoder_state_t * const state)
+{
+  threadqueue_job_t *prev_job = NULL;
+
+  for (int i = 0; state->children[i].encoder_control; ++i) {
+    threadqueue_job_t *job =
+      kvz_threadqueue_job_create(kvz_encoder_state_worker_write_slice, &state->children[i]);
+
+    _encode_one_frame_add_bitstream_deps(&state->children[i], job);
+    if (prev_job) {
+      kvz_threadqueue_job_dep_add(job, prev_job);
+    } else if (state->previous_encoder_state != state &&
+               state->previous_encoder_state->tqj_bitstream_written)
+    {
+      //We need to depend on previous bitstream generation
+      kvz_threadqueue_job_dep_add(job, state->previous_encoder_state->tqj_bitstream_written);
+    }
+    kvz_threadqueue_submit(state->encoder_control->threadqueue, job);
+
+    kvz_threadqueue_free_job(&prev_job);
+    prev_job = job;
+  }
+
+  return prev_job;
+}
+
+
+/**
+ * \brief Return whether any slice of the state starts inside a tile.
+ */
+static bool encoder_state_tile_has_slices(const encoder_state_t *const state)
+{
+  if (state->type == ENCODER_STATE_TYPE_SLICE &&
+      state->slice->start_in_ts > state->tile->lcu_offset_in_ts)
+  {
+    return true;
+  }
+  for (int i = 0; state->children[i].encoder_control; ++i) {
+    if (encoder_state_tile_has_slices(&state->children[i])) return true;
+  }
+  return false;
+}
+
+
+static void encoder_state_deferred_lcu_stats(encoder_state_t *const state)
+{
+  for (int i = 0; state->children[i].encoder_control; ++i) {
+    encoder_state_deferred_lcu_stats(&state->children[i]);
+  }
+  for (int i = 0; i < state->lcu_order_count; ++i) {
+    if (lcu_stats_deferred(state, &state->lcu_order[i])) {
+      encoder_state_lcu_stats(state, &state->lcu_order[i]);
+    }
+  }
+}
+
+
+/**
+ * \brief Compute the statistics and hashes of the LCUs next to slice
+ *        boundaries.
+ *
+ * Runs after the whole picture has been reconstructed. The LCUs are
+ * visited in tile scan order.
+ */
+static void encoder_state_worker_deferred_lcu_stats(void * opaque)
+{
+  encoder_state_deferred_lcu_stats((encoder_state_t *) opaque);
+}
+
+
+/**
+ * \brief Compute the MD5 of the reconstructed picture.
+ *
+ * Unlike the checksum and the CRC, MD5 cannot be computed in parts, so it
+ * is done in a job of its own after the picture has been reconstructed.
+ */
+static void encoder_state_worker_picture_md5(void * opaque)
+{
+  encoder_state_t *const state = opaque;
+  kvz_image_md5(state->tile->frame->rec, state->frame->picture_md5,
+                state->encoder_control->bitdepth);
+}
+
+
 void kvz_encode_one_frame(encoder_state_t * const state, kvz_picture* frame)
 {
+  KVZ_GET_TIME(&state->frame->encode_start);
+
   encoder_state_init_new_frame(state, frame);
   encoder_state_encode(state);
 
   threadqueue_job_t *job =
     kvz_threadqueue_job_create(kvz_encoder_state_worker_write_bitstream, state);
 
-  _encode_one_frame_add_bitstream_deps(state, job);
-  if (state->previous_encoder_state != state && state->previous_encoder_state->tqj_bitstream_written) {
-    //We need to depend on previous bitstream generation
-    kvz_threadqueue_job_dep_add(job, state->previous_encoder_state->tqj_bitstream_written);
+  if (state->slice_callback) {
+    threadqueue_job_t *last_slice_job = encode_one_frame_add_slice_jobs(state);
+    kvz_threadqueue_job_dep_add(job, last_slice_job);
+    kvz_threadqueue_free_job(&last_slice_job);
+  } else {
+    _encode_one_frame_add_bitstream_deps(state, job);
+    if (state->previous_encoder_state != state && state->previous_encoder_state->tqj_bitstream_written) {
+      //We need to depend on previous bitstream generation
+      kvz_threadqueue_job_dep_add(job, state->previous_encoder_state->tqj_bitstream_written);
+    }
+  }
+
+  const kvz_config *const cfg = &state->encoder_control->cfg;
+  if ((cfg->calc_psnr || cfg->calc_ssim ||
+       cfg->hash == KVZ_HASH_CHECKSUM || cfg->hash == KVZ_HASH_CRC) &&
+      encoder_state_tile_has_slices(state))
+  {
+    threadqueue_job_t *stats_job =
+      kvz_threadqueue_job_create(encoder_state_worker_deferred_lcu_stats, state);
+    _encode_one_frame_add_bitstream_deps(state, stats_job);
+    kvz_threadqueue_submit(state->encoder_control->threadqueue, stats_job);
+    kvz_threadqueue_job_dep_add(job, stats_job);
+    kvz_threadqueue_free_job(&stats_job);
+  }
+
+  if (state->encoder_control->cfg.hash == KVZ_HASH_MD5) {
+    // Hash the picture in parallel with writing the bitstream of the
+    // previous frames and encoding the next ones.
+    threadqueue_job_t *md5_job =
+      kvz_threadqueue_job_create(encoder_state_worker_picture_md5, state);
+    _encode_one_frame_add_bitstream_deps(state, md5_job);
+    kvz_threadqueue_submit(state->encoder_control->threadqueue, md5_job);
+    kvz_threadqueue_job_dep_add(job, md5_job);
+    kvz_threadqueue_free_job(&md5_job);
   }
+
   kvz_threadqueue_submit(state->encoder_control->threadqueue, job);
   assert(!state->tqj_bitstream_written);
   state->tqj_bitstream_written = job;
@@ -1702,6 +2163,7 @@ void kvz_encoder_prepare(encoder_state_t *state)
     assert(!state->tile->frame->source);
     assert(!state->tile->frame->rec);
     assert(!state->tile->frame->cu_array);
+    assert(!state->frame->motion_field);
     state->frame->prepared = 1;
 
     return;
@@ -1724,13 +2186,18 @@ void kvz_encoder_prepare(encoder_state_t *state)
       !prev_state->frame->poc ||
       encoder->cfg.gop[prev_state->frame->gop_offset].is_ref) {
 
-    // Store current list of POCs for use in TMVP derivation
-    memcpy(prev_state->tile->frame->rec->ref_pocs, state->frame->ref->pocs, sizeof(int32_t)*state->frame->ref->used_size);
+    // Only the ML inter depth features need the whole CU data of the
+    // references. TMVP uses the compressed motion field.
+    cu_array_t *ref_cu_array =
+      encoder->cfg.ml_pu_depth_inter || encoder->cfg.ml_inter_samples_fn ?
+      prev_state->tile->frame->cu_array : NULL;
 
     // Add previous reconstructed picture as a reference
     kvz_image_list_add(state->frame->ref,
                    prev_state->tile->frame->rec,
-                   prev_state->tile->frame->cu_array,
+                   ref_cu_array,
+                   prev_state->frame->motion_field,
+                   prev_state->tile->frame->rec_progress,
                    prev_state->frame->poc,
                    prev_state->frame->ref_LX);
     kvz_cu_array_free(&state->tile->frame->cu_array);
@@ -1745,8 +2212,10 @@ void kvz_encoder_prepare(encoder_state_t *state)
 
   kvz_image_free(state->tile->frame->rec);
   state->tile->frame->rec = NULL;
+  kvz_threadqueue_progress_free(&state->tile->frame->rec_progress);
 
   kvz_cu_array_free(&state->tile->frame->cu_array);
+  kvz_cu_motion_field_free(&state->frame->motion_field);
 
   // Update POC and frame count.
   state->frame->num = prev_state->frame->num + 1;
@@ -1774,6 +2243,48 @@ coeff_scan_order_t kvz_get_scan_order(int8_t cu_type, int intra_mode, int depth)
   return SCAN_DIAG;
 }
 
+/**
+ * \brief Get the number of luma pixel rows of a reference picture that
+ * blocks above the refresh band may refer to.
+ *
+ * Only the rows refreshed during the current refresh period can be
+ * reconstructed by a decoder that starts from the recovery point. The
+ * bottom rows of that area are excluded because the loop filters mix in
+ * pixels from the rows below.
+ *
+ * \param ref_idx  index of the reference picture in state->frame->ref
+ */
+int32_t kvz_gdr_ref_height(const encoder_state_t *state, int ref_idx)
+{
+  const encoder_control_t *const encoder = state->encoder_control;
+  const int32_t period = encoder->cfg.gdr_period;
+  const int32_t num = state->frame->num;
+
+  if (num <= period) {
+    // The first refresh period follows the intra picture so there is no
+    // recovery point to start decoding from.
+    return encoder->in.height;
+  }
+
+  // POC is equal to the frame number when GDR is enabled.
+  const int32_t ref_num = state->frame->ref->pocs[ref_idx];
+  const int32_t period_start = (num - 1) / period * period + 1;
+  if (ref_num < period_start) {
+    return 0;
+  }
+
+  int32_t first, end;
+  gdr_refresh_rows(encoder, ref_num, &first, &end);
+
+  int32_t filter_margin = 0;
+  if (encoder->cfg.sao_type) {
+    filter_margin = SAO_DELAY_PX;
+  } else if (encoder->cfg.deblock_enable) {
+    filter_margin = DEBLOCK_DELAY_PX;
+  }
+  return MAX(0, end * LCU_WIDTH - filter_margin);
+}
+
 lcu_stats_t* kvz_get_lcu_stats(encoder_state_t *state, int lcu_x, int lcu_y)
 {
   const int index = lcu_x + state->tile->lcu_offset_x +
@@ -1782,6 +2293,44 @@ lcu_stats_t* kvz_get_lcu_stats(encoder_state_t *state, int lcu_x, int lcu_y)
   return &state->frame->lcu_stats[index];
 }
 
+/**
+ * \brief Return the area of the tile whose pixels are final after the LCU.
+ *
+ * Deblocking and SAO of the following LCUs still modify the rightmost and
+ * bottommost pixels of the LCU, so the area is the LCU shifted up and left
+ * by the filter delay, extended to the edges of the tile.
+ *
+ * \param state   encoder state
+ * \param lcu     LCU that has been filtered
+ * \param start   returns the top-left corner of the area
+ * \param end     returns the bottom-right corner of the area, exclusive
+ */
+void kvz_lcu_finished_area(const encoder_state_t *state,
+                           const lcu_order_element_t *lcu,
+                           vector2d_t *start,
+                           vector2d_t *end)
+{
+  int delay = 0;
+  if (state->encoder_control->cfg.sao_type) {
+    delay = SAO_DELAY_PX;
+  } else if (state->encoder_control->cfg.deblock_enable) {
+    delay = DEBLOCK_DELAY_PX;
+  }
+
+  // The filters are applied across slice boundaries, so neighbours in other
+  // slices of the tile count as well.
+  const videoframe_t *const frame = state->tile->frame;
+  const bool left  = lcu->position.x > 0;
+  const bool above = lcu->position.y > 0;
+  const bool right = lcu->position.x + 1 < frame->width_in_lcu;
+  const bool below = lcu->position.y + 1 < frame->height_in_lcu;
+
+  start->x = lcu->position_px.x - (left  ? delay : 0);
+  start->y = lcu->position_px.y - (above ? delay : 0);
+  end->x   = lcu->position_px.x + lcu->size.x - (right ? delay : 0);
+  end->y   = lcu->position_px.y + lcu->size.y - (below ? delay : 0);
+}
+
 int kvz_get_cu_ref_qp(const encoder_state_t *state, int x, int y, int last_qp)
 {
   const cu_array_t *cua = state->tile->frame->cu_array;
@@ -46,8 +46,11 @@
 #include "image.h"
 #include "imagelist.h"
 #include "kvazaar.h"
+#include "ml_intra_cu_depth_pred.h"
+#include "nal.h"
 #include "tables.h"
 #include "threadqueue.h"
+#include "threads.h"
 #include "videoframe.h"
 #include "extras/crypto.h"
 
@@ -62,6 +65,9 @@ typedef enum {
 } encoder_state_type;
 
 
+//! \brief Number of scales in MS-SSIM
+#define MS_SSIM_SCALES 5
+
 typedef struct lcu_stats_t {
   //! \brief Number of bits that were spent
   uint32_t bits;
@@ -89,9 +95,30 @@ typedef struct lcu_stats_t {
   int8_t qp;
   int8_t adjust_qp;
   uint8_t skipped;
+
+  //! \brief Sum of squared errors of the Y, U and V pixels finished by the LCU
+  uint64_t sse[3];
+
+  //! \brief Sums of the SSIM and contrast-structure terms over the SSIM
+  //!        windows finished by the LCU at each MS-SSIM scale
+  double ssim[MS_SSIM_SCALES];
+  double ssim_cs[MS_SSIM_SCALES];
+  uint32_t ssim_windows[MS_SSIM_SCALES];
+
+  //! \brief Checksum or CRC of the Y, U and V pixels finished by the LCU
+  uint32_t hash[3];
 } lcu_stats_t;
 
 
+/**
+ * \brief Argument of the pre-analysis job of one LCU row.
+ */
+typedef struct pre_analysis_row_t {
+  struct encoder_state_t *state;
+  int32_t row;
+} pre_analysis_row_t;
+
+
 typedef struct encoder_state_config_frame_t {
   /**
    * \brief Frame-level lambda.
@@ -126,6 +153,9 @@ typedef struct encoder_state_config_frame_t {
   //! L0 reference index list size
   uint8_t ref_LX_size[2];
 
+  //! Motion of the current picture for TMVP of later pictures
+  cu_motion_field_t *motion_field;
+
   bool is_irap;
   uint8_t pictype;
   enum kvz_slice_type slicetype;
@@ -169,8 +199,17 @@ typedef struct encoder_state_config_frame_t {
    */
   lcu_stats_t *lcu_stats;
 
+  //! \brief MD5 of the Y, U and V planes of the reconstructed picture.
+  unsigned char picture_md5[3][SEI_HASH_MAX_LENGTH];
+
   pthread_mutex_t rc_lock;
 
+  //! \brief Fast coefficient cost weights of this frame with --fastrd-online.
+  uint64_t fast_coeff_wts[MAX_FAST_COEFF_COST_QP];
+  //! \brief CABAC cost samples of this frame for refitting the weights.
+  fast_coeff_stats_t fast_coeff_stats[MAX_FAST_COEFF_COST_QP];
+  pthread_mutex_t fast_coeff_lock;
+
   struct kvz_rc_data *new_ratecontrol;
 
   struct encoder_state_t const *previous_layer_state;
@@ -180,14 +219,78 @@ typedef struct encoder_state_config_frame_t {
   */
   double *aq_offsets;
 
+  /**
+   * \brief Jobs analysing the source picture, one for each LCU row.
+   *
+   * Started as soon as the frame is received, so the analysis overlaps the
+   * coding of the previous frames. LCUs that use the results depend on the
+   * job of their row.
+   */
+  threadqueue_job_t **pre_analysis_jobs;
+  pre_analysis_row_t *pre_analysis_rows;
+
+  //! Pixel variance of the source picture, computed by the pre-analysis.
+  double source_variance;
+
+  /**
+   * \brief Luma sums of each LCU for the ML intra depth prediction.
+   *
+   * Computed by the pre-analysis. NULL if the prediction is disabled.
+   */
+  ml_intra_ctu_sums_t *ml_intra_sums;
+
   int8_t max_qp_delta_depth;
 
   /**
    * \brief Whether next NAL is the first NAL in the access unit.
    */
   bool first_nal;
+
+  /**
+   * \brief Time when encoding of the frame was started.
+   */
+  KVZ_CLOCK_T encode_start;
+
+  /**
+   * \brief Time from encode_start until the bitstream was written, in seconds.
+   */
+  double latency;
+
+  /**
+   * \brief CTU rows coded as intra with gradual decoding refresh.
+   *
+   * Rows from gdr_refresh_first to gdr_refresh_end - 1 are refreshed in
+   * this frame. Rows above them have been refreshed in the preceding frames
+   * of the same refresh period.
+   */
+  int32_t gdr_refresh_first;
+  int32_t gdr_refresh_end;
+
+  //! VBV buffer fullness in bits before removal of the next picture.
+  double vbv_fullness;
+
+  //! Maximum number of bits for the current picture that does not underflow the VBV buffer.
+  double vbv_max_bits;
+
+  //! Number of LCUs coded in the current frame.
+  int32_t lcus_coded;
+
+  //! Frame number of the latest picture with a buffering period SEI.
+  int32_t hrd_bp_num;
+
+  //! Frame number of the picture with a buffering period SEI before hrd_bp_num.
+  int32_t hrd_prev_bp_num;
+
+  //! Frame number of the latest picture with POC 0.
+  int32_t hrd_poc0_num;
+
   double icost;
   double remaining_weight;
+
+  //! Intra rate control parameters at the start of the frame.
+  double intra_alpha;
+  double intra_beta;
+
   double i_bits_left;
 
   double *c_para;
@@ -233,6 +336,11 @@ typedef struct encoder_state_config_tile_t {
   //Jobs for each individual LCU of a wavefront row.
   threadqueue_job_t **wf_jobs;
 
+  // Downscaled luma of the source (0) and reconstruction (1) for MS-SSIM.
+  // Scale s is (width >> s) x (height >> s) pixels. Scale 0 is the frame
+  // itself and is not stored. NULL if SSIM is not calculated.
+  kvz_pixel *ssim_scales[2][MS_SSIM_SCALES];
+
 } encoder_state_config_tile_t;
 
 typedef struct encoder_state_config_slice_t {
@@ -248,7 +356,7 @@ typedef struct encoder_state_config_slice_t {
 } encoder_state_config_slice_t;
 
 typedef struct encoder_state_config_wfrow_t {
-  //Row in tile coordinates of the wavefront
+  //Row of the wavefront, counted from the first row of the parent state
   int32_t lcu_offset_y;
 } encoder_state_config_wfrow_t;
 
@@ -302,10 +410,22 @@ typedef struct encoder_state_t {
 
   uint32_t stats_bitstream_length; //Bitstream length written in bytes
 
+  //! \brief Function for outputting each slice, or NULL. Only used in the main state.
+  kvz_slice_callback slice_callback;
+  void *slice_callback_opaque;
+  //! \brief Number of bits of the current frame passed to slice_callback.
+  uint64_t slice_output_bits;
+
   //! \brief Lambda for SSE
   double lambda;
   //! \brief Lambda for SAD and SATD
   double lambda_sqrt;
+#if KVZ_FIXED_POINT_COST
+  //! \brief lambda with RD_LAMBDA_FRAC_BITS fractional bits
+  int64_t lambda_fixed;
+  //! \brief lambda_sqrt with RD_LAMBDA_FRAC_BITS fractional bits
+  int64_t lambda_sqrt_fixed;
+#endif
   //! \brief Quantization parameter for the current LCU
   int8_t qp;
 
@@ -339,6 +459,15 @@ typedef struct encoder_state_t {
   //Constraint structure  
   void * constraint;
 
+  //! \brief Merge candidate costs of the LCU being searched.
+  struct merge_satd_cache_t *merge_satd_cache;
+
+  //! \brief Unipred predictions of the PU in bi-prediction search.
+  struct unipred_cache_t *unipred_cache;
+
+  //! \brief Fast estimated blocks since the last --fastrd-online sample.
+  int32_t fast_coeff_sample_count;
+
 
 } encoder_state_t;
 
@@ -355,6 +484,12 @@ void kvz_encoder_create_ref_lists(const encoder_state_t *const state);
 
 lcu_stats_t* kvz_get_lcu_stats(encoder_state_t *state, int lcu_x, int lcu_y);
 
+void kvz_lcu_finished_area(const encoder_state_t *state,
+                           const lcu_order_element_t *lcu,
+                           vector2d_t *start,
+                           vector2d_t *end);
+
+int32_t kvz_gdr_ref_height(const encoder_state_t *state, int ref_idx);
 
 int kvz_get_cu_ref_qp(const encoder_state_t *state, int x, int y, int last_qp);
 
@@ -365,6 +500,14 @@ static INLINE bool encoder_state_must_write_vps(const encoder_state_t *state)
 {
   const int32_t frame = state->frame->num;
   const int32_t vps_period = state->encoder_control->cfg.vps_period;
+  const int32_t gdr_period = state->encoder_control->cfg.gdr_period;
+
+  if (gdr_period > 0) {
+    // Refresh periods start from frame 1 and each one after the first
+    // starts from a recovery point.
+    return (vps_period >= 0 && frame == 0) ||
+           (vps_period >  0 && frame > gdr_period && (frame - 1) % vps_period == 0);
+  }
 
   return (vps_period >  0 && frame % vps_period == 0) ||
          (vps_period >= 0 && frame == 0);
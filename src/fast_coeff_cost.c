@@ -34,6 +34,35 @@
 #include "kvazaar.h"
 #include "encoderstate.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Weight of the previously accumulated samples when the samples of a new
+// frame are added.
+#define FASTRD_ONLINE_DECAY 0.875
+// Number of samples of a QP needed before its weights are refit.
+#define FASTRD_ONLINE_MIN_SAMPLES 32
+// Strength of the pull towards the initial weights, as a number of samples.
+#define FASTRD_ONLINE_PRIOR_SAMPLES 64.0
+
+struct fast_coeff_online_t {
+  threadqueue_queue_t *threadqueue;
+  //! The last refit job, or NULL.
+  threadqueue_job_t *refit_job;
+
+  //! Weights from the default table or the table file.
+  double initial[MAX_FAST_COEFF_COST_QP][4];
+
+  // Decayed sums of the samples of all finished frames.
+  double count[MAX_FAST_COEFF_COST_QP];
+  double xx[MAX_FAST_COEFF_COST_QP][4][4];
+  double xy[MAX_FAST_COEFF_COST_QP][4];
+
+  //! Current weights. Written by the refit job with atomic stores.
+  fast_coeff_table_t table;
+};
+
 // Note: Assumes that costs are non-negative, for pretty obvious reasons
 static uint16_t to_q88(float f)
 {
@@ -81,8 +110,224 @@ void kvz_fast_coeff_use_default_table(fast_coeff_table_t *fast_coeff_table)
   }
 }
 
+/**
+ * \brief Get the coefficient cost weights for the QP of the state.
+ *
+ * The tables only go up to MAX_FAST_COEFF_COST_QP - 1, so the weights of
+ * that QP are used for the QPs above it.
+ */
 uint64_t kvz_fast_coeff_get_weights(const encoder_state_t *state)
 {
+  const int qp = CLIP(0, MAX_FAST_COEFF_COST_QP - 1, state->qp);
+  if (state->encoder_control->fast_coeff_online) {
+    return state->frame->fast_coeff_wts[qp];
+  }
   const fast_coeff_table_t *table = &(state->encoder_control->fast_coeff_table);
-  return table->wts_by_qp[state->qp];
+  return table->wts_by_qp[qp];
+}
+
+fast_coeff_online_t *kvz_fast_coeff_online_alloc(const fast_coeff_table_t *initial,
+                                                 threadqueue_queue_t *threadqueue)
+{
+  fast_coeff_online_t *online = calloc(1, sizeof(fast_coeff_online_t));
+  if (!online) return NULL;
+
+  online->threadqueue = threadqueue;
+  online->table = *initial;
+  for (int qp = 0; qp < MAX_FAST_COEFF_COST_QP; qp++) {
+    for (int i = 0; i < 4; i++) {
+      online->initial[qp][i] = ((initial->wts_by_qp[qp] >> (16 * i)) & 0xffff) / 256.0;
+    }
+  }
+  return online;
+}
+
+void kvz_fast_coeff_online_free(fast_coeff_online_t *online)
+{
+  if (!online) return;
+
+  // The threadqueue has been stopped by now so the job won't run anymore.
+  kvz_threadqueue_free_job(&online->refit_job);
+  free(online);
+}
+
+/**
+ * \brief Start using the current weights for a new frame.
+ *
+ * The weights are copied to the frame so that they stay the same while the
+ * frame is being encoded.
+ */
+void kvz_fast_coeff_online_start_frame(encoder_state_t *state)
+{
+  fast_coeff_online_t *online = state->encoder_control->fast_coeff_online;
+
+  if (state->encoder_control->cfg.deterministic && online->refit_job) {
+    // Use the weights fitted from all frames finished so far instead of
+    // whatever the refit job has published by now.
+    kvz_threadqueue_waitfor(online->threadqueue, online->refit_job);
+  }
+
+  for (int qp = 0; qp < MAX_FAST_COEFF_COST_QP; qp++) {
+    state->frame->fast_coeff_wts[qp] = KVZ_ATOMIC_LOAD_ACQUIRE64(&online->table.wts_by_qp[qp]);
+  }
+  memset(state->frame->fast_coeff_stats, 0, sizeof(state->frame->fast_coeff_stats));
+}
+
+/**
+ * \brief Add a block with a known CABAC cost to the samples of the frame.
+ *
+ * \param bits   CABAC cost of the coefficients with RD_FRAC_BITS fractional bits
+ */
+void kvz_fast_coeff_online_add_sample(const encoder_state_t *state,
+                                      const coeff_t *coeff,
+                                      int32_t width,
+                                      int64_t bits)
+{
+  int64_t x[4] = { 0, 0, 0, 0 };
+  for (int32_t i = 0; i < width * width; i++) {
+    x[MIN(abs(coeff[i]), 3)]++;
+  }
+
+  fast_coeff_stats_t *stats = &state->frame->fast_coeff_stats[state->qp];
+
+  pthread_mutex_lock(&state->frame->fast_coeff_lock);
+  stats->count++;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      stats->xx[i][j] += x[i] * x[j];
+    }
+    stats->xy[i] += x[i] * bits;
+  }
+  pthread_mutex_unlock(&state->frame->fast_coeff_lock);
+}
+
+/**
+ * \brief Solve the regularized least squares weights of one QP.
+ *
+ * Solves (XtX + lambda * I) w = Xty + lambda * w0 with Gaussian elimination,
+ * where w0 are the initial weights. Weights that come out negative are fixed
+ * to zero and the rest are solved again.
+ *
+ * \return 1 on success, 0 if the system is singular
+ */
+static int refit_qp(const fast_coeff_online_t *online, int qp, double wts[4])
+{
+  const double lambda = FASTRD_ONLINE_PRIOR_SAMPLES *
+    (online->xx[qp][0][0] + online->xx[qp][1][1] +
+     online->xx[qp][2][2] + online->xx[qp][3][3]) / (4.0 * online->count[qp]);
+
+  bool fixed[4] = { false, false, false, false };
+
+  for (int iter = 0; iter < 4; iter++) {
+    // Fixed weights are zero, so they are replaced by the equation w_i = 0.
+    double a[4][5];
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 4; j++) {
+        if (fixed[i] || fixed[j]) {
+          a[i][j] = (i == j) ? 1.0 : 0.0;
+        } else {
+          a[i][j] = online->xx[qp][i][j] + (i == j ? lambda : 0.0);
+        }
+      }
+      a[i][4] = fixed[i] ? 0.0 : online->xy[qp][i] + lambda * online->initial[qp][i];
+    }
+
+    for (int col = 0; col < 4; col++) {
+      int pivot = col;
+      for (int row = col + 1; row < 4; row++) {
+        if (fabs(a[row][col]) > fabs(a[pivot][col])) pivot = row;
+      }
+      if (fabs(a[pivot][col]) < 1e-9) return 0;
+
+      for (int j = 0; j < 5; j++) {
+        double tmp = a[col][j];
+        a[col][j] = a[pivot][j];
+        a[pivot][j] = tmp;
+      }
+      for (int row = col + 1; row < 4; row++) {
+        const double f = a[row][col] / a[col][col];
+        for (int j = col; j < 5; j++) {
+          a[row][j] -= f * a[col][j];
+        }
+      }
+    }
+
+    for (int i = 3; i >= 0; i--) {
+      double sum = a[i][4];
+      for (int j = i + 1; j < 4; j++) {
+        sum -= a[i][j] * wts[j];
+      }
+      wts[i] = sum / a[i][i];
+    }
+
+    int most_negative = -1;
+    for (int i = 0; i < 4; i++) {
+      if (wts[i] < 0.0 && (most_negative < 0 || wts[i] < wts[most_negative])) {
+        most_negative = i;
+      }
+    }
+    if (most_negative < 0) break;
+    fixed[most_negative] = true;
+  }
+
+  // The weights are stored as unsigned Q8.8.
+  for (int i = 0; i < 4; i++) {
+    wts[i] = CLIP(0.0, 255.99, wts[i]);
+  }
+  return 1;
+}
+
+static void fast_coeff_online_refit_worker(void *opaque)
+{
+  fast_coeff_online_t *online = opaque;
+
+  for (int qp = 0; qp < MAX_FAST_COEFF_COST_QP; qp++) {
+    double wts[4];
+    if (online->count[qp] < FASTRD_ONLINE_MIN_SAMPLES ||
+        !refit_qp(online, qp, wts)) {
+      continue;
+    }
+    KVZ_ATOMIC_STORE_RELEASE64(&online->table.wts_by_qp[qp], to_4xq88(wts));
+  }
+}
+
+/**
+ * \brief Add the samples of a finished frame and refit the weights.
+ *
+ * Called in output order, so the weights depend only on which frames have
+ * been finished. The refit runs as a job in the background.
+ */
+void kvz_fast_coeff_online_finish_frame(encoder_state_t *state)
+{
+  fast_coeff_online_t *online = state->encoder_control->fast_coeff_online;
+  const fast_coeff_stats_t *stats = state->frame->fast_coeff_stats;
+
+  bool have_samples = false;
+  for (int qp = 0; qp < MAX_FAST_COEFF_COST_QP; qp++) {
+    have_samples |= stats[qp].count > 0;
+  }
+  if (!have_samples) return;
+
+  // The refit job reads the sums, so wait for the previous one before
+  // touching them.
+  if (online->refit_job) {
+    kvz_threadqueue_waitfor(online->threadqueue, online->refit_job);
+    kvz_threadqueue_free_job(&online->refit_job);
+  }
+
+  const double y_scale = 1.0 / (1 << RD_FRAC_BITS);
+  for (int qp = 0; qp < MAX_FAST_COEFF_COST_QP; qp++) {
+    if (stats[qp].count == 0) continue;
+
+    online->count[qp] = online->count[qp] * FASTRD_ONLINE_DECAY + stats[qp].count;
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 4; j++) {
+        online->xx[qp][i][j] = online->xx[qp][i][j] * FASTRD_ONLINE_DECAY + stats[qp].xx[i][j];
+      }
+      online->xy[qp][i] = online->xy[qp][i] * FASTRD_ONLINE_DECAY + stats[qp].xy[i] * y_scale;
+    }
+  }
+
+  online->refit_job = kvz_threadqueue_job_create(fast_coeff_online_refit_worker, online);
+  kvz_threadqueue_submit(online->threadqueue, online->refit_job);
 }
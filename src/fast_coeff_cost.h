@@ -34,7 +34,9 @@
 #define FAST_COEFF_COST_H_
 
 #include <stdio.h>
+#include "global.h" // IWYU pragma: keep
 #include "kvazaar.h"
+#include "threadqueue.h"
 // #include "encoderstate.h"
 
 #define MAX_FAST_COEFF_COST_QP 50
@@ -102,10 +104,35 @@ static const double default_fast_coeff_cost_wts[][4] = {
 
 };
 
+/**
+ * \brief Sums for fitting the weights of one QP with least squares.
+ *
+ * x is the number of coefficients in each of the four buckets and y the
+ * CABAC cost of the block with RD_FRAC_BITS fractional bits. The sums are
+ * integers so that they don't depend on the order of the samples.
+ */
+typedef struct {
+  int64_t count;
+  int64_t xx[4][4];
+  int64_t xy[4];
+} fast_coeff_stats_t;
+
+typedef struct fast_coeff_online_t fast_coeff_online_t;
+
 typedef struct encoder_state_t encoder_state_t;
 
 int kvz_fast_coeff_table_parse(fast_coeff_table_t *fast_coeff_table, FILE *fast_coeff_table_f);
 void kvz_fast_coeff_use_default_table(fast_coeff_table_t *fast_coeff_table);
 uint64_t kvz_fast_coeff_get_weights(const encoder_state_t *state);
 
+fast_coeff_online_t *kvz_fast_coeff_online_alloc(const fast_coeff_table_t *initial,
+                                                 threadqueue_queue_t *threadqueue);
+void kvz_fast_coeff_online_free(fast_coeff_online_t *online);
+void kvz_fast_coeff_online_start_frame(encoder_state_t *state);
+void kvz_fast_coeff_online_add_sample(const encoder_state_t *state,
+                                      const coeff_t *coeff,
+                                      int32_t width,
+                                      int64_t bits);
+void kvz_fast_coeff_online_finish_frame(encoder_state_t *state);
+
 #endif // FAST_COEFF_COST_H_
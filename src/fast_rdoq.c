@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "fast_rdoq.h"
+
+#include "global.h"
+
+static uint16_t to_q9(double f)
+{
+  return (uint16_t)(CLIP(0.0, 1.0, f) * 512.0 + 0.5);
+}
+
+static void set_offsets(fast_rdoq_table_t *fast_rdoq_table, int qp, const double offsets[8])
+{
+  for (int size = 0; size < 4; size++) {
+    fast_rdoq_table->deadzone[qp][size] = to_q9(offsets[2 * size + 0]);
+    fast_rdoq_table->rounding[qp][size] = to_q9(offsets[2 * size + 1]);
+  }
+}
+
+int kvz_fast_rdoq_table_parse(fast_rdoq_table_t *fast_rdoq_table, FILE *fast_rdoq_table_f)
+{
+  for (int i = 0; i < MAX_FAST_RDOQ_QP; i++) {
+    double curr_offsets[8];
+
+    if (fscanf(fast_rdoq_table_f, "%lf %lf %lf %lf %lf %lf %lf %lf\n",
+               curr_offsets + 0, curr_offsets + 1,
+               curr_offsets + 2, curr_offsets + 3,
+               curr_offsets + 4, curr_offsets + 5,
+               curr_offsets + 6, curr_offsets + 7) != 8) {
+      return 1;
+    }
+    set_offsets(fast_rdoq_table, i, curr_offsets);
+  }
+  return 0;
+}
+
+void kvz_fast_rdoq_use_default_table(fast_rdoq_table_t *fast_rdoq_table)
+{
+  for (int i = 0; i < MAX_FAST_RDOQ_QP; i++) {
+    set_offsets(fast_rdoq_table, i, default_fast_rdoq_offsets[i]);
+  }
+}
@@ -0,0 +1,113 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#ifndef FAST_RDOQ_H_
+#define FAST_RDOQ_H_
+
+/**
+ * \file
+ * \brief Offset table for the approximate RDOQ quantizer.
+ */
+
+#include <stdio.h>
+#include "kvazaar.h"
+
+#define MAX_FAST_RDOQ_QP 50
+
+typedef struct {
+  // Deadzone and rounding offsets in units of 1/512 of a quantization step,
+  // for transform sizes 4x4 to 32x32.
+  uint16_t deadzone[MAX_FAST_RDOQ_QP][4];
+  uint16_t rounding[MAX_FAST_RDOQ_QP][4];
+} fast_rdoq_table_t;
+
+// Deadzone and rounding offset pairs for 4x4, 8x8, 16x16 and 32x32
+// transforms, for QPs from 0 to MAX_FAST_RDOQ_QP. The deadzone offset
+// decides between levels 0 and 1 and the rounding offset is used for larger
+// levels. Fitted to the decisions of full RDOQ.
+static const double default_fast_rdoq_offsets[][8] = {
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.352, 0.469, 0.500, 0.469, 0.500, 0.469},
+{0.445, 0.453, 0.391, 0.453, 0.500, 0.453, 0.500, 0.453},
+{0.445, 0.453, 0.391, 0.453, 0.500, 0.453, 0.500, 0.453},
+{0.438, 0.453, 0.438, 0.453, 0.492, 0.453, 0.492, 0.438},
+{0.438, 0.453, 0.438, 0.453, 0.492, 0.453, 0.492, 0.438},
+{0.430, 0.406, 0.438, 0.453, 0.469, 0.422, 0.492, 0.438},
+{0.430, 0.414, 0.438, 0.445, 0.445, 0.422, 0.445, 0.398},
+{0.430, 0.422, 0.422, 0.453, 0.445, 0.422, 0.398, 0.430},
+{0.430, 0.438, 0.398, 0.422, 0.414, 0.422, 0.430, 0.430},
+{0.398, 0.445, 0.398, 0.453, 0.414, 0.445, 0.383, 0.430},
+{0.383, 0.445, 0.391, 0.453, 0.398, 0.445, 0.383, 0.453},
+{0.383, 0.445, 0.375, 0.453, 0.375, 0.445, 0.375, 0.445},
+{0.383, 0.453, 0.375, 0.453, 0.375, 0.445, 0.375, 0.445},
+{0.359, 0.453, 0.234, 0.453, 0.227, 0.453, 0.258, 0.445},
+{0.336, 0.453, 0.234, 0.453, 0.227, 0.453, 0.258, 0.445},
+{0.305, 0.453, 0.203, 0.453, 0.219, 0.453, 0.227, 0.453},
+{0.305, 0.453, 0.188, 0.453, 0.188, 0.453, 0.227, 0.453},
+{0.305, 0.445, 0.188, 0.453, 0.172, 0.453, 0.227, 0.453},
+{0.320, 0.445, 0.250, 0.438, 0.211, 0.453, 0.281, 0.453},
+{0.320, 0.445, 0.250, 0.438, 0.219, 0.453, 0.266, 0.453},
+{0.336, 0.445, 0.250, 0.438, 0.219, 0.453, 0.258, 0.453},
+{0.344, 0.438, 0.281, 0.430, 0.250, 0.453, 0.258, 0.453},
+{0.336, 0.438, 0.281, 0.430, 0.266, 0.445, 0.258, 0.438},
+{0.383, 0.422, 0.281, 0.414, 0.289, 0.414, 0.258, 0.430},
+{0.375, 0.422, 0.281, 0.406, 0.289, 0.414, 0.273, 0.430},
+{0.398, 0.422, 0.281, 0.383, 0.289, 0.367, 0.312, 0.438},
+{0.375, 0.430, 0.281, 0.383, 0.289, 0.367, 0.312, 0.445},
+{0.375, 0.430, 0.281, 0.383, 0.281, 0.352, 0.320, 0.453},
+{0.250, 0.398, 0.273, 0.375, 0.266, 0.352, 0.320, 0.453},
+{0.250, 0.438, 0.211, 0.383, 0.234, 0.352, 0.305, 0.453},
+{0.250, 0.438, 0.273, 0.383, 0.266, 0.352, 0.312, 0.453},
+{0.250, 0.461, 0.281, 0.383, 0.258, 0.352, 0.305, 0.453},
+{0.273, 0.461, 0.281, 0.383, 0.258, 0.328, 0.297, 0.453},
+{0.273, 0.461, 0.281, 0.383, 0.234, 0.320, 0.297, 0.453},
+{0.164, 0.461, 0.281, 0.375, 0.250, 0.320, 0.297, 0.453},
+{0.125, 0.461, 0.242, 0.375, 0.195, 0.320, 0.289, 0.453},
+{0.125, 0.461, 0.219, 0.375, 0.125, 0.320, 0.258, 0.453},
+{0.180, 0.461, 0.219, 0.375, 0.125, 0.320, 0.258, 0.453},
+};
+
+int kvz_fast_rdoq_table_parse(fast_rdoq_table_t *fast_rdoq_table, FILE *fast_rdoq_table_f);
+void kvz_fast_rdoq_use_default_table(fast_rdoq_table_t *fast_rdoq_table);
+
+#endif // FAST_RDOQ_H_
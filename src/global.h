@@ -283,6 +283,67 @@ typedef int16_t coeff_t;
 #define MAX_DOUBLE 1.7e+308
 #endif
 
+/**
+ * \brief Arithmetic used for rate-distortion costs.
+ *
+ * When KVZ_FIXED_POINT_COST is nonzero, bit counts and RD costs are integers
+ * with RD_FRAC_BITS fractional bits and lambda is applied as an integer with
+ * RD_LAMBDA_FRAC_BITS fractional bits. Mode decisions then do not depend on
+ * the floating point behaviour of the platform or compiler. Otherwise the
+ * costs are doubles and the macros expand to the plain expressions.
+ *
+ * Bits are converted to costs with RD_COST_BITS or RD_COST_BITS_SQRT and
+ * distortions with RD_COST_DIST or RD_COST_WDIST.
+ */
+#ifndef KVZ_FIXED_POINT_COST
+#define KVZ_FIXED_POINT_COST 0
+#endif
+
+#define RD_FRAC_BITS 15
+#define RD_LAMBDA_FRAC_BITS 16
+
+#if KVZ_FIXED_POINT_COST
+typedef int64_t rd_bits_t;
+typedef int64_t rd_cost_t;
+
+#define RD_BITS(n) ((rd_bits_t)(n) * (1 << RD_FRAC_BITS))
+#define RD_BITS_FROM_DOUBLE(b) ((rd_bits_t)((b) * (1 << RD_FRAC_BITS) + 0.5))
+#define RD_BITS_TO_DOUBLE(b) ((double)(b) / (1 << RD_FRAC_BITS))
+// Small enough that the cost of RD_BITS_MAX does not overflow.
+#define RD_BITS_MAX (MAX_INT64 >> 32)
+
+#define RD_COST_DIST(d) ((rd_cost_t)(d) * (1 << RD_FRAC_BITS))
+#define RD_COST_WDIST(d, w) \
+  ((rd_cost_t)(d) * (rd_cost_t)((w) * (1 << RD_FRAC_BITS) + 0.5))
+#define RD_COST_BITS(state, b) \
+  (((b) * (state)->lambda_fixed + (1 << (RD_LAMBDA_FRAC_BITS - 1))) >> RD_LAMBDA_FRAC_BITS)
+#define RD_COST_BITS_SQRT(state, b) \
+  (((b) * (state)->lambda_sqrt_fixed + (1 << (RD_LAMBDA_FRAC_BITS - 1))) >> RD_LAMBDA_FRAC_BITS)
+#define RD_COST_SCALE(c, num, den) ((c) * (num) / (den))
+#define RD_COST_TRUNC(c) (c)
+#define RD_COST_TO_DOUBLE(c) ((double)(c) / (1 << RD_FRAC_BITS))
+#define RD_COST_MAX (MAX_INT64 >> 2)
+#else
+typedef double rd_bits_t;
+typedef double rd_cost_t;
+
+#define RD_BITS(n) (n)
+#define RD_BITS_FROM_DOUBLE(b) (b)
+#define RD_BITS_TO_DOUBLE(b) (b)
+#define RD_BITS_MAX MAX_INT
+
+#define RD_COST_DIST(d) ((double)(d))
+#define RD_COST_WDIST(d, w) ((double)(d) * (w))
+#define RD_COST_BITS(state, b) ((b) * (state)->lambda)
+#define RD_COST_BITS_SQRT(state, b) ((b) * (state)->lambda_sqrt)
+#define RD_COST_SCALE(c, num, den) ((c) * ((double)(num) / (den)))
+// Some searches keep their costs in integer variables. This reproduces the
+// truncation in the floating point build.
+#define RD_COST_TRUNC(c) ((double)(int64_t)(c))
+#define RD_COST_TO_DOUBLE(c) (c)
+#define RD_COST_MAX MAX_DOUBLE
+#endif
+
 //For transform.h and encoder.h
 #define SCALING_LIST_4x4      0
 #define SCALING_LIST_8x8      1
@@ -35,6 +35,10 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 #include "strategies/strategies-ipol.h"
 #include "strategies/strategies-picture.h"
 #include "threads.h"
@@ -142,6 +146,33 @@ void kvz_image_free(kvz_picture *const im)
   free(im);
 }
 
+/**
+ * \brief Ask the kernel to back the pixels of an image with huge pages.
+ *
+ * Only the whole 2 MiB pages inside the buffer are affected, so this
+ * should be called before the pixels are first written. Does nothing on
+ * systems without transparent huge pages.
+ */
+void kvz_image_use_huge_pages(const kvz_picture *const im)
+{
+#ifdef MADV_HUGEPAGE
+  const uintptr_t huge_page_size = 2 * 1024 * 1024;
+
+  const size_t luma_size = im->width * im->height;
+  const size_t chroma_sizes[] = { 0, luma_size / 4, luma_size / 2, luma_size };
+  const size_t size = (luma_size + 2 * chroma_sizes[im->chroma_format]) * sizeof(kvz_pixel);
+
+  const uintptr_t start = ((uintptr_t)im->fulldata + huge_page_size - 1) & ~(huge_page_size - 1);
+  const uintptr_t end = ((uintptr_t)im->fulldata + size) & ~(huge_page_size - 1);
+  if (end > start) {
+    // Failing is harmless, the image just stays on normal pages.
+    madvise((void *)start, end - start, MADV_HUGEPAGE);
+  }
+#else
+  (void)im;
+#endif
+}
+
 /**
  * \brief Get a new pointer to an image.
  *
@@ -70,6 +70,8 @@ kvz_picture *kvz_image_alloc(enum kvz_chroma_format chroma_format, const int32_t
 
 void kvz_image_free(kvz_picture *im);
 
+void kvz_image_use_huge_pages(const kvz_picture *im);
+
 kvz_picture *kvz_image_copy_ref(kvz_picture *im);
 
 kvz_picture *kvz_image_make_subimage(kvz_picture *const orig_image,
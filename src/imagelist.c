@@ -50,6 +50,8 @@ image_list_t * kvz_image_list_alloc(int size)
   list->size      = size;
   list->images    = malloc(sizeof(kvz_picture*)  * size);
   list->cu_arrays = malloc(sizeof(cu_array_t*)   * size);
+  list->motion_fields = malloc(sizeof(cu_motion_field_t*) * size);
+  list->progress  = malloc(sizeof(threadqueue_progress_t*) * size);
   list->pocs      = malloc(sizeof(int32_t)       * size);
   list->ref_LXs   = malloc(sizeof(*list->ref_LXs) * size);
   list->used_size = 0;
@@ -67,10 +69,12 @@ int kvz_image_list_resize(image_list_t *list, unsigned size)
 {
   list->images = (kvz_picture**)realloc(list->images, sizeof(kvz_picture*) * size);
   list->cu_arrays = (cu_array_t**)realloc(list->cu_arrays, sizeof(cu_array_t*) * size);
+  list->motion_fields = (cu_motion_field_t**)realloc(list->motion_fields, sizeof(cu_motion_field_t*) * size);
+  list->progress = (threadqueue_progress_t**)realloc(list->progress, sizeof(threadqueue_progress_t*) * size);
   list->pocs = realloc(list->pocs, sizeof(int32_t) * size);
   list->ref_LXs = realloc(list->ref_LXs, sizeof(*list->ref_LXs) * size);
   list->size = size;
-  return size == 0 || (list->images && list->cu_arrays && list->pocs);
+  return size == 0 || (list->images && list->cu_arrays && list->motion_fields && list->progress && list->pocs);
 }
 
 /**
@@ -87,6 +91,8 @@ int kvz_image_list_destroy(image_list_t *list)
       list->images[i] = NULL;
       kvz_cu_array_free(&list->cu_arrays[i]);
       list->cu_arrays[i] = NULL;
+      kvz_cu_motion_field_free(&list->motion_fields[i]);
+      kvz_threadqueue_progress_free(&list->progress[i]);
       list->pocs[i] = 0;
       for (int j = 0; j < 16; j++) {
         list->ref_LXs[i][0][j] = 0;
@@ -98,11 +104,15 @@ int kvz_image_list_destroy(image_list_t *list)
   if (list->size > 0) {
     free(list->images);
     free(list->cu_arrays);
+    free(list->motion_fields);
+    free(list->progress);
     free(list->pocs);
     free(list->ref_LXs);
   }
   list->images = NULL;
   list->cu_arrays = NULL;
+  list->motion_fields = NULL;
+  list->progress = NULL;
   list->pocs = NULL;
   list->ref_LXs = NULL;
   free(list);
@@ -113,9 +123,12 @@ int kvz_image_list_destroy(image_list_t *list)
  * \brief Add picture to the front of the picturelist
  * \param pic picture pointer to add
  * \param picture_list list to use
+ * \param cua      cu array of the picture or NULL
+ * \param motion   motion field of the picture
+ * \param progress row progress of the picture or NULL
  * \return 1 on success
  */
-int kvz_image_list_add(image_list_t *list, kvz_picture *im, cu_array_t *cua, int32_t poc, uint8_t ref_LX[2][16])
+int kvz_image_list_add(image_list_t *list, kvz_picture *im, cu_array_t *cua, cu_motion_field_t *motion, threadqueue_progress_t *progress, int32_t poc, uint8_t ref_LX[2][16])
 {
   int i = 0;
   if (KVZ_ATOMIC_INC(&(im->refcount)) == 1) {
@@ -124,7 +137,7 @@ int kvz_image_list_add(image_list_t *list, kvz_picture *im, cu_array_t *cua, int
     return 0;
   }
   
-  if (KVZ_ATOMIC_INC(&(cua->refcount)) == 1) {
+  if (cua && KVZ_ATOMIC_INC(&(cua->refcount)) == 1) {
     fprintf(stderr, "Tried to add an unreferenced cu_array. This is a bug!\n");
     assert(0); //Stop for debugging
     return 0;
@@ -138,6 +151,8 @@ int kvz_image_list_add(image_list_t *list, kvz_picture *im, cu_array_t *cua, int
   for (i = list->used_size; i > 0; i--) {
     list->images[i] = list->images[i - 1];
     list->cu_arrays[i] = list->cu_arrays[i - 1];
+    list->motion_fields[i] = list->motion_fields[i - 1];
+    list->progress[i] = list->progress[i - 1];
     list->pocs[i] = list->pocs[i - 1];
     for (int j = 0; j < 16; j++) {
       list->ref_LXs[i][0][j] = list->ref_LXs[i - 1][0][j];
@@ -147,6 +162,8 @@ int kvz_image_list_add(image_list_t *list, kvz_picture *im, cu_array_t *cua, int
 
   list->images[0] = im;
   list->cu_arrays[0] = cua;
+  list->motion_fields[0] = kvz_cu_motion_field_copy_ref(motion);
+  list->progress[0] = progress ? kvz_threadqueue_progress_copy_ref(progress) : NULL;
   list->pocs[0] = poc;
   for (int j = 0; j < 16; j++) {
     list->ref_LXs[0][0][j] = ref_LX[0][j];
@@ -175,10 +192,16 @@ int kvz_image_list_rem(image_list_t * const list, const unsigned n)
 
   kvz_cu_array_free(&list->cu_arrays[n]);
 
+  kvz_cu_motion_field_free(&list->motion_fields[n]);
+
+  kvz_threadqueue_progress_free(&list->progress[n]);
+
   // The last item is easy to remove
   if (n == list->used_size - 1) {
     list->images[n] = NULL;
     list->cu_arrays[n] = NULL;
+    list->motion_fields[n] = NULL;
+    list->progress[n] = NULL;
     list->pocs[n] = 0;
     for (int j = 0; j < 16; j++) {
       list->ref_LXs[n][0][j] = 0;
@@ -191,6 +214,8 @@ int kvz_image_list_rem(image_list_t * const list, const unsigned n)
     for (i = n; i < list->used_size - 1; ++i) {
       list->images[i] = list->images[i + 1];
       list->cu_arrays[i] = list->cu_arrays[i + 1];
+      list->motion_fields[i] = list->motion_fields[i + 1];
+      list->progress[i] = list->progress[i + 1];
       list->pocs[i] = list->pocs[i + 1];
       for (int j = 0; j < 16; j++) {
         list->ref_LXs[i][0][j] = list->ref_LXs[i + 1][0][j];
@@ -199,6 +224,8 @@ int kvz_image_list_rem(image_list_t * const list, const unsigned n)
     }
     list->images[list->used_size - 1] = NULL;
     list->cu_arrays[list->used_size - 1] = NULL;
+    list->motion_fields[list->used_size - 1] = NULL;
+    list->progress[list->used_size - 1] = NULL;
     list->pocs[list->used_size - 1] = 0;
     for (int j = 0; j < 16; j++) {
       list->ref_LXs[list->used_size - 1][0][j] = 0;
@@ -217,7 +244,7 @@ int kvz_image_list_copy_contents(image_list_t *target, image_list_t *source) {
   }
   
   for (i = source->used_size - 1; i >= 0; --i) {
-    kvz_image_list_add(target, source->images[i], source->cu_arrays[i], source->pocs[i], source->ref_LXs[i]);
+    kvz_image_list_add(target, source->images[i], source->cu_arrays[i], source->motion_fields[i], source->progress[i], source->pocs[i], source->ref_LXs[i]);
   }
   return 1;
 }
@@ -41,6 +41,7 @@
 #include "cu.h"
 #include "global.h" // IWYU pragma: keep
 #include "kvazaar.h"
+#include "threadqueue.h"
 
 
 /**
@@ -49,7 +50,9 @@
 typedef struct
 {
   struct kvz_picture* *images;          //!< \brief Pointer to array of picture pointers.
-  cu_array_t* *cu_arrays;
+  cu_array_t* *cu_arrays; //!< \brief CU data of each image, NULL if not kept.
+  cu_motion_field_t* *motion_fields; //!< \brief Compressed motion of each image for TMVP.
+  threadqueue_progress_t* *progress; //!< \brief Reconstructed CTUs of each CTU row, NULL if not tracked.
   int32_t *pocs;
   uint8_t (*ref_LXs)[2][16]; //!< L0 and L1 reference index list for each image
   uint32_t size;       //!< \brief Array size.
@@ -61,7 +64,7 @@ typedef struct
 image_list_t * kvz_image_list_alloc(int size);
 int kvz_image_list_resize(image_list_t *list, unsigned size);
 int kvz_image_list_destroy(image_list_t *list);
-int kvz_image_list_add(image_list_t *list, kvz_picture *im, cu_array_t* cua, int32_t poc, uint8_t ref_LX[2][16]);
+int kvz_image_list_add(image_list_t *list, kvz_picture *im, cu_array_t* cua, cu_motion_field_t *motion, threadqueue_progress_t *progress, int32_t poc, uint8_t ref_LX[2][16]);
 int kvz_image_list_rem(image_list_t *list, unsigned n);
 
 int kvz_image_list_copy_contents(image_list_t *target, image_list_t *source);
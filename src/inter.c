@@ -47,8 +47,8 @@
 typedef struct {
   const cu_info_t *a[2];
   const cu_info_t *b[3];
-  const cu_info_t *c3;
-  const cu_info_t *h;
+  const cu_motion_t *c3;
+  const cu_motion_t *h;
 } merge_candidates_t;
 
 
@@ -501,6 +501,43 @@ static unsigned inter_recon_unipred(const encoder_state_t * const state,
  * \param predict_luma   Enable or disable luma prediction for this call.
  * \param predict_chroma Enable or disable chroma prediction for this call.
  */
+/**
+ * \brief Predict the luma of a PU from one reference for bi-prediction.
+ *
+ * The result can be combined with kvz_bipred_average. Both outputs have
+ * a stride of pu_w.
+ *
+ * \param px_out   output for integer MVs
+ * \param im_out   high precision output for fractional MVs
+ *
+ * \return 1 if the prediction was written to im_out, 0 if to px_out
+ */
+unsigned kvz_inter_pred_unipred_luma(const encoder_state_t *state,
+                                     const kvz_picture *ref,
+                                     int32_t pu_x,
+                                     int32_t pu_y,
+                                     int32_t pu_w,
+                                     int32_t pu_h,
+                                     const int16_t mv_param[2],
+                                     kvz_pixel *px_out,
+                                     kvz_pixel_im *im_out)
+{
+  yuv_t px;
+  px.size = pu_w * pu_h;
+  px.y = px_out;
+  px.u = NULL;
+  px.v = NULL;
+
+  yuv_im_t im;
+  im.size = pu_w * pu_h;
+  im.y = im_out;
+  im.u = NULL;
+  im.v = NULL;
+
+  return inter_recon_unipred(state, ref, pu_x, pu_y, pu_w, pu_h, pu_w, mv_param,
+                             &px, &im, true, false);
+}
+
 void kvz_inter_recon_bipred(const encoder_state_t *const state,
   const kvz_picture *ref1,
   const kvz_picture *ref2,
@@ -618,7 +655,7 @@ void kvz_inter_pred_pu(const encoder_state_t * const state,
   const int pu_h = PU_GET_H(cu->part_size, width, i_pu);
   cu_info_t *pu = LCU_GET_CU_AT_PX(lcu, SUB_SCU(pu_x), SUB_SCU(pu_y));
 
-  if (pu->inter.mv_dir == 3) {
+  if (pu->mv_dir == 3) {
     const kvz_picture *const refs[2] = {
       state->frame->ref->images[
         state->frame->ref_LX[0][
@@ -636,7 +673,7 @@ void kvz_inter_pred_pu(const encoder_state_t * const state,
       predict_luma, predict_chroma);
   }
   else {
-    const int mv_idx = pu->inter.mv_dir - 1;
+    const int mv_idx = pu->mv_dir - 1;
     const kvz_picture *const ref =
       state->frame->ref->images[
         state->frame->ref_LX[mv_idx][
@@ -669,7 +706,7 @@ void kvz_inter_pred_pu(const encoder_state_t * const state,
 static void inter_clear_cu_unused(cu_info_t* cu)
 {
   for (unsigned i = 0; i < 2; ++i) {
-    if (cu->inter.mv_dir & (1 << i)) continue;
+    if (cu->mv_dir & (1 << i)) continue;
 
     cu->inter.mv[i][0] = 0;
     cu->inter.mv[i][1] = 0;
@@ -866,28 +903,19 @@ static void get_temporal_merge_candidates(const encoder_state_t * const state,
       return;
     }
 
-    cu_array_t *ref_cu_array = state->frame->ref->cu_arrays[colocated_ref];
-    int cu_per_width = ref_cu_array->width / SCU_WIDTH;
+    const cu_motion_field_t *ref_motion = state->frame->ref->motion_fields[colocated_ref];
 
     uint32_t xColBr = x + width;
     uint32_t yColBr = y + height;
 
-    // H must be available
+    // H must be available and Y inside the current CTU / LCU
     if (xColBr < state->encoder_control->in.width &&
-        yColBr < state->encoder_control->in.height) {
-      int32_t H_offset = -1;
-
-      // Y inside the current CTU / LCU
-      if (yColBr % LCU_WIDTH != 0) {
-        H_offset = ((xColBr >> 4) << 4) / SCU_WIDTH +
-                  (((yColBr >> 4) << 4) / SCU_WIDTH) * cu_per_width;
-      }
-
-      if (H_offset >= 0) {
-        // Only use when it's inter block
-        if (ref_cu_array->data[H_offset].type == CU_INTER) {
-          cand_out->h = &ref_cu_array->data[H_offset];
-        }
+        yColBr < state->encoder_control->in.height &&
+        yColBr % LCU_WIDTH != 0) {
+      const cu_motion_t *h = kvz_cu_motion_field_at(ref_motion, xColBr, yColBr);
+      // Only use when it's inter block
+      if (h->mv_dir) {
+        cand_out->h = h;
       }
     }
     uint32_t xColCtr = x + (width / 2);
@@ -895,9 +923,9 @@ static void get_temporal_merge_candidates(const encoder_state_t * const state,
 
     // C3 must be inside the LCU, in the center position of current CU
     if (xColCtr < state->encoder_control->in.width && yColCtr < state->encoder_control->in.height) {
-      uint32_t C3_offset = ((xColCtr >> 4) << 4) / SCU_WIDTH + ((((yColCtr >> 4) << 4) / SCU_WIDTH) * cu_per_width);
-      if (ref_cu_array->data[C3_offset].type == CU_INTER) {
-        cand_out->c3 = &ref_cu_array->data[C3_offset];
+      const cu_motion_t *c3 = kvz_cu_motion_field_at(ref_motion, xColCtr, yColCtr);
+      if (c3->mv_dir) {
+        cand_out->c3 = c3;
       }
     }
   }
@@ -1125,7 +1153,7 @@ static INLINE void apply_mv_scaling(const encoder_state_t *state,
  *
  * \param state         encoder state
  * \param current_ref   index of the picture referenced by the current CU
- * \param colocated     colocated CU
+ * \param colocated     motion of the colocated block
  * \param reflist       either 0 (for L0) or 1 (for L1)
  * \param[out] mv_out   Returns the motion vector
  *
@@ -1133,7 +1161,7 @@ static INLINE void apply_mv_scaling(const encoder_state_t *state,
  */
 static bool add_temporal_candidate(const encoder_state_t *state,
                                    uint8_t current_ref,
-                                   const cu_info_t *colocated,
+                                   const cu_motion_t *colocated,
                                    int32_t reflist,
                                    int16_t mv_out[2])
 {
@@ -1162,21 +1190,19 @@ static bool add_temporal_candidate(const encoder_state_t *state,
     }
   }
 
-  if ((colocated->inter.mv_dir & (col_list + 1)) == 0) {
+  if ((colocated->mv_dir & (col_list + 1)) == 0) {
     // Use the other list if the colocated PU does not have a MV for the
     // primary list.
     col_list = 1 - col_list;
   }
 
-  mv_out[0] = colocated->inter.mv[col_list][0];
-  mv_out[1] = colocated->inter.mv[col_list][1];
+  mv_out[0] = colocated->mv[col_list][0];
+  mv_out[1] = colocated->mv[col_list][1];
   apply_mv_scaling_pocs(
     state->frame->poc,
     state->frame->ref->pocs[current_ref],
     state->frame->ref->pocs[colocated_ref],
-    state->frame->ref->images[colocated_ref]->ref_pocs[
-      state->frame->ref->ref_LXs[colocated_ref]
-        [col_list][colocated->inter.mv_ref[col_list]]],
+    colocated->ref_poc[col_list],
     mv_out
   );
 
@@ -1192,12 +1218,12 @@ static INLINE bool add_mvp_candidate(const encoder_state_t *state,
 {
   if (!cand) return false;
 
-  assert(cand->inter.mv_dir != 0);
+  assert(cand->mv_dir != 0);
 
   for (int i = 0; i < 2; i++) {
     const int cand_list = i == 0 ? reflist : !reflist;
 
-    if ((cand->inter.mv_dir & (1 << cand_list)) == 0) continue;
+    if ((cand->mv_dir & (1 << cand_list)) == 0) continue;
 
     if (scaling) {
       mv_cand_out[0] = cand->inter.mv[cand_list][0];
@@ -1206,7 +1232,7 @@ static INLINE bool add_mvp_candidate(const encoder_state_t *state,
       return true;
     }
 
-    if (cand->inter.mv_dir & (1 << cand_list) &&
+    if (cand->mv_dir & (1 << cand_list) &&
         state->frame->ref_LX[cand_list][cand->inter.mv_ref[cand_list]] ==
         state->frame->ref_LX[reflist][cur_cu->inter.mv_ref[reflist]])
     {
@@ -1234,8 +1260,8 @@ static void get_mv_cand_from_candidates(const encoder_state_t * const state,
 {
   const cu_info_t *const *a = merge_cand->a;
   const cu_info_t *const *b = merge_cand->b;
-  const cu_info_t *c3 = merge_cand->c3;
-  const cu_info_t *h  = merge_cand->h;
+  const cu_motion_t *c3 = merge_cand->c3;
+  const cu_motion_t *h  = merge_cand->h;
 
   uint8_t candidates = 0;
   uint8_t b_candidates = 0;
@@ -1385,10 +1411,10 @@ void kvz_inter_get_mv_cand_cua(const encoder_state_t * const state,
 static bool is_duplicate_candidate(const cu_info_t* cu1, const cu_info_t* cu2)
 {
   if (!cu2) return false;
-  if (cu1->inter.mv_dir != cu2->inter.mv_dir) return false;
+  if (cu1->mv_dir != cu2->mv_dir) return false;
 
   for (int reflist = 0; reflist < 2; reflist++) {
-    if (cu1->inter.mv_dir & (1 << reflist)) {
+    if (cu1->mv_dir & (1 << reflist)) {
       if (cu1->inter.mv[reflist][0]  != cu2->inter.mv[reflist][0]  ||
           cu1->inter.mv[reflist][1]  != cu2->inter.mv[reflist][1]  ||
           cu1->inter.mv_ref[reflist] != cu2->inter.mv_ref[reflist]) {
@@ -1420,7 +1446,7 @@ static bool add_merge_candidate(const cu_info_t *cand,
   merge_cand_out->mv[1][1] = cand->inter.mv[1][1];
   merge_cand_out->ref[0]   = cand->inter.mv_ref[0]; // L0/L1 references
   merge_cand_out->ref[1]   = cand->inter.mv_ref[1];
-  merge_cand_out->dir      = cand->inter.mv_dir;
+  merge_cand_out->dir      = cand->mv_dir;
   return true;
 }
 
@@ -1483,7 +1509,7 @@ uint8_t kvz_inter_get_merge_cand(const encoder_state_t * const state,
       // TODO: enable L1 TMVP candidate
       // get_temporal_merge_candidates(state, x, y, width, height, 2, 0, &merge_cand);
 
-      const cu_info_t *temporal_cand =
+      const cu_motion_t *temporal_cand =
         (merge_cand.h != NULL) ? merge_cand.h : merge_cand.c3;
 
       if (add_temporal_candidate(state,
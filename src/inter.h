@@ -69,6 +69,16 @@ void kvz_inter_pred_pu(const encoder_state_t * const state,
   bool predict_chroma,
   int i_pu);
 
+unsigned kvz_inter_pred_unipred_luma(const encoder_state_t *state,
+                                     const kvz_picture *ref,
+                                     int32_t pu_x,
+                                     int32_t pu_y,
+                                     int32_t pu_w,
+                                     int32_t pu_h,
+                                     const int16_t mv_param[2],
+                                     kvz_pixel *px_out,
+                                     kvz_pixel_im *im_out);
+
 void kvz_inter_recon_bipred(const encoder_state_t * const state,
                             const kvz_picture * ref1,
                             const kvz_picture * ref2,
@@ -47,6 +47,7 @@
 #include "image.h"
 #include "input_frame_buffer.h"
 #include "kvazaar_internal.h"
+#include "quality.h"
 #include "strategyselector.h"
 #include "threadqueue.h"
 #include "videoframe.h"
@@ -113,6 +114,7 @@ static kvz_encoder * kvazaar_open(const kvz_config *cfg)
   encoder->out_state_num = 0;
   encoder->frames_started = 0;
   encoder->frames_done = 0;
+  encoder->frames_in_flight = encoder->num_encoder_states;
 
   // Assure that the rc data allocation was successful
   if(!kvz_get_rc_data(encoder->control)) {
@@ -174,6 +176,48 @@ static void set_frame_info(kvz_frame_info *const info, const encoder_state_t *co
 
   info->ref_list_len[0] = state->frame->ref_LX_size[0];
   info->ref_list_len[1] = state->frame->ref_LX_size[1];
+
+  info->latency = state->frame->latency;
+
+  kvz_quality_frame(state, info->psnr, &info->ssim, &info->ms_ssim);
+}
+
+
+/**
+ * \brief Adjust the number of frames in flight from thread queue times.
+ *
+ * Called after each output frame. If the worker threads were idle for a
+ * significant part of the time, another frame is let in flight. If the
+ * threads were saturated and jobs waited in the queue longer than they ran,
+ * the extra frame only adds latency and is dropped.
+ */
+static void update_frames_in_flight(kvz_encoder *enc)
+{
+  double idle, ready_wait, busy;
+  if (!kvz_threadqueue_get_times(enc->control->threadqueue, &idle, &ready_wait, &busy)) {
+    return;
+  }
+
+  const double d_idle       = idle       - enc->tq_times.idle;
+  const double d_ready_wait = ready_wait - enc->tq_times.ready_wait;
+  const double d_busy       = busy       - enc->tq_times.busy;
+
+  enc->tq_times.idle       = idle;
+  enc->tq_times.ready_wait = ready_wait;
+  enc->tq_times.busy       = busy;
+
+  if (d_idle + d_busy <= 0.0) return;
+  const double idle_ratio = d_idle / (d_idle + d_busy);
+
+  if (idle_ratio > 0.1) {
+    if (enc->frames_in_flight < enc->num_encoder_states) {
+      enc->frames_in_flight++;
+    }
+  } else if (idle_ratio < 0.02 && d_ready_wait > d_busy) {
+    if (enc->frames_in_flight > 1) {
+      enc->frames_in_flight--;
+    }
+  }
 }
 
 
@@ -198,6 +242,24 @@ static int kvazaar_headers(kvz_encoder *enc,
 }
 
 
+static int kvazaar_set_slice_callback(kvz_encoder *enc,
+                                      kvz_slice_callback callback,
+                                      void *opaque)
+{
+  if (enc->frames_started > 0) {
+    fprintf(stderr, "Slice callback must be set before encoding.\n");
+    return 0;
+  }
+
+  for (unsigned i = 0; i < enc->num_encoder_states; ++i) {
+    enc->states[i].slice_callback        = callback;
+    enc->states[i].slice_callback_opaque = opaque;
+  }
+
+  return 1;
+}
+
+
 /**
 * \brief Separate a single field from a frame.
 *
@@ -288,7 +350,9 @@ static int kvazaar_encode(kvz_encoder *enc,
 
   encoder_state_t *output_state = &enc->states[enc->out_state_num];
   if ((!output_state->frame->done &&
-       (pic_in == NULL || enc->cur_state_num == enc->out_state_num)) ||
+       (pic_in == NULL ||
+        enc->cur_state_num == enc->out_state_num ||
+        enc->frames_started - enc->frames_done >= enc->frames_in_flight)) ||
        (state->frame->num == 0  && state->encoder_control->cfg.rc_algorithm == KVZ_OBA)) {
 
     kvz_threadqueue_waitfor(enc->control->threadqueue, output_state->tqj_bitstream_written);
@@ -296,9 +360,25 @@ static int kvazaar_encode(kvz_encoder *enc,
     // the next frame is done.
     kvz_threadqueue_free_job(&output_state->tqj_bitstream_written);
 
-    // Get stream length before taking chunks since that clears the stream.
-    if (len_out) *len_out = kvz_bitstream_tell(&output_state->stream) / 8;
-    if (data_out) *data_out = kvz_bitstream_take_chunks(&output_state->stream);
+    if (enc->control->cfg.deterministic &&
+        (enc->control->cfg.rc_algorithm == KVZ_OBA || enc->control->cfg.stats_file_prefix)) {
+      // Update the rate control parameters in output order instead of when
+      // the bitstream job happens to finish.
+      kvz_update_after_picture(output_state);
+    }
+
+    if (enc->control->fast_coeff_online) {
+      kvz_fast_coeff_online_finish_frame(output_state);
+    }
+
+    if (output_state->slice_callback) {
+      // The data has already been passed to the callback.
+      if (len_out) *len_out = output_state->stats_bitstream_length;
+    } else {
+      // Get stream length before taking chunks since that clears the stream.
+      if (len_out) *len_out = kvz_bitstream_tell(&output_state->stream) / 8;
+      if (data_out) *data_out = kvz_bitstream_take_chunks(&output_state->stream);
+    }
     if (pic_out) *pic_out = kvz_image_copy_ref(output_state->tile->frame->rec);
     if (src_out) *src_out = kvz_image_copy_ref(output_state->tile->frame->source);
     if (info_out) set_frame_info(info_out, output_state);
@@ -308,6 +388,11 @@ static int kvazaar_encode(kvz_encoder *enc,
     enc->frames_done += 1;
 
     enc->out_state_num = (enc->out_state_num + 1) % (enc->num_encoder_states);
+
+    if (enc->control->cfg.auto_parallelism && enc->control->cfg.threads > 0 &&
+        !enc->control->cfg.deterministic) {
+      update_frames_in_flight(enc);
+    }
   }
 
   return 1;
@@ -415,6 +500,8 @@ static const kvz_api kvz_8bit_api = {
   .encoder_encode = kvazaar_field_encoding_adapter,
 
   .picture_alloc_csp = kvz_image_alloc,
+
+  .encoder_set_slice_callback = kvazaar_set_slice_callback,
 };
 
 
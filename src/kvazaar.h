@@ -151,6 +151,7 @@ enum kvz_hash
   KVZ_HASH_NONE = 0,
   KVZ_HASH_CHECKSUM = 1,
   KVZ_HASH_MD5 = 2,
+  KVZ_HASH_CRC = 3,
 };
 
 /**
@@ -230,6 +231,12 @@ enum kvz_sao {
   KVZ_SAO_FULL = 3
 };
 
+enum kvz_quant_mode {
+  KVZ_QUANT_PLAIN = 0,
+  KVZ_QUANT_APPROX = 1,
+  KVZ_QUANT_RDOQ = 2,
+};
+
 enum kvz_scalinglist {
   KVZ_SCALING_LIST_OFF = 0,
   KVZ_SCALING_LIST_CUSTOM = 1,
@@ -494,6 +501,90 @@ typedef struct kvz_config
   uint8_t fast_bipred;
 
   uint8_t enable_logging_output; //!< \brief May be used to disable the logging output to stderr. Default: on.
+
+  /** \brief Select WPP, tiles and OWF from a throughput model and adapt the
+   *         number of frames in flight at runtime. */
+  uint8_t auto_parallelism;
+
+  /** \brief Maximum number of frames in flight with auto_parallelism. 0 for no limit. */
+  int32_t max_latency_frames;
+
+  /** \brief Limit motion vectors by the reconstruction progress of each
+   *         reference picture instead of a fixed OWF/WPP bound. */
+  uint8_t adaptive_mv_range;
+
+  /** \brief Target encoding latency in milliseconds. 0 for no limit.
+   *
+   * Disables frame reordering, limits OWF and splits frames into rows of
+   * tiles with a slice each so that each slice can be output as soon as it
+   * is done. */
+  int32_t latency_budget;
+
+  /** \brief Gradual decoding refresh period in frames. 0 to disable.
+   *
+   * Instead of periodic intra pictures, a band of CTU rows moving down the
+   * picture is coded as intra so that the whole picture has been refreshed
+   * after this many frames. */
+  int32_t gdr_period;
+
+  /** \brief VBV buffer size in bits. 0 to disable VBV and HRD signaling. */
+  int32_t vbv_bufsize;
+
+  /** \brief Maximum rate at which the VBV buffer is filled in bits per
+   *         second. 0 to use target_bitrate. */
+  int32_t vbv_maxrate;
+
+  /** \brief Initial fullness of the VBV buffer as a fraction of vbv_bufsize. */
+  double vbv_init;
+
+  /** \brief Calculate SSIM and MS-SSIM of the luma for each frame. */
+  int8_t calc_ssim;
+
+  /** \brief Quantizer used for 4x4, 8x8, 16x16 and 32x32 transforms when
+   *         rdoq_enable is set. */
+  enum kvz_quant_mode quant_modes[4];
+
+  /** \brief Pointer to fast RDOQ offset table filename */
+  char *fast_rdoq_table_fn;
+
+  /** \brief Prune intra transform split search with a cost estimate. */
+  int8_t fast_tr_split;
+
+  /** \brief Skip the high frequency part of 32x32 transforms when it is
+   *         predicted to quantize to zero. */
+  int8_t dct32_lowfreq;
+
+  /** \brief Produce the same bitstream regardless of the number of threads.
+   *
+   * Automatic parallelism settings don't depend on the thread count, rate
+   * control only uses statistics of pictures and LCUs that are known to be
+   * done and features that depend on thread timing are disabled. */
+  int8_t deterministic;
+
+  /** \brief Enable machine learning based CU split termination for inter
+   *         encoding. */
+  int8_t ml_pu_depth_inter;
+
+  /** \brief File to write features and split decisions of inter CUs to, for
+   *         training the classifier of ml_pu_depth_inter. */
+  char *ml_inter_samples_fn;
+
+  /** \brief File to load the decision trees of the machine learning based
+   *         CU depth predictors from. */
+  char *ml_model_fn;
+
+  /** \brief Adapt the fast coefficient cost weights during encoding by
+   *         costing every fastrd_online_interval:th fast estimated block
+   *         with CABAC. 0 to disable. */
+  int32_t fastrd_online_interval;
+
+  /** \brief Number of iterations of refining the bi-prediction motion
+   *         vectors one list at a time. 0 to disable. */
+  int32_t bipred_refine;
+
+  /** \brief Back the reconstructed pictures with transparent huge pages
+   *         where the system supports them. */
+  int8_t huge_pages;
 } kvz_config;
 
 /**
@@ -643,6 +734,35 @@ typedef struct kvz_frame_info {
    */
   int ref_list_len[2];
 
+  /**
+   * \brief Encoding latency in seconds
+   *
+   * Time from starting to encode the picture until all of its encoded data
+   * was ready.
+   */
+  double latency;
+
+  /**
+   * \brief PSNR of the Y, U and V planes
+   *
+   * Zero if PSNR is not calculated.
+   */
+  double psnr[3];
+
+  /**
+   * \brief SSIM of the luma
+   *
+   * Zero if SSIM is not calculated.
+   */
+  double ssim;
+
+  /**
+   * \brief MS-SSIM of the luma
+   *
+   * Zero if SSIM is not calculated.
+   */
+  double ms_ssim;
+
 } kvz_frame_info;
 
 /**
@@ -661,6 +781,30 @@ typedef struct kvz_data_chunk {
   struct kvz_data_chunk *next;
 } kvz_data_chunk;
 
+/**
+ * \brief Function for receiving encoded slices.
+ *
+ * Called from a worker thread once for each slice segment of a picture, in
+ * bitstream order, as soon as it has been encoded. The data of the first
+ * slice includes the parameter sets and SEI messages preceding it. The
+ * last call for each picture has end_of_picture set and may carry the
+ * suffix SEI messages only.
+ *
+ * The function receives the ownership of data and is responsible for
+ * calling chunk_free on it.
+ *
+ * \param opaque          pointer given to encoder_set_slice_callback
+ * \param data            encoded data
+ * \param len             number of bytes in data
+ * \param poc             picture order count of the picture
+ * \param end_of_picture  1 if this is the last data of the picture
+ */
+typedef void (*kvz_slice_callback)(void *opaque,
+                                   kvz_data_chunk *data,
+                                   uint32_t len,
+                                   int32_t poc,
+                                   int end_of_picture);
+
 typedef struct kvz_api {
 
   /**
@@ -823,6 +967,25 @@ typedef struct kvz_api {
    * \return        allocated picture, or NULL if allocation failed.
    */
   kvz_picture * (*picture_alloc_csp)(enum kvz_chroma_format chroma_fomat, int32_t width, int32_t height);
+
+  /**
+   * \brief Output encoded data one slice at a time.
+   *
+   * When a callback is set, the encoded data of each picture is passed to
+   * it as soon as each slice is done, and encoder_encode does not return
+   * any data in data_out. The length of the whole picture is still
+   * returned in len_out.
+   *
+   * Must be called before the first picture is passed to encoder_encode.
+   *
+   * \param encoder   encoder
+   * \param callback  function to call, or NULL to disable
+   * \param opaque    pointer passed to the callback
+   * \return          1 on success, 0 on error.
+   */
+  int           (*encoder_set_slice_callback)(kvz_encoder *encoder,
+                                              kvz_slice_callback callback,
+                                              void *opaque);
 } kvz_api;
 
 
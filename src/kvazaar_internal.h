@@ -73,6 +73,23 @@ struct kvz_encoder {
 
   unsigned frames_started;
   unsigned frames_done;
+
+  /**
+   * \brief Maximum number of frames being encoded at the same time.
+   *
+   * At most num_encoder_states. Adjusted at runtime when
+   * auto_parallelism is enabled.
+   */
+  unsigned frames_in_flight;
+
+  /**
+   * \brief Thread queue times when frames_in_flight was last updated.
+   */
+  struct {
+    double idle;
+    double ready_wait;
+    double busy;
+  } tq_times;
 };
 
 #endif // KVAZAAR_INTERNAL_H_
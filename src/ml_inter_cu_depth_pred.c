@@ -0,0 +1,322 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "ml_inter_cu_depth_pred.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "strategies/strategies-picture.h"
+
+
+/*
+ * The built-in decision trees, see ml_model.h for the layout. A positive
+ * prediction means that splitting the CU is not worth searching.
+ */
+typedef enum {
+	ML_FEATURE_SAD = 0,
+	ML_FEATURE_COST,
+	ML_FEATURE_VARIANCE,
+	ML_FEATURE_NEIGH_DEPTH,
+	ML_FEATURE_COL_DEPTH,
+	ML_FEATURE_MV_COHERENCE,
+	ML_FEATURE_CBF,
+	ML_FEATURE_SKIPPED,
+	ML_FEATURE_QP,
+} ml_inter_feature_t;
+
+static const size_t ml_feature_offsets[ML_INTER_NUM_FEATURES] = {
+	offsetof(ml_inter_features_t, sad),
+	offsetof(ml_inter_features_t, cost),
+	offsetof(ml_inter_features_t, variance),
+	offsetof(ml_inter_features_t, neigh_depth),
+	offsetof(ml_inter_features_t, col_depth),
+	offsetof(ml_inter_features_t, mv_coherence),
+	offsetof(ml_inter_features_t, cbf),
+	offsetof(ml_inter_features_t, skipped),
+	offsetof(ml_inter_features_t, qp),
+};
+
+static const ml_tree_node_t tree_depth_0_nodes[] = {
+	/*  0 */ ML_TREE_NODE(NEIGH_DEPTH, 0.75, 1, 8),
+	/*  1 */ ML_TREE_NODE(COST, 85.03, 2, 7),
+	/*  2 */ ML_TREE_NODE(QP, 35.5, 3, 4),
+	/*  3 */ ML_TREE_LEAF(3, 0),
+	/*  4 */ ML_TREE_NODE(MV_COHERENCE, 24.5, 5, 6),
+	/*  5 */ ML_TREE_LEAF(5, 1),
+	/*  6 */ ML_TREE_LEAF(6, 0),
+	/*  7 */ ML_TREE_LEAF(7, 0),
+	/*  8 */ ML_TREE_LEAF(8, 0),
+};
+static const ml_tree_t tree_depth_0 = { tree_depth_0_nodes, 4 };
+
+static const ml_tree_node_t tree_depth_1_nodes[] = {
+	/*  0 */ ML_TREE_NODE(NEIGH_DEPTH, 0.25, 1, 8),
+	/*  1 */ ML_TREE_NODE(MV_COHERENCE, -0.5, 2, 3),
+	/*  2 */ ML_TREE_LEAF(2, 0),
+	/*  3 */ ML_TREE_NODE(MV_COHERENCE, 41.25, 4, 7),
+	/*  4 */ ML_TREE_NODE(QP, 35.5, 5, 6),
+	/*  5 */ ML_TREE_LEAF(5, 0),
+	/*  6 */ ML_TREE_LEAF(6, 1),
+	/*  7 */ ML_TREE_LEAF(7, 0),
+	/*  8 */ ML_TREE_NODE(QP, 28, 9, 10),
+	/*  9 */ ML_TREE_LEAF(9, 0),
+	/* 10 */ ML_TREE_NODE(QP, 35.5, 11, 12),
+	/* 11 */ ML_TREE_LEAF(11, 0),
+	/* 12 */ ML_TREE_NODE(COST, 95.6935, 13, 14),
+	/* 13 */ ML_TREE_LEAF(13, 1),
+	/* 14 */ ML_TREE_LEAF(14, 0),
+};
+static const ml_tree_t tree_depth_1 = { tree_depth_1_nodes, 4 };
+
+static const ml_tree_node_t tree_depth_2_nodes[] = {
+	/*  0 */ ML_TREE_NODE(MV_COHERENCE, -0.5, 1, 8),
+	/*  1 */ ML_TREE_NODE(QP, 26.5, 2, 3),
+	/*  2 */ ML_TREE_LEAF(2, 0),
+	/*  3 */ ML_TREE_NODE(COST, 39.4235, 4, 7),
+	/*  4 */ ML_TREE_NODE(NEIGH_DEPTH, 0.25, 5, 6),
+	/*  5 */ ML_TREE_LEAF(5, 1),
+	/*  6 */ ML_TREE_LEAF(6, 0),
+	/*  7 */ ML_TREE_LEAF(7, 0),
+	/*  8 */ ML_TREE_NODE(COST, 16.804, 9, 14),
+	/*  9 */ ML_TREE_NODE(NEIGH_DEPTH, 0.25, 10, 11),
+	/* 10 */ ML_TREE_LEAF(10, 1),
+	/* 11 */ ML_TREE_NODE(MV_COHERENCE, 20.25, 12, 13),
+	/* 12 */ ML_TREE_LEAF(12, 1),
+	/* 13 */ ML_TREE_LEAF(13, 0),
+	/* 14 */ ML_TREE_NODE(QP, 30.5, 15, 16),
+	/* 15 */ ML_TREE_LEAF(15, 0),
+	/* 16 */ ML_TREE_NODE(MV_COHERENCE, 11.75, 17, 18),
+	/* 17 */ ML_TREE_LEAF(17, 1),
+	/* 18 */ ML_TREE_LEAF(18, 0),
+};
+static const ml_tree_t tree_depth_2 = { tree_depth_2_nodes, 4 };
+
+#undef ML_TREE_NODE
+#undef ML_TREE_LEAF
+
+/*!< Models indexed by the CU depth. Splitting 8x8 CUs only gives intra NxN. */
+static const ml_model_t default_split_models[] = {
+	ML_DEFAULT_MODEL(ML_MODEL_INTER_SPLIT, 0, tree_depth_0),
+	ML_DEFAULT_MODEL(ML_MODEL_INTER_SPLIT, 1, tree_depth_1),
+	ML_DEFAULT_MODEL(ML_MODEL_INTER_SPLIT, 2, tree_depth_2),
+};
+
+
+static FILE *samples_file = NULL;
+static pthread_mutex_t samples_mutex;
+
+
+static int mv_distance(const cu_info_t *cur_cu, const cu_info_t *neigh)
+{
+	const int list = (cur_cu->mv_dir & 1) ? 0 : 1;
+	if (neigh->type != CU_INTER || !(neigh->mv_dir & (1 << list))) {
+		return -1;
+	}
+	return abs(cur_cu->inter.mv[list][0] - neigh->inter.mv[list][0]) +
+	       abs(cur_cu->inter.mv[list][1] - neigh->inter.mv[list][1]);
+}
+
+
+/**
+ * \brief Gather the features of an inter CU.
+ *
+ * Must be called after the best mode of the depth has been reconstructed
+ * into the LCU.
+ *
+ * \param state     encoder state
+ * \param lcu       LCU of the current depth
+ * \param x         x-coordinate of the CU in the tile
+ * \param y         y-coordinate of the CU in the tile
+ * \param depth     depth of the CU
+ * \param cost      RD cost of the CU
+ * \param features  Returns the features.
+ */
+void kvz_ml_inter_cu_features(const encoder_state_t *state,
+                              const lcu_t *lcu,
+                              int x, int y, int depth,
+                              double cost,
+                              ml_inter_features_t *features)
+{
+	const int width = LCU_WIDTH >> depth;
+	const int num_pixels = width * width;
+	const int x_local = SUB_SCU(x);
+	const int y_local = SUB_SCU(y);
+	const cu_info_t *cur_cu = LCU_GET_CU_AT_PX(lcu, x_local, y_local);
+
+	const kvz_pixel *src = &lcu->ref.y[x_local + y_local * LCU_WIDTH];
+	const kvz_pixel *rec = &lcu->rec.y[x_local + y_local * LCU_WIDTH];
+
+	features->sad = kvz_reg_sad(src, rec, width, width, LCU_WIDTH, LCU_WIDTH) / (double)num_pixels;
+	features->cost = cost / num_pixels;
+
+	int64_t sum = 0;
+	int64_t sq_sum = 0;
+	int32_t sums[LCU_WIDTH / 4][2];
+	for (int y_blk = 0; y_blk < width; y_blk += 4) {
+		kvz_pixel_4x4_sums(src + y_blk * LCU_WIDTH, LCU_WIDTH, width / 4, sums);
+		for (int i = 0; i < width / 4; ++i) {
+			sum    += sums[i][0];
+			sq_sum += sums[i][1];
+		}
+	}
+	features->variance = (double)(num_pixels * sq_sum - sum * sum) / ((double)num_pixels * num_pixels);
+
+	const cu_info_t *neighs[2] = {
+		x > 0 ? LCU_GET_CU_AT_PX(lcu, x_local - 1, y_local) : NULL,
+		y > 0 ? LCU_GET_CU_AT_PX(lcu, x_local, y_local - 1) : NULL,
+	};
+	int neigh_count = 0;
+	int neigh_depth = 0;
+	int mv_count = 0;
+	int mv_diff = 0;
+	for (int i = 0; i < 2; ++i) {
+		if (!neighs[i]) continue;
+		neigh_count++;
+		neigh_depth += neighs[i]->depth - depth;
+		int dist = mv_distance(cur_cu, neighs[i]);
+		if (dist >= 0) {
+			mv_count++;
+			mv_diff += dist;
+		}
+	}
+	features->neigh_depth = neigh_count ? (double)neigh_depth / neigh_count : 0.0;
+	features->mv_coherence = mv_count ? (double)mv_diff / mv_count : -1.0;
+
+	features->col_depth = 0.0;
+	if (state->frame->ref_LX_size[0] > 0) {
+		const cu_array_t *col_array = state->frame->ref->cu_arrays[state->frame->ref_LX[0][0]];
+		if (col_array) {
+			const cu_info_t *col_cu = kvz_cu_array_at_const(col_array,
+			                                                x + state->tile->offset_x,
+			                                                y + state->tile->offset_y);
+			features->col_depth = col_cu->depth - depth;
+		}
+	}
+
+	features->cbf = cbf_is_set_any(cur_cu->cbf, depth);
+	features->skipped = cur_cu->skipped;
+	features->qp = state->qp;
+}
+
+
+/**
+ * \brief Predict whether searching the split of an inter CU can be skipped.
+ *
+ * \param state     encoder state
+ * \param features  features of the CU
+ * \param depth     depth of the CU
+ * \return true if the CU should not be split
+ */
+bool kvz_ml_inter_cu_terminate_split(const encoder_state_t *state,
+                                     const ml_inter_features_t *features,
+                                     int depth)
+{
+	const int num_models = sizeof(default_split_models) / sizeof(default_split_models[0]);
+	if (depth >= num_models) {
+		return false;
+	}
+
+	const encoder_control_t *ctrl = state->encoder_control;
+	const ml_model_t *model = kvz_ml_model_select(ctrl->ml_models,
+	                                              &default_split_models[depth],
+	                                              ML_MODEL_INTER_SPLIT,
+	                                              depth,
+	                                              state->qp,
+	                                              ctrl->in.width * ctrl->in.height);
+	int8_t prediction;
+	kvz_ml_model_predict_all(model, ml_feature_offsets, features, sizeof(*features), 1, &prediction);
+	return prediction > 0;
+}
+
+
+/**
+ * \brief Open the file for writing training samples.
+ *
+ * Each sample is a line of comma separated values: the depth, the features
+ * in the order of ml_inter_features_t and whether the RD search chose to
+ * split the CU.
+ *
+ * \param filename  name of the file
+ * \return 0 on success
+ */
+int kvz_ml_inter_init_samples(const char *filename)
+{
+	if (pthread_mutex_init(&samples_mutex, NULL) != 0) {
+		fprintf(stderr, "Failed to create mutex\n");
+		return -1;
+	}
+
+	samples_file = fopen(filename, "w");
+	if (samples_file == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", filename, strerror(errno));
+		pthread_mutex_destroy(&samples_mutex);
+		return -1;
+	}
+
+	fprintf(samples_file, "depth,sad,cost,variance,neigh_depth,col_depth,mv_coherence,cbf,skipped,qp,split\n");
+	return 0;
+}
+
+
+void kvz_ml_inter_close_samples(void)
+{
+	if (samples_file != NULL) {
+		fclose(samples_file);
+		samples_file = NULL;
+		pthread_mutex_destroy(&samples_mutex);
+	}
+}
+
+
+void kvz_ml_inter_write_sample(const ml_inter_features_t *features, int depth, bool split)
+{
+	if (samples_file == NULL) return;
+
+	pthread_mutex_lock(&samples_mutex);
+	fprintf(samples_file, "%d,%.3f,%.3f,%.3f,%.2f,%.0f,%.2f,%.0f,%.0f,%.0f,%d\n",
+	        depth,
+	        features->sad,
+	        features->cost,
+	        features->variance,
+	        features->neigh_depth,
+	        features->col_depth,
+	        features->mv_coherence,
+	        features->cbf,
+	        features->skipped,
+	        features->qp,
+	        split);
+	pthread_mutex_unlock(&samples_mutex);
+}
@@ -0,0 +1,78 @@
+#ifndef ML_INTER_CU_DEPTH_PRED_H_
+#define ML_INTER_CU_DEPTH_PRED_H_
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+/**
+ * \ingroup Constraint
+ * \file
+ * Machine learning based early termination of the CU quadtree search in
+ * inter frames.
+ */
+
+#include "global.h" // IWYU pragma: keep
+#include "cu.h"
+#include "encoderstate.h"
+#include "ml_model.h"
+
+
+/*
+ * brief Features of an inter CU, gathered after the best mode of the
+ * current depth has been chosen.
+ */
+typedef struct {
+	double sad;           /*!< SAD of the reconstruction per pixel */
+	double cost;          /*!< RD cost of the CU per pixel */
+	double variance;      /*!< Variance of the source block */
+	double neigh_depth;   /*!< Mean depth of the left and above CUs minus the CU depth */
+	double col_depth;     /*!< Depth of the co-located CU minus the CU depth */
+	double mv_coherence;  /*!< Mean MV difference to the neighbouring inter CUs */
+	double cbf;           /*!< Whether the CU has coded coefficients */
+	double skipped;       /*!< Whether the CU is coded in skip mode */
+	double qp;
+} ml_inter_features_t;
+
+void kvz_ml_inter_cu_features(const encoder_state_t *state,
+                              const lcu_t *lcu,
+                              int x, int y, int depth,
+                              double cost,
+                              ml_inter_features_t *features);
+
+bool kvz_ml_inter_cu_terminate_split(const encoder_state_t *state,
+                                     const ml_inter_features_t *features,
+                                     int depth);
+
+int kvz_ml_inter_init_samples(const char *filename);
+void kvz_ml_inter_close_samples(void);
+void kvz_ml_inter_write_sample(const ml_inter_features_t *features, int depth, bool split);
+
+#endif
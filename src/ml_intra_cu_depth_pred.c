@@ -32,799 +32,311 @@
 
 #include "ml_intra_cu_depth_pred.h"
 
+#include <stddef.h>
 
-static int tree_predict_merge_depth_1(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->merge_variance <= 140.3129)
-		{
-				if (p_features->var_of_sub_var <= 569.6553)
-				{
-						if (p_features->merge_variance <= 20.8854)
-						{
-								*p_nb_iter = 19428.0;
-								*p_nb_bad = 1740.0;
-								return -1.0000;
-						}
-						else if (p_features->sub_variance_0 <= 9.1015)
-						{
-								if (p_features->merge_variance <= 39.132)
-								{
-										*p_nb_iter = 1166.0;
-										*p_nb_bad = 358.0;
-										return -1.0000;
-								}
-								else {
-										*p_nb_iter = 1049.0;
-										*p_nb_bad = 392.0;
-										return 1.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 9371.0;
-								*p_nb_bad = 1805.0;
-								return -1.0000;
-						}
-				}
-				else if (p_features->sub_variance_2 <= 23.3193)
-				{
-						*p_nb_iter = 1059.0;
-						*p_nb_bad = 329.0;
-						return 1.0000;
-				}
-				else if (p_features->sub_variance_1 <= 30.7348)
-				{
-						*p_nb_iter = 1042.0;
-						*p_nb_bad = 395.0;
-						return 1.0000;
-				}
-				else {
-						*p_nb_iter = 1756.0;
-						*p_nb_bad = 588.0;
-						return -1.0000;
-				}
-		}
-		else if (p_features->merge_variance <= 857.8047)
-		{
-				if (p_features->var_of_sub_var <= 66593.5553)
-				{
-						if (p_features->sub_variance_0 <= 12.1697)
-						{
-								*p_nb_iter = 2006.0;
-								*p_nb_bad = 374.0;
-								return 1.0000;
-						}
-						else if (p_features->neigh_variance_C <= 646.8204)
-						{
-								if (p_features->neigh_variance_A <= 664.7609)
-								{
-										if (p_features->neigh_variance_B <= 571.2004)
-										{
-												if (p_features->var_of_sub_mean <= 4.1069)
-												{
-														*p_nb_iter = 1208.0;
-														*p_nb_bad = 399.0;
-														return 1.0000;
-												}
-												else if (p_features->var_of_sub_var <= 11832.6635)
-												{
-														*p_nb_iter = 8701.0;
-														*p_nb_bad = 3037.0;
-														return -1.0000;
-												}
-												else if (p_features->neigh_variance_A <= 142.298)
-												{
-														*p_nb_iter = 1025.0;
-														*p_nb_bad = 290.0;
-														return 1.0000;
-												}
-												else if (p_features->variance <= 394.4839)
-												{
-														*p_nb_iter = 1156.0;
-														*p_nb_bad = 489.0;
-														return 1.0000;
-												}
-												else {
-														*p_nb_iter = 1150.0;
-														*p_nb_bad = 503.0;
-														return -1.0000;
-												}
-										}
-										else {
-												*p_nb_iter = 1777.0;
-												*p_nb_bad = 558.0;
-												return 1.0000;
-										}
-								}
-								else {
-										*p_nb_iter = 1587.0;
-										*p_nb_bad = 411.0;
-										return 1.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 1980.0;
-								*p_nb_bad = 474.0;
-								return 1.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 3613.0;
-						*p_nb_bad = 475.0;
-						return 1.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 20926.0;
-				*p_nb_bad = 1873.0;
-				return 1.0000;
-		}
-}
-
+#include "strategies/strategies-picture.h"
 
 
-static int tree_predict_merge_depth_2(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->merge_variance <= 119.4611)
-		{
-				if (p_features->var_of_sub_var <= 1078.0638)
-				{
-						if (p_features->neigh_variance_B <= 70.2189)
-						{
-								*p_nb_iter = 29253.0;
-								*p_nb_bad = 3837.0;
-								return -1.0000;
-						}
-						else if (p_features->variance <= 20.8711)
-						{
-								*p_nb_iter = 1292.0;
-								*p_nb_bad = 458.0;
-								return 2.0000;
-						}
-						else {
-								*p_nb_iter = 1707.0;
-								*p_nb_bad = 399.0;
-								return -1.0000;
-						}
-				}
-				else if (p_features->var_of_sub_var <= 3300.4034)
-				{
-						*p_nb_iter = 1554.0;
-						*p_nb_bad = 675.0;
-						return -1.0000;
-				}
-				else {
-						*p_nb_iter = 1540.0;
-						*p_nb_bad = 429.0;
-						return 2.0000;
-				}
-		}
-		else if (p_features->merge_variance <= 696.1989)
-		{
-				if (p_features->var_of_sub_var <= 31803.3242)
-				{
-						if (p_features->sub_variance_2 <= 10.3845)
-						{
-								*p_nb_iter = 3473.0;
-								*p_nb_bad = 768.0;
-								return 2.0000;
-						}
-						else if (p_features->neigh_variance_C <= 571.5329)
-						{
-								if (p_features->neigh_variance_B <= 492.8159)
-								{
-										if (p_features->neigh_variance_B <= 38.9672)
-										{
-												*p_nb_iter = 1887.0;
-												*p_nb_bad = 588.0;
-												return 2.0000;
-										}
-										else if (p_features->neigh_variance_A <= 380.5927)
-										{
-												if (p_features->sub_variance_1 <= 19.9678)
-												{
-														*p_nb_iter = 1686.0;
-														*p_nb_bad = 721.0;
-														return 2.0000;
-												}
-												else if (p_features->neigh_variance_A <= 66.6749)
-												{
-														*p_nb_iter = 1440.0;
-														*p_nb_bad = 631.0;
-														return 2.0000;
-												}
-												else {
-														*p_nb_iter = 5772.0;
-														*p_nb_bad = 2031.0;
-														return -1.0000;
-												}
-										}
-										else {
-												*p_nb_iter = 1791.0;
-												*p_nb_bad = 619.0;
-												return 2.0000;
-										}
-								}
-								else {
-										*p_nb_iter = 1624.0;
-										*p_nb_bad = 494.0;
-										return 2.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 1298.0;
-								*p_nb_bad = 312.0;
-								return 2.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 4577.0;
-						*p_nb_bad = 892.0;
-						return 2.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 21106.0;
-				*p_nb_bad = 2744.0;
-				return 2.0000;
-		}
-}
-
-
-
-static int tree_predict_merge_depth_3(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->merge_variance <= 80.1487)
-		{
-				if (p_features->neigh_variance_C <= 83.7148)
-				{
-						*p_nb_iter = 29806.0;
-						*p_nb_bad = 3603.0;
-						return -1.0000;
-				}
-				else {
-						*p_nb_iter = 1003.0;
-						*p_nb_bad = 421.0;
-						return 3.0000;
-				}
-		}
-		else if (p_features->merge_variance <= 351.8138)
-		{
-				if (p_features->neigh_variance_C <= 255.4236)
-				{
-						if (p_features->neigh_variance_B <= 260.5349)
-						{
-								if (p_features->var_of_sub_var <= 6381.513)
-								{
-										if (p_features->neigh_variance_A <= 244.2556)
-										{
-												if (p_features->sub_variance_0 <= 4.75)
-												{
-														*p_nb_iter = 1290.0;
-														*p_nb_bad = 525.0;
-														return 3.0000;
-												}
-												else if (p_features->neigh_variance_B <= 16.9287)
-												{
-														*p_nb_iter = 1045.0;
-														*p_nb_bad = 499.0;
-														return 3.0000;
-												}
-												else {
-														*p_nb_iter = 6901.0;
-														*p_nb_bad = 2494.0;
-														return -1.0000;
-												}
-										}
-										else {
-												*p_nb_iter = 1332.0;
-												*p_nb_bad = 408.0;
-												return 3.0000;
-										}
-								}
-								else {
-										*p_nb_iter = 2929.0;
-										*p_nb_bad = 842.0;
-										return 3.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 2239.0;
-								*p_nb_bad = 572.0;
-								return 3.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 2777.0;
-						*p_nb_bad = 714.0;
-						return 3.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 30678.0;
-				*p_nb_bad = 5409.0;
-				return 3.0000;
-		}
-}
-
-
-
-static int tree_predict_merge_depth_4(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->neigh_variance_C <= 240.2773)
-		{
-				if (p_features->neigh_variance_B <= 227.5898)
-				{
-						if (p_features->neigh_variance_A <= 195.4844)
-						{
-								if (p_features->variance <= 203.3086)
-								{
-										if (p_features->qp <= 32)
-										{
-												if (p_features->neigh_variance_C <= 102.2344)
-												{
-														if (p_features->neigh_variance_B <= 116.4961)
-														{
-																if (p_features->variance <= 89.4023)
-																{
-																		*p_nb_iter = 27398.0;
-																		*p_nb_bad = 4665.0;
-																		return -1.0000;
-																}
-																else {
-																		*p_nb_iter = 1676.0;
-																		*p_nb_bad = 795.0;
-																		return 4.0000;
-																}
-														}
-														else {
-																*p_nb_iter = 1405.0;
-																*p_nb_bad = 566.0;
-																return 4.0000;
-														}
-												}
-												else {
-														*p_nb_iter = 2827.0;
-														*p_nb_bad = 1173.0;
-														return 4.0000;
-												}
-										}
-										else {
-												*p_nb_iter = 8871.0;
-												*p_nb_bad = 822.0;
-												return -1.0000;
-										}
-								}
-								else {
-										*p_nb_iter = 3162.0;
-										*p_nb_bad = 718.0;
-										return 4.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 6154.0;
-								*p_nb_bad = 1397.0;
-								return 4.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 9385.0;
-						*p_nb_bad = 1609.0;
-						return 4.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 19122.0;
-				*p_nb_bad = 2960.0;
-				return 4.0000;
-		}
-}
-
-
-
-static int tree_predict_split_depth_0(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->var_of_sub_var <= 12754.7856)
-		{
-				if (p_features->var_of_sub_var <= 137.9034)
-				{
-						*p_nb_iter = 25155.0;
-						*p_nb_bad = 2959.0;
-						return 0.0000;
-				}
-				else if (p_features->sub_variance_2 <= 13.2892)
-				{
-						*p_nb_iter = 1080.0;
-						*p_nb_bad = 383.0;
-						return -1.0000;
-				}
-				else if (p_features->variance <= 564.1738)
-				{
-						if (p_features->var_of_sub_var <= 1185.4728)
-						{
-								*p_nb_iter = 6067.0;
-								*p_nb_bad = 1699.0;
-								return 0.0000;
-						}
-						else if (p_features->var_of_sub_mean <= 46.2388)
-						{
-								if (p_features->sub_variance_0 <= 46.8708)
-								{
-										*p_nb_iter = 1088.0;
-										*p_nb_bad = 377.0;
-										return -1.0000;
-								}
-								else if (p_features->sub_variance_3 <= 61.4213)
-								{
-										*p_nb_iter = 1183.0;
-										*p_nb_bad = 498.0;
-										return -1.0000;
-								}
-								else {
-										*p_nb_iter = 3416.0;
-										*p_nb_bad = 1373.0;
-										return 0.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 3769.0;
-								*p_nb_bad = 1093.0;
-								return 0.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 1036.0;
-						*p_nb_bad = 434.0;
-						return -1.0000;
-				}
-		}
-		else if (p_features->var_of_sub_var <= 98333.8279)
-		{
-				if (p_features->variance <= 987.2333)
-				{
-						if (p_features->var_of_sub_var <= 37261.2896)
-						{
-								if (p_features->variance <= 238.2248)
-								{
-										*p_nb_iter = 1323.0;
-										*p_nb_bad = 301.0;
-										return -1.0000;
-								}
-								else if (p_features->var_of_sub_var <= 17347.3971)
-								{
-										*p_nb_iter = 1215.0;
-										*p_nb_bad = 550.0;
-										return 0.0000;
-								}
-								else if (p_features->qp <= 22)
-								{
-										*p_nb_iter = 1000.0;
-										*p_nb_bad = 493.0;
-										return 0.0000;
-								}
-								else {
-										*p_nb_iter = 2640.0;
-										*p_nb_bad = 1121.0;
-										return -1.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 5188.0;
-								*p_nb_bad = 1248.0;
-								return -1.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 2323.0;
-						*p_nb_bad = 274.0;
-						return -1.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 21357.0;
-				*p_nb_bad = 1829.0;
-				return -1.0000;
-		}
-}
-
-
-static int tree_predict_split_depth_1(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->var_of_sub_var <= 1138.9473)
-		{
-				*p_nb_iter = 32445.0;
-				*p_nb_bad = 4580.0;
-				return 1.0000;
-		}
-		else if (p_features->var_of_sub_var <= 27289.2117)
-		{
-				if (p_features->sub_variance_1 <= 12.0603)
-				{
-						*p_nb_iter = 1900.0;
-						*p_nb_bad = 401.0;
-						return -1.0000;
-				}
-				else if (p_features->var_of_sub_var <= 5841.4773)
-				{
-						if (p_features->variance <= 72.4175)
-						{
-								*p_nb_iter = 1000.0;
-								*p_nb_bad = 356.0;
-								return -1.0000;
-						}
-						else if (p_features->neigh_variance_A <= 633.8163)
-						{
-								*p_nb_iter = 5279.0;
-								*p_nb_bad = 1961.0;
-								return 1.0000;
-						}
-						else {
-								*p_nb_iter = 1176.0;
-								*p_nb_bad = 527.0;
-								return -1.0000;
-						}
-				}
-				else if (p_features->sub_variance_0 <= 38.3035)
-				{
-						*p_nb_iter = 1251.0;
-						*p_nb_bad = 293.0;
-						return -1.0000;
-				}
-				else if (p_features->neigh_variance_B <= 664.9494)
-				{
-						if (p_features->sub_variance_3 <= 45.8181)
-						{
-								*p_nb_iter = 1276.0;
-								*p_nb_bad = 471.0;
-								return -1.0000;
-						}
-						else if (p_features->sub_variance_3 <= 404.3086)
-						{
-								if (p_features->sub_variance_1 <= 99.8715)
-								{
-										*p_nb_iter = 1005.0;
-										*p_nb_bad = 435.0;
-										return -1.0000;
-								}
-								else if (p_features->sub_variance_0 <= 282.3064)
-								{
-										*p_nb_iter = 1370.0;
-										*p_nb_bad = 539.0;
-										return 1.0000;
-								}
-								else {
-										*p_nb_iter = 1013.0;
-										*p_nb_bad = 495.0;
-										return -1.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 1000.0;
-								*p_nb_bad = 379.0;
-								return -1.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 2270.0;
-						*p_nb_bad = 679.0;
-						return -1.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 29015.0;
-				*p_nb_bad = 3950.0;
-				return -1.0000;
-		}
-}
+/*
+ * The built-in decision trees, see ml_model.h for the layout. The merge
+ * trees predict from the features of a block whether it should not be
+ * merged with its siblings and the split trees predict from the features of
+ * the upper block whether it should be split (-1).
+ */
+typedef enum {
+	ML_FEATURE_VARIANCE = 0,
+	ML_FEATURE_MERGE_VARIANCE,
+	ML_FEATURE_SUB_VARIANCE_0,
+	ML_FEATURE_SUB_VARIANCE_1,
+	ML_FEATURE_SUB_VARIANCE_2,
+	ML_FEATURE_SUB_VARIANCE_3,
+	ML_FEATURE_NEIGH_VARIANCE_A,
+	ML_FEATURE_NEIGH_VARIANCE_B,
+	ML_FEATURE_NEIGH_VARIANCE_C,
+	ML_FEATURE_VAR_OF_SUB_MEAN,
+	ML_FEATURE_VAR_OF_SUB_VAR,
+	ML_FEATURE_QP,
+} ml_feature_t;
+
+static const size_t ml_feature_offsets[ML_INTRA_NUM_FEATURES] = {
+	offsetof(features_s, variance),
+	offsetof(features_s, merge_variance),
+	offsetof(features_s, sub_variance_0),
+	offsetof(features_s, sub_variance_1),
+	offsetof(features_s, sub_variance_2),
+	offsetof(features_s, sub_variance_3),
+	offsetof(features_s, neigh_variance_A),
+	offsetof(features_s, neigh_variance_B),
+	offsetof(features_s, neigh_variance_C),
+	offsetof(features_s, var_of_sub_mean),
+	offsetof(features_s, var_of_sub_var),
+	offsetof(features_s, qp),
+};
 
+static const ml_tree_node_t tree_merge_depth_1_nodes[] = {
+  /*  0 */ ML_TREE_NODE(MERGE_VARIANCE, 140.3129, 1, 14),
+  /*  1 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 569.6553, 2, 9),
+  /*  2 */ ML_TREE_NODE(MERGE_VARIANCE, 20.8854, 3, 4),
+  /*  3 */ ML_TREE_LEAF(3, -1),
+  /*  4 */ ML_TREE_NODE(SUB_VARIANCE_0, 9.1015, 5, 8),
+  /*  5 */ ML_TREE_NODE(MERGE_VARIANCE, 39.132, 6, 7),
+  /*  6 */ ML_TREE_LEAF(6, -1),
+  /*  7 */ ML_TREE_LEAF(7, 1),
+  /*  8 */ ML_TREE_LEAF(8, -1),
+  /*  9 */ ML_TREE_NODE(SUB_VARIANCE_2, 23.3193, 10, 11),
+  /* 10 */ ML_TREE_LEAF(10, 1),
+  /* 11 */ ML_TREE_NODE(SUB_VARIANCE_1, 30.7348, 12, 13),
+  /* 12 */ ML_TREE_LEAF(12, 1),
+  /* 13 */ ML_TREE_LEAF(13, -1),
+  /* 14 */ ML_TREE_NODE(MERGE_VARIANCE, 857.8047, 15, 34),
+  /* 15 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 66593.5553, 16, 33),
+  /* 16 */ ML_TREE_NODE(SUB_VARIANCE_0, 12.1697, 17, 18),
+  /* 17 */ ML_TREE_LEAF(17, 1),
+  /* 18 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 646.8204, 19, 32),
+  /* 19 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 664.7609, 20, 31),
+  /* 20 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 571.2004, 21, 30),
+  /* 21 */ ML_TREE_NODE(VAR_OF_SUB_MEAN, 4.1069, 22, 23),
+  /* 22 */ ML_TREE_LEAF(22, 1),
+  /* 23 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 11832.6635, 24, 25),
+  /* 24 */ ML_TREE_LEAF(24, -1),
+  /* 25 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 142.298, 26, 27),
+  /* 26 */ ML_TREE_LEAF(26, 1),
+  /* 27 */ ML_TREE_NODE(VARIANCE, 394.4839, 28, 29),
+  /* 28 */ ML_TREE_LEAF(28, 1),
+  /* 29 */ ML_TREE_LEAF(29, -1),
+  /* 30 */ ML_TREE_LEAF(30, 1),
+  /* 31 */ ML_TREE_LEAF(31, 1),
+  /* 32 */ ML_TREE_LEAF(32, 1),
+  /* 33 */ ML_TREE_LEAF(33, 1),
+  /* 34 */ ML_TREE_LEAF(34, 1),
+};
+static const ml_tree_t tree_merge_depth_1 = { tree_merge_depth_1_nodes, 11 };
+
+static const ml_tree_node_t tree_merge_depth_2_nodes[] = {
+  /*  0 */ ML_TREE_NODE(MERGE_VARIANCE, 119.4611, 1, 10),
+  /*  1 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 1078.0638, 2, 7),
+  /*  2 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 70.2189, 3, 4),
+  /*  3 */ ML_TREE_LEAF(3, -1),
+  /*  4 */ ML_TREE_NODE(VARIANCE, 20.8711, 5, 6),
+  /*  5 */ ML_TREE_LEAF(5, 2),
+  /*  6 */ ML_TREE_LEAF(6, -1),
+  /*  7 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 3300.4034, 8, 9),
+  /*  8 */ ML_TREE_LEAF(8, -1),
+  /*  9 */ ML_TREE_LEAF(9, 2),
+  /* 10 */ ML_TREE_NODE(MERGE_VARIANCE, 696.1989, 11, 28),
+  /* 11 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 31803.3242, 12, 27),
+  /* 12 */ ML_TREE_NODE(SUB_VARIANCE_2, 10.3845, 13, 14),
+  /* 13 */ ML_TREE_LEAF(13, 2),
+  /* 14 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 571.5329, 15, 26),
+  /* 15 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 492.8159, 16, 25),
+  /* 16 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 38.9672, 17, 18),
+  /* 17 */ ML_TREE_LEAF(17, 2),
+  /* 18 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 380.5927, 19, 24),
+  /* 19 */ ML_TREE_NODE(SUB_VARIANCE_1, 19.9678, 20, 21),
+  /* 20 */ ML_TREE_LEAF(20, 2),
+  /* 21 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 66.6749, 22, 23),
+  /* 22 */ ML_TREE_LEAF(22, 2),
+  /* 23 */ ML_TREE_LEAF(23, -1),
+  /* 24 */ ML_TREE_LEAF(24, 2),
+  /* 25 */ ML_TREE_LEAF(25, 2),
+  /* 26 */ ML_TREE_LEAF(26, 2),
+  /* 27 */ ML_TREE_LEAF(27, 2),
+  /* 28 */ ML_TREE_LEAF(28, 2),
+};
+static const ml_tree_t tree_merge_depth_2 = { tree_merge_depth_2_nodes, 10 };
+
+static const ml_tree_node_t tree_merge_depth_3_nodes[] = {
+  /*  0 */ ML_TREE_NODE(MERGE_VARIANCE, 80.1487, 1, 4),
+  /*  1 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 83.7148, 2, 3),
+  /*  2 */ ML_TREE_LEAF(2, -1),
+  /*  3 */ ML_TREE_LEAF(3, 3),
+  /*  4 */ ML_TREE_NODE(MERGE_VARIANCE, 351.8138, 5, 18),
+  /*  5 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 255.4236, 6, 17),
+  /*  6 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 260.5349, 7, 16),
+  /*  7 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 6381.513, 8, 15),
+  /*  8 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 244.2556, 9, 14),
+  /*  9 */ ML_TREE_NODE(SUB_VARIANCE_0, 4.75, 10, 11),
+  /* 10 */ ML_TREE_LEAF(10, 3),
+  /* 11 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 16.9287, 12, 13),
+  /* 12 */ ML_TREE_LEAF(12, 3),
+  /* 13 */ ML_TREE_LEAF(13, -1),
+  /* 14 */ ML_TREE_LEAF(14, 3),
+  /* 15 */ ML_TREE_LEAF(15, 3),
+  /* 16 */ ML_TREE_LEAF(16, 3),
+  /* 17 */ ML_TREE_LEAF(17, 3),
+  /* 18 */ ML_TREE_LEAF(18, 3),
+};
+static const ml_tree_t tree_merge_depth_3 = { tree_merge_depth_3_nodes, 8 };
+
+static const ml_tree_node_t tree_merge_depth_4_nodes[] = {
+  /*  0 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 240.2773, 1, 16),
+  /*  1 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 227.5898, 2, 15),
+  /*  2 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 195.4844, 3, 14),
+  /*  3 */ ML_TREE_NODE(VARIANCE, 203.3086, 4, 13),
+  /*  4 */ ML_TREE_NODE(QP, 32, 5, 12),
+  /*  5 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 102.2344, 6, 11),
+  /*  6 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 116.4961, 7, 10),
+  /*  7 */ ML_TREE_NODE(VARIANCE, 89.4023, 8, 9),
+  /*  8 */ ML_TREE_LEAF(8, -1),
+  /*  9 */ ML_TREE_LEAF(9, 4),
+  /* 10 */ ML_TREE_LEAF(10, 4),
+  /* 11 */ ML_TREE_LEAF(11, 4),
+  /* 12 */ ML_TREE_LEAF(12, -1),
+  /* 13 */ ML_TREE_LEAF(13, 4),
+  /* 14 */ ML_TREE_LEAF(14, 4),
+  /* 15 */ ML_TREE_LEAF(15, 4),
+  /* 16 */ ML_TREE_LEAF(16, 4),
+};
+static const ml_tree_t tree_merge_depth_4 = { tree_merge_depth_4_nodes, 8 };
+
+static const ml_tree_node_t tree_split_depth_0_nodes[] = {
+  /*  0 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 12754.7856, 1, 16),
+  /*  1 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 137.9034, 2, 3),
+  /*  2 */ ML_TREE_LEAF(2, 0),
+  /*  3 */ ML_TREE_NODE(SUB_VARIANCE_2, 13.2892, 4, 5),
+  /*  4 */ ML_TREE_LEAF(4, -1),
+  /*  5 */ ML_TREE_NODE(VARIANCE, 564.1738, 6, 15),
+  /*  6 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 1185.4728, 7, 8),
+  /*  7 */ ML_TREE_LEAF(7, 0),
+  /*  8 */ ML_TREE_NODE(VAR_OF_SUB_MEAN, 46.2388, 9, 14),
+  /*  9 */ ML_TREE_NODE(SUB_VARIANCE_0, 46.8708, 10, 11),
+  /* 10 */ ML_TREE_LEAF(10, -1),
+  /* 11 */ ML_TREE_NODE(SUB_VARIANCE_3, 61.4213, 12, 13),
+  /* 12 */ ML_TREE_LEAF(12, -1),
+  /* 13 */ ML_TREE_LEAF(13, 0),
+  /* 14 */ ML_TREE_LEAF(14, 0),
+  /* 15 */ ML_TREE_LEAF(15, -1),
+  /* 16 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 98333.8279, 17, 28),
+  /* 17 */ ML_TREE_NODE(VARIANCE, 987.2333, 18, 27),
+  /* 18 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 37261.2896, 19, 26),
+  /* 19 */ ML_TREE_NODE(VARIANCE, 238.2248, 20, 21),
+  /* 20 */ ML_TREE_LEAF(20, -1),
+  /* 21 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 17347.3971, 22, 23),
+  /* 22 */ ML_TREE_LEAF(22, 0),
+  /* 23 */ ML_TREE_NODE(QP, 22, 24, 25),
+  /* 24 */ ML_TREE_LEAF(24, 0),
+  /* 25 */ ML_TREE_LEAF(25, -1),
+  /* 26 */ ML_TREE_LEAF(26, -1),
+  /* 27 */ ML_TREE_LEAF(27, -1),
+  /* 28 */ ML_TREE_LEAF(28, -1),
+};
+static const ml_tree_t tree_split_depth_0 = { tree_split_depth_0_nodes, 8 };
+
+static const ml_tree_node_t tree_split_depth_1_nodes[] = {
+  /*  0 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 1138.9473, 1, 2),
+  /*  1 */ ML_TREE_LEAF(1, 1),
+  /*  2 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 27289.2117, 3, 24),
+  /*  3 */ ML_TREE_NODE(SUB_VARIANCE_1, 12.0603, 4, 5),
+  /*  4 */ ML_TREE_LEAF(4, -1),
+  /*  5 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 5841.4773, 6, 11),
+  /*  6 */ ML_TREE_NODE(VARIANCE, 72.4175, 7, 8),
+  /*  7 */ ML_TREE_LEAF(7, -1),
+  /*  8 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 633.8163, 9, 10),
+  /*  9 */ ML_TREE_LEAF(9, 1),
+  /* 10 */ ML_TREE_LEAF(10, -1),
+  /* 11 */ ML_TREE_NODE(SUB_VARIANCE_0, 38.3035, 12, 13),
+  /* 12 */ ML_TREE_LEAF(12, -1),
+  /* 13 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 664.9494, 14, 23),
+  /* 14 */ ML_TREE_NODE(SUB_VARIANCE_3, 45.8181, 15, 16),
+  /* 15 */ ML_TREE_LEAF(15, -1),
+  /* 16 */ ML_TREE_NODE(SUB_VARIANCE_3, 404.3086, 17, 22),
+  /* 17 */ ML_TREE_NODE(SUB_VARIANCE_1, 99.8715, 18, 19),
+  /* 18 */ ML_TREE_LEAF(18, -1),
+  /* 19 */ ML_TREE_NODE(SUB_VARIANCE_0, 282.3064, 20, 21),
+  /* 20 */ ML_TREE_LEAF(20, 1),
+  /* 21 */ ML_TREE_LEAF(21, -1),
+  /* 22 */ ML_TREE_LEAF(22, -1),
+  /* 23 */ ML_TREE_LEAF(23, -1),
+  /* 24 */ ML_TREE_LEAF(24, -1),
+};
+static const ml_tree_t tree_split_depth_1 = { tree_split_depth_1_nodes, 10 };
+
+static const ml_tree_node_t tree_split_depth_2_nodes[] = {
+  /*  0 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 2597.4529, 1, 10),
+  /*  1 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 146.7734, 2, 3),
+  /*  2 */ ML_TREE_LEAF(2, 2),
+  /*  3 */ ML_TREE_NODE(MERGE_VARIANCE, 259.6952, 4, 5),
+  /*  4 */ ML_TREE_LEAF(4, 2),
+  /*  5 */ ML_TREE_NODE(QP, 27, 6, 9),
+  /*  6 */ ML_TREE_NODE(VARIANCE, 73.9929, 7, 8),
+  /*  7 */ ML_TREE_LEAF(7, -1),
+  /*  8 */ ML_TREE_LEAF(8, 2),
+  /*  9 */ ML_TREE_LEAF(9, 2),
+  /* 10 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 60850.5208, 11, 24),
+  /* 11 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 10144.602, 12, 23),
+  /* 12 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 926.8972, 13, 22),
+  /* 13 */ ML_TREE_NODE(SUB_VARIANCE_0, 26.6006, 14, 15),
+  /* 14 */ ML_TREE_LEAF(14, -1),
+  /* 15 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 493.5849, 16, 21),
+  /* 16 */ ML_TREE_NODE(NEIGH_VARIANCE_A, 72.9516, 17, 18),
+  /* 17 */ ML_TREE_LEAF(17, -1),
+  /* 18 */ ML_TREE_NODE(VARIANCE, 156.4014, 19, 20),
+  /* 19 */ ML_TREE_LEAF(19, -1),
+  /* 20 */ ML_TREE_LEAF(20, 2),
+  /* 21 */ ML_TREE_LEAF(21, -1),
+  /* 22 */ ML_TREE_LEAF(22, -1),
+  /* 23 */ ML_TREE_LEAF(23, -1),
+  /* 24 */ ML_TREE_LEAF(24, -1),
+};
+static const ml_tree_t tree_split_depth_2 = { tree_split_depth_2_nodes, 8 };
+
+static const ml_tree_node_t tree_split_depth_3_nodes[] = {
+  /*  0 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 818.5173, 1, 10),
+  /*  1 */ ML_TREE_NODE(MERGE_VARIANCE, 62.7641, 2, 3),
+  /*  2 */ ML_TREE_LEAF(2, 3),
+  /*  3 */ ML_TREE_NODE(QP, 27, 4, 9),
+  /*  4 */ ML_TREE_NODE(VARIANCE, 9.4219, 5, 6),
+  /*  5 */ ML_TREE_LEAF(5, 3),
+  /*  6 */ ML_TREE_NODE(MERGE_VARIANCE, 375.2185, 7, 8),
+  /*  7 */ ML_TREE_LEAF(7, 3),
+  /*  8 */ ML_TREE_LEAF(8, -1),
+  /*  9 */ ML_TREE_LEAF(9, 3),
+  /* 10 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 37332.3018, 11, 28),
+  /* 11 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 7585.0282, 12, 27),
+  /* 12 */ ML_TREE_NODE(QP, 32, 13, 24),
+  /* 13 */ ML_TREE_NODE(NEIGH_VARIANCE_C, 330.2178, 14, 23),
+  /* 14 */ ML_TREE_NODE(SUB_VARIANCE_0, 8.5273, 15, 16),
+  /* 15 */ ML_TREE_LEAF(15, -1),
+  /* 16 */ ML_TREE_NODE(NEIGH_VARIANCE_B, 221.5469, 17, 22),
+  /* 17 */ ML_TREE_NODE(VAR_OF_SUB_VAR, 1989.7928, 18, 19),
+  /* 18 */ ML_TREE_LEAF(18, 3),
+  /* 19 */ ML_TREE_NODE(VARIANCE, 155.5974, 20, 21),
+  /* 20 */ ML_TREE_LEAF(20, 3),
+  /* 21 */ ML_TREE_LEAF(21, -1),
+  /* 22 */ ML_TREE_LEAF(22, -1),
+  /* 23 */ ML_TREE_LEAF(23, -1),
+  /* 24 */ ML_TREE_NODE(MERGE_VARIANCE, 281.9509, 25, 26),
+  /* 25 */ ML_TREE_LEAF(25, 3),
+  /* 26 */ ML_TREE_LEAF(26, -1),
+  /* 27 */ ML_TREE_LEAF(27, -1),
+  /* 28 */ ML_TREE_LEAF(28, -1),
+};
+static const ml_tree_t tree_split_depth_3 = { tree_split_depth_3_nodes, 9 };
 
-static int tree_predict_split_depth_2(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->var_of_sub_var <= 2597.4529)
-		{
-				if (p_features->var_of_sub_var <= 146.7734)
-				{
-						*p_nb_iter = 23216.0;
-						*p_nb_bad = 1560.0;
-						return 2.0000;
-				}
-				else if (p_features->merge_variance <= 259.6952)
-				{
-						*p_nb_iter = 7470.0;
-						*p_nb_bad = 1902.0;
-						return 2.0000;
-				}
-				else if (p_features->qp <= 27)
-				{
-						if (p_features->variance <= 73.9929)
-						{
-								*p_nb_iter = 1138.0;
-								*p_nb_bad = 486.0;
-								return -1.0000;
-						}
-						else {
-								*p_nb_iter = 1619.0;
-								*p_nb_bad = 716.0;
-								return 2.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 2425.0;
-						*p_nb_bad = 861.0;
-						return 2.0000;
-				}
-		}
-		else if (p_features->var_of_sub_var <= 60850.5208)
-		{
-				if (p_features->var_of_sub_var <= 10144.602)
-				{
-						if (p_features->neigh_variance_C <= 926.8972)
-						{
-								if (p_features->sub_variance_0 <= 26.6006)
-								{
-										*p_nb_iter = 1796.0;
-										*p_nb_bad = 586.0;
-										return -1.0000;
-								}
-								else if (p_features->neigh_variance_A <= 493.5849)
-								{
-										if (p_features->neigh_variance_A <= 72.9516)
-										{
-												*p_nb_iter = 1326.0;
-												*p_nb_bad = 557.0;
-												return -1.0000;
-										}
-										else if (p_features->variance <= 156.4014)
-										{
-												*p_nb_iter = 1210.0;
-												*p_nb_bad = 563.0;
-												return -1.0000;
-										}
-										else {
-												*p_nb_iter = 1920.0;
-												*p_nb_bad = 817.0;
-												return 2.0000;
-										}
-								}
-								else {
-										*p_nb_iter = 1106.0;
-										*p_nb_bad = 437.0;
-										return -1.0000;
-								}
-						}
-						else {
-								*p_nb_iter = 1001.0;
-								*p_nb_bad = 278.0;
-								return -1.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 13068.0;
-						*p_nb_bad = 3612.0;
-						return -1.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 22705.0;
-				*p_nb_bad = 2687.0;
-				return -1.0000;
-		}
-}
 
+static const ml_model_t default_merge_models[4] = {
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_MERGE, 1, tree_merge_depth_1),
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_MERGE, 2, tree_merge_depth_2),
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_MERGE, 3, tree_merge_depth_3),
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_MERGE, 4, tree_merge_depth_4),
+};
 
+static const ml_model_t default_split_models[4] = {
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_SPLIT, 0, tree_split_depth_0),
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_SPLIT, 1, tree_split_depth_1),
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_SPLIT, 2, tree_split_depth_2),
+	ML_DEFAULT_MODEL(ML_MODEL_INTRA_SPLIT, 3, tree_split_depth_3),
+};
 
-static int tree_predict_split_depth_3(features_s* p_features, double* p_nb_iter, double* p_nb_bad)
-{
-		if (p_features->var_of_sub_var <= 818.5173)
-		{
-				if (p_features->merge_variance <= 62.7641)
-				{
-						*p_nb_iter = 20568.0;
-						*p_nb_bad = 767.0;
-						return 3.0000;
-				}
-				else if (p_features->qp <= 27)
-				{
-						if (p_features->variance <= 9.4219)
-						{
-								*p_nb_iter = 1255.0;
-								*p_nb_bad = 206.0;
-								return 3.0000;
-						}
-						else if (p_features->merge_variance <= 375.2185)
-						{
-								*p_nb_iter = 3999.0;
-								*p_nb_bad = 1321.0;
-								return 3.0000;
-						}
-						else {
-								*p_nb_iter = 1786.0;
-								*p_nb_bad = 817.0;
-								return -1.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 5286.0;
-						*p_nb_bad = 737.0;
-						return 3.0000;
-				}
-		}
-		else if (p_features->var_of_sub_var <= 37332.3018)
-		{
-				if (p_features->var_of_sub_var <= 7585.0282)
-				{
-						if (p_features->qp <= 32)
-						{
-								if (p_features->neigh_variance_C <= 330.2178)
-								{
-										if (p_features->sub_variance_0 <= 8.5273)
-										{
-												*p_nb_iter = 1114.0;
-												*p_nb_bad = 346.0;
-												return -1.0000;
-										}
-										else if (p_features->neigh_variance_B <= 221.5469)
-										{
-												if (p_features->var_of_sub_var <= 1989.7928)
-												{
-														*p_nb_iter = 1539.0;
-														*p_nb_bad = 606.0;
-														return 3.0000;
-												}
-												else if (p_features->variance <= 155.5974)
-												{
-														*p_nb_iter = 1298.0;
-														*p_nb_bad = 634.0;
-														return 3.0000;
-												}
-												else {
-														*p_nb_iter = 1076.0;
-														*p_nb_bad = 456.0;
-														return -1.0000;
-												}
-										}
-										else {
-												*p_nb_iter = 1644.0;
-												*p_nb_bad = 639.0;
-												return -1.0000;
-										}
-								}
-								else {
-										*p_nb_iter = 2401.0;
-										*p_nb_bad = 713.0;
-										return -1.0000;
-								}
-						}
-						else if (p_features->merge_variance <= 281.9509)
-						{
-								*p_nb_iter = 1020.0;
-								*p_nb_bad = 262.0;
-								return 3.0000;
-						}
-						else {
-								*p_nb_iter = 1278.0;
-								*p_nb_bad = 594.0;
-								return -1.0000;
-						}
-				}
-				else {
-						*p_nb_iter = 10507.0;
-						*p_nb_bad = 2943.0;
-						return -1.0000;
-				}
-		}
-		else {
-				*p_nb_iter = 25229.0;
-				*p_nb_bad = 3060.0;
-				return -1.0000;
-		}
-}
+#undef ML_TREE_NODE
+#undef ML_TREE_LEAF
 
 
 
  /**
  *	Allocate the structure and buffer
  */
-ml_intra_ctu_pred_t* kvz_init_ml_intra_depth_const() {
+ml_intra_ctu_pred_t* kvz_init_ml_intra_depth_const(const ml_model_set_t* models, uint32_t area) {
 	ml_intra_ctu_pred_t* ml_intra_depth_ctu = NULL;
 	// Allocate the ml_intra_ctu_pred_t strucutre
 	ml_intra_depth_ctu = MALLOC(ml_intra_ctu_pred_t, 1);
@@ -837,6 +349,10 @@ ml_intra_ctu_pred_t* kvz_init_ml_intra_depth_const() {
 	// Set the extra Upper Expansion in the upper_depth enabled by default 
 	ml_intra_depth_ctu->b_extra_up_exp = true;
 
+	// Trees loaded with --ml-model replace the built-in ones
+	ml_intra_depth_ctu->models = models;
+	ml_intra_depth_ctu->area = area;
+
 	// Allocate the depth matrices 
 	ml_intra_depth_ctu->_mat_lower_depth = MALLOC(uint8_t, LCU_DEPTH_MAT_SIZE);
 	if (!ml_intra_depth_ctu->_mat_lower_depth) {
@@ -884,139 +400,18 @@ static void features_init_array(features_s* arr_features, int16_t _size, int _qp
 }
 
 /*!
-* \brief Compute the average of a block inside an 8 bits 2D vector.
-*
-* \param _mat_src 	First depth map.
-* \param _x 		X coordinate of the start of the block inside the matrix.
-* \param _x_end 	X coordinate of the end of the block inside the matrix.
-* \param _y 		Y coordinate of the start of the block inside the matrix.
-* \param _y_end     Y coordinate of the end of the block inside the matrix.
-* \param _width     Width of the matrix.
-* \return average value of the block, -1 if error.
-*/
-static INLINE double vect_average_blck_int8(const kvz_pixel* _mat_src, size_t _x, size_t _x_end, size_t _y, size_t _y_end, size_t _width)
-{
-	if (_mat_src == NULL)
-	{
-		fprintf(stderr, "null pointer as parameter.");
-		assert(0);
-		return -1.0;
-	}
-	double   block_size = (double)(_x_end - _x) * (double)(_y_end - _y);
-	double   avg_vect = 0.0;
-	//STD_print_matrix(_mat_src,64, 64);
-	for (size_t i_y = _y; i_y < _y_end; ++i_y)
-	{
-		size_t i_y_line = i_y * _width;
-		for (size_t i_x = _x; i_x < _x_end; ++i_x)
-		{
-			avg_vect = avg_vect + (double)_mat_src[i_x + i_y_line];
-		}
-	}
-	return avg_vect / (double)(block_size);
-}
-
-/*!
-* \brief Compute the variance of a block inside an 8 bits 2D vector.
+* \brief Compute the variance of a block from the sums of its pixels.
 *
-* \param _mat_src 	First depth map.
-* \param _x 		X coordinate of the start of the block inside the matrix.
-* \param _x_end 	X coordinate of the end of the block inside the matrix.
-* \param _y 		Y coordinate of the start of the block inside the matrix.
-* \param _y_end     Y coordinate of the end of the block inside the matrix.
-* \param _avg_blck  Average value of the block.
-* \param _width     Width of the matrix.
-* \return average value of the block, -1 if error.
+* \param sums       Sum of the pixels and sum of their squares.
+* \param i_nbPixels Number of pixels in the block.
+* \return variance of the block.
 */
-static INLINE double vect_variance_blck_int8(const kvz_pixel* _mat_src, size_t _x, size_t _x_end, size_t _y, size_t _y_end, double _avg_blck, size_t _width)
+static INLINE double block_variance(const int32_t sums[2], int32_t i_nbPixels)
 {
-	if (_mat_src == NULL)
-	{
-		fprintf(stderr, "null pointer as parameter.");
-		assert(0);
-		return -1.0;
-	}
-	double   block_size = (double)(_x_end - _x) * (double)(_y_end - _y);
-	double   variance = 0.0;
-	for (size_t i_y = _y; i_y < _y_end; ++i_y)
-	{
-		size_t i_y_line = i_y * _width;
-		for (size_t i_x = _x; i_x < _x_end; ++i_x)
-		{
-			variance = variance + pow2((double)(_mat_src[i_x + i_y_line]) - _avg_blck);
-		}
-	}
-	return variance / (double)(block_size);
-}
-
-/*!
-* \brief Function to compute the average and the variance of a pixel block inside of a LCU.
-*
-* \param arr_luma_px Array of the pixels of the block.
-* \param i_xLcu      X coordinate of the lcu.
-* \param i_yLcu      Y coordinate of the lcu.
-* \param i_xBlck     X coordinate of the pixel block inside the LCU.
-* \param i_yBlck     Y coordinate of the pixel block inside the LCU.
-* \param i_blockSize Size of the block in pixels (4, 8, 16, 32 or 64).
-* \param i_width     Width  of the frame in pixels.
-* \param i_height    Height of the frame in pixels.
-* \param p_average   Pointer to be filled with the average.
-* \param p_variance  Pointer to be filled with the variance;
-* \return None.
-*/
-static INLINE void features_var_avg_blck(kvz_pixel* arr_luma_px, uint32_t i_xLcu, uint32_t i_yLcu,
-	uint32_t i_xBlck, uint32_t i_yBlck, uint8_t i_blockSize,
-	int32_t i_width, int32_t i_height,
-	double* p_average, double* p_variance)
-{
-	uint32_t iXMax = CR_XMAX(i_xLcu, i_blockSize + i_xBlck, i_width);
-	uint32_t iYMax = CR_YMAX(i_yLcu, i_blockSize + i_yBlck, i_height);
-	*p_average = vect_average_blck_int8(arr_luma_px, i_xBlck, iXMax, i_yBlck, iYMax, 64);
-	*p_variance = vect_variance_blck_int8(arr_luma_px, i_xBlck, iXMax, i_yBlck, iYMax, (*p_average), 64);
-}
-
-/*!
-* \brief Function to combine the variance and mean values of four blocks.
-*
-* \param arr_var     Array of 4*4 variances of the LCU.
-* \param arr_avgLuma Array of 4*4 mean values of the LCU.
-* \param i_x         X coordinate of the top left block.
-* \param i_y         Y coordinate of the top left block.
-* \param i_depth     Depth of the blocks (0,1,2,3 or 4).
-* \param p_varianceC Pointer to be filled with the combined variance.
-* \param p_avgLumaC  Pointer to be filled with the combined average.
-* \return None.
-*/
-static INLINE void features_combine_var(double* arr_var, double* arr_avgLuma, uint32_t i_x, uint32_t i_y, uint32_t i_depth,
-	double* p_varianceC, double* p_avgLumaC)
-{
-	double d_var_temp_1 = 0.0;
-	double d_var_temp_2 = 0.0;
-	double d_avg_temp_1 = 0.0;
-	double d_avg_temp_2 = 0.0;
-
-	int16_t i_subCU = (i_x + (i_y << 4)) << (4 - i_depth);
-	int16_t i_rows = (16 << (3 - i_depth));
-
-	int16_t i_sb0 = i_subCU; 									/*!< Top left sub block index */
-	int16_t i_sb1 = i_subCU + (1 << (3 - i_depth));			/*!< Top right sub block index */
-	int16_t i_sb2 = i_subCU + i_rows;							/*!< Bottom left sub block index */
-	int16_t i_sb3 = i_subCU + i_rows + (1 << (3 - i_depth)); 	/*!< Bottom right sub block index */
-
-	d_avg_temp_1 = (arr_avgLuma[i_sb0] + arr_avgLuma[i_sb1]) / 2.0;
-	d_avg_temp_2 = (arr_avgLuma[i_sb2] + arr_avgLuma[i_sb3]) / 2.0;
-
-	d_var_temp_1 = (2.0 * (arr_var[i_sb0] + arr_var[i_sb1]) + pow2((arr_avgLuma[i_sb0] - arr_avgLuma[i_sb1]))) / 4.0;
-	d_var_temp_2 = (2.0 * (arr_var[i_sb2] + arr_var[i_sb3]) + pow2((arr_avgLuma[i_sb2] - arr_avgLuma[i_sb3]))) / 4.0;
-
-	if (p_avgLumaC)
-	{
-		*p_avgLumaC = (d_avg_temp_1 + d_avg_temp_2) / 2.0;
-	}
-	*p_varianceC = (2.0 * (d_var_temp_1 + d_var_temp_2) + pow2(d_avg_temp_1 - d_avg_temp_2)) / 4.0;
+	int64_t i_num = (int64_t)i_nbPixels * sums[1] - (int64_t)sums[0] * sums[0];
+	return (double)i_num / ((double)i_nbPixels * (double)i_nbPixels);
 }
 
-
 /*!
 * \brief Function to combine the variance of the mean values of the sub block.
 *
@@ -1076,41 +471,35 @@ static void features_var_neighbor(features_s* arr_features, int16_t _x, int16_t
 
 
 /*!
-* \brief Extract the features from the pixels for a given different depth.
+* \brief Extract the features from the pixel sums for a given depth.
 *
 * \param arr_features 		Array of features to be retrieved for the current depth.
 * \param i_depth 			Depth to be evaluated.
-* \param arr_var 			Array of 16*16 variances.
-* \param arr_avg 			Array of 16*16 average lumas.
+* \param arr_sums 			Pixel sums of the blocks of the current depth.
+* \param arr_sub_sums 		Pixel sums of the blocks of depth i_depth + 1.
 * \return None.
 */
-static void features_compute(features_s* arr_features, uint8_t i_depth, double* arr_var, double* arr_avg)
+static void features_compute(features_s* arr_features, uint8_t i_depth, const int32_t arr_sums[][2], const int32_t arr_sub_sums[][2])
 {
-	double d_avgLumaC;
-
 	int8_t i_nbBlock = (1 << i_depth);
+	int32_t i_nbPixels = (LCU_WIDTH * LCU_WIDTH) >> (2 * i_depth);
 
 	for (int8_t y = 0; y < i_nbBlock; ++y)
 	{
 		for (int8_t x = 0; x < i_nbBlock; ++x)
 		{
 			int16_t i_cu = x + (y << i_depth);
-			if (i_depth == 4)
+			arr_features[i_cu].variance = block_variance(arr_sums[i_cu], i_nbPixels);
+			if (i_depth < 4)
 			{
-				arr_features[i_cu].variance = arr_var[i_cu];
-			}
-			else
-			{
-				features_combine_var(arr_var, arr_avg, x, y, i_depth, &arr_features[i_cu].variance, &d_avgLumaC);
-				int16_t i_CU_4 = (x << (4 - i_depth)) + (y << (8 - i_depth));
-				int16_t i_rows = (16 << (3 - i_depth));
-				arr_features[i_cu].var_of_sub_mean = features_get_var_of_sub_mean(arr_avg,
-					i_CU_4,
-					i_CU_4 + (1 << (3 - i_depth)),
-					i_CU_4 + i_rows,
-					i_CU_4 + i_rows + (1 << (3 - i_depth)));
-				arr_avg[i_CU_4] = d_avgLumaC;
-				arr_var[i_CU_4] = arr_features[i_cu].variance;
+				int16_t i_sb0 = (x << 1) + (y << (2 + i_depth));
+				int16_t i_rows = 2 << i_depth;
+				double arr_avg[4];
+				arr_avg[0] = arr_sub_sums[i_sb0][0] / (double)(i_nbPixels >> 2);
+				arr_avg[1] = arr_sub_sums[i_sb0 + 1][0] / (double)(i_nbPixels >> 2);
+				arr_avg[2] = arr_sub_sums[i_sb0 + i_rows][0] / (double)(i_nbPixels >> 2);
+				arr_avg[3] = arr_sub_sums[i_sb0 + i_rows + 1][0] / (double)(i_nbPixels >> 2);
+				arr_features[i_cu].var_of_sub_mean = features_get_var_of_sub_mean(arr_avg, 0, 1, 2, 3);
 			}
 			if (x % 2 == 1 &&
 				y % 2 == 1)
@@ -1223,25 +612,39 @@ static void features_var_of_sub_var(features_s* arr_features, uint8_t i_depth)
 
 
 /*!
-* \brief Extract the features from the pixels for all the depth.
+* \brief Compute the sums of the pixels of the 4*4 luma blocks of a CTU.
 *
-* \param main_handler 		Pointer to the main high level reduction handler.
-* \param p_state      		Pointer to the state of the current LCU.
-* \param arr_features_4 	Array of features for level of depth 4.
-* \param arr_features_8 	Array of features for level of depth 3.
-* \param arr_features_16 	Array of features for level of depth 2.
-* \param arr_features_32	Array of features for level of depth 1.
-* \param p_features64	    Pointer to the features of depth 0.
+* \param luma_px 	Luma pixels of the CTU with a stride of LCU_WIDTH.
+* \param sums    	Returns the sums.
 * \return None.
 */
-static void features_compute_all(features_s* arr_features[5], kvz_pixel* luma_px)
+void kvz_lcu_luma_sums(const kvz_pixel* luma_px, ml_intra_ctu_sums_t* sums)
 {
+	for (int8_t y = 0; y < 16; ++y)
+	{
+		kvz_pixel_4x4_sums(&luma_px[(y << 2) * LCU_WIDTH], LCU_WIDTH, 16, &sums->sums_4x4[y << 4]);
+	}
+}
+
 
-	uint32_t x_px = 0; /*!< Top left X of the lcu */
-	uint32_t y_px = 0; /*!< Top left Y of the lcu */
-	double variance[256] = { 0.0 };
-	double avg_luma[256] = { 0.0 };
+/*!
+* \brief Extract the features from the pixel sums for all the depth.
+*
+* \param arr_features 	Arrays of features for the depths 0 to 4.
+* \param sums         	Sums of the 4*4 luma blocks of the CTU.
+* \return None.
+*/
+static void features_compute_all(features_s* arr_features[5], const ml_intra_ctu_sums_t* sums)
+{
 
+	/*!< Sum of the pixels and sum of their squares for every block of
+	 *   every depth, in raster order within the depth */
+	int32_t arr_sums_4[256][2];
+	int32_t arr_sums_8[64][2];
+	int32_t arr_sums_16[16][2];
+	int32_t arr_sums_32[4][2];
+	int32_t arr_sums_64[1][2];
+	int32_t (*arr_sums[5])[2] = { arr_sums_64, arr_sums_32, arr_sums_16, arr_sums_8, arr_sums_4 };
 
 	features_s* arr_features_4 = arr_features[4];
 	features_s* arr_features_8 = arr_features[3];
@@ -1249,36 +652,37 @@ static void features_compute_all(features_s* arr_features[5], kvz_pixel* luma_px
 	features_s* arr_features_32 = arr_features[1];
 	features_s* p_features64 = arr_features[0];
 
-	/*!< Compute the variance for all 4*4 blocs */
-	for (int8_t y = 0; y < 8; ++y)
+	/*!< The sums of all 4*4 blocs are computed by kvz_lcu_luma_sums */
+	memcpy(arr_sums_4, sums->sums_4x4, sizeof(arr_sums_4));
+
+	/*!< Sum them up to the larger blocks */
+	for (int8_t i_depth = 3; i_depth >= 0; --i_depth)
 	{
-		for (int8_t x = 0; x < 8; ++x)
+		int8_t i_nbBlock = (1 << i_depth);
+		for (int8_t y = 0; y < i_nbBlock; ++y)
 		{
-			int16_t x_blck = (x << 1);
-			int16_t y_blck = (y << 1);
-			features_var_avg_blck(luma_px, x_px, y_px, x_blck << 2, y_blck << 2, 4, LCU_WIDTH, LCU_WIDTH,
-				&avg_luma[CR_GET_CU_D4(x_blck, y_blck, 4)],
-				&variance[CR_GET_CU_D4(x_blck, y_blck, 4)]);
-
-			features_var_avg_blck(luma_px, x_px, y_px, (x_blck + 1) << 2, y_blck << 2, 4, LCU_WIDTH, LCU_WIDTH,
-				&avg_luma[CR_GET_CU_D4(x_blck + 1, y_blck, 4)],
-				&variance[CR_GET_CU_D4(x_blck + 1, y_blck, 4)]);
-			features_var_avg_blck(luma_px, x_px, y_px, x_blck << 2, (y_blck + 1) << 2, 4, LCU_WIDTH, LCU_WIDTH,
-				&avg_luma[CR_GET_CU_D4(x_blck, y_blck + 1, 4)],
-				&variance[CR_GET_CU_D4(x_blck, y_blck + 1, 4)]);
-			features_var_avg_blck(luma_px, x_px, y_px, (x_blck + 1) << 2, (y_blck + 1) << 2, 4, LCU_WIDTH, LCU_WIDTH,
-				&avg_luma[CR_GET_CU_D4(x_blck + 1, y_blck + 1, 4)],
-				&variance[CR_GET_CU_D4(x_blck + 1, y_blck + 1, 4)]);
-
+			for (int8_t x = 0; x < i_nbBlock; ++x)
+			{
+				int16_t i_sb0 = (x << 1) + (y << (2 + i_depth));
+				int16_t i_rows = 2 << i_depth;
+				for (int k = 0; k < 2; ++k)
+				{
+					arr_sums[i_depth][x + (y << i_depth)][k] =
+						arr_sums[i_depth + 1][i_sb0][k] +
+						arr_sums[i_depth + 1][i_sb0 + 1][k] +
+						arr_sums[i_depth + 1][i_sb0 + i_rows][k] +
+						arr_sums[i_depth + 1][i_sb0 + i_rows + 1][k];
+				}
+			}
 		}
 	}
 
 	/* Compute the generic features of the all depth */
-	features_compute(arr_features_4, 4, variance, avg_luma);
-	features_compute(arr_features_8, 3, variance, avg_luma);
-	features_compute(arr_features_16, 2, variance, avg_luma);
-	features_compute(arr_features_32, 1, variance, avg_luma);
-	features_compute(p_features64, 0, variance, avg_luma);
+	features_compute(arr_features_4, 4, arr_sums_4, NULL);
+	features_compute(arr_features_8, 3, arr_sums_8, arr_sums_4);
+	features_compute(arr_features_16, 2, arr_sums_16, arr_sums_8);
+	features_compute(arr_features_32, 1, arr_sums_32, arr_sums_16);
+	features_compute(p_features64, 0, arr_sums_64, arr_sums_32);
 
 	/* Set the Sub_var features for the depth 3, 2, 1, 0*/
 	features_sub_var(arr_features_8, arr_features_4, 3);
@@ -1399,6 +803,8 @@ static void fill_depth_matrix_8(uint8_t* matrix, vect_2D* cu, int8_t curr_depth,
 /*!
 * \brief Generate the PUM depth map in a 8*8 array for a given depth with a Buttom-Up approach.
 *
+* \param ml_intra_depth_ctu	Models used for the prediction.
+* \param qp                 QP of the CTU.
 * \param arr_depthMap 		Array of the depth map.
 * \param arr_features_cur 	Array of features for current depth (i_depth).
 * \param arr_features_up 	Array of features for up depth (i_depth-1).
@@ -1410,29 +816,18 @@ static void fill_depth_matrix_8(uint8_t* matrix, vect_2D* cu, int8_t curr_depth,
 * 							1 to use use depth features
 * \return None.
 */
-static void ml_os_qt_gen(uint8_t* arr_depthMap, features_s* arr_features_cur, features_s* arr_features_up, uint8_t i_depth, int _level, uint8_t limited_flag)
+static void ml_os_qt_gen(const ml_intra_ctu_pred_t* ml_intra_depth_ctu, int8_t qp, uint8_t* arr_depthMap, features_s* arr_features_cur, features_s* arr_features_up, uint8_t i_depth, int _level, uint8_t limited_flag)
 {
-	
-
-		tree_predict predict_func_merge[4] = {
-				tree_predict_merge_depth_1,
-				tree_predict_merge_depth_2,
-				tree_predict_merge_depth_3,
-				tree_predict_merge_depth_4
-		};
-
-		tree_predict predict_func_split[4] = {
-				tree_predict_split_depth_0,
-				tree_predict_split_depth_1,
-				tree_predict_split_depth_2,
-				tree_predict_split_depth_3
-		};
-	
-	tree_predict prediction_function_merge = predict_func_merge[i_depth - 1];
-	tree_predict prediction_function_split = predict_func_split[i_depth - 1];
+	const ml_model_t* merge_model = kvz_ml_model_select(ml_intra_depth_ctu->models, &default_merge_models[i_depth - 1],
+	                                                    ML_MODEL_INTRA_MERGE, i_depth, qp, ml_intra_depth_ctu->area);
+	const ml_model_t* split_model = kvz_ml_model_select(ml_intra_depth_ctu->models, &default_split_models[i_depth - 1],
+	                                                    ML_MODEL_INTRA_SPLIT, i_depth - 1, qp, ml_intra_depth_ctu->area);
 
-	double d_nb_iter;
-	double d_nb_bad;
+	/*!< Predictions for all the blocks of the current and the upper depth */
+	int8_t arr_merge_pred[256];
+	int8_t arr_split_pred[64];
+	kvz_ml_model_predict_all(merge_model, ml_feature_offsets, arr_features_cur, sizeof(features_s), 1 << (2 * i_depth), arr_merge_pred);
+	kvz_ml_model_predict_all(split_model, ml_feature_offsets, arr_features_up, sizeof(features_s), 1 << (2 * (i_depth - 1)), arr_split_pred);
 
 	uint8_t i_rdepth = i_depth < 4 ? i_depth : 3;
 
@@ -1463,11 +858,11 @@ static void ml_os_qt_gen(uint8_t* arr_depthMap, features_s* arr_features_cur, fe
 				int8_t split_prediction;
 
 
-				merge_prediction[0] = prediction_function_merge(&arr_features_cur[i_cu_0], &d_nb_iter, &d_nb_bad);
-				merge_prediction[1] = prediction_function_merge(&arr_features_cur[i_cu_1], &d_nb_iter, &d_nb_bad);
-				merge_prediction[2] = prediction_function_merge(&arr_features_cur[i_cu_2], &d_nb_iter, &d_nb_bad);
-				merge_prediction[3] = prediction_function_merge(&arr_features_cur[i_cu_3], &d_nb_iter, &d_nb_bad);
-				split_prediction = prediction_function_split(&arr_features_up[i_cu_up], &d_nb_iter, &d_nb_bad);
+				merge_prediction[0] = arr_merge_pred[i_cu_0];
+				merge_prediction[1] = arr_merge_pred[i_cu_1];
+				merge_prediction[2] = arr_merge_pred[i_cu_2];
+				merge_prediction[3] = arr_merge_pred[i_cu_3];
+				split_prediction = arr_split_pred[i_cu_up];
 
 				int8_t pred = combined_tree_function(merge_prediction, split_prediction, (i_depth >= 4) ? 8 : 9, i_depth);
 				int condition = (pred < 0) ? 1 : 0;
@@ -1487,7 +882,7 @@ static void ml_os_qt_gen(uint8_t* arr_depthMap, features_s* arr_features_cur, fe
 
 
 
-static void os_luma_qt_pred(ml_intra_ctu_pred_t* ml_intra_depth_ctu, kvz_pixel* luma_px, int8_t qp, uint8_t* arr_CDM)
+static void os_luma_qt_pred(ml_intra_ctu_pred_t* ml_intra_depth_ctu, const ml_intra_ctu_sums_t* sums, int8_t qp, uint8_t* arr_CDM)
 {
 	// Features array per depth
 	features_s arr_features_4[256];
@@ -1512,18 +907,18 @@ static void os_luma_qt_pred(ml_intra_ctu_pred_t* ml_intra_depth_ctu, kvz_pixel*
 	arr_features[4] = arr_features_4;
 
 
-	features_compute_all(arr_features, luma_px);
+	features_compute_all(arr_features, sums);
 
 	// Generate the CDM for the current CTU
 	
 	/*!< Set the depth map to 4 by default */
 	memset(arr_CDM, 4, 64);
-	ml_os_qt_gen(arr_CDM, arr_features_4, arr_features_8, 4, 1, RESTRAINED_FLAG);
+	ml_os_qt_gen(ml_intra_depth_ctu, qp, arr_CDM, arr_features_4, arr_features_8, 4, 1, RESTRAINED_FLAG);
 	
 
-	ml_os_qt_gen(arr_CDM, arr_features_8, arr_features_16, 3, 1, RESTRAINED_FLAG);
-	ml_os_qt_gen(arr_CDM, arr_features_16, arr_features_32, 2, 1, RESTRAINED_FLAG);
-	ml_os_qt_gen(arr_CDM, arr_features_32, &features64, 1, 1, RESTRAINED_FLAG);
+	ml_os_qt_gen(ml_intra_depth_ctu, qp, arr_CDM, arr_features_8, arr_features_16, 3, 1, RESTRAINED_FLAG);
+	ml_os_qt_gen(ml_intra_depth_ctu, qp, arr_CDM, arr_features_16, arr_features_32, 2, 1, RESTRAINED_FLAG);
+	ml_os_qt_gen(ml_intra_depth_ctu, qp, arr_CDM, arr_features_32, &features64, 1, 1, RESTRAINED_FLAG);
 
 
 
@@ -1741,12 +1136,13 @@ static void generate_interval_from_os_pred(ml_intra_ctu_pred_t* ml_intra_depth_c
 }
 
 /**
-*	Generate the interval of depth predictions based on the luma samples
+*	Generate the interval of depth predictions based on the sums of the
+*	luma samples computed by kvz_lcu_luma_sums
 */
-void kvz_lcu_luma_depth_pred(ml_intra_ctu_pred_t* ml_intra_depth_ctu, kvz_pixel* luma_px, int8_t qp) {
+void kvz_lcu_luma_depth_pred(ml_intra_ctu_pred_t* ml_intra_depth_ctu, const ml_intra_ctu_sums_t* sums, int8_t qp) {
 
 	// Compute the one-shot (OS) Quad-tree prediction (_mat_OS_pred)
-	os_luma_qt_pred(ml_intra_depth_ctu, luma_px, qp, ml_intra_depth_ctu->_mat_upper_depth);
+	os_luma_qt_pred(ml_intra_depth_ctu, sums, qp, ml_intra_depth_ctu->_mat_upper_depth);
 
 	// Generate the interval of QT predictions around the first one
 	generate_interval_from_os_pred(ml_intra_depth_ctu, ml_intra_depth_ctu->_mat_upper_depth);
@@ -35,6 +35,7 @@
 #include <stdio.h>
 #include "global.h" // IWYU pragma: keep
 #include "kvazaar.h"
+#include "ml_model.h"
 
 
 
@@ -68,6 +69,10 @@ typedef struct {
 	/*!< Matrix used to store the upper and lower QT prediction*/
 	uint8_t* _mat_upper_depth; 
 	uint8_t* _mat_lower_depth;
+	/*!< Loaded models, or NULL to use the built-in ones */
+	const ml_model_set_t* models;
+	/*!< Luma area of the pictures, for selecting the models */
+	uint32_t area;
 } ml_intra_ctu_pred_t;
 
 
@@ -87,17 +92,24 @@ typedef struct {
 	double neigh_variance_B;
 	double neigh_variance_C;
 	double var_of_sub_mean;
-	int 	qp;
+	double	qp;
 	//int   NB_pixels;
 	double var_of_sub_var;
 }features_s;
 
 
-typedef int (*tree_predict)(features_s*, double*, double*);
+ // Sum of the luma pixels and sum of their squares for every 4*4 block of
+ // a CTU, in raster order. The features of all the depths are computed
+ // from these.
+typedef struct {
+	int32_t sums_4x4[256][2];
+} ml_intra_ctu_sums_t;
+
 
-ml_intra_ctu_pred_t* kvz_init_ml_intra_depth_const(void);
+ml_intra_ctu_pred_t* kvz_init_ml_intra_depth_const(const ml_model_set_t* models, uint32_t area);
 void kvz_end_ml_intra_depth_const(ml_intra_ctu_pred_t * ml_intra_depth_ctu);
 
-void kvz_lcu_luma_depth_pred(ml_intra_ctu_pred_t* ml_intra_depth_ctu, kvz_pixel* luma_px, int8_t qp);
+void kvz_lcu_luma_sums(const kvz_pixel* luma_px, ml_intra_ctu_sums_t* sums);
+void kvz_lcu_luma_depth_pred(ml_intra_ctu_pred_t* ml_intra_depth_ctu, const ml_intra_ctu_sums_t* sums, int8_t qp);
 
 #endif
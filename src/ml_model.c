@@ -0,0 +1,340 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "ml_model.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define ML_MODEL_VERSION 1
+#define ML_MODEL_HEADER_SIZE 8
+#define ML_MODEL_ENTRY_SIZE 14
+#define ML_MODEL_NODE_SIZE 10
+
+/*!< Maximum number of blocks evaluated by one call of predict_all */
+#define ML_MAX_BLOCKS 256
+
+static const uint8_t model_num_features[ML_NUM_MODEL_KINDS] = {
+	ML_INTRA_NUM_FEATURES,
+	ML_INTRA_NUM_FEATURES,
+	ML_INTER_NUM_FEATURES,
+};
+
+typedef struct {
+	const uint8_t* data;
+	size_t size;
+	size_t pos;
+} model_reader_t;
+
+static const uint8_t* read_bytes(model_reader_t* reader, size_t len)
+{
+	if (reader->size - reader->pos < len) return NULL;
+	const uint8_t* bytes = reader->data + reader->pos;
+	reader->pos += len;
+	return bytes;
+}
+
+static uint16_t get_u16(const uint8_t* b)
+{
+	return (uint16_t)(b[0] | b[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t* b)
+{
+	return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static float get_f32(const uint8_t* b)
+{
+	uint32_t bits = get_u32(b);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+/**
+ * \brief Parse the models of a model file.
+ *
+ * When set is NULL, only validates the file and counts the models, trees
+ * and nodes. Otherwise fills the arrays of set, which must be large enough.
+ *
+ * \return 0 on success
+ */
+static int parse_models(model_reader_t* reader, ml_model_set_t* set,
+                        int* num_models, int* num_trees, int* num_nodes)
+{
+	const uint8_t* header = read_bytes(reader, ML_MODEL_HEADER_SIZE);
+	if (!header || memcmp(header, "KVZM", 4) != 0) {
+		fprintf(stderr, "Not a model file.\n");
+		return -1;
+	}
+	if (get_u16(header + 4) != ML_MODEL_VERSION) {
+		fprintf(stderr, "Unsupported model file version %d.\n", get_u16(header + 4));
+		return -1;
+	}
+
+	*num_models = get_u16(header + 6);
+	*num_trees = 0;
+	*num_nodes = 0;
+	for (int m = 0; m < *num_models; ++m) {
+		const uint8_t* entry = read_bytes(reader, ML_MODEL_ENTRY_SIZE);
+		if (!entry) goto truncated;
+
+		const uint8_t kind = entry[0];
+		const int trees = get_u16(entry + 12);
+		if (kind >= ML_NUM_MODEL_KINDS || trees == 0) {
+			fprintf(stderr, "Invalid model %d in model file.\n", m);
+			return -1;
+		}
+
+		if (set) {
+			ml_model_t* model = &set->models[m];
+			model->kind = kind;
+			model->depth = entry[1];
+			model->qp_min = entry[2];
+			model->qp_max = entry[3];
+			model->area_min = get_u32(entry + 4);
+			model->area_max = get_u32(entry + 8);
+			model->num_trees = trees;
+			model->trees = &set->trees[*num_trees];
+		}
+
+		for (int t = 0; t < trees; ++t) {
+			const uint8_t* count = read_bytes(reader, 2);
+			if (!count) goto truncated;
+			const int nodes = get_u16(count);
+			if (nodes == 0) {
+				fprintf(stderr, "Empty tree in model %d.\n", m);
+				return -1;
+			}
+
+			ml_tree_node_t* tree_nodes = set ? &set->nodes[*num_nodes] : NULL;
+			for (int n = 0; n < nodes; ++n) {
+				const uint8_t* node = read_bytes(reader, ML_MODEL_NODE_SIZE);
+				if (!node) goto truncated;
+
+				const int16_t next[2] = { (int16_t)get_u16(node + 2), (int16_t)get_u16(node + 4) };
+				const bool leaf = next[0] == n && next[1] == n;
+				if (!leaf && (node[0] >= model_num_features[kind] ||
+				              next[0] <= n || next[0] >= nodes ||
+				              next[1] <= n || next[1] >= nodes)) {
+					fprintf(stderr, "Invalid node %d in model %d.\n", n, m);
+					return -1;
+				}
+
+				if (tree_nodes) {
+					tree_nodes[n].feature = leaf ? 0 : node[0];
+					tree_nodes[n].value = (int8_t)node[1];
+					tree_nodes[n].next[0] = next[0];
+					tree_nodes[n].next[1] = next[1];
+					tree_nodes[n].threshold = get_f32(node + 6);
+				}
+			}
+
+			if (set) {
+				// Nodes only point forward, so the depths of the subtrees are known
+				// when going through the nodes backwards.
+				int* depths = MALLOC(int, nodes);
+				if (!depths) return -1;
+				for (int n = nodes - 1; n >= 0; --n) {
+					const ml_tree_node_t* node = &tree_nodes[n];
+					depths[n] = node->next[0] == n ? 0 : 1 + MAX(depths[node->next[0]], depths[node->next[1]]);
+				}
+				set->trees[*num_trees].nodes = tree_nodes;
+				set->trees[*num_trees].depth = depths[0];
+				free(depths);
+			}
+
+			*num_trees += 1;
+			*num_nodes += nodes;
+		}
+	}
+
+	if (reader->pos != reader->size) {
+		fprintf(stderr, "Trailing data in model file.\n");
+		return -1;
+	}
+	return 0;
+
+truncated:
+	fprintf(stderr, "Model file is truncated.\n");
+	return -1;
+}
+
+
+/**
+ * \brief Load a set of models from a file.
+ *
+ * \param filename  name of the model file
+ * \return the models, or NULL on failure
+ */
+ml_model_set_t* kvz_ml_model_set_load(const char* filename)
+{
+	ml_model_set_t* set = NULL;
+	uint8_t* data = NULL;
+
+	FILE* file = fopen(filename, "rb");
+	if (!file) {
+		fprintf(stderr, "Failed to open %s: %s\n", filename, strerror(errno));
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size < 0) goto failed;
+
+	data = MALLOC(uint8_t, size + 1);
+	if (!data || fread(data, 1, size, file) != (size_t)size) goto failed;
+
+	// Validate and count everything first, so the set is allocated at once.
+	int num_models, num_trees, num_nodes;
+	model_reader_t reader = { data, size, 0 };
+	if (parse_models(&reader, NULL, &num_models, &num_trees, &num_nodes) != 0) goto failed;
+
+	set = calloc(1, sizeof(ml_model_set_t));
+	if (!set) goto failed;
+	set->num_models = num_models;
+	set->models = MALLOC(ml_model_t, num_models + 1);
+	set->trees = MALLOC(ml_tree_t, num_trees + 1);
+	set->nodes = MALLOC(ml_tree_node_t, num_nodes + 1);
+	if (!set->models || !set->trees || !set->nodes) goto failed;
+
+	reader.pos = 0;
+	if (parse_models(&reader, set, &num_models, &num_trees, &num_nodes) != 0) goto failed;
+
+	free(data);
+	fclose(file);
+	return set;
+
+failed:
+	fprintf(stderr, "Failed to load models from %s.\n", filename);
+	kvz_ml_model_set_free(set);
+	free(data);
+	fclose(file);
+	return NULL;
+}
+
+
+void kvz_ml_model_set_free(ml_model_set_t* set)
+{
+	if (!set) return;
+	FREE_POINTER(set->models);
+	FREE_POINTER(set->trees);
+	FREE_POINTER(set->nodes);
+	free(set);
+}
+
+
+/**
+ * \brief Select the model to use.
+ *
+ * \param set       loaded models or NULL
+ * \param fallback  built-in model
+ * \param kind      enum ml_model_kind
+ * \param depth     CU depth
+ * \param qp        QP of the picture
+ * \param area      luma area of the picture
+ * \return the first matching model in set, or fallback if there is none
+ */
+const ml_model_t* kvz_ml_model_select(const ml_model_set_t* set,
+                                      const ml_model_t* fallback,
+                                      int kind, int depth, int qp, uint32_t area)
+{
+	if (set) {
+		for (int i = 0; i < set->num_models; ++i) {
+			const ml_model_t* model = &set->models[i];
+			if (model->kind == kind && model->depth == depth &&
+			    WITHIN(qp, model->qp_min, model->qp_max) &&
+			    WITHIN(area, model->area_min, model->area_max)) {
+				return model;
+			}
+		}
+	}
+	return fallback;
+}
+
+
+/**
+ * \brief Evaluate a model for a number of blocks at once.
+ *
+ * The trees are evaluated with a fixed number of steps for all blocks, so
+ * the loop does not branch on the features.
+ *
+ * \param model            model to evaluate
+ * \param feature_offsets  offsets of the features in the feature struct
+ * \param features         array of feature structs
+ * \param features_size    size of one feature struct
+ * \param count            number of blocks, at most 256
+ * \param predictions      Returns the sum of the leaf values of each block.
+ */
+void kvz_ml_model_predict_all(const ml_model_t* model,
+                              const size_t* feature_offsets,
+                              const void* features, size_t features_size,
+                              int count, int8_t* predictions)
+{
+	int16_t sums[ML_MAX_BLOCKS] = { 0 };
+	int16_t node[ML_MAX_BLOCKS];
+
+	assert(count <= ML_MAX_BLOCKS);
+
+	for (int t = 0; t < model->num_trees; ++t)
+	{
+		const ml_tree_t* tree = &model->trees[t];
+		memset(node, 0, count * sizeof(node[0]));
+
+		for (int step = 0; step < tree->depth; ++step)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				const ml_tree_node_t* p_node = &tree->nodes[node[i]];
+				const char* block = (const char*)features + i * features_size;
+				const double feature = *(const double*)(block + feature_offsets[p_node->feature]);
+				node[i] = p_node->next[!(feature <= p_node->threshold)];
+			}
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			sums[i] += tree->nodes[node[i]].value;
+		}
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		predictions[i] = (int8_t)CLIP(INT8_MIN, INT8_MAX, sums[i]);
+	}
+}
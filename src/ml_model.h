@@ -0,0 +1,141 @@
+#ifndef ML_MODEL_H_
+#define ML_MODEL_H_
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+/**
+ * \ingroup Constraint
+ * \file
+ * Decision tree ensembles used by the machine learning based CU depth
+ * predictors and the binary file format for loading them at run time.
+ *
+ * All values are little-endian. A model file starts with the header
+ *
+ *     char     magic[4]    "KVZM"
+ *     uint16_t version     1
+ *     uint16_t num_models
+ *
+ * followed by the models. Each model is
+ *
+ *     uint8_t  kind        enum ml_model_kind
+ *     uint8_t  depth       CU depth the model is used for
+ *     uint8_t  qp_min      QP range the model is used for
+ *     uint8_t  qp_max
+ *     uint32_t area_min    range of luma picture areas (width * height)
+ *     uint32_t area_max    the model is used for
+ *     uint16_t num_trees
+ *
+ * followed by the trees. A tree is a uint16_t node count followed by the
+ * nodes, root first. A node is
+ *
+ *     uint8_t  feature     index of the feature compared by an inner node
+ *     int8_t   value       prediction of a leaf
+ *     int16_t  next[2]     next node if feature <= threshold, otherwise
+ *     float    threshold
+ *
+ * A leaf points to itself with both next indices. Inner nodes may only point
+ * forward in the array. The prediction of a model is the sum of the leaf
+ * values of its trees. It is interpreted as follows:
+ *
+ *   - intra merge: positive if the block should not be merged
+ *   - intra split: -1 if the upper block should be split
+ *   - inter split: positive if the split of the CU should not be searched
+ *
+ * The first model in the file that matches the kind, depth, QP and picture
+ * area is used. When none matches, the built-in model is used.
+ */
+
+#include "global.h" // IWYU pragma: keep
+
+#include <stddef.h>
+
+
+enum ml_model_kind {
+	ML_MODEL_INTRA_MERGE = 0, /*!< Intra merge trees, features of ml_intra_cu_depth_pred.c */
+	ML_MODEL_INTRA_SPLIT = 1, /*!< Intra split trees, features of ml_intra_cu_depth_pred.c */
+	ML_MODEL_INTER_SPLIT = 2, /*!< Inter split termination, features of ml_inter_cu_depth_pred.c */
+	ML_NUM_MODEL_KINDS
+};
+
+/*!< Number of features of each kind of model */
+#define ML_INTRA_NUM_FEATURES 12
+#define ML_INTER_NUM_FEATURES 9
+
+typedef struct {
+	uint8_t feature;   /*!< Feature compared by an inner node */
+	int8_t  value;     /*!< Prediction of a leaf */
+	int16_t next[2];   /*!< Next node if feature <= threshold, otherwise */
+	double  threshold;
+} ml_tree_node_t;
+
+typedef struct {
+	const ml_tree_node_t* nodes;
+	int depth;         /*!< Number of steps from the root to the deepest leaf */
+} ml_tree_t;
+
+typedef struct {
+	uint8_t kind;
+	uint8_t depth;
+	uint8_t qp_min;
+	uint8_t qp_max;
+	uint32_t area_min;
+	uint32_t area_max;
+	int num_trees;
+	const ml_tree_t* trees;
+} ml_model_t;
+
+typedef struct ml_model_set_t {
+	int num_models;
+	ml_model_t* models;
+	ml_tree_t* trees;
+	ml_tree_node_t* nodes;
+} ml_model_set_t;
+
+#define ML_TREE_NODE(feature, threshold, le, gt) { ML_FEATURE_ ## feature, 0, { le, gt }, threshold }
+#define ML_TREE_LEAF(self, value) { 0, value, { self, self }, 0.0 }
+
+/*!< Built-in model consisting of a single tree */
+#define ML_DEFAULT_MODEL(kind, depth, tree) { kind, depth, 0, 255, 0, UINT32_MAX, 1, &tree }
+
+ml_model_set_t* kvz_ml_model_set_load(const char* filename);
+void kvz_ml_model_set_free(ml_model_set_t* set);
+
+const ml_model_t* kvz_ml_model_select(const ml_model_set_t* set,
+                                      const ml_model_t* fallback,
+                                      int kind, int depth, int qp, uint32_t area);
+
+void kvz_ml_model_predict_all(const ml_model_t* model,
+                              const size_t* feature_offsets,
+                              const void* features, size_t features_size,
+                              int count, int8_t* predictions);
+
+#endif
@@ -68,23 +68,6 @@ void kvz_nal_write(bitstream_t * const bitstream, const uint8_t nal_type,
   kvz_bitstream_writebyte(bitstream, byte);
 }
 
-/*!
- \brief Calculate checksums for all colors of the picture.
- \param im The image that checksum is calculated for.
- \param checksum_out Result of the calculation.
- \returns Void
-*/
-void kvz_image_checksum(const kvz_picture *im, unsigned char checksum_out[][SEI_HASH_MAX_LENGTH], const uint8_t bitdepth)
-{
-  kvz_array_checksum(im->y, im->height, im->width, im->width, checksum_out[0], bitdepth);
-
-  /* The number of chroma pixels is half that of luma. */
-  if (im->chroma_format != KVZ_CSP_400) {
-    kvz_array_checksum(im->u, im->height >> 1, im->width >> 1, im->width >> 1, checksum_out[1], bitdepth);
-    kvz_array_checksum(im->v, im->height >> 1, im->width >> 1, im->width >> 1, checksum_out[2], bitdepth);
-  }
-}
-
 /*!
 \brief Calculate md5 for all colors of the picture.
 \param im The image that md5 is calculated for.
@@ -93,11 +76,91 @@ void kvz_image_checksum(const kvz_picture *im, unsigned char checksum_out[][SEI_
 */
 void kvz_image_md5(const kvz_picture *im, unsigned char checksum_out[][SEI_HASH_MAX_LENGTH], const uint8_t bitdepth)
 {
-  kvz_array_md5(im->y, im->height, im->width, im->width, checksum_out[0], bitdepth);
+  const kvz_pixel *const data[3] = { im->y, im->u, im->v };
+
+  /* The number of chroma pixels is a quarter of that of luma. */
+  const uint32_t luma_size = im->width * im->height;
+  const uint32_t length[3] = { luma_size, luma_size >> 2, luma_size >> 2 };
+
+  /* All colors are hashed at once to use multi-buffer implementations. */
+  kvz_array_md5(im->chroma_format != KVZ_CSP_400 ? 3 : 1, data, length, checksum_out);
+}
 
-  /* The number of chroma pixels is half that of luma. */
-  if (im->chroma_format != KVZ_CSP_400) {
-    kvz_array_md5(im->u, im->height >> 1, im->width >> 1, im->width >> 1, checksum_out[1], bitdepth);
-    kvz_array_md5(im->v, im->height >> 1, im->width >> 1, im->width >> 1, checksum_out[2], bitdepth);
+// Generator polynomial of the decoded picture hash CRC without the x^16 term.
+#define CRC_POLYNOMIAL 0x1021
+
+/**
+ * \brief Multiply two polynomials modulo the CRC polynomial.
+ */
+static uint16_t crc_mulmod(uint16_t a, uint16_t b)
+{
+  uint16_t result = 0;
+  for (int bit = 15; bit >= 0; --bit) {
+    result = (uint16_t)(result << 1) ^ ((result >> 15) ? CRC_POLYNOMIAL : 0);
+    if ((b >> bit) & 1) result ^= a;
   }
+  return result;
+}
+
+/**
+ * \brief Return x^(8 * bytes) modulo the CRC polynomial.
+ *
+ * Multiplying a CRC by this moves it the given number of bytes earlier in
+ * the data.
+ */
+static uint16_t crc_shift_bytes(uint64_t bytes)
+{
+  uint16_t result = 1;
+  uint16_t power = 1 << 8;
+  for (; bytes; bytes >>= 1) {
+    if (bytes & 1) result = crc_mulmod(result, power);
+    power = crc_mulmod(power, power);
+  }
+  return result;
+}
+
+/**
+ * \brief Calculate the contribution of a rectangle to the CRC of a plane.
+ *
+ * The CRC is linear, so the rectangles covering a plane can be hashed
+ * independently and combined with xor. The result is finalized with
+ * kvz_crc_plane.
+ *
+ * \param data          top-left pixel of the rectangle
+ * \param stride        distance between rows in data
+ * \param x0            horizontal position of the rectangle in the plane
+ * \param y0            vertical position of the rectangle in the plane
+ * \param width         width of the rectangle
+ * \param height        height of the rectangle
+ * \param plane_width   width of the plane
+ * \param plane_height  height of the plane
+ */
+uint16_t kvz_crc_rect(const kvz_pixel *data, int stride,
+                      int x0, int y0, int width, int height,
+                      int plane_width, int plane_height)
+{
+  const int bytes_per_pixel = KVZ_BIT_DEPTH > 8 ? 2 : 1;
+  const uint16_t row_shift = crc_shift_bytes((uint64_t)plane_width * bytes_per_pixel);
+
+  uint16_t crc = 0;
+  for (int y = 0; y < height; ++y) {
+    crc = crc_mulmod(crc, row_shift) ^ kvz_array_crc(0, &data[y * stride], width);
+  }
+
+  const uint64_t pixels_after = (uint64_t)(plane_width - x0 - width) +
+                                (uint64_t)plane_width * (plane_height - y0 - height);
+  return crc_mulmod(crc, crc_shift_bytes(pixels_after * bytes_per_pixel));
+}
+
+/**
+ * \brief Return the CRC of a plane from the xor of the CRCs of its parts.
+ */
+uint16_t kvz_crc_plane(uint16_t rects, int plane_width, int plane_height)
+{
+  const int bytes_per_pixel = KVZ_BIT_DEPTH > 8 ? 2 : 1;
+  const uint64_t bytes = (uint64_t)plane_width * plane_height * bytes_per_pixel;
+
+  // The CRC register starts at 0xffff and two zero bytes are appended.
+  const uint16_t crc = crc_mulmod(0xffff, crc_shift_bytes(bytes)) ^ rects;
+  return crc_mulmod(crc, crc_shift_bytes(2));
 }
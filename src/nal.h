@@ -49,11 +49,13 @@
 // FUNCTIONS
 void kvz_nal_write(bitstream_t * const bitstream, const uint8_t nal_type,
                const uint8_t temporal_id, const int long_start_code);
-void kvz_image_checksum(const kvz_picture *im,
-                      unsigned char checksum_out[][SEI_HASH_MAX_LENGTH], const uint8_t bitdepth);
 void kvz_image_md5(const kvz_picture *im,
                    unsigned char checksum_out[][SEI_HASH_MAX_LENGTH],
                    const uint8_t bitdepth);
+uint16_t kvz_crc_rect(const kvz_pixel *data, int stride,
+                      int x0, int y0, int width, int height,
+                      int plane_width, int plane_height);
+uint16_t kvz_crc_plane(uint16_t rects, int plane_width, int plane_height);
 
 
 
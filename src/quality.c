@@ -0,0 +1,329 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "quality.h"
+
+#include <math.h>
+
+#include "encoder.h"
+#include "kvazaar.h"
+#include "strategies/strategies-picture.h"
+
+
+/**
+ * \brief Value that is reported instead of PSNR when SSE is zero.
+ */
+static const double MAX_PSNR = 999.99;
+
+/**
+ * \brief Weights of the MS-SSIM scales from the finest to the coarsest.
+ *
+ * From Wang, Simoncelli and Bovik, "Multiscale structural similarity for
+ * image quality assessment", 2003.
+ */
+static const double MS_SSIM_WEIGHTS[MS_SSIM_SCALES] = {
+  0.0448, 0.2856, 0.3001, 0.2363, 0.1333
+};
+
+/**
+ * \brief Maximum number of 4x4 blocks in a row of SSIM windows of an LCU.
+ *
+ * The pixels finished by an LCU are at most LCU_WIDTH + SAO_DELAY_PX wide.
+ */
+#define SSIM_MAX_BLOCKS ((LCU_WIDTH + SAO_DELAY_PX) / 4 + 2)
+
+
+/**
+ * \brief Return the sum of squared errors of a rectangle.
+ */
+static uint64_t rect_sse(const kvz_pixel *ref, int ref_stride,
+                         const kvz_pixel *rec, int rec_stride,
+                         int width, int height)
+{
+  // kvz_pixels_calc_ssd drops the low bits of the error with high bit
+  // depths, so it is only used for 8-bit pixels.
+  const int width8  = KVZ_BIT_DEPTH == 8 ? width  & ~7 : 0;
+  const int height8 = KVZ_BIT_DEPTH == 8 ? height & ~7 : 0;
+  uint64_t sse = 0;
+
+  for (int y = 0; y < height8; y += 8) {
+    for (int x = 0; x < width8; x += 8) {
+      sse += kvz_pixels_calc_ssd(&ref[x + y * ref_stride],
+                                 &rec[x + y * rec_stride],
+                                 ref_stride, rec_stride, 8);
+    }
+  }
+  for (int y = 0; y < height; ++y) {
+    for (int x = (y < height8 ? width8 : 0); x < width; ++x) {
+      const int32_t diff = ref[x + y * ref_stride] - rec[x + y * rec_stride];
+      sse += diff * diff;
+    }
+  }
+  return sse;
+}
+
+/**
+ * \brief Downscale a rectangle of pixels by two in both directions.
+ *
+ * Pixels x0..x1-1, y0..y1-1 of dst are computed as the averages of the
+ * corresponding 2x2 blocks of src.
+ */
+static void downscale_rect(const kvz_pixel *src, int src_stride,
+                           kvz_pixel *dst, int dst_stride,
+                           int x0, int x1, int y0, int y1)
+{
+  for (int y = y0; y < y1; ++y) {
+    for (int x = x0; x < x1; ++x) {
+      const kvz_pixel *p = &src[2 * x + 2 * y * src_stride];
+      dst[x + y * dst_stride] = (p[0] + p[1] + p[src_stride] + p[src_stride + 1] + 2) >> 2;
+    }
+  }
+}
+
+/**
+ * \brief Accumulate SSIM over 8x8 windows with a step of four pixels.
+ *
+ * Windows are placed at x0 + 4 * i < x1 and y0 + 4 * j < y1. Each 4x4 block
+ * is shared by four windows, so the statistics of a row of blocks are
+ * computed once and kept for the next row of windows.
+ */
+static void ssim_rect(const kvz_pixel *ref, int ref_stride,
+                      const kvz_pixel *rec, int rec_stride,
+                      int x0, int x1, int y0, int y1,
+                      double *ssim_sum, double *cs_sum, uint32_t *count)
+{
+  if (x0 >= x1 || y0 >= y1) return;
+
+  const int windows = (x1 - x0 + 3) / 4;
+  assert(windows + 1 <= SSIM_MAX_BLOCKS);
+
+  // The constants are scaled by 64 * 64 and 64 * 63 to match the sums over
+  // the 64 pixels of a window.
+  const double max = PIXEL_MAX;
+  const double c1 = 0.01 * 0.01 * max * max * 64 * 64;
+  const double c2 = 0.03 * 0.03 * max * max * 64 * 63;
+
+  int32_t sums[2][SSIM_MAX_BLOCKS][4];
+  kvz_ssim_4x4_stats(&ref[x0 + y0 * ref_stride], ref_stride,
+                     &rec[x0 + y0 * rec_stride], rec_stride,
+                     windows + 1, sums[0]);
+
+  for (int y = y0, row = 0; y < y1; y += 4, row ^= 1) {
+    int32_t (*top)[4]    = sums[row];
+    int32_t (*bottom)[4] = sums[row ^ 1];
+    kvz_ssim_4x4_stats(&ref[x0 + (y + 4) * ref_stride], ref_stride,
+                       &rec[x0 + (y + 4) * rec_stride], rec_stride,
+                       windows + 1, bottom);
+
+    for (int i = 0; i < windows; ++i) {
+      int32_t s[4];
+      for (int k = 0; k < 4; ++k) {
+        s[k] = top[i][k] + top[i + 1][k] + bottom[i][k] + bottom[i + 1][k];
+      }
+      const double s1  = s[0];
+      const double s2  = s[1];
+      const double vars  = (double)s[2] * 64 - s1 * s1 - s2 * s2;
+      const double covar = (double)s[3] * 64 - s1 * s2;
+
+      const double cs = (2 * covar + c2) / (vars + c2);
+      *cs_sum   += cs;
+      *ssim_sum += (2 * s1 * s2 + c1) / (s1 * s1 + s2 * s2 + c1) * cs;
+    }
+    *count += windows;
+  }
+}
+
+/**
+ * \brief Accumulate PSNR and SSIM statistics of the pixels finished by an LCU.
+ *
+ * The statistics cover the area returned by kvz_lcu_finished_area. The
+ * caller makes sure that the neighboring slices of the tile are finished.
+ *
+ * SSIM windows and downscaled MS-SSIM pixels are assigned to the LCU that
+ * finishes their bottom-right pixel. The LCUs above and to the left are
+ * finished before this one, so all of the other pixels are final as well.
+ * Windows are not placed over tile boundaries, because tiles are encoded
+ * independently.
+ *
+ * \param state   encoder state
+ * \param lcu     LCU that was just filtered
+ */
+void kvz_quality_lcu(encoder_state_t *const state,
+                     const lcu_order_element_t *const lcu)
+{
+  const encoder_control_t *const encoder = state->encoder_control;
+  const videoframe_t *const frame = state->tile->frame;
+  const kvz_picture *const src = frame->source;
+  const kvz_picture *const rec = frame->rec;
+  lcu_stats_t *const stats = kvz_get_lcu_stats(state, lcu->position.x, lcu->position.y);
+
+  vector2d_t start, end;
+  kvz_lcu_finished_area(state, lcu, &start, &end);
+  const int x0 = start.x;
+  const int y0 = start.y;
+  const int x1 = end.x;
+  const int y1 = end.y;
+  const bool left  = lcu->position.x > 0;
+  const bool above = lcu->position.y > 0;
+
+  if (encoder->cfg.calc_psnr) {
+    stats->sse[COLOR_Y] = rect_sse(&src->y[x0 + y0 * src->stride], src->stride,
+                                   &rec->y[x0 + y0 * rec->stride], rec->stride,
+                                   x1 - x0, y1 - y0);
+    if (encoder->chroma_format != KVZ_CSP_400) {
+      for (int c = COLOR_U; c <= COLOR_V; ++c) {
+        stats->sse[c] = rect_sse(&src->data[c][x0 / 2 + y0 / 2 * src->stride / 2], src->stride / 2,
+                                 &rec->data[c][x0 / 2 + y0 / 2 * rec->stride / 2], rec->stride / 2,
+                                 (x1 - x0) / 2, (y1 - y0) / 2);
+      }
+    }
+  }
+
+  if (!encoder->cfg.calc_ssim) return;
+
+  for (int s = 0; s < MS_SSIM_SCALES; ++s) {
+    const int width  = frame->width  >> s;
+    const kvz_pixel *ref_px   = s == 0 ? src->y : state->tile->ssim_scales[0][s];
+    const kvz_pixel *rec_px   = s == 0 ? rec->y : state->tile->ssim_scales[1][s];
+    const int ref_stride = s == 0 ? src->stride : width;
+    const int rec_stride = s == 0 ? rec->stride : width;
+
+    if (s > 0) {
+      const int prev_width = frame->width >> (s - 1);
+      const kvz_pixel *ref_prev = s == 1 ? src->y : state->tile->ssim_scales[0][s - 1];
+      const kvz_pixel *rec_prev = s == 1 ? rec->y : state->tile->ssim_scales[1][s - 1];
+      downscale_rect(ref_prev, s == 1 ? src->stride : prev_width,
+                     state->tile->ssim_scales[0][s], width,
+                     x0 >> s, x1 >> s, y0 >> s, y1 >> s);
+      downscale_rect(rec_prev, s == 1 ? rec->stride : prev_width,
+                     state->tile->ssim_scales[1][s], width,
+                     x0 >> s, x1 >> s, y0 >> s, y1 >> s);
+    }
+
+    // Windows whose bottom-right pixel is in this LCU, starting at
+    // multiples of four. A window crossing the top edge also needs the LCU
+    // above and to the left, which is in the tile if the other two are.
+    const int win_x0 = (MAX(left  ? 0 : x0 >> s, (x0 >> s) - 7) + 3) & ~3;
+    const int win_y0 = (MAX(above ? 0 : y0 >> s, (y0 >> s) - 7) + 3) & ~3;
+    const int win_x1 = (x1 >> s) - 7;
+    const int win_y1 = (y1 >> s) - 7;
+
+    stats->ssim[s] = 0;
+    stats->ssim_cs[s] = 0;
+    stats->ssim_windows[s] = 0;
+    ssim_rect(ref_px, ref_stride, rec_px, rec_stride,
+              win_x0, win_x1, win_y0, win_y1,
+              &stats->ssim[s], &stats->ssim_cs[s], &stats->ssim_windows[s]);
+  }
+}
+
+/**
+ * \brief Reduce the quality statistics of the LCUs of a frame.
+ *
+ * PSNR is computed from the total squared error of each color component.
+ * SSIM is the mean over the full resolution windows. MS-SSIM combines the
+ * mean contrast-structure terms of the finer scales with the mean SSIM of
+ * the coarsest scale. If the frame is too small for all of the scales, the
+ * weights of the remaining scales are renormalized.
+ *
+ * \param state     main encoder state of the frame
+ * \param psnr      returns the PSNR of each color component
+ * \param ssim      returns the SSIM of the luma
+ * \param ms_ssim   returns the MS-SSIM of the luma
+ */
+void kvz_quality_frame(const encoder_state_t *const state,
+                       double psnr[3],
+                       double *ssim,
+                       double *ms_ssim)
+{
+  const encoder_control_t *const encoder = state->encoder_control;
+  const lcu_stats_t *const stats = state->frame->lcu_stats;
+  const int num_lcus = encoder->in.width_in_lcu * encoder->in.height_in_lcu;
+
+  psnr[0] = psnr[1] = psnr[2] = 0.0;
+  *ssim = 0.0;
+  *ms_ssim = 0.0;
+
+  if (encoder->cfg.calc_psnr) {
+    const double max_squared_error = (double)PIXEL_MAX * (double)PIXEL_MAX;
+    const int colors = encoder->chroma_format == KVZ_CSP_400 ? 1 : 3;
+
+    for (int c = 0; c < colors; ++c) {
+      uint64_t sse = 0;
+      for (int i = 0; i < num_lcus; ++i) {
+        sse += stats[i].sse[c];
+      }
+      int32_t num_pixels = encoder->in.width * encoder->in.height;
+      if (c != COLOR_Y) {
+        num_pixels >>= 2;
+      }
+
+      // Avoid division by zero
+      if (sse == 0) {
+        psnr[c] = MAX_PSNR;
+      } else {
+        psnr[c] = 10.0 * log10(num_pixels * max_squared_error / sse);
+      }
+    }
+  }
+
+  if (encoder->cfg.calc_ssim) {
+    // Sum in LCU order so that the result does not depend on threading.
+    double ssim_sum[MS_SSIM_SCALES] = { 0.0 };
+    double cs_sum[MS_SSIM_SCALES] = { 0.0 };
+    uint64_t windows[MS_SSIM_SCALES] = { 0 };
+    int scales = 0;
+
+    for (int s = 0; s < MS_SSIM_SCALES; ++s) {
+      for (int i = 0; i < num_lcus; ++i) {
+        ssim_sum[s] += stats[i].ssim[s];
+        cs_sum[s]   += stats[i].ssim_cs[s];
+        windows[s]  += stats[i].ssim_windows[s];
+      }
+      if (windows[s] == 0) break;
+      scales = s + 1;
+    }
+    if (scales == 0) return;
+
+    *ssim = ssim_sum[0] / windows[0];
+
+    double product = 1.0;
+    double weight_sum = 0.0;
+    for (int s = 0; s < scales; ++s) {
+      const double term = (s == scales - 1 ? ssim_sum[s] : cs_sum[s]) / windows[s];
+      product *= pow(MAX(term, 0.0), MS_SSIM_WEIGHTS[s]);
+      weight_sum += MS_SSIM_WEIGHTS[s];
+    }
+    *ms_ssim = pow(product, 1.0 / weight_sum);
+  }
+}
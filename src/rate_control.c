@@ -300,7 +300,7 @@ static int xCalcHADs8x8_ISlice(kvz_pixel * piOrg, int y, int iStrideOrg)
  * \param state   the main encoder state
  * \return        number of header bits
  */
-static uint64_t pic_header_bits(encoder_state_t * const state)
+static uint64_t pic_header_bits(const encoder_state_t * const state)
 {
   const kvz_config* cfg = &state->encoder_control->cfg;
 
@@ -319,6 +319,10 @@ static uint64_t pic_header_bits(encoder_state_t * const state)
       bits += 456;
       break;
 
+    case KVZ_HASH_CRC:
+      bits += 120;
+      break;
+
     case KVZ_HASH_NONE:
       break;
   }
@@ -356,6 +360,11 @@ static double pic_allocate_bits(encoder_state_t * const state)
   }
 
   if (state->frame->is_irap && encoder->cfg.intra_bit_allocation) {
+    const int num_lcus = encoder->in.width_in_lcu * encoder->in.height_in_lcu;
+    for (int i = 0; i < num_lcus; ++i) {
+      state->frame->lcu_stats[i].i_cost = 0;
+    }
+
     int total_cost = 0;
     for (int y = 0; y < encoder->cfg.height; y += 8) {
       for (int x = 0; x < encoder->cfg.width; x += 8) {
@@ -390,6 +399,218 @@ static double pic_allocate_bits(encoder_state_t * const state)
   return MAX(100, pic_target_bits);
 }
 
+/**
+ * \brief Number of bits added to the VBV buffer between two pictures.
+ */
+static double vbv_fill_per_picture(const kvz_config * const cfg)
+{
+  const double framerate = cfg->framerate_num != 0 ?
+    cfg->framerate_num / (double)cfg->framerate_denom : cfg->framerate;
+  return cfg->vbv_maxrate / framerate;
+}
+
+/**
+ * \brief Estimate VBV buffer fullness before removal of a picture.
+ *
+ * The fullness is known for pictures that have been written. The pictures
+ * in flight are assumed to use the maximum number of bits allowed for them.
+ *
+ * \param state      encoder state of the picture
+ * \param in_flight  number of preceding pictures that may not have been written
+ * \return           estimated fullness in bits
+ */
+static double vbv_fullness_before(const encoder_state_t * const state, int in_flight)
+{
+  const kvz_config *const cfg = &state->encoder_control->cfg;
+
+  if (state->frame->num == 0) {
+    return cfg->vbv_init * cfg->vbv_bufsize;
+  }
+
+  const encoder_state_t *const prev = state->previous_encoder_state;
+  if (in_flight == 0) {
+    return prev->frame->vbv_fullness;
+  }
+
+  const double fullness = vbv_fullness_before(prev, in_flight - 1) -
+                          prev->frame->vbv_max_bits - pic_header_bits(prev) +
+                          vbv_fill_per_picture(cfg);
+  return MIN(cfg->vbv_bufsize, fullness);
+}
+
+/**
+ * \brief Limit the number of bits allocated for a picture so that the VBV
+ * buffer does not underflow.
+ *
+ * Also sets state->frame->vbv_max_bits, which is used for clamping the QP
+ * of the remaining LCUs if the picture exceeds its allocation and for
+ * estimating the fullness for the next pictures.
+ *
+ * \param state   the main encoder state
+ * \param bits    target number of bits, excluding headers
+ * \return        limited target number of bits
+ */
+static double vbv_limit_pic_bits(encoder_state_t * const state, double bits)
+{
+  const kvz_config *const cfg = &state->encoder_control->cfg;
+
+  if (cfg->vbv_bufsize == 0) {
+    state->frame->vbv_max_bits = 0;
+    return bits;
+  }
+
+  const double fullness =
+    vbv_fullness_before(state, MIN(cfg->owf, state->frame->num));
+  const double max_bits = MAX(1, fullness - pic_header_bits(state));
+
+  // Leave a tenth of the buffer for the prediction error.
+  bits = MAX(100, MIN(bits, max_bits - 0.1 * cfg->vbv_bufsize));
+
+  // Allow the picture to exceed its allocation only so much that the
+  // estimates of the following pictures remain valid.
+  state->frame->vbv_max_bits = MIN(max_bits, 2 * bits);
+
+  return bits;
+}
+
+/**
+ * \brief Check whether an LCU is always coded before the current LCU.
+ *
+ * With --deterministic, rate control only uses statistics of these LCUs
+ * since they don't depend on the order in which the threads run.
+ * Coordinates are in LCUs and relative to the frame.
+ *
+ * \param state   encoder state of the current LCU
+ * \param cur     position of the current LCU
+ * \param x       horizontal position of the other LCU
+ * \param y       vertical position of the other LCU
+ */
+static bool lcu_done_before(const encoder_state_t * const state,
+                            vector2d_t cur, int x, int y)
+{
+  const encoder_state_config_tile_t * const tile = state->tile;
+
+  // Tiles are coded in parallel.
+  if (x < tile->lcu_offset_x || x >= tile->lcu_offset_x + tile->frame->width_in_lcu ||
+      y < tile->lcu_offset_y || y >= tile->lcu_offset_y + tile->frame->height_in_lcu) {
+    return false;
+  }
+
+  if (y == cur.y) return x < cur.x;
+  if (y > cur.y) return false;
+  if (!state->encoder_control->cfg.wpp) return true;
+
+  // Each wavefront row is at least two LCUs ahead of the next one.
+  return x <= cur.x + (cur.y - y);
+}
+
+typedef struct {
+  int count;
+  double bits;
+  double original_weight;
+  double i_cost;
+} lcu_done_sums_t;
+
+/**
+ * \brief Sum the statistics of the LCUs that are always coded before the
+ * current LCU.
+ */
+static lcu_done_sums_t sum_lcus_done_before(const encoder_state_t * const state,
+                                            vector2d_t cur)
+{
+  const encoder_control_t * const encoder = state->encoder_control;
+  const encoder_state_config_tile_t * const tile = state->tile;
+  lcu_done_sums_t sums = { 0, 0, 0, 0 };
+
+  for (int y = tile->lcu_offset_y; y <= cur.y; ++y) {
+    for (int x = tile->lcu_offset_x;
+         x < tile->lcu_offset_x + tile->frame->width_in_lcu;
+         ++x)
+    {
+      if (!lcu_done_before(state, cur, x, y)) continue;
+      const lcu_stats_t *lcu = &state->frame->lcu_stats[x + y * encoder->in.width_in_lcu];
+      sums.count++;
+      sums.bits += lcu->bits;
+      sums.original_weight += lcu->original_weight;
+      sums.i_cost += lcu->i_cost;
+    }
+  }
+
+  return sums;
+}
+
+/**
+ * \brief Raise the QP of an LCU if the picture is about to underflow the
+ * VBV buffer.
+ *
+ * The size of the rest of the picture is extrapolated from the LCUs coded
+ * so far. QP is raised by 6 for each halving of the bits that are needed.
+ *
+ * \param state   the main encoder state
+ * \param pos     position of the LCU in the frame
+ * \param qp      QP selected by rate control
+ * \return        QP for the LCU
+ */
+static int8_t vbv_clip_lcu_qp(encoder_state_t * const state, vector2d_t pos, int8_t qp)
+{
+  if (state->frame->vbv_max_bits <= 0) return qp;
+
+  const int num_lcus = state->encoder_control->in.width_in_lcu *
+                       state->encoder_control->in.height_in_lcu;
+
+  double bits_coded;
+  int lcus_coded;
+  if (state->encoder_control->cfg.deterministic) {
+    const lcu_done_sums_t done = sum_lcus_done_before(state, pos);
+    bits_coded = done.bits;
+    lcus_coded = done.count;
+  } else {
+    pthread_mutex_lock(&state->frame->rc_lock);
+    bits_coded = state->frame->cur_frame_bits_coded;
+    lcus_coded = state->frame->lcus_coded;
+    pthread_mutex_unlock(&state->frame->rc_lock);
+  }
+
+  if (lcus_coded == 0) return qp;
+
+  // Aim below the limit because the extrapolation is not exact.
+  const double bits_left = 0.9 * state->frame->vbv_max_bits - bits_coded;
+  const double bits_needed = bits_coded / lcus_coded * (num_lcus - lcus_coded);
+  if (bits_needed <= bits_left) return qp;
+
+  // The QP delta of a CU is limited like with VAQ.
+  const int max_qp = CLIP_TO_QP(state->frame->QP + KVZ_QP_DELTA_MAX / 2);
+  if (bits_left <= 0) return max_qp;
+
+  const int vbv_qp = state->frame->QP + (int)ceil(6.0 * log2(bits_needed / bits_left));
+  return MIN(max_qp, MAX(qp, vbv_qp));
+}
+
+/**
+ * \brief Update VBV buffer fullness after a picture has been written.
+ *
+ * \param state   the main encoder state
+ * \param bits    number of bits written for the picture
+ */
+void kvz_update_vbv_fullness(encoder_state_t * const state, uint64_t bits)
+{
+  const kvz_config *const cfg = &state->encoder_control->cfg;
+
+  if (cfg->vbv_bufsize == 0) return;
+
+  const double fullness = state->frame->num == 0
+    ? cfg->vbv_init * cfg->vbv_bufsize
+    : state->previous_encoder_state->frame->vbv_fullness;
+
+  if (fullness < bits && cfg->enable_logging_output) {
+    fprintf(stderr, "VBV underflow in frame %d: %.0f bits in buffer, %llu needed\n",
+            state->frame->num, fullness, (unsigned long long)bits);
+  }
+
+  state->frame->vbv_fullness =
+    MIN(cfg->vbv_bufsize, fullness - bits + vbv_fill_per_picture(cfg));
+}
+
 static int8_t lambda_to_qp(const double lambda)
 {
   const int8_t qp = 4.2005 * log(lambda) + 13.7223 + 0.5;
@@ -502,6 +723,8 @@ void kvz_estimate_pic_lambda(encoder_state_t * const state) {
     alpha = state->frame->new_ratecontrol->intra_alpha;
     beta = state->frame->new_ratecontrol->intra_beta;
     pthread_mutex_unlock(&state->frame->new_ratecontrol->intra_lock);
+    state->frame->intra_alpha = alpha;
+    state->frame->intra_beta = beta;
   }
   else if(state->frame->poc == 0) {
     alpha = state->frame->rc_alpha;
@@ -514,7 +737,7 @@ void kvz_estimate_pic_lambda(encoder_state_t * const state) {
     beta = state->frame->new_ratecontrol->pic_k_para[layer] - 1;
     pthread_mutex_unlock(&state->frame->new_ratecontrol->ck_frame_lock);
   }
-  double bits = pic_allocate_bits(state);
+  double bits = vbv_limit_pic_bits(state, pic_allocate_bits(state));
   state->frame->cur_pic_target_bits = bits;
 
   double est_lambda;
@@ -597,26 +820,48 @@ void kvz_estimate_pic_lambda(encoder_state_t * const state) {
 }
 
 
+/**
+ * \brief Allocate bits for an LCU.
+ *
+ * \param state   encoder state of the LCU
+ * \param pos     position of the LCU in the frame
+ */
 static double get_ctu_bits(encoder_state_t * const state, vector2d_t pos) {
   int avg_bits;
   const encoder_control_t * const encoder = state->encoder_control;
+  const bool deterministic = encoder->cfg.deterministic;
   
   int num_ctu = state->encoder_control->in.width_in_lcu * state->encoder_control->in.height_in_lcu;
-  const int index = pos.x + pos.y * state->tile->frame->width_in_lcu;
+  const int index = pos.x + pos.y * state->encoder_control->in.width_in_lcu;
 
   if (state->frame->is_irap) {
     if(encoder->cfg.intra_bit_allocation) {
-      int cus_left = num_ctu - index + 1;
-      int window = MIN(4, cus_left);
-      double mad = kvz_get_lcu_stats(state, pos.x, pos.y)->i_cost;
-
-      pthread_mutex_lock(&state->frame->rc_lock);
-      double bits_left = state->frame->cur_pic_target_bits - state->frame->cur_frame_bits_coded;
-      double weighted_bits_left = (bits_left * window + (bits_left - state->frame->i_bits_left)*cus_left) / window;
-      avg_bits = mad * weighted_bits_left / state->frame->remaining_weight;
-      state->frame->remaining_weight -= mad;
-      state->frame->i_bits_left -= state->frame->cur_pic_target_bits * mad / state->frame->icost;
-      pthread_mutex_unlock(&state->frame->rc_lock);
+      double mad = state->frame->lcu_stats[index].i_cost;
+
+      if (deterministic) {
+        // Recompute the running totals from the LCUs that are known to be
+        // done instead of updating the shared ones.
+        const lcu_done_sums_t done = sum_lcus_done_before(state, pos);
+        int cus_left = num_ctu - done.count + 1;
+        int window = MIN(4, cus_left);
+        double remaining_weight = state->frame->icost - done.i_cost;
+        double i_bits_left = state->frame->i_bits_left -
+          state->frame->cur_pic_target_bits * done.i_cost / state->frame->icost;
+        double bits_left = state->frame->cur_pic_target_bits - done.bits;
+        double weighted_bits_left = (bits_left * window + (bits_left - i_bits_left)*cus_left) / window;
+        avg_bits = mad * weighted_bits_left / remaining_weight;
+      } else {
+        int cus_left = num_ctu - index + 1;
+        int window = MIN(4, cus_left);
+
+        pthread_mutex_lock(&state->frame->rc_lock);
+        double bits_left = state->frame->cur_pic_target_bits - state->frame->cur_frame_bits_coded;
+        double weighted_bits_left = (bits_left * window + (bits_left - state->frame->i_bits_left)*cus_left) / window;
+        avg_bits = mad * weighted_bits_left / state->frame->remaining_weight;
+        state->frame->remaining_weight -= mad;
+        state->frame->i_bits_left -= state->frame->cur_pic_target_bits * mad / state->frame->icost;
+        pthread_mutex_unlock(&state->frame->rc_lock);
+      }
     }
     else {
       avg_bits = state->frame->cur_pic_target_bits * ((double)state->frame->lcu_stats[index].pixels /
@@ -626,7 +871,13 @@ static double get_ctu_bits(encoder_state_t * const state, vector2d_t pos) {
   else {
     double total_weight = 0;
     // In case wpp is used only the ctus of the current frame are safe to use
-    const int used_ctu_count = MIN(4, (encoder->cfg.wpp ? (pos.y + 1) * encoder->in.width_in_lcu : num_ctu) - index);
+    int window_end = encoder->cfg.wpp ? (pos.y + 1) * encoder->in.width_in_lcu : num_ctu;
+    if (deterministic && encoder->cfg.tiles_width_count * encoder->cfg.tiles_height_count > 1) {
+      // Stay within the tile row since other tiles are coded in parallel.
+      window_end = pos.y * encoder->in.width_in_lcu +
+        state->tile->lcu_offset_x + state->tile->frame->width_in_lcu;
+    }
+    const int used_ctu_count = MIN(4, window_end - index);
     int target_bits = 0;
     double best_lambda = 0.0;
     double temp_lambda = state->frame->lambda;
@@ -638,10 +889,18 @@ static double get_ctu_bits(encoder_state_t * const state, vector2d_t pos) {
       target_bits += state->frame->lcu_stats[i].weight;
     }
 
-    pthread_mutex_lock(&state->frame->rc_lock);
-    total_weight = state->frame->remaining_weight;
-    target_bits = MAX(target_bits + state->frame->cur_pic_target_bits - state->frame->cur_frame_bits_coded - (int)total_weight, 10);
-    pthread_mutex_unlock(&state->frame->rc_lock);
+    if (deterministic) {
+      // The remaining weight starts from the picture target and the original
+      // weight of each LCU is subtracted from it when the LCU is done.
+      const lcu_done_sums_t done = sum_lcus_done_before(state, pos);
+      total_weight = state->frame->cur_pic_target_bits - done.original_weight;
+      target_bits = MAX(target_bits + state->frame->cur_pic_target_bits - done.bits - (int)total_weight, 10);
+    } else {
+      pthread_mutex_lock(&state->frame->rc_lock);
+      total_weight = state->frame->remaining_weight;
+      target_bits = MAX(target_bits + state->frame->cur_pic_target_bits - state->frame->cur_frame_bits_coded - (int)total_weight, 10);
+      pthread_mutex_unlock(&state->frame->rc_lock);
+    }
 
     //just similar with the process at frame level, details can refer to the function kvz_estimate_pic_lambda
     do {
@@ -690,19 +949,44 @@ static double qp_to_lambda(encoder_state_t* const state, int qp)
   return lambda;
 }
 
+/**
+ * \brief Update the integer lambdas used for fixed-point RD costs.
+ *
+ * Must be called whenever state->lambda changes.
+ */
+static void set_fixed_point_lambda(encoder_state_t * const state)
+{
+#if KVZ_FIXED_POINT_COST
+  state->lambda_fixed      = (int64_t)(state->lambda      * (1 << RD_LAMBDA_FRAC_BITS) + 0.5);
+  state->lambda_sqrt_fixed = (int64_t)(state->lambda_sqrt * (1 << RD_LAMBDA_FRAC_BITS) + 0.5);
+#endif
+}
+
  void kvz_set_ctu_qp_lambda(encoder_state_t * const state, vector2d_t pos) {
-  double bits = get_ctu_bits(state, pos);
+  // Position of the LCU in the frame.
+  const vector2d_t lcu_pos = {
+    pos.x + state->tile->lcu_offset_x,
+    pos.y + state->tile->lcu_offset_y
+  };
+  double bits = get_ctu_bits(state, lcu_pos);
 
   const encoder_control_t * const encoder = state->encoder_control;
   const int frame_allocation = state->encoder_control->cfg.frame_allocation;
+  const bool deterministic = encoder->cfg.deterministic;
 
-  int index = pos.x + pos.y * state->encoder_control->in.width_in_lcu;
+  int index = lcu_pos.x + lcu_pos.y * state->encoder_control->in.width_in_lcu;
   lcu_stats_t* ctu = &state->frame->lcu_stats[index];
   double bpp = bits / ctu->pixels;
 
   double alpha;
   double beta;
-  if (state->frame->is_irap && encoder->cfg.intra_bit_allocation) {
+  if (state->frame->is_irap && encoder->cfg.intra_bit_allocation && deterministic) {
+    // The shared parameters may be updated by an earlier picture while this
+    // one is being coded.
+    alpha = state->frame->intra_alpha;
+    beta = state->frame->intra_beta;
+  }
+  else if (state->frame->is_irap && encoder->cfg.intra_bit_allocation) {
     pthread_mutex_lock(&state->frame->new_ratecontrol->intra_lock);
     alpha = state->frame->new_ratecontrol->intra_alpha;
     beta = state->frame->new_ratecontrol->intra_beta;
@@ -732,21 +1016,30 @@ static double qp_to_lambda(encoder_state_t* const state, int qp)
   }
   else {
     // In case wpp is used the previous ctus may not be ready from above rows
-    const int ctu_limit = encoder->cfg.wpp ? pos.y * encoder->in.width_in_lcu : 0;
+    const int ctu_limit = encoder->cfg.wpp && !deterministic ? lcu_pos.y * encoder->in.width_in_lcu : 0;
     
     est_lambda = alpha * pow(bpp, beta) * (state->frame->is_irap ? 0.5 : 1);
     const double clip_lambda = state->frame->lambda;
 
     double clip_neighbor_lambda = -1;
     int clip_qp = -1;
-    if (encoder->cfg.clip_neighbour || state->frame->num == 0) {
+    if (encoder->cfg.clip_neighbour || state->frame->num == 0 || deterministic) {
+      const int width = encoder->in.width_in_lcu;
       for (int temp_index = index - 1; temp_index >= ctu_limit; --temp_index) {
+        if (deterministic &&
+            !lcu_done_before(state, lcu_pos, temp_index % width, temp_index / width)) {
+          continue;
+        }
         if (state->frame->lcu_stats[temp_index].lambda > 0) {
           clip_neighbor_lambda = state->frame->lcu_stats[temp_index].lambda;
           break;
         }
       }
       for (int temp_index = index - 1; temp_index >= ctu_limit; --temp_index) {
+        if (deterministic &&
+            !lcu_done_before(state, lcu_pos, temp_index % width, temp_index / width)) {
+          continue;
+        }
         if (state->frame->lcu_stats[temp_index].qp > -1) {
           clip_qp = state->frame->lcu_stats[temp_index].qp;
           break;
@@ -796,12 +1089,17 @@ static double qp_to_lambda(encoder_state_t* const state, int qp)
       est_qp);
   }
 
+  const int vbv_qp = vbv_clip_lcu_qp(state, lcu_pos, est_qp);
+  if (vbv_qp != est_qp) {
+    est_qp = vbv_qp;
+    est_lambda = qp_to_lambda(state, vbv_qp);
+  }
+
   state->lambda = est_lambda;
   state->lambda_sqrt = sqrt(est_lambda);
   state->qp = est_qp;
   ctu->qp = est_qp;
   ctu->lambda = est_lambda;
-  ctu->i_cost = 0;
 
   // Apply variance adaptive quantization
   if (encoder->cfg.vaq) {
@@ -825,6 +1123,8 @@ static double qp_to_lambda(encoder_state_t* const state, int qp)
     //ctu->qp = state->qp;
     //ctu->lambda = state->lambda;
   }
+
+  set_fixed_point_lambda(state);
 }
 
 
@@ -1025,7 +1325,7 @@ void kvz_set_picture_lambda_and_qp(encoder_state_t * const state)
                         &state->frame->rc_beta);
     }
 
-    const double pic_target_bits = pic_allocate_bits(state);
+    const double pic_target_bits = vbv_limit_pic_bits(state, pic_allocate_bits(state));
     const double target_bpp = pic_target_bits / ctrl->in.pixels_per_pic;
     double lambda = state->frame->rc_alpha * pow(target_bpp, state->frame->rc_beta);
     lambda = clip_lambda(lambda);
@@ -1140,6 +1440,17 @@ void kvz_set_lcu_lambda_and_qp(encoder_state_t * const state,
     state->lambda_sqrt = sqrt(lambda);
     state->qp          = lambda_to_qp(lambda);
 
+    const vector2d_t lcu_pos = {
+      pos.x + state->tile->lcu_offset_x,
+      pos.y + state->tile->lcu_offset_y
+    };
+    const int8_t vbv_qp = vbv_clip_lcu_qp(state, lcu_pos, state->qp);
+    if (vbv_qp != state->qp) {
+      state->qp          = vbv_qp;
+      state->lambda      = qp_to_lambda(state, vbv_qp);
+      state->lambda_sqrt = sqrt(state->lambda);
+    }
+
   } else {
     state->qp          = state->frame->QP;
     state->lambda      = state->frame->lambda;
@@ -1169,4 +1480,6 @@ void kvz_set_lcu_lambda_and_qp(encoder_state_t * const state,
     lcu->adjust_lambda = state->lambda;
     lcu->adjust_qp = state->qp;
   }
+
+  set_fixed_point_lambda(state);
 }
@@ -149,18 +149,6 @@ const float kvz_f_entropy_bits[128] =
 };
 
 
-// This struct is for passing data to kvz_rdoq_sign_hiding
-struct sh_rates_t {
-  // Bit cost of increasing rate by one.
-  int32_t inc[32 * 32];
-  // Bit cost of decreasing rate by one.
-  int32_t dec[32 * 32];
-  // Bit cost of going from zero to one.
-  int32_t sig_coeff_inc[32 * 32];
-  // Coeff minus quantized coeff.
-  int32_t quant_delta[32 * 32];
-};
-
 int kvz_init_rdcost_outfiles(const char *dir_path)
 {
 #define RD_SAMPLING_MAX_FN_LENGTH 4095
@@ -233,7 +221,7 @@ out:
  *
  * \returns bits needed to code input coefficients
  */
-static INLINE double get_coeff_cabac_cost(
+static INLINE rd_bits_t get_coeff_cabac_cost(
     const encoder_state_t * const state,
     const coeff_t *coeff,
     int32_t width,
@@ -257,7 +245,7 @@ static INLINE double get_coeff_cabac_cost(
 
   // Clear bytes and bits and set mode to "count"
   cabac_copy.only_count = 1;
-  double bits = 0;
+  rd_bits_t bits = 0;
 
   // Execute the coding function.
   // It is safe to drop the const modifier since state won't be modified
@@ -312,7 +300,7 @@ static INLINE void save_accuracy(int qp, double ccc, double fast_cost)
  *
  * \returns       number of bits needed to code coefficients
  */
-double kvz_get_coeff_cost(const encoder_state_t * const state,
+rd_bits_t kvz_get_coeff_cost(encoder_state_t * const state,
                             const coeff_t *coeff,
                             int32_t width,
                             int32_t type,
@@ -331,17 +319,24 @@ double kvz_get_coeff_cost(const encoder_state_t * const state,
       return UINT32_MAX; // Hush little compiler don't you cry, not really gonna return anything after assert(0)
     } else {
       uint64_t weights = kvz_fast_coeff_get_weights(state);
-      double fast_cost = kvz_fast_coeff_cost(coeff, width, weights);
+      rd_bits_t fast_cost = RD_BITS_FROM_DOUBLE(kvz_fast_coeff_cost(coeff, width, weights));
+      if (state->encoder_control->fast_coeff_online &&
+          ++state->fast_coeff_sample_count >=
+            state->encoder_control->cfg.fastrd_online_interval) {
+        state->fast_coeff_sample_count = 0;
+        rd_bits_t ccc = get_coeff_cabac_cost(state, coeff, width, type, scan_mode);
+        kvz_fast_coeff_online_add_sample(state, coeff, width, ccc);
+      }
       if (check_accuracy) {
-        double ccc = get_coeff_cabac_cost(state, coeff, width, type, scan_mode);
-        save_accuracy(state->qp, ccc, fast_cost);
+        rd_bits_t ccc = get_coeff_cabac_cost(state, coeff, width, type, scan_mode);
+        save_accuracy(state->qp, RD_BITS_TO_DOUBLE(ccc), RD_BITS_TO_DOUBLE(fast_cost));
       }
       return fast_cost;
     }
   } else {
-    double ccc = get_coeff_cabac_cost(state, coeff, width, type, scan_mode);
+    rd_bits_t ccc = get_coeff_cabac_cost(state, coeff, width, type, scan_mode);
     if (save_cccs) {
-      save_ccc(state->qp, coeff, width * width, ccc);
+      save_ccc(state->qp, coeff, width * width, RD_BITS_TO_DOUBLE(ccc));
     }
     return ccc;
   }
@@ -473,9 +468,9 @@ INLINE uint32_t kvz_get_coded_level ( encoder_state_t * const state, double *cod
  *
  * From HM 12.0
 */
-static double get_rate_last(const encoder_state_t * const state,
-                            const uint32_t  pos_x, const uint32_t pos_y,
-                            int32_t* last_x_bits, int32_t* last_y_bits)
+double kvz_get_rate_last(const encoder_state_t * const state,
+                         const uint32_t  pos_x, const uint32_t pos_y,
+                         int32_t* last_x_bits, int32_t* last_y_bits)
 {
   uint32_t ctx_x   = g_group_idx[pos_x];
   uint32_t ctx_y   = g_group_idx[pos_y];
@@ -489,8 +484,8 @@ static double get_rate_last(const encoder_state_t * const state,
   return state->lambda * uiCost;
 }
 
-static void calc_last_bits(encoder_state_t * const state, int32_t width, int32_t height, int8_t type,
-                           int32_t* last_x_bits, int32_t* last_y_bits)
+void kvz_calc_last_bits(encoder_state_t * const state, int32_t width, int32_t height, int8_t type,
+                        int32_t* last_x_bits, int32_t* last_y_bits)
 {
   cabac_data_t * const cabac = &state->cabac;
   int32_t bits_x = 0, bits_y = 0;
@@ -665,14 +660,31 @@ void kvz_rdoq_sign_hiding(
 }
 
 
+/**
+ * \brief Select the quantizer used for a transform block.
+ *
+ * \param encoder  encoder control
+ * \param width    transform width
+ */
+enum kvz_quant_mode kvz_select_quant_mode(const encoder_control_t *encoder, int32_t width)
+{
+  if (!encoder->cfg.rdoq_enable || (width == 4 && encoder->cfg.rdoq_skip)) {
+    return KVZ_QUANT_PLAIN;
+  }
+  return encoder->cfg.quant_modes[kvz_g_convert_to_bit[width]];
+}
+
 /** RDOQ with CABAC
  * \returns void
  * Rate distortion optimized quantization for entropy
  * coding engines using probability models like CABAC
  * From HM 12.0
+ *
+ * Generic implementation of the rdoq strategy. Other implementations must
+ * make exactly the same decisions.
  */
-void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff, int32_t width,
-           int32_t height, int8_t type, int8_t scan_mode, int8_t block_type, int8_t tr_depth)
+void kvz_rdoq_generic(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff, int32_t width,
+                      int32_t height, int8_t type, int8_t scan_mode, int8_t block_type, int8_t tr_depth)
 {
   const encoder_control_t * const encoder = state->encoder_control;
   cabac_data_t * const cabac = &state->cabac;
@@ -774,7 +786,7 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
   for (; cg_scanpos >= 0; cg_scanpos--) cost_coeffgroup_sig[cg_scanpos] = 0;
 
   int32_t last_x_bits[32], last_y_bits[32];
-  calc_last_bits(state, width, height, type, last_x_bits, last_y_bits);
+  kvz_calc_last_bits(state, width, height, type, last_x_bits, last_y_bits);
 
   for (int32_t cg_scanpos = cg_last_scanpos; cg_scanpos >= 0; cg_scanpos--) {
     uint32_t cg_blkpos  = scan_cg[cg_scanpos];
@@ -968,7 +980,7 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
           uint32_t   pos_y = blkpos >> log2_block_size;
           uint32_t   pos_x = blkpos - ( pos_y << log2_block_size );
 
-          double cost_last = (scan_mode == SCAN_VER) ? get_rate_last(state, pos_y, pos_x,last_x_bits,last_y_bits) : get_rate_last(state, pos_x, pos_y, last_x_bits,last_y_bits );
+          double cost_last = (scan_mode == SCAN_VER) ? kvz_get_rate_last(state, pos_y, pos_x,last_x_bits,last_y_bits) : kvz_get_rate_last(state, pos_x, pos_y, last_x_bits,last_y_bits );
           double totalCost = base_cost + cost_last - cost_sig[ scanpos ];
 
           if( totalCost < best_cost ) {
@@ -1009,14 +1021,14 @@ void kvz_rdoq(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff,
 /**
  * Calculate cost of actual motion vectors using CABAC coding
  */
-double kvz_get_mvd_coding_cost_cabac(const encoder_state_t* state,
-                                     const cabac_data_t* cabac,
-                                     const int32_t mvd_hor,
-                                     const int32_t mvd_ver)
+rd_bits_t kvz_get_mvd_coding_cost_cabac(const encoder_state_t* state,
+                                        const cabac_data_t* cabac,
+                                        const int32_t mvd_hor,
+                                        const int32_t mvd_ver)
 {
   cabac_data_t cabac_copy = *cabac;
   cabac_copy.only_count = 1;
-  double bits = 0;
+  rd_bits_t bits = 0;
   // It is safe to drop const here because cabac->only_count is set.
   kvz_encode_mvd((encoder_state_t*) state, &cabac_copy, mvd_hor, mvd_ver, &bits);
 
@@ -1027,7 +1039,7 @@ double kvz_get_mvd_coding_cost_cabac(const encoder_state_t* state,
 * \returns int
 * Calculates Motion Vector cost and related costs using CABAC coding
 */
-double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
+rd_cost_t kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
                                int x,
                                int y,
                                int mv_shift,
@@ -1035,7 +1047,7 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
                                inter_merge_cand_t merge_cand[MRG_MAX_NUM_CANDS],
                                int16_t num_cand,
                                int32_t ref_idx,
-                               double* bitcost)
+                               rd_bits_t* bitcost)
 {
   cabac_data_t state_cabac_copy;
   cabac_data_t* cabac;
@@ -1068,7 +1080,7 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
   state_cabac_copy.only_count = 1;
 
   cabac = &state_cabac_copy;
-  double bits = 0;
+  rd_bits_t bits = 0;
 
   if (!merged) {
     vector2d_t mvd1 = {
@@ -1079,8 +1091,8 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
       x - mv_cand[1][0],
       y - mv_cand[1][1],
     };
-    double cand1_cost = kvz_get_mvd_coding_cost_cabac(state, cabac, mvd1.x, mvd1.y);
-    double cand2_cost = kvz_get_mvd_coding_cost_cabac(state, cabac, mvd2.x, mvd2.y);
+    rd_bits_t cand1_cost = kvz_get_mvd_coding_cost_cabac(state, cabac, mvd1.x, mvd1.y);
+    rd_bits_t cand2_cost = kvz_get_mvd_coding_cost_cabac(state, cabac, mvd2.x, mvd2.y);
 
     // Select candidate 1 if it has lower cost
     if (cand2_cost < cand1_cost) {
@@ -1104,7 +1116,7 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
           CABAC_FBITS_UPDATE(cabac, &(cabac->ctx.cu_merge_idx_ext_model), symbol, bits, "MergeIndex");
         } else {
           CABAC_BIN_EP(cabac, symbol, "MergeIndex");
-          bits += 1;
+          bits += RD_BITS(1);
         }
         if (symbol == 0) break;
       }
@@ -1123,7 +1135,7 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
 
     //ToDo: bidir mv support
     for (ref_list_idx = 0; ref_list_idx < 2; ref_list_idx++) {
-      if (/*cur_cu->inter.mv_dir*/ 1 & (1 << ref_list_idx)) {
+      if (/*cur_cu->mv_dir*/ 1 & (1 << ref_list_idx)) {
         if (ref_list[ref_list_idx] > 1) {
           // parseRefFrmIdx
           int32_t ref_frame = ref_idx;
@@ -1143,7 +1155,7 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
                 CABAC_FBITS_UPDATE(cabac, &(cabac->ctx.cu_ref_pic_model[1]), symbol, bits, "ref_idx_lX");
               } else {
                 CABAC_BIN_EP(cabac, symbol, "ref_idx_lX");
-                bits += 1;
+                bits += RD_BITS(1);
               }
               if (symbol == 0) break;
             }
@@ -1151,7 +1163,7 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
         }
 
         // ToDo: Bidir vector support
-        if (!(state->frame->ref_list == REF_PIC_LIST_1 && /*cur_cu->inter.mv_dir == 3*/ 0)) {
+        if (!(state->frame->ref_list == REF_PIC_LIST_1 && /*cur_cu->mv_dir == 3*/ 0)) {
           // It is safe to drop const here because cabac->only_count is set.
           kvz_encode_mvd((encoder_state_t*) state, cabac, mvd.x, mvd.y, &bits);
         }
@@ -1171,7 +1183,7 @@ double kvz_calc_mvd_cost_cabac(const encoder_state_t * state,
   *bitcost = bits;
 
   // Store bitcost before restoring cabac
-  return *bitcost * state->lambda_sqrt;
+  return RD_COST_BITS_SQRT(state, *bitcost);
 }
 
 void kvz_close_rdcost_outfiles(void)
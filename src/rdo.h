@@ -51,14 +51,42 @@ extern const uint32_t kvz_g_go_rice_prefix_len[5];
 int kvz_init_rdcost_outfiles(const char *fn_template);
 void kvz_close_rdcost_outfiles(void);
 
-void  kvz_rdoq(encoder_state_t *state, coeff_t *coef, coeff_t *dest_coeff, int32_t width,
-           int32_t height, int8_t type, int8_t scan_mode, int8_t block_type, int8_t tr_depth);
+// This struct is for passing data to kvz_rdoq_sign_hiding
+struct sh_rates_t {
+  // Bit cost of increasing rate by one.
+  int32_t inc[32 * 32];
+  // Bit cost of decreasing rate by one.
+  int32_t dec[32 * 32];
+  // Bit cost of going from zero to one.
+  int32_t sig_coeff_inc[32 * 32];
+  // Coeff minus quantized coeff.
+  int32_t quant_delta[32 * 32];
+};
 
-double kvz_get_coeff_cost(const encoder_state_t * const state,
-                            const coeff_t *coeff,
-                            int32_t width,
-                            int32_t type,
-                            int8_t scan_mode);
+enum kvz_quant_mode kvz_select_quant_mode(const encoder_control_t *encoder, int32_t width);
+
+void  kvz_rdoq_generic(encoder_state_t *state, coeff_t *coef, coeff_t *dest_coeff, int32_t width,
+                       int32_t height, int8_t type, int8_t scan_mode, int8_t block_type, int8_t tr_depth);
+
+void kvz_rdoq_sign_hiding(const encoder_state_t *const state,
+                          const int32_t qp_scaled,
+                          const uint32_t *const scan2raster,
+                          const struct sh_rates_t *const sh_rates,
+                          const int32_t last_pos,
+                          const coeff_t *const coeffs,
+                          coeff_t *const quant_coeffs);
+
+void kvz_calc_last_bits(encoder_state_t *state, int32_t width, int32_t height, int8_t type,
+                        int32_t *last_x_bits, int32_t *last_y_bits);
+double kvz_get_rate_last(const encoder_state_t *state,
+                         const uint32_t pos_x, const uint32_t pos_y,
+                         int32_t *last_x_bits, int32_t *last_y_bits);
+
+rd_bits_t kvz_get_coeff_cost(encoder_state_t * const state,
+                             const coeff_t *coeff,
+                             int32_t width,
+                             int32_t type,
+                             int8_t scan_mode);
 
 int32_t kvz_get_ic_rate(encoder_state_t *state, uint32_t abs_level, uint16_t ctx_num_one, uint16_t ctx_num_abs,
                     uint16_t abs_go_rice, uint32_t c1_idx, uint32_t c2_idx, int8_t type);
@@ -71,10 +99,10 @@ uint32_t kvz_get_coded_level(encoder_state_t * state, double* coded_cost, double
 
 kvz_mvd_cost_func kvz_calc_mvd_cost_cabac;
 
-double kvz_get_mvd_coding_cost_cabac(const encoder_state_t* state,
-                                     const cabac_data_t* cabac,
-                                     int32_t mvd_hor,
-                                     int32_t mvd_ver);
+rd_bits_t kvz_get_mvd_coding_cost_cabac(const encoder_state_t* state,
+                                        const cabac_data_t* cabac,
+                                        int32_t mvd_hor,
+                                        int32_t mvd_ver);
 
 // Number of fixed point fractional bits used in the fractional bit table.
 #define CTX_FRAC_BITS 15
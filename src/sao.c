@@ -49,9 +49,9 @@ static void init_sao_info(sao_info_t *sao) {
 }
 
 
-static double sao_mode_bits_none(const encoder_state_t * const state, sao_info_t *sao_top, sao_info_t *sao_left)
+static rd_bits_t sao_mode_bits_none(const encoder_state_t * const state, sao_info_t *sao_top, sao_info_t *sao_left)
 {
-  double mode_bits = 0.0;
+  rd_bits_t mode_bits = 0;
   cabac_data_t * cabac = (cabac_data_t*)&state->search_cabac;
   cabac_ctx_t *ctx = NULL;
   // FL coded merges.
@@ -71,9 +71,9 @@ static double sao_mode_bits_none(const encoder_state_t * const state, sao_info_t
   return mode_bits;
 }
 
-static double sao_mode_bits_merge(const encoder_state_t * const state,
+static rd_bits_t sao_mode_bits_merge(const encoder_state_t * const state,
                                  int8_t merge_cand) {
-  double mode_bits = 0.0;
+  rd_bits_t mode_bits = 0;
   cabac_data_t * cabac = (cabac_data_t*)&state->search_cabac;
   cabac_ctx_t *ctx = NULL;
   // FL coded merges.
@@ -86,11 +86,11 @@ static double sao_mode_bits_merge(const encoder_state_t * const state,
 }
 
 
-static double sao_mode_bits_edge(const encoder_state_t * const state,
+static rd_bits_t sao_mode_bits_edge(const encoder_state_t * const state,
                               int edge_class, int offsets[NUM_SAO_EDGE_CATEGORIES],
                               sao_info_t *sao_top, sao_info_t *sao_left, unsigned buf_cnt)
 {
-  double mode_bits = 0.0;
+  rd_bits_t mode_bits = 0;
   cabac_data_t * cabac = (cabac_data_t*)&state->search_cabac;
   cabac_ctx_t *ctx = NULL;
   // FL coded merges.
@@ -106,7 +106,7 @@ static double sao_mode_bits_edge(const encoder_state_t * const state,
   // TR coded type_idx_, edge = 2 = cMax
   ctx = &(cabac->ctx.sao_type_idx_model);
   CABAC_FBITS_UPDATE(cabac, ctx, 1, mode_bits, "sao_type");
-  mode_bits += 1.0;
+  mode_bits += RD_BITS(1);
 
   // TR coded offsets.
   for (unsigned buf_index = 0; buf_index < buf_cnt; buf_index++) {
@@ -114,24 +114,24 @@ static double sao_mode_bits_edge(const encoder_state_t * const state,
     for (edge_cat = SAO_EO_CAT1; edge_cat <= SAO_EO_CAT4; ++edge_cat) {
       int abs_offset = abs(offsets[edge_cat+5*buf_index]);
       if (abs_offset == 0 || abs_offset == SAO_ABS_OFFSET_MAX) {
-        mode_bits += abs_offset + 1;
+        mode_bits += RD_BITS(abs_offset + 1);
       } else {
-        mode_bits += abs_offset + 2;
+        mode_bits += RD_BITS(abs_offset + 2);
       }
     }    
   }
 
-  mode_bits += 2.0;
+  mode_bits += RD_BITS(2);
 
   return mode_bits;
 }
 
 
-static double sao_mode_bits_band(const encoder_state_t * const state,
+static rd_bits_t sao_mode_bits_band(const encoder_state_t * const state,
                               int band_position[2], int offsets[10],
                               sao_info_t *sao_top, sao_info_t *sao_left, unsigned buf_cnt)
 {
-  double mode_bits = 0.0;
+  rd_bits_t mode_bits = 0;
   cabac_data_t * cabac = (cabac_data_t*)&state->search_cabac;
   cabac_ctx_t *ctx = NULL;
   // FL coded merges.
@@ -147,7 +147,7 @@ static double sao_mode_bits_band(const encoder_state_t * const state,
   // TR coded sao_type_idx_, band = 1
   ctx = &(cabac->ctx.sao_type_idx_model);
   CABAC_FBITS_UPDATE(cabac, ctx, 1, mode_bits, "sao_type");
-  mode_bits += 1.0;
+  mode_bits += RD_BITS(1);
 
   // TR coded offsets and possible FL coded offset signs.
   for (unsigned buf_index = 0; buf_index < buf_cnt; buf_index++)
@@ -156,17 +156,17 @@ static double sao_mode_bits_band(const encoder_state_t * const state,
     for (i = 0; i < 4; ++i) {
       int abs_offset = abs(offsets[i + 1 + buf_index*5]);
       if (abs_offset == 0) {
-        mode_bits += abs_offset + 1;
+        mode_bits += RD_BITS(abs_offset + 1);
       } else if(abs_offset == SAO_ABS_OFFSET_MAX) {
-        mode_bits += abs_offset + 1 + 1;
+        mode_bits += RD_BITS(abs_offset + 1 + 1);
       } else {
-        mode_bits += abs_offset + 2 + 1;
+        mode_bits += RD_BITS(abs_offset + 2 + 1);
       }      
     }
   }
 
   // FL coded band position.
-  mode_bits += 5.0 * buf_cnt;
+  mode_bits += RD_BITS(5 * buf_cnt);
 
   return mode_bits;
 }
@@ -206,7 +206,7 @@ void kvz_calc_sao_offset_array(const encoder_control_t * const encoder, const sa
  * \param rec_data  Reconstructed pixel data. 64x64 for luma, 32x32 for chroma.
  * \param sao_bands an array of bands for original and reconstructed block
  */
-static int calc_sao_band_offsets(int sao_bands[2][32], int offsets[4],
+static int calc_sao_band_offsets(const int sao_bands[2][32], int offsets[4],
                                  int *band_position)
 {
   int band;
@@ -260,31 +260,6 @@ static int calc_sao_band_offsets(int sao_bands[2][32], int offsets[4],
   return best_dist;
 }
 
-/**
- * \param orig_data  Original pixel data. 64x64 for luma, 32x32 for chroma.
- * \param rec_data  Reconstructed pixel data. 64x64 for luma, 32x32 for chroma.
- * \param sao_bands an array of bands for original and reconstructed block
- */
-static void calc_sao_bands(const encoder_state_t * const state, const kvz_pixel *orig_data, const kvz_pixel *rec_data,
-                           int block_width, int block_height,
-                           int sao_bands[2][32])
-{
-  int y, x;
-  int shift = state->encoder_control->bitdepth-5;
-
-  //Loop pixels and take top 5 bits to classify different bands
-  for (y = 0; y < block_height; ++y) {
-    for (x = 0; x < block_width; ++x) {
-      int32_t curr_pos = y * block_width + x;
-
-      kvz_pixel sb_index = rec_data[curr_pos] >> shift;
-      sao_bands[0][sb_index] += orig_data[curr_pos] - rec_data[curr_pos];
-      sao_bands[1][sb_index]++;
-    }
-  }
-}
-
-
 /**
  * \brief Reconstruct SAO.
  *
@@ -298,6 +273,13 @@ static void calc_sao_bands(const encoder_state_t * const state, const kvz_pixel
  * \param height          height of the area to filter
  * \param sao             SAO information
  * \param color           color plane index
+ * \param above           whether the pixels above the area are available
+ * \param below           whether the pixels below the area are available
+ * \param left            whether the pixels left of the area are available
+ * \param right           whether the pixels right of the area are available
+ *
+ * Pixels are not available across the frame, tile and slice boundaries
+ * since filtering across them is disabled.
  */
 void kvz_sao_reconstruct(const encoder_state_t *state,
                          const kvz_pixel *buffer,
@@ -307,39 +289,37 @@ void kvz_sao_reconstruct(const encoder_state_t *state,
                          int width,
                          int height,
                          const sao_info_t *sao,
-                         color_t color)
+                         color_t color,
+                         bool above,
+                         bool below,
+                         bool left,
+                         bool right)
 {
   const encoder_control_t *const ctrl = state->encoder_control;
   videoframe_t *const frame = state->tile->frame;
   const int shift = color == COLOR_Y ? 0 : 1;
 
-  const int frame_width = frame->width >> shift;
-  const int frame_height = frame->height >> shift;
   const int frame_stride = frame->rec->stride >> shift;
   kvz_pixel *output = &frame->rec->data[color][frame_x + frame_y * frame_stride];
 
   if (sao->type == SAO_TYPE_EDGE) {
     const vector2d_t *offset = g_sao_edge_offsets[sao->eo_class];
 
-    if (frame_x + width + offset[0].x > frame_width ||
-        frame_x + width + offset[1].x > frame_width)
-    {
+    if (!right && (offset[0].x > 0 || offset[1].x > 0)) {
       // Nothing to do for the rightmost column.
       width -= 1;
     }
-    if (frame_x + offset[0].x < 0 || frame_x + offset[1].x < 0) {
+    if (!left && (offset[0].x < 0 || offset[1].x < 0)) {
       // Nothing to do for the leftmost column.
       buffer += 1;
       output += 1;
       width -= 1;
     }
-    if (frame_y + height + offset[0].y > frame_height ||
-        frame_y + height + offset[1].y > frame_height)
-    {
+    if (!below && (offset[0].y > 0 || offset[1].y > 0)) {
       // Nothing to do for the bottommost row.
       height -= 1;
     }
-    if (frame_y + offset[0].y < 0 || frame_y + offset[1].y < 0) {
+    if (!above && (offset[0].y < 0 || offset[1].y < 0)) {
       // Nothing to do for the topmost row.
       buffer += stride;
       output += frame_stride;
@@ -361,18 +341,51 @@ void kvz_sao_reconstruct(const encoder_state_t *state,
 }
 
 
-static void sao_search_edge_sao(const encoder_state_t * const state, 
-                                const kvz_pixel * data[], const kvz_pixel * recdata[],
-                                int block_width, int block_height,
+/**
+ * \brief Change in SSE caused by applying edge offsets to a block.
+ *
+ * Applying offset h to N pixels with a summed error of E changes the SSE by
+ * N * h^2 - 2 * h * E.
+ */
+static int sao_edge_ddistortion(const sao_stats_t *stats, sao_eo_class eo_class,
+                                const int offsets[NUM_SAO_EDGE_CATEGORIES])
+{
+  int ddistortion = 0;
+  for (int edge_cat = SAO_EO_CAT0; edge_cat < NUM_SAO_EDGE_CATEGORIES; ++edge_cat) {
+    const int offset = offsets[edge_cat];
+    const int cat_sum = stats->edge[eo_class][0][edge_cat];
+    const int cat_cnt = stats->edge[eo_class][1][edge_cat];
+    ddistortion += cat_cnt * offset * offset - 2 * offset * cat_sum;
+  }
+  return ddistortion;
+}
+
+
+/**
+ * \brief Change in SSE caused by applying band offsets to a block.
+ */
+static int sao_band_ddistortion(const sao_stats_t *stats, int band_pos,
+                                const int offsets[4])
+{
+  int ddistortion = 0;
+  for (int i = 0; i < 4 && band_pos + i < 32; ++i) {
+    const int offset = offsets[i];
+    const int band_sum = stats->band[0][band_pos + i];
+    const int band_cnt = stats->band[1][band_pos + i];
+    ddistortion += band_cnt * offset * offset - 2 * offset * band_sum;
+  }
+  return ddistortion;
+}
+
+
+static void sao_search_edge_sao(const encoder_state_t * const state,
+                                const sao_stats_t stats[],
                                 unsigned buf_cnt,
                                 sao_info_t *sao_out, sao_info_t *sao_top,
                                 sao_info_t *sao_left)
 {
   sao_eo_class edge_class;
-  // This array is used to calculate the mean offset used to minimize distortion.
-  int cat_sum_cnt[2][NUM_SAO_EDGE_CATEGORIES];
   unsigned i = 0;
-  
 
   sao_out->type = SAO_TYPE_EDGE;
   sao_out->ddistortion = INT_MAX;
@@ -382,12 +395,9 @@ static void sao_search_edge_sao(const encoder_state_t * const state,
     int sum_ddistortion = 0;
     sao_eo_cat edge_cat;
 
-    // Call calc_sao_edge_dir once for luma and twice for chroma.
+    // Once for luma and twice for chroma.
     for (i = 0; i < buf_cnt; ++i) {
-      FILL(cat_sum_cnt, 0);
-      kvz_calc_sao_edge_dir(data[i], recdata[i], edge_class,
-                        block_width, block_height, cat_sum_cnt);
-    
+      const int (*cat_sum_cnt)[NUM_SAO_EDGE_CATEGORIES] = stats[i].edge[edge_class];
 
       for (edge_cat = SAO_EO_CAT1; edge_cat <= SAO_EO_CAT4; ++edge_cat) {
         int cat_sum = cat_sum_cnt[0][edge_cat];
@@ -423,7 +433,7 @@ static void sao_search_edge_sao(const encoder_state_t * const state,
     }
 
     {
-      float mode_bits = sao_mode_bits_edge(state, edge_class, edge_offset, sao_top, sao_left, buf_cnt);
+      float mode_bits = RD_BITS_TO_DOUBLE(sao_mode_bits_edge(state, edge_class, edge_offset, sao_top, sao_left, buf_cnt));
       sum_ddistortion += (int)((double)mode_bits*state->lambda +0.5);
     }
     // SAO is not applied for category 0.
@@ -440,8 +450,8 @@ static void sao_search_edge_sao(const encoder_state_t * const state,
 }
 
 
-static void sao_search_band_sao(const encoder_state_t * const state, const kvz_pixel * data[], const kvz_pixel * recdata[],
-                               int block_width, int block_height,
+static void sao_search_band_sao(const encoder_state_t * const state,
+                               const sao_stats_t stats[],
                                unsigned buf_cnt,
                                sao_info_t *sao_out, sao_info_t *sao_top,
                                sao_info_t *sao_left)
@@ -453,21 +463,15 @@ static void sao_search_band_sao(const encoder_state_t * const state, const kvz_p
 
   // Band offset
   {
-    int sao_bands[2][32];
     int temp_offsets[10];
     int ddistortion = 0;
     float temp_rate = 0.0;
     
     for (i = 0; i < buf_cnt; ++i) {
-      FILL(sao_bands, 0);
-      calc_sao_bands(state, data[i], recdata[i],block_width,
-                     block_height,sao_bands);
-    
-
-      ddistortion += calc_sao_band_offsets(sao_bands, &temp_offsets[1+5*i], &sao_out->band_position[i]);      
+      ddistortion += calc_sao_band_offsets(stats[i].band, &temp_offsets[1+5*i], &sao_out->band_position[i]);
     }
 
-    temp_rate = sao_mode_bits_band(state, sao_out->band_position, temp_offsets, sao_top, sao_left, buf_cnt);
+    temp_rate = RD_BITS_TO_DOUBLE(sao_mode_bits_band(state, sao_out->band_position, temp_offsets, sao_top, sao_left, buf_cnt));
     ddistortion += (int)((double)temp_rate*state->lambda + 0.5);
 
     // Select band sao over edge sao when distortion is lower
@@ -481,15 +485,12 @@ static void sao_search_band_sao(const encoder_state_t * const state, const kvz_p
 
 
 /**
- * \param data     Array of pointers to reference pixels.
- * \param recdata  Array of pointers to reconstructed pixels.
- * \param block_width   Width of the area to be examined.
- * \param block_height  Height of the area to be examined.
- * \param buf_cnt  Number of pointers data and recdata have.
+ * \param stats    Statistics of each color plane.
+ * \param buf_cnt  Number of color planes in stats.
  * \param sao_out  Output parameter for the best sao parameters.
  */
-static void sao_search_best_mode(const encoder_state_t * const state, const kvz_pixel * data[], const kvz_pixel * recdata[],
-                                 int block_width, int block_height,
+static void sao_search_best_mode(const encoder_state_t * const state,
+                                 const sao_stats_t stats[],
                                  unsigned buf_cnt,
                                  sao_info_t *sao_out, sao_info_t *sao_top,
                                  sao_info_t *sao_left, int32_t merge_cost[3])
@@ -508,15 +509,14 @@ static void sao_search_best_mode(const encoder_state_t * const state, const kvz_
   band_sao.eo_class = SAO_EO0;
 
   if (state->encoder_control->cfg.sao_type & 1){
-    sao_search_edge_sao(state, data, recdata, block_width, block_height, buf_cnt, &edge_sao, sao_top, sao_left);
-    float mode_bits = sao_mode_bits_edge(state, edge_sao.eo_class, edge_sao.offsets, sao_top, sao_left, buf_cnt);
+    sao_search_edge_sao(state, stats, buf_cnt, &edge_sao, sao_top, sao_left);
+    float mode_bits = RD_BITS_TO_DOUBLE(sao_mode_bits_edge(state, edge_sao.eo_class, edge_sao.offsets, sao_top, sao_left, buf_cnt));
     int ddistortion = (int)(mode_bits * state->lambda + 0.5);
     unsigned buf_i;
     
     for (buf_i = 0; buf_i < buf_cnt; ++buf_i) {
-      ddistortion += kvz_sao_edge_ddistortion(data[buf_i], recdata[buf_i], 
-                                          block_width, block_height,
-                                          edge_sao.eo_class, &edge_sao.offsets[5 * buf_i]);
+      ddistortion += sao_edge_ddistortion(&stats[buf_i], edge_sao.eo_class,
+                                          &edge_sao.offsets[5 * buf_i]);
     }
     
     edge_sao.ddistortion = ddistortion;
@@ -526,15 +526,14 @@ static void sao_search_best_mode(const encoder_state_t * const state, const kvz_
   }
 
   if (state->encoder_control->cfg.sao_type & 2){
-    sao_search_band_sao(state, data, recdata, block_width, block_height, buf_cnt, &band_sao, sao_top, sao_left);
-    float mode_bits = sao_mode_bits_band(state, band_sao.band_position, band_sao.offsets, sao_top, sao_left, buf_cnt);
+    sao_search_band_sao(state, stats, buf_cnt, &band_sao, sao_top, sao_left);
+    float mode_bits = RD_BITS_TO_DOUBLE(sao_mode_bits_band(state, band_sao.band_position, band_sao.offsets, sao_top, sao_left, buf_cnt));
     int ddistortion = (int)(mode_bits * state->lambda + 0.5);
     unsigned buf_i;
     
     for (buf_i = 0; buf_i < buf_cnt; ++buf_i) {
-      ddistortion += kvz_sao_band_ddistortion(state, data[buf_i], recdata[buf_i], 
-                                          block_width, block_height, 
-                                          band_sao.band_position[buf_i], &band_sao.offsets[1 + 5 * buf_i]);
+      ddistortion += sao_band_ddistortion(&stats[buf_i], band_sao.band_position[buf_i],
+                                          &band_sao.offsets[1 + 5 * buf_i]);
     }
     
     band_sao.ddistortion = ddistortion;
@@ -554,7 +553,7 @@ static void sao_search_best_mode(const encoder_state_t * const state, const kvz_
   // Choose between SAO and doing nothing, taking into account the
   // rate-distortion cost of coding do nothing.
   {
-    float mode_bits_none = sao_mode_bits_none(state, sao_top, sao_left);
+    float mode_bits_none = RD_BITS_TO_DOUBLE(sao_mode_bits_none(state, sao_top, sao_left));
     int cost_of_nothing = (int)(mode_bits_none * state->lambda + 0.5);
     if (sao_out->ddistortion >= cost_of_nothing) {
       sao_out->type = SAO_TYPE_NONE;
@@ -571,23 +570,21 @@ static void sao_search_best_mode(const encoder_state_t * const state, const kvz_
 
       if (merge_cand) {
         unsigned buf_i;
-        float mode_bits = sao_mode_bits_merge(state, i + 1);
+        float mode_bits = RD_BITS_TO_DOUBLE(sao_mode_bits_merge(state, i + 1));
         int ddistortion = (int)(mode_bits * state->lambda + 0.5);
 
         switch (merge_cand->type) {
           case SAO_TYPE_EDGE:
                 for (buf_i = 0; buf_i < buf_cnt; ++buf_i) {
-                  ddistortion += kvz_sao_edge_ddistortion(data[buf_i], recdata[buf_i],
-                    block_width, block_height,
-                    merge_cand->eo_class, &merge_cand->offsets[5 * buf_i]);
+                  ddistortion += sao_edge_ddistortion(&stats[buf_i], merge_cand->eo_class,
+                    &merge_cand->offsets[5 * buf_i]);
                 }
                 merge_cost[i + 1] = ddistortion;
             break;
           case SAO_TYPE_BAND:
               for (buf_i = 0; buf_i < buf_cnt; ++buf_i) {
-                ddistortion += kvz_sao_band_ddistortion(state, data[buf_i], recdata[buf_i],
-                  block_width, block_height,
-                  merge_cand->band_position[buf_i], &merge_cand->offsets[1 + 5 * buf_i]);
+                ddistortion += sao_band_ddistortion(&stats[buf_i], merge_cand->band_position[buf_i],
+                  &merge_cand->offsets[1 + 5 * buf_i]);
               }
               merge_cost[i + 1] = ddistortion;
             break;
@@ -606,10 +603,9 @@ static void sao_search_chroma(const encoder_state_t * const state, const videofr
 {
   int block_width  = (LCU_WIDTH / 2);
   int block_height = (LCU_WIDTH / 2);
-  const kvz_pixel *orig_list[2];
-  const kvz_pixel *rec_list[2];
-  kvz_pixel orig[2][LCU_CHROMA_SIZE];
-  kvz_pixel rec[2][LCU_CHROMA_SIZE];
+  kvz_pixel orig[LCU_CHROMA_SIZE];
+  kvz_pixel rec[LCU_CHROMA_SIZE];
+  sao_stats_t stats[2];
   color_t color_i;
 
   // Check for right and bottom boundaries.
@@ -622,28 +618,27 @@ static void sao_search_chroma(const encoder_state_t * const state, const videofr
 
   sao->type = SAO_TYPE_EDGE;
 
-  // Copy data to temporary buffers and init orig and rec lists to point to those buffers.
+  // Copy data to temporary buffers and gather the statistics of both planes.
   for (color_i = COLOR_U; color_i <= COLOR_V; ++color_i) {
     kvz_pixel *data = &frame->source->data[color_i][CU_TO_PIXEL(x_ctb, y_ctb, 1, frame->source->stride / 2)];
     kvz_pixel *recdata = &frame->rec->data[color_i][CU_TO_PIXEL(x_ctb, y_ctb, 1, frame->rec->stride / 2)];
-    kvz_pixels_blit(data, orig[color_i - 1], block_width, block_height,
+    kvz_pixels_blit(data, orig, block_width, block_height,
                         frame->source->stride / 2, block_width);
-    kvz_pixels_blit(recdata, rec[color_i - 1], block_width, block_height,
+    kvz_pixels_blit(recdata, rec, block_width, block_height,
                         frame->rec->stride / 2, block_width);
-    orig_list[color_i - 1] = &orig[color_i - 1][0];
-    rec_list[color_i - 1] = &rec[color_i - 1][0];
+    kvz_calc_sao_stats(state->encoder_control, orig, rec, block_width, block_height,
+                       &stats[color_i - 1]);
   }
 
   // Calculate
-  sao_search_best_mode(state, orig_list, rec_list, block_width, block_height, 2, sao, sao_top, sao_left, merge_cost);
+  sao_search_best_mode(state, stats, 2, sao, sao_top, sao_left, merge_cost);
 }
 
 static void sao_search_luma(const encoder_state_t * const state, const videoframe_t *frame, unsigned x_ctb, unsigned y_ctb, sao_info_t *sao, sao_info_t *sao_top, sao_info_t *sao_left, int32_t merge_cost[3])
 {
   kvz_pixel orig[LCU_LUMA_SIZE];
   kvz_pixel rec[LCU_LUMA_SIZE];
-  const kvz_pixel * orig_list[1] = { NULL };
-  const kvz_pixel * rec_list[1] = { NULL };
+  sao_stats_t stats;
   kvz_pixel *data = &frame->source->y[CU_TO_PIXEL(x_ctb, y_ctb, 0, frame->source->stride)];
   kvz_pixel *recdata = &frame->rec->y[CU_TO_PIXEL(x_ctb, y_ctb, 0, frame->rec->stride)];
   int block_width = LCU_WIDTH;
@@ -663,9 +658,8 @@ static void sao_search_luma(const encoder_state_t * const state, const videofram
   kvz_pixels_blit(data, orig, block_width, block_height, frame->source->stride, block_width);
   kvz_pixels_blit(recdata, rec, block_width, block_height, frame->rec->stride, block_width);
 
-  orig_list[0] = orig;
-  rec_list[0] = rec;
-  sao_search_best_mode(state, orig_list, rec_list, block_width, block_height, 1, sao, sao_top, sao_left, merge_cost);
+  kvz_calc_sao_stats(state->encoder_control, orig, rec, block_width, block_height, &stats);
+  sao_search_best_mode(state, &stats, 1, sao, sao_top, sao_left, merge_cost);
 }
 
 void kvz_sao_search_lcu(const encoder_state_t* const state, int lcu_x, int lcu_y)
@@ -62,6 +62,20 @@ typedef struct sao_info_t {
   int offsets[NUM_SAO_EDGE_CATEGORIES * 2];
 } sao_info_t;
 
+/**
+ * \brief Statistics of a single color plane of a CTU for the SAO search.
+ *
+ * Sums are sums of orig - rec differences and counts are numbers of pixels.
+ * Edge statistics only cover the pixels that have all their neighbours
+ * inside the block, band statistics cover the whole block.
+ */
+typedef struct sao_stats_t {
+  // edge[eo_class][0 for sum, 1 for count][edge category]
+  int edge[SAO_NUM_EO][2][NUM_SAO_EDGE_CATEGORIES];
+  // band[0 for sum, 1 for count][band]
+  int band[2][32];
+} sao_stats_t;
+
 
 // Offsets of a and b in relation to c.
 // dir_offset[dir][a or b]
@@ -92,7 +106,11 @@ void kvz_sao_reconstruct(const encoder_state_t *state,
                          int width,
                          int height,
                          const sao_info_t *sao,
-                         color_t color);
+                         color_t color,
+                         bool above,
+                         bool below,
+                         bool left,
+                         bool right);
 
 void kvz_sao_search_lcu(const encoder_state_t* const state, int lcu_x, int lcu_y);
 void kvz_calc_sao_offset_array(const encoder_control_t * const encoder, const sao_info_t *sao, int *offset, color_t color_i);
@@ -42,6 +42,7 @@
 #include "inter.h"
 #include "intra.h"
 #include "kvazaar.h"
+#include "ml_inter_cu_depth_pred.h"
 #include "rdo.h"
 #include "search_inter.h"
 #include "search_intra.h"
@@ -152,6 +153,9 @@ static void lcu_fill_cu_info(lcu_t *lcu, int x_local, int y_local, int width, in
         to->skipped   = cu->skipped;
         to->merged    = cu->merged;
         to->merge_idx = cu->merge_idx;
+        to->mv_dir    = cu->mv_dir;
+        to->mv_cand0  = cu->mv_cand0;
+        to->mv_cand1  = cu->mv_cand1;
         to->inter     = cu->inter;
       }
     }
@@ -196,7 +200,7 @@ static void lcu_fill_cbf(lcu_t *lcu, int x_local, int y_local, int width, cu_inf
 
 
 //Calculates cost for all zero coeffs
-static double cu_zero_coeff_cost(const encoder_state_t *state, lcu_t *work_tree, const int x, const int y,
+static rd_cost_t cu_zero_coeff_cost(const encoder_state_t *state, lcu_t *work_tree, const int x, const int y,
   const int depth)
 {
   int x_local = SUB_SCU(x);
@@ -207,20 +211,20 @@ static double cu_zero_coeff_cost(const encoder_state_t *state, lcu_t *work_tree,
   const int luma_index = y_local * LCU_WIDTH + x_local;
   const int chroma_index = (y_local / 2) * LCU_WIDTH_C + (x_local / 2);
 
-  double ssd = 0.0;
-  ssd += KVZ_LUMA_MULT * kvz_pixels_calc_ssd(
+  rd_cost_t ssd = 0;
+  ssd += RD_COST_WDIST(kvz_pixels_calc_ssd(
     &lcu->ref.y[luma_index], &lcu->rec.y[luma_index],
     LCU_WIDTH, LCU_WIDTH, cu_width
-    );
+    ), KVZ_LUMA_MULT);
   if (x % 8 == 0 && y % 8 == 0 && state->encoder_control->chroma_format != KVZ_CSP_400) {
-    ssd += KVZ_CHROMA_MULT * kvz_pixels_calc_ssd(
+    ssd += RD_COST_WDIST(kvz_pixels_calc_ssd(
       &lcu->ref.u[chroma_index], &lcu->rec.u[chroma_index],
       LCU_WIDTH_C, LCU_WIDTH_C, cu_width / 2
-      );
-    ssd += KVZ_CHROMA_MULT * kvz_pixels_calc_ssd(
+      ), KVZ_CHROMA_MULT);
+    ssd += RD_COST_WDIST(kvz_pixels_calc_ssd(
       &lcu->ref.v[chroma_index], &lcu->rec.v[chroma_index],
       LCU_WIDTH_C, LCU_WIDTH_C, cu_width / 2
-      );
+      ), KVZ_CHROMA_MULT);
   }
   // Save the pixels at a lower level of the working tree.
   copy_cu_pixels(x_local, y_local, cu_width, lcu, &work_tree[depth + 1]);
@@ -238,10 +242,10 @@ static double cu_zero_coeff_cost(const encoder_state_t *state, lcu_t *work_tree,
 * Takes into account SSD of reconstruction and the cost of encoding whatever
 * prediction unit data needs to be coded.
 */
-double kvz_cu_rd_cost_luma(const encoder_state_t *const state,
-                           const int x_px, const int y_px, const int depth,
-                           const cu_info_t *const pred_cu,
-                           lcu_t *const lcu)
+rd_cost_t kvz_cu_rd_cost_luma(encoder_state_t *const state,
+                              const int x_px, const int y_px, const int depth,
+                              const cu_info_t *const pred_cu,
+                              lcu_t *const lcu)
 {
   const int width = LCU_WIDTH >> depth;
   const int skip_residual_coding = pred_cu->skipped || (pred_cu->type == CU_INTER && pred_cu->cbf == 0);
@@ -249,8 +253,8 @@ double kvz_cu_rd_cost_luma(const encoder_state_t *const state,
   // cur_cu is used for TU parameters.
   cu_info_t *const tr_cu = LCU_GET_CU_AT_PX(lcu, x_px, y_px);
 
-  double coeff_bits = 0;
-  double tr_tree_bits = 0;
+  rd_bits_t coeff_bits = 0;
+  rd_bits_t tr_tree_bits = 0;
 
   // Check that lcu is not in 
   assert(x_px >= 0 && x_px < LCU_WIDTH);
@@ -281,14 +285,14 @@ double kvz_cu_rd_cost_luma(const encoder_state_t *const state,
 
   if (tr_depth > 0) {
     int offset = width / 2;
-    double sum = 0;
+    rd_cost_t sum = 0;
 
     sum += kvz_cu_rd_cost_luma(state, x_px, y_px, depth + 1, pred_cu, lcu);
     sum += kvz_cu_rd_cost_luma(state, x_px + offset, y_px, depth + 1, pred_cu, lcu);
     sum += kvz_cu_rd_cost_luma(state, x_px, y_px + offset, depth + 1, pred_cu, lcu);
     sum += kvz_cu_rd_cost_luma(state, x_px + offset, y_px + offset, depth + 1, pred_cu, lcu);
 
-    return sum + tr_tree_bits * state->lambda;
+    return sum + RD_COST_BITS(state, tr_tree_bits);
   }
 
 
@@ -340,23 +344,23 @@ double kvz_cu_rd_cost_luma(const encoder_state_t *const state,
       coeff_bits += kvz_get_coeff_cost(state, coeffs, width, 0, luma_scan_mode);
   }
 
-  double bits = tr_tree_bits + coeff_bits;
-  return (double)ssd * KVZ_LUMA_MULT + bits * state->lambda;
+  rd_bits_t bits = tr_tree_bits + coeff_bits;
+  return RD_COST_WDIST(ssd, KVZ_LUMA_MULT) + RD_COST_BITS(state, bits);
 }
 
 
-double kvz_cu_rd_cost_chroma(const encoder_state_t *const state,
-                             const int x_px, const int y_px, const int depth,
-                             const cu_info_t *const pred_cu,
-                             lcu_t *const lcu)
+rd_cost_t kvz_cu_rd_cost_chroma(encoder_state_t *const state,
+                                const int x_px, const int y_px, const int depth,
+                                const cu_info_t *const pred_cu,
+                                lcu_t *const lcu)
 {
   const vector2d_t lcu_px = { x_px / 2, y_px / 2 };
   const int width = (depth <= MAX_DEPTH) ? LCU_WIDTH >> (depth + 1) : LCU_WIDTH >> depth;
   cu_info_t *const tr_cu = LCU_GET_CU_AT_PX(lcu, x_px, y_px);
   const int skip_residual_coding = pred_cu->skipped || (pred_cu->type == CU_INTER && pred_cu->cbf == 0);
 
-  double tr_tree_bits = 0;
-  double coeff_bits = 0;
+  rd_bits_t tr_tree_bits = 0;
+  rd_bits_t coeff_bits = 0;
 
   assert(x_px >= 0 && x_px < LCU_WIDTH);
   assert(y_px >= 0 && y_px < LCU_WIDTH);
@@ -385,14 +389,14 @@ double kvz_cu_rd_cost_chroma(const encoder_state_t *const state,
 
   if (tr_cu->tr_depth > depth) {
     int offset = LCU_WIDTH >> (depth + 1);
-    double sum = 0;
+    rd_cost_t sum = 0;
 
     sum += kvz_cu_rd_cost_chroma(state, x_px, y_px, depth + 1, pred_cu, lcu);
     sum += kvz_cu_rd_cost_chroma(state, x_px + offset, y_px, depth + 1, pred_cu, lcu);
     sum += kvz_cu_rd_cost_chroma(state, x_px, y_px + offset, depth + 1, pred_cu, lcu);
     sum += kvz_cu_rd_cost_chroma(state, x_px + offset, y_px + offset, depth + 1, pred_cu, lcu);
 
-    return sum + tr_tree_bits * state->lambda;
+    return sum + RD_COST_BITS(state, tr_tree_bits);
   }
 
   // Chroma SSD
@@ -417,22 +421,22 @@ double kvz_cu_rd_cost_chroma(const encoder_state_t *const state,
     if(v_is_set)coeff_bits += kvz_get_coeff_cost(state, &lcu->coeff.v[index], width, 2, scan_order);
   }
 
-  double bits = tr_tree_bits + coeff_bits;
-  return (double)ssd * KVZ_CHROMA_MULT + bits * state->lambda;
+  rd_bits_t bits = tr_tree_bits + coeff_bits;
+  return RD_COST_WDIST(ssd, KVZ_CHROMA_MULT) + RD_COST_BITS(state, bits);
 }
 
-static double cu_rd_cost_tr_split_accurate(const encoder_state_t* const state,
-                                           const int x_px, const int y_px, const int depth,
-                                           const cu_info_t* const pred_cu,
-                                           lcu_t* const lcu) {
+static rd_cost_t cu_rd_cost_tr_split_accurate(encoder_state_t* const state,
+                                              const int x_px, const int y_px, const int depth,
+                                              const cu_info_t* const pred_cu,
+                                              lcu_t* const lcu) {
   const int width = LCU_WIDTH >> depth;
 
   const int skip_residual_coding = pred_cu->skipped || (pred_cu->type == CU_INTER && pred_cu->cbf == 0);
   // cur_cu is used for TU parameters.
   cu_info_t* const tr_cu = LCU_GET_CU_AT_PX(lcu, x_px, y_px);
 
-  double coeff_bits = 0;
-  double tr_tree_bits = 0;
+  rd_bits_t coeff_bits = 0;
+  rd_bits_t tr_tree_bits = 0;
 
   // Check that lcu is not in 
   assert(x_px >= 0 && x_px < LCU_WIDTH);
@@ -484,13 +488,13 @@ static double cu_rd_cost_tr_split_accurate(const encoder_state_t* const state,
 
   if (tr_depth > 0) {
     int offset = LCU_WIDTH >> (depth + 1);
-    double sum = 0;
+    rd_cost_t sum = 0;
 
     sum += cu_rd_cost_tr_split_accurate(state, x_px, y_px, depth + 1, pred_cu, lcu);
     sum += cu_rd_cost_tr_split_accurate(state, x_px + offset, y_px, depth + 1, pred_cu, lcu);
     sum += cu_rd_cost_tr_split_accurate(state, x_px, y_px + offset, depth + 1, pred_cu, lcu);
     sum += cu_rd_cost_tr_split_accurate(state, x_px + offset, y_px + offset, depth + 1, pred_cu, lcu);
-    return sum + tr_tree_bits * state->lambda;
+    return sum + RD_COST_BITS(state, tr_tree_bits);
   }
   const int cb_flag_y = cbf_is_set(tr_cu->cbf, depth, COLOR_Y) ;
 
@@ -547,13 +551,13 @@ static double cu_rd_cost_tr_split_accurate(const encoder_state_t* const state,
     }
   }
 
-  double bits = tr_tree_bits + coeff_bits;
-  return luma_ssd * KVZ_LUMA_MULT + chroma_ssd * KVZ_CHROMA_MULT + bits * state->lambda;
+  rd_bits_t bits = tr_tree_bits + coeff_bits;
+  return RD_COST_WDIST(luma_ssd, KVZ_LUMA_MULT) + RD_COST_WDIST(chroma_ssd, KVZ_CHROMA_MULT) + RD_COST_BITS(state, bits);
 }
 
 
 // Return estimate of bits used to code prediction mode of cur_cu.
-static double calc_mode_bits(const encoder_state_t *state,
+static rd_bits_t calc_mode_bits(const encoder_state_t *state,
                              const lcu_t *lcu,
                              const cu_info_t * cur_cu,
                              int x, int y)
@@ -570,7 +574,7 @@ static double calc_mode_bits(const encoder_state_t *state,
     kvz_intra_get_dir_luma_predictor(x, y, candidate_modes, cur_cu, left_cu, above_cu);
   }
 
-  double mode_bits = kvz_luma_mode_bits(state, cur_cu->intra.mode, candidate_modes);
+  rd_bits_t mode_bits = kvz_luma_mode_bits(state, cur_cu->intra.mode, candidate_modes);
 
   if (x % 8 == 0 && y % 8 == 0 && state->encoder_control->chroma_format != KVZ_CSP_400) {
     mode_bits += kvz_chroma_mode_bits(state, cur_cu->intra.mode_chroma, cur_cu->intra.mode);
@@ -584,14 +588,14 @@ static double calc_mode_bits(const encoder_state_t *state,
 /**
  * \brief Sort modes and costs to ascending order according to costs.
  */
-void kvz_sort_modes(int8_t *__restrict modes, double *__restrict costs, uint8_t length)
+void kvz_sort_modes(int8_t *__restrict modes, rd_cost_t *__restrict costs, uint8_t length)
 {
   // Length for intra is always between 5 and 23, and is either 21, 17, 9 or 8 about
   // 60% of the time, so there should be no need for anything more complex
   // than insertion sort.
   // Length for merge is 5 or less.
   for (uint8_t i = 1; i < length; ++i) {
-    const double cur_cost = costs[i];
+    const rd_cost_t cur_cost = costs[i];
     const int8_t cur_mode = modes[i];
     uint8_t j = i;
     while (j > 0 && cur_cost < costs[j - 1]) {
@@ -613,7 +617,7 @@ void kvz_sort_keys_by_cost(unit_stats_map_t *__restrict map)
   // Size of sorted arrays is expected to be "small". No need for faster algorithm.
   for (uint8_t i = 1; i < map->size; ++i) {
     const int8_t cur_indx = map->keys[i];
-    const double cur_cost = map->cost[cur_indx];
+    const rd_cost_t cur_cost = map->cost[cur_indx];
     uint8_t j = i;
     while (j > 0 && cur_cost < map->cost[map->keys[j - 1]]) {
       map->keys[j] = map->keys[j - 1];
@@ -642,14 +646,14 @@ static uint8_t get_ctx_cu_split_model(const lcu_t *lcu, int x, int y, int depth)
  * - All the final data for the LCU gets eventually copied to depth 0, which
  *   will be the final output of the recursion.
  */
-static double search_cu(encoder_state_t * const state, int x, int y, int depth, lcu_t *work_tree)
+static rd_cost_t search_cu(encoder_state_t * const state, int x, int y, int depth, lcu_t *work_tree)
 {
   const encoder_control_t* ctrl = state->encoder_control;
   const videoframe_t * const frame = state->tile->frame;
   int cu_width = LCU_WIDTH >> depth;
-  double cost = MAX_DOUBLE;
-  double inter_zero_coeff_cost = MAX_DOUBLE;
-  double inter_bitcost = MAX_INT;
+  rd_cost_t cost = RD_COST_MAX;
+  rd_cost_t inter_zero_coeff_cost = RD_COST_MAX;
+  rd_bits_t inter_bitcost = RD_BITS_MAX;
   cu_info_t *cur_cu;
   cabac_data_t pre_search_cabac;
   memcpy(&pre_search_cabac, &state->search_cabac, sizeof(pre_search_cabac));
@@ -698,9 +702,16 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
   if (x + cu_width <= frame->width &&
       y + cu_width <= frame->height)
   {
+    // CTU rows refreshed by gradual decoding refresh are coded as intra.
+    const int lcu_row = (y + state->tile->offset_y) / LCU_WIDTH;
+    const bool gdr_refresh = WITHIN(lcu_row,
+                                    state->frame->gdr_refresh_first,
+                                    state->frame->gdr_refresh_end - 1);
+
     int cu_width_inter_min = LCU_WIDTH >> pu_depth_inter.max;
     bool can_use_inter =
       state->frame->slicetype != KVZ_SLICE_I &&
+      !gdr_refresh &&
       depth <= MAX_DEPTH &&
       (
         WITHIN(depth, pu_depth_inter.min, pu_depth_inter.max) ||
@@ -712,8 +723,8 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
       );
 
     if (can_use_inter) {
-      double mode_cost;
-      double mode_bitcost;
+      rd_cost_t mode_cost;
+      rd_bits_t mode_bitcost;
       kvz_search_cu_inter(state,
                           x, y,
                           depth,
@@ -759,7 +770,7 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
     // decision after reconstructing the inter frame.
     bool skip_intra = (state->encoder_control->cfg.rdo == 0
                       && cur_cu->type != CU_NOTSET
-                      && cost / (cu_width * cu_width) < INTRA_THRESHOLD)
+                      && RD_COST_TO_DOUBLE(cost) / (cu_width * cu_width) < INTRA_THRESHOLD)
                       || (ctrl->cfg.early_skip && cur_cu->skipped);
 
     int32_t cu_width_intra_min = LCU_WIDTH >> pu_depth_intra.max;
@@ -770,21 +781,21 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
         // otherwise forbid it.
         (x & ~(cu_width_intra_min - 1)) + cu_width_intra_min > frame->width ||
         (y & ~(cu_width_intra_min - 1)) + cu_width_intra_min > frame->height) &&
-      !(state->encoder_control->cfg.force_inter && state->frame->slicetype != KVZ_SLICE_I);
+      !(state->encoder_control->cfg.force_inter && state->frame->slicetype != KVZ_SLICE_I && !gdr_refresh);
 
     if (can_use_intra && !skip_intra) {
       int8_t intra_mode;
-      double intra_cost;
+      rd_cost_t intra_cost;
       kvz_search_cu_intra(state, x, y, depth, lcu,
                           &intra_mode, &intra_cost);
 #ifdef COMPLETE_PRED_MODE_BITS
       // Technically counting these bits would be correct, however counting
       // them universally degrades quality so this block is disabled by default
       if(state->frame->slicetype != KVZ_SLICE_I) {
-        double pred_mode_type_bits = 0;
+        rd_bits_t pred_mode_type_bits = 0;
         CABAC_FBITS_UPDATE(&state->search_cabac, &state->search_cabac.ctx.cu_pred_mode_model, 1, pred_mode_type_bits, "pred_mode_flag");
         CABAC_FBITS_UPDATE(&state->search_cabac, &state->search_cabac.ctx.cu_skip_flag_model[kvz_get_skip_context(x, y, lcu, NULL)], 0, pred_mode_type_bits, "skip_flag");
-        intra_cost += pred_mode_type_bits * state->lambda;
+        intra_cost += RD_COST_BITS(state, pred_mode_type_bits);
       }
 #endif
       if (intra_cost < cost) {
@@ -841,7 +852,7 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
 
         if (ctrl->cfg.zero_coeff_rdo && !ctrl->cfg.lossless && !ctrl->cfg.rdoq_enable) {
           //Calculate cost for zero coeffs
-          inter_zero_coeff_cost = cu_zero_coeff_cost(state, work_tree, x, y, depth) + inter_bitcost * state->lambda;
+          inter_zero_coeff_cost = cu_zero_coeff_cost(state, work_tree, x, y, depth) + RD_COST_BITS(state, inter_bitcost);
 
         }
 
@@ -861,7 +872,7 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
           int skip_ctx = kvz_get_skip_context(x, y, lcu, NULL);
           inter_bitcost = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_skip_flag_model[skip_ctx], 1);
           inter_bitcost += CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.cu_merge_idx_ext_model), cur_cu->merge_idx != 0);
-          inter_bitcost += cur_cu->merge_idx;        
+          inter_bitcost += RD_BITS(cur_cu->merge_idx);
         }
       }
       lcu_fill_inter(lcu, x_local, y_local, cu_width);
@@ -870,7 +881,7 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
   }
 
   if (cur_cu->type == CU_INTRA || cur_cu->type == CU_INTER) {
-    double bits = 0;
+    rd_bits_t bits = 0;
     cabac_data_t* cabac  = &state->search_cabac;
     cabac->update = 1;
 
@@ -891,7 +902,7 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
       bits += calc_mode_bits(state, lcu, cur_cu, x, y);
     }
     
-    cost = bits * state->lambda;
+    cost = RD_COST_BITS(state, bits);
 
     cost += cu_rd_cost_tr_split_accurate(state, x_local, y_local, depth, cur_cu, lcu);
     
@@ -919,6 +930,15 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
     cabac->update = 0;
   } 
 
+  // Gather the features for the inter split classifier now that the best
+  // mode of this depth has been reconstructed.
+  ml_inter_features_t ml_features;
+  const bool use_ml_inter = cur_cu->type == CU_INTER && depth < MAX_DEPTH &&
+    (ctrl->cfg.ml_pu_depth_inter || ctrl->cfg.ml_inter_samples_fn);
+  if (use_ml_inter) {
+    kvz_ml_inter_cu_features(state, lcu, x, y, depth, RD_COST_TO_DOUBLE(cost), &ml_features);
+  }
+
   bool can_split_cu =
     // If the CU is partially outside the frame, we need to split it even
     // if pu_depth_intra and pu_depth_inter would not permit it.
@@ -930,14 +950,14 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
   // Recursively split all the way to max search depth.
   if (can_split_cu) {
     int half_cu = cu_width / 2;
-    double split_cost = 0.0;
+    rd_cost_t split_cost = 0;
     int cbf = cbf_is_set_any(cur_cu->cbf, depth);
     cabac_data_t post_seach_cabac;
     memcpy(&post_seach_cabac, &state->search_cabac, sizeof(post_seach_cabac));
     memcpy(&state->search_cabac, &pre_search_cabac, sizeof(post_seach_cabac));
     state->search_cabac.update = 1;
 
-    double split_bits = 0;
+    rd_bits_t split_bits = 0;
 
     if (depth < MAX_DEPTH) {
       // Add cost of cu_split_flag.
@@ -952,20 +972,30 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
       CABAC_FBITS_UPDATE(&state->search_cabac, ctx, 0, split_bits, "split_search");
     }
     state->search_cabac.update = 0;
-    split_cost += split_bits * state->lambda;
+    split_cost += RD_COST_BITS(state, split_bits);
 
     // If skip mode was selected for the block, skip further search.
     // Skip mode means there's no coefficients in the block, so splitting
     // might not give any better results but takes more time to do.
     // It is ok to interrupt the search as soon as it is known that
     // the split costs at least as much as not splitting.
-    if (cur_cu->type == CU_NOTSET || cbf || state->encoder_control->cfg.cu_split_termination == KVZ_CU_SPLIT_TERMINATION_OFF) {
+    //
+    // The inter classifier can also predict that the split is not worth
+    // searching.
+    const bool ml_terminate = use_ml_inter && ctrl->cfg.ml_pu_depth_inter &&
+      kvz_ml_inter_cu_terminate_split(state, &ml_features, depth);
+    if ((cur_cu->type == CU_NOTSET || cbf || state->encoder_control->cfg.cu_split_termination == KVZ_CU_SPLIT_TERMINATION_OFF) &&
+        !ml_terminate) {
       if (split_cost < cost) split_cost += search_cu(state, x,           y,           depth + 1, work_tree);
       if (split_cost < cost) split_cost += search_cu(state, x + half_cu, y,           depth + 1, work_tree);
       if (split_cost < cost) split_cost += search_cu(state, x,           y + half_cu, depth + 1, work_tree);
       if (split_cost < cost) split_cost += search_cu(state, x + half_cu, y + half_cu, depth + 1, work_tree);
+
+      if (use_ml_inter) {
+        kvz_ml_inter_write_sample(&ml_features, depth, split_cost < cost);
+      }
     } else {
-      split_cost = INT_MAX;
+      split_cost = RD_COST_DIST(INT_MAX);
     }
 
     // If no search is not performed for this depth, try just the best mode
@@ -985,7 +1015,7 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
         memcpy(&temp_cabac, &state->search_cabac, sizeof(temp_cabac));
         memcpy(&state->search_cabac, &pre_search_cabac, sizeof(pre_search_cabac));
         cost = 0;
-        double bits = 0;
+        rd_bits_t bits = 0;
         if (depth < MAX_DEPTH) {
           uint8_t split_model = get_ctx_cu_split_model(lcu, x, y, depth);
           cabac_ctx_t* ctx = &(state->search_cabac.ctx.split_flag_model[split_model]);
@@ -1012,8 +1042,8 @@ static double search_cu(encoder_state_t * const state, int x, int y, int depth,
                            cur_cu->intra.mode, mode_chroma,
                            NULL, lcu);
 
-        double mode_bits = calc_mode_bits(state, lcu, cur_cu, x, y) + bits;
-        cost += mode_bits * state->lambda;
+        rd_bits_t mode_bits = calc_mode_bits(state, lcu, cur_cu, x, y) + bits;
+        cost += RD_COST_BITS(state, mode_bits);
 
         cost += cu_rd_cost_tr_split_accurate(state, x_local, y_local, depth, cur_cu, lcu);
 
@@ -1161,6 +1191,20 @@ static void copy_lcu_to_cu_data(const encoder_state_t * const state, int x_px, i
   // Copy non-reference CUs to picture.
   kvz_cu_array_copy_from_lcu(state->tile->frame->cu_array, x_px, y_px, lcu);
 
+  // Store the motion for TMVP of later pictures.
+  if (state->frame->slicetype != KVZ_SLICE_I) {
+    int32_t ref_pocs[2][16] = { { 0 } };
+    for (int list = 0; list < 2; list++) {
+      for (int i = 0; i < state->frame->ref_LX_size[list]; i++) {
+        ref_pocs[list][i] = state->frame->ref->pocs[state->frame->ref_LX[list][i]];
+      }
+    }
+    kvz_cu_motion_field_copy_from_lcu(state->frame->motion_field,
+                                      x_px + state->tile->offset_x,
+                                      y_px + state->tile->offset_y,
+                                      lcu, ref_pocs);
+  }
+
   // Copy pixels to picture.
   {
     videoframe_t * const pic = state->tile->frame;
@@ -1189,6 +1233,7 @@ void kvz_search_lcu(encoder_state_t * const state, const int x, const int y, con
 {
   memcpy(&state->search_cabac, &state->cabac, sizeof(cabac_data_t));
   state->search_cabac.only_count = 1;
+  memset(state->merge_satd_cache->count, 0, sizeof(state->merge_satd_cache->count));
   assert(x % LCU_WIDTH == 0);
   assert(y % LCU_WIDTH == 0);
 
@@ -1207,11 +1252,16 @@ void kvz_search_lcu(encoder_state_t * const state, const int x, const int y, con
   // for the current lcu
   constraint_t* constr = state->constraint;
   if (constr->ml_intra_depth_ctu) {
-    kvz_lcu_luma_depth_pred(constr->ml_intra_depth_ctu, work_tree[0].ref.y, state->qp);
+    const int lcu_index = x / LCU_WIDTH + state->tile->lcu_offset_x +
+                          (y / LCU_WIDTH + state->tile->lcu_offset_y) *
+                          state->encoder_control->in.width_in_lcu;
+    kvz_lcu_luma_depth_pred(constr->ml_intra_depth_ctu,
+                            &state->frame->ml_intra_sums[lcu_index],
+                            state->qp);
   }
 
   // Start search from depth 0.
-  double cost = search_cu(state, x, y, 0, work_tree);
+  double cost = RD_COST_TO_DOUBLE(search_cu(state, x, y, 0, work_tree));
 
   // Save squared cost for rate control.
   if(state->encoder_control->cfg.rc_algorithm == KVZ_LAMBDA) {
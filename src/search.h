@@ -67,25 +67,25 @@
 typedef struct unit_stats_map_t {
 
   cu_info_t unit[MAX_UNIT_STATS_MAP_SIZE]; //!< list of searched units
-  double    cost[MAX_UNIT_STATS_MAP_SIZE]; //!< list of matching RD costs
-  double    bits[MAX_UNIT_STATS_MAP_SIZE]; //!< list of matching bit costs  
+  rd_cost_t cost[MAX_UNIT_STATS_MAP_SIZE]; //!< list of matching RD costs
+  rd_bits_t bits[MAX_UNIT_STATS_MAP_SIZE]; //!< list of matching bit costs  
   int8_t    keys[MAX_UNIT_STATS_MAP_SIZE]; //!< list of keys (indices) to elements in the other arrays
   int       size;                    //!< number of active elements in the lists
 } unit_stats_map_t;
 
-void kvz_sort_modes(int8_t *__restrict modes, double *__restrict costs, uint8_t length);
+void kvz_sort_modes(int8_t *__restrict modes, rd_cost_t *__restrict costs, uint8_t length);
 void kvz_sort_keys_by_cost(unit_stats_map_t *__restrict map);
 
 void kvz_search_lcu(encoder_state_t *state, int x, int y, const yuv_t *hor_buf, const yuv_t *ver_buf);
 
-double kvz_cu_rd_cost_luma(const encoder_state_t *const state,
-                           const int x_px, const int y_px, const int depth,
-                           const cu_info_t *const pred_cu,
-                           lcu_t *const lcu);
-double kvz_cu_rd_cost_chroma(const encoder_state_t *const state,
-                             const int x_px, const int y_px, const int depth,
-                             const cu_info_t *const pred_cu,
-                             lcu_t *const lcu);
+rd_cost_t kvz_cu_rd_cost_luma(encoder_state_t *const state,
+                              const int x_px, const int y_px, const int depth,
+                              const cu_info_t *const pred_cu,
+                              lcu_t *const lcu);
+rd_cost_t kvz_cu_rd_cost_chroma(encoder_state_t *const state,
+                                const int x_px, const int y_px, const int depth,
+                                const cu_info_t *const pred_cu,
+                                lcu_t *const lcu);
 void kvz_lcu_fill_trdepth(lcu_t *lcu, int x_px, int y_px, int depth, int tr_depth);
 
 void kvz_intra_recon_lcu_luma(encoder_state_t * const state, int x, int y, int depth, int8_t intra_mode, cu_info_t *cur_cu, lcu_t *lcu);
@@ -90,8 +90,11 @@ typedef struct {
 
 /**
  * \return  True if referred block is within current tile.
+ *
+ * \param ref_idx   index of the reference picture in the reference list,
+ *                  only used with adaptive MV range and GDR
  */
-static INLINE bool fracmv_within_tile(const inter_search_info_t *info, int x, int y)
+static INLINE bool fracmv_within_ref(const inter_search_info_t *info, int ref_idx, int x, int y)
 {
   const encoder_control_t *ctrl = info->state->encoder_control;
 
@@ -122,26 +125,69 @@ static INLINE bool fracmv_within_tile(const inter_search_info_t *info, int x, in
       margin += DEBLOCK_DELAY_PX;
     }
 
-    // Coordinates of the top-left corner of the containing LCU.
-    const vector2d_t orig_lcu = {
-      .x = info->origin.x / LCU_WIDTH,
-      .y = info->origin.y / LCU_WIDTH,
-    };
-    // Difference between the coordinates of the LCU containing the
-    // bottom-left corner of the referenced block and the LCU containing
-    // this block.
-    const vector2d_t mv_lcu = {
-      ((info->origin.x + info->width  + margin) * 4 + x) / (LCU_WIDTH << 2) - orig_lcu.x,
-      ((info->origin.y + info->height + margin) * 4 + y) / (LCU_WIDTH << 2) - orig_lcu.y,
-    };
+    const threadqueue_progress_t *progress = ctrl->cfg.adaptive_mv_range ?
+      info->state->frame->ref->progress[ref_idx] : NULL;
+
+    if (progress) {
+      // Check that the LCU containing the bottom-right corner of the
+      // referenced block has been reconstructed. With WPP, everything above
+      // and to the left of it has been reconstructed as well.
+      const videoframe_t *frame = info->state->tile->frame;
+      const vector2d_t br = {
+        (info->origin.x + info->width  + margin) * 4 + x,
+        (info->origin.y + info->height + margin) * 4 + y,
+      };
+      const vector2d_t ref_lcu = {
+        br.x < 0 ? 0 : MIN(frame->width_in_lcu  - 1, br.x / (LCU_WIDTH << 2)),
+        br.y < 0 ? 0 : MIN(frame->height_in_lcu - 1, br.y / (LCU_WIDTH << 2)),
+      };
 
-    if (mv_lcu.y > ctrl->max_inter_ref_lcu.down) {
-      return false;
+      if (kvz_threadqueue_progress_get(progress, ref_lcu.y) <= ref_lcu.x) {
+        return false;
+      }
+
+    } else {
+      // Coordinates of the top-left corner of the containing LCU.
+      const vector2d_t orig_lcu = {
+        .x = info->origin.x / LCU_WIDTH,
+        .y = info->origin.y / LCU_WIDTH,
+      };
+      // Difference between the coordinates of the LCU containing the
+      // bottom-left corner of the referenced block and the LCU containing
+      // this block.
+      const vector2d_t mv_lcu = {
+        ((info->origin.x + info->width  + margin) * 4 + x) / (LCU_WIDTH << 2) - orig_lcu.x,
+        ((info->origin.y + info->height + margin) * 4 + y) / (LCU_WIDTH << 2) - orig_lcu.y,
+      };
+
+      if (mv_lcu.y > ctrl->max_inter_ref_lcu.down) {
+        return false;
+      }
+
+      if (mv_lcu.x + mv_lcu.y >
+          ctrl->max_inter_ref_lcu.down + ctrl->max_inter_ref_lcu.right)
+      {
+        return false;
+      }
     }
+  }
 
-    if (mv_lcu.x + mv_lcu.y >
-        ctrl->max_inter_ref_lcu.down + ctrl->max_inter_ref_lcu.right)
-    {
+  if (ctrl->cfg.gdr_period > 0 &&
+      info->state->frame->num > ctrl->cfg.gdr_period &&
+      info->origin.y + info->state->tile->offset_y <
+        info->state->frame->gdr_refresh_first * LCU_WIDTH)
+  {
+    // Blocks in the refreshed area may only refer to the area refreshed
+    // since the recovery point.
+    int margin = 0;
+    if (is_frac_luma) {
+      margin = 4;
+    } else if (is_frac_chroma) {
+      margin = 2;
+    }
+    const int bottom =
+      (info->origin.y + info->state->tile->offset_y + info->height + margin) * 4 + y;
+    if (bottom > kvz_gdr_ref_height(info->state, ref_idx) * 4) {
       return false;
     }
   }
@@ -179,6 +225,15 @@ static INLINE bool fracmv_within_tile(const inter_search_info_t *info, int x, in
 }
 
 
+/**
+ * \return  True if referred block is within current tile.
+ */
+static INLINE bool fracmv_within_tile(const inter_search_info_t *info, int x, int y)
+{
+  return fracmv_within_ref(info, info->ref_idx, x, y);
+}
+
+
 /**
  * \return  True if referred block is within current tile.
  */
@@ -188,6 +243,28 @@ static INLINE bool intmv_within_tile(const inter_search_info_t *info, int x, int
 }
 
 
+/**
+ * \brief Move an integer MV upwards until it refers to reconstructed pixels.
+ *
+ * Used with adaptive MV range for candidates that point to parts of the
+ * reference picture that are not ready yet. Rows above are further along
+ * in WPP, so moving the vector up is the cheapest way to make it valid.
+ * The same applies to the refreshed area with GDR.
+ *
+ * \return  True if the MV is valid.
+ */
+static bool clip_intmv_to_ref_progress(const inter_search_info_t *info, vector2d_t *mv)
+{
+  for (int dy = 0; dy <= 2 * LCU_WIDTH; dy += 8) {
+    if (intmv_within_tile(info, mv->x, mv->y - dy)) {
+      mv->y -= dy;
+      return true;
+    }
+  }
+  return false;
+}
+
+
 /**
  * \brief Calculate cost for an integer motion vector.
  *
@@ -202,14 +279,14 @@ static INLINE bool intmv_within_tile(const inter_search_info_t *info, int x, int
 static bool check_mv_cost(inter_search_info_t *info,
                           int x,
                           int y,
-                          double *best_cost,
-                          double* best_bits,
+                          rd_cost_t *best_cost,
+                          rd_bits_t* best_bits,
                           vector2d_t *best_mv)
 {
   if (!intmv_within_tile(info, x, y)) return false;
 
-  double bitcost = 0;
-  double cost = kvz_image_calc_sad(
+  rd_bits_t bitcost = 0;
+  rd_cost_t cost = RD_COST_DIST(kvz_image_calc_sad(
       info->pic,
       info->ref,
       info->origin.x,
@@ -219,7 +296,7 @@ static bool check_mv_cost(inter_search_info_t *info,
       info->width,
       info->height,
       info->optimized_sad
-  );
+  ));
 
   if (cost >= *best_cost) return false;
 
@@ -294,8 +371,8 @@ static bool mv_in_merge(const inter_search_info_t *info, vector2d_t mv)
  */
 static void select_starting_point(inter_search_info_t *info,
                                   vector2d_t extra_mv,
-                                  double *best_cost,
-                                  double* best_bits,
+                                  rd_cost_t *best_cost,
+                                  rd_bits_t* best_bits,
                                   vector2d_t *best_mv)
 {
   // Check the 0-vector, so we can ignore all 0-vectors in the merge cand list.
@@ -314,22 +391,31 @@ static void select_starting_point(inter_search_info_t *info,
   for (unsigned i = 0; i < info->num_merge_cand; ++i) {
     if (info->merge_cand[i].dir == 3) continue;
 
-    int x = (info->merge_cand[i].mv[info->merge_cand[i].dir - 1][0] + 2) >> 2;
-    int y = (info->merge_cand[i].mv[info->merge_cand[i].dir - 1][1] + 2) >> 2;
+    vector2d_t mv = {
+      (info->merge_cand[i].mv[info->merge_cand[i].dir - 1][0] + 2) >> 2,
+      (info->merge_cand[i].mv[info->merge_cand[i].dir - 1][1] + 2) >> 2
+    };
 
-    if (x == 0 && y == 0) continue;
+    if (mv.x == 0 && mv.y == 0) continue;
 
-    check_mv_cost(info, x, y, best_cost, best_bits, best_mv);
+    if ((info->state->encoder_control->cfg.adaptive_mv_range ||
+         info->state->encoder_control->cfg.gdr_period) &&
+        !clip_intmv_to_ref_progress(info, &mv))
+    {
+      continue;
+    }
+
+    check_mv_cost(info, mv.x, mv.y, best_cost, best_bits, best_mv);
   }
 }
 
 
-static double get_mvd_coding_cost(const encoder_state_t* state,
+static rd_bits_t get_mvd_coding_cost(const encoder_state_t* state,
   const cabac_data_t* cabac,
   const int32_t mvd_hor,
   const int32_t mvd_ver)
 {
-  double bitcost = 4 << CTX_FRAC_BITS;
+  uint32_t bitcost = 4 << CTX_FRAC_BITS;
   const vector2d_t abs_mvd = { abs(mvd_hor), abs(mvd_ver) };
   bitcost += abs_mvd.x == 1 ? 1 << CTX_FRAC_BITS : (0 * (1 << CTX_FRAC_BITS));
   bitcost += abs_mvd.y == 1 ? 1 << CTX_FRAC_BITS : (0 * (1 << CTX_FRAC_BITS));
@@ -338,7 +424,7 @@ static double get_mvd_coding_cost(const encoder_state_t* state,
   bitcost += get_ep_ex_golomb_bitcost(abs_mvd.y) << CTX_FRAC_BITS;
 
   // Round and shift back to integer bits.
-  return bitcost / (1 << CTX_FRAC_BITS);
+  return RD_BITS(bitcost >> CTX_FRAC_BITS);
 }
 
 
@@ -346,7 +432,7 @@ static int select_mv_cand(const encoder_state_t *state,
                           int16_t mv_cand[2][2],
                           int32_t mv_x,
                           int32_t mv_y,
-                          double*cost_out)
+                          rd_bits_t *cost_out)
 {
   const bool same_cand =
     (mv_cand[0][0] == mv_cand[1][0] && mv_cand[0][1] == mv_cand[1][1]);
@@ -356,7 +442,7 @@ static int select_mv_cand(const encoder_state_t *state,
     return 0;
   }
 
-  double (*mvd_coding_cost)(const encoder_state_t * const state,
+  rd_bits_t (*mvd_coding_cost)(const encoder_state_t * const state,
                               const cabac_data_t*,
                               int32_t, int32_t);
   if (state->encoder_control->cfg.mv_rdo) {
@@ -365,12 +451,12 @@ static int select_mv_cand(const encoder_state_t *state,
     mvd_coding_cost = get_mvd_coding_cost;
   }
 
-  double cand1_cost = mvd_coding_cost(
+  rd_bits_t cand1_cost = mvd_coding_cost(
       state, &state->cabac,
       mv_x - mv_cand[0][0],
       mv_y - mv_cand[0][1]);
 
-  double cand2_cost;
+  rd_bits_t cand2_cost;
   if (same_cand) {
     cand2_cost = cand1_cost;
   } else {
@@ -389,7 +475,7 @@ static int select_mv_cand(const encoder_state_t *state,
 }
 
 
-static double calc_mvd_cost(const encoder_state_t *state,
+static rd_cost_t calc_mvd_cost(const encoder_state_t *state,
                             int x,
                             int y,
                             int mv_shift,
@@ -397,9 +483,9 @@ static double calc_mvd_cost(const encoder_state_t *state,
                             inter_merge_cand_t merge_cand[MRG_MAX_NUM_CANDS],
                             int16_t num_cand,
                             int32_t ref_idx,
-                            double* bitcost)
+                            rd_bits_t* bitcost)
 {
-  double temp_bitcost = 0;
+  rd_bits_t temp_bitcost = 0;
   uint32_t merge_idx;
   int8_t merged      = 0;
 
@@ -414,7 +500,7 @@ static double calc_mvd_cost(const encoder_state_t *state,
         state->frame->ref_LX[merge_cand[merge_idx].dir - 1][
           merge_cand[merge_idx].ref[merge_cand[merge_idx].dir - 1]
         ] == ref_idx) {
-      temp_bitcost += merge_idx;
+      temp_bitcost += RD_BITS(merge_idx);
       merged = 1;
       break;
     }
@@ -422,18 +508,18 @@ static double calc_mvd_cost(const encoder_state_t *state,
 
   // Check mvd cost only if mv is not merged
   if (!merged) {
-    double mvd_cost = 0;
+    rd_bits_t mvd_cost = 0;
     select_mv_cand(state, mv_cand, x, y, &mvd_cost);
     temp_bitcost += mvd_cost;
   }
   *bitcost = temp_bitcost;
-  return temp_bitcost * state->lambda_sqrt;
+  return RD_COST_BITS_SQRT(state, temp_bitcost);
 }
 
 
 static bool early_terminate(inter_search_info_t *info,
-                            double *best_cost,
-                            double* best_bits,
+                            rd_cost_t *best_cost,
+                            rd_bits_t* best_bits,
                             vector2d_t *best_mv)
 {
   static const vector2d_t small_hexbs[7] = {
@@ -447,11 +533,11 @@ static bool early_terminate(inter_search_info_t *info,
   int last_index = 3;
 
   for (int k = 0; k < 2; ++k) {
-    double threshold;
+    rd_cost_t threshold;
     if (info->state->encoder_control->cfg.me_early_termination ==
         KVZ_ME_EARLY_TERMINATION_SENSITIVE)
     {
-      threshold = *best_cost * 0.95;
+      threshold = RD_COST_SCALE(*best_cost, 19, 20);
     } else {
       threshold = *best_cost;
     }
@@ -487,8 +573,8 @@ void kvz_tz_pattern_search(inter_search_info_t *info,
                            const int iDist,
                            vector2d_t mv,
                            int *best_dist,
-                           double *best_cost,
-                           double* best_bits,
+                           rd_cost_t *best_cost,
+                           rd_bits_t* best_bits,
                            vector2d_t *best_mv)
 {
   assert(pattern_type < 4);
@@ -605,8 +691,8 @@ void kvz_tz_pattern_search(inter_search_info_t *info,
 void kvz_tz_raster_search(inter_search_info_t *info,
                           int iSearchRange,
                           int iRaster,
-                          double *best_cost,
-                          double* best_bits,
+                          rd_cost_t *best_cost,
+                          rd_bits_t* best_bits,
                           vector2d_t *best_mv)
 {
   const vector2d_t mv = { best_mv->x >> 2, best_mv->y >> 2 };
@@ -622,8 +708,8 @@ void kvz_tz_raster_search(inter_search_info_t *info,
 
 static void tz_search(inter_search_info_t *info,
                       vector2d_t extra_mv,
-                      double *best_cost,
-                      double* best_bits,
+                      rd_cost_t *best_cost,
+                      rd_bits_t* best_bits,
                       vector2d_t *best_mv)
 {
   //TZ parameters
@@ -710,8 +796,8 @@ static void tz_search(inter_search_info_t *info,
 static void hexagon_search(inter_search_info_t *info,
                            vector2d_t extra_mv,
                            uint32_t steps,
-                           double *best_cost,
-                           double* best_bits,
+                           rd_cost_t *best_cost,
+                           rd_bits_t* best_bits,
                            vector2d_t *best_mv)
 {
   // The start of the hexagonal pattern has been repeated at the end so that
@@ -808,8 +894,8 @@ static void hexagon_search(inter_search_info_t *info,
 static void diamond_search(inter_search_info_t *info,
                            vector2d_t extra_mv,
                            uint32_t steps,
-                           double *best_cost,
-                           double* best_bits,
+                           rd_cost_t *best_cost,
+                           rd_bits_t* best_bits,
                            vector2d_t *best_mv)
 {
   enum diapos {
@@ -890,8 +976,8 @@ static void diamond_search(inter_search_info_t *info,
 static void search_mv_full(inter_search_info_t *info,
                            int32_t search_range,
                            vector2d_t extra_mv,
-                           double *best_cost,
-                           double* best_bits,
+                           rd_cost_t *best_cost,
+                           rd_bits_t* best_bits,
                            vector2d_t *best_mv)
 {
   // Search around the 0-vector.
@@ -970,8 +1056,8 @@ static void search_mv_full(inter_search_info_t *info,
  * refines the search by searching best 1/4-pel postion around best 1/2-pel position.
  */
 static void search_frac(inter_search_info_t *info,
-                        double *best_cost,
-                        double *best_bits,
+                        rd_cost_t *best_cost,
+                        rd_bits_t *best_bits,
                         vector2d_t *best_mv)
 {
   // Map indexes to relative coordinates in the following way:
@@ -987,13 +1073,14 @@ static void search_frac(inter_search_info_t *info,
   // Set mv to pixel precision
   vector2d_t mv = { best_mv->x >> 2, best_mv->y >> 2 };
 
-  double cost = MAX_DOUBLE;
-  double bitcost = 0;
-  double bitcosts[4] = { 0 };
+  rd_cost_t cost = RD_COST_MAX;
+  rd_bits_t bitcost = 0;
+  rd_bits_t bitcosts[4] = { 0 };
+  rd_cost_t costs[4] = { 0 };
   unsigned best_index = 0;
 
 // Keep this as unsigned until SAD / SATD functions are updated
-  unsigned costs[4] = { 0 };
+  unsigned satd_costs[4] = { 0 };
 
   ALIGNED(64) kvz_pixel filtered[4][LCU_LUMA_SIZE];
 
@@ -1051,17 +1138,18 @@ static void search_frac(inter_search_info_t *info,
   int tmp_stride = pic->stride;
                   
   // Search integer position
-  costs[0] = kvz_satd_any_size(width, height,
+  satd_costs[0] = kvz_satd_any_size(width, height,
     tmp_pic, tmp_stride,
     ext_origin + ext_s + 1, ext_s);
 
-  costs[0] += info->mvd_cost_func(state,
-                                  mv.x, mv.y, 2,
-                                  info->mv_cand,
-                                  NULL,
-                                  0,
-                                  info->ref_idx,
-                                  &bitcosts[0]);
+  costs[0] = RD_COST_TRUNC(RD_COST_DIST(satd_costs[0]) +
+                           info->mvd_cost_func(state,
+                                               mv.x, mv.y, 2,
+                                               info->mv_cand,
+                                               NULL,
+                                               0,
+                                               info->ref_idx,
+                                               &bitcosts[0]));
   cost = costs[0];
   bitcost = bitcosts[0];
   
@@ -1108,11 +1196,11 @@ static void search_frac(inter_search_info_t *info,
     filtered_pos[2] = &filtered[2][0];
     filtered_pos[3] = &filtered[3][0];
 
-    kvz_satd_any_size_quad(width, height, (const kvz_pixel **)filtered_pos, LCU_WIDTH, tmp_pic, tmp_stride, 4, costs, within_tile);
+    kvz_satd_any_size_quad(width, height, (const kvz_pixel **)filtered_pos, LCU_WIDTH, tmp_pic, tmp_stride, 4, satd_costs, within_tile);
 
     for (int j = 0; j < 4; j++) {
       if (within_tile[j]) {
-        costs[j] += info->mvd_cost_func(
+        costs[j] = RD_COST_TRUNC(RD_COST_DIST(satd_costs[j]) + info->mvd_cost_func(
             state,
             mv.x + pattern[j]->x,
             mv.y + pattern[j]->y,
@@ -1122,7 +1210,7 @@ static void search_frac(inter_search_info_t *info,
             0,
             info->ref_idx,
             &bitcosts[j]
-        );
+        ));
       }
     }
 
@@ -1278,16 +1366,16 @@ static void search_pu_inter_ref(inter_search_info_t *info,
   // no point to this anymore, but for now it helps.
   const int mid_x = info->state->tile->offset_x + info->origin.x + (info->width >> 1);
   const int mid_y = info->state->tile->offset_y + info->origin.y + (info->height >> 1);
-  const cu_array_t* ref_array = info->state->frame->ref->cu_arrays[info->ref_idx];
-  const cu_info_t* ref_cu = kvz_cu_array_at_const(ref_array, mid_x, mid_y);
-  if (ref_cu->type == CU_INTER) {
+  const cu_motion_field_t *ref_motion = info->state->frame->ref->motion_fields[info->ref_idx];
+  const cu_motion_t *ref_cu = kvz_cu_motion_field_at(ref_motion, mid_x, mid_y);
+  if (ref_cu->mv_dir) {
     vector2d_t mv_previous = { 0, 0 };
-    if (ref_cu->inter.mv_dir & 1) {
-      mv_previous.x = ref_cu->inter.mv[0][0];
-      mv_previous.y = ref_cu->inter.mv[0][1];
+    if (ref_cu->mv_dir & 1) {
+      mv_previous.x = ref_cu->mv[0][0];
+      mv_previous.y = ref_cu->mv[0][1];
     } else {
-      mv_previous.x = ref_cu->inter.mv[1][0];
-      mv_previous.y = ref_cu->inter.mv[1][1];
+      mv_previous.x = ref_cu->mv[1][0];
+      mv_previous.y = ref_cu->mv[1][1];
     }
     // Apply mv scaling if neighbor poc is available
     if (info->state->frame->ref_LX_size[ref_list] > 0) {
@@ -1304,7 +1392,7 @@ static void search_pu_inter_ref(inter_search_info_t *info,
           break;
         }
       }
-      if ((ref_cu->inter.mv_dir & (col_list + 1)) == 0) {
+      if ((ref_cu->mv_dir & (col_list + 1)) == 0) {
         // Use the other list if the colocated PU does not have a MV for the
         // primary list.
         col_list = 1 - col_list;
@@ -1316,11 +1404,7 @@ static void search_pu_inter_ref(inter_search_info_t *info,
         info->state->frame->poc,
         info->state->frame->ref->pocs[info->state->frame->ref_LX[ref_list][LX_idx]],
         info->state->frame->ref->pocs[neighbor_poc_index],
-        info->state->frame->ref->images[neighbor_poc_index]->ref_pocs[
-          info->state->frame->ref->ref_LXs[neighbor_poc_index]
-            [col_list]
-          [ref_cu->inter.mv_ref[col_list]]
-        ],
+        ref_cu->ref_poc[col_list],
         &mv_previous
           );
     }
@@ -1328,6 +1412,12 @@ static void search_pu_inter_ref(inter_search_info_t *info,
     // Check if the mv is valid after scaling
     if (fracmv_within_tile(info, mv_previous.x, mv_previous.y)) {
       best_mv = mv_previous;
+    } else if (cfg->adaptive_mv_range || cfg->gdr_period) {
+      vector2d_t mv_int = { mv_previous.x >> 2, mv_previous.y >> 2 };
+      if (clip_intmv_to_ref_progress(info, &mv_int)) {
+        best_mv.x = mv_int.x * 4;
+        best_mv.y = mv_int.y * 4;
+      }
     }
   }
 
@@ -1340,8 +1430,8 @@ static void search_pu_inter_ref(inter_search_info_t *info,
     default: break;
   }
 
-  double best_cost = MAX_DOUBLE;
-  double best_bits = MAX_INT;
+  rd_cost_t best_cost = RD_COST_MAX;
+  rd_bits_t best_bits = RD_BITS_MAX;
 
   // Select starting point from among merge candidates. These should
   // include both mv_cand vectors and (0, 0).
@@ -1375,9 +1465,9 @@ static void search_pu_inter_ref(inter_search_info_t *info,
     }
   }
 
-  if (cfg->fme_level == 0 && best_cost < MAX_DOUBLE) {
+  if (cfg->fme_level == 0 && best_cost < RD_COST_MAX) {
     // Recalculate inter cost with SATD.
-    best_cost = kvz_image_calc_satd(
+    best_cost = RD_COST_DIST(kvz_image_calc_satd(
       info->state->tile->frame->source,
       info->ref,
       info->origin.x,
@@ -1385,12 +1475,12 @@ static void search_pu_inter_ref(inter_search_info_t *info,
       info->state->tile->offset_x + info->origin.x + (best_mv.x >> 2),
       info->state->tile->offset_y + info->origin.y + (best_mv.y >> 2),
       info->width,
-      info->height);
-    best_cost += best_bits * info->state->lambda_sqrt;
+      info->height));
+    best_cost += RD_COST_BITS_SQRT(info->state, best_bits);
   }
 
-  double LX_cost[2] = { best_cost, best_cost };
-  double LX_bits[2] = { best_bits, best_bits };
+  rd_cost_t LX_cost[2] = { best_cost, best_cost };
+  rd_bits_t LX_bits[2] = { best_bits, best_bits };
 
   // Compute costs and add entries for both lists, if necessary
   for (; ref_list < 2 && ref_list_active[ref_list]; ++ref_list) {
@@ -1399,12 +1489,12 @@ static void search_pu_inter_ref(inter_search_info_t *info,
     uint8_t mv_ref_coded = LX_idx;
     int cu_mv_cand = select_mv_cand(info->state, info->mv_cand, best_mv.x, best_mv.y, NULL);
     const int extra_bits = ref_list + mv_ref_coded; // TODO: check if mv_dir bits are missing
-    LX_cost[ref_list] += extra_bits * info->state->lambda_sqrt;
-    LX_bits[ref_list] += extra_bits;
+    LX_cost[ref_list] += RD_COST_BITS_SQRT(info->state, RD_BITS(extra_bits));
+    LX_bits[ref_list] += RD_BITS(extra_bits);
 
     // Update best unipreds for biprediction
     bool valid_mv = fracmv_within_tile(info, best_mv.x, best_mv.y);
-    if (valid_mv && best_cost < MAX_DOUBLE) {
+    if (valid_mv && best_cost < RD_COST_MAX) {
 
       // Map reference index to L0/L1 pictures
       unit_stats_map_t *cur_map = &amvp[ref_list];
@@ -1414,7 +1504,7 @@ static void search_pu_inter_ref(inter_search_info_t *info,
       unipred_pu->type = CU_INTER;
       unipred_pu->merged  = false;
       unipred_pu->skipped = false;
-      unipred_pu->inter.mv_dir = ref_list + 1;
+      unipred_pu->mv_dir = ref_list + 1;
       unipred_pu->inter.mv_ref[ref_list] = LX_idx;
       unipred_pu->inter.mv[ref_list][0] = (int16_t)best_mv.x;
       unipred_pu->inter.mv[ref_list][1] = (int16_t)best_mv.y;
@@ -1429,6 +1519,183 @@ static void search_pu_inter_ref(inter_search_info_t *info,
 }
 
 
+/**
+ * \brief Get the luma prediction of the current PU from one reference.
+ *
+ * The prediction is interpolated only if it is not in the unipred cache.
+ *
+ * \param ref_idx  index of the reference picture in the reference list
+ * \param keep     entry that must not be replaced, or NULL
+ */
+static const unipred_cache_entry_t *get_unipred(const inter_search_info_t *info,
+                                                int32_t ref_idx,
+                                                const int16_t mv[2],
+                                                const unipred_cache_entry_t *keep)
+{
+  unipred_cache_t *cache = info->state->unipred_cache;
+
+  for (int i = 0; i < cache->count; ++i) {
+    unipred_cache_entry_t *entry = &cache->entries[i];
+    if (entry->ref_idx == ref_idx && entry->mv[0] == mv[0] && entry->mv[1] == mv[1]) {
+      return entry;
+    }
+  }
+
+  if (&cache->entries[cache->next] == keep) {
+    cache->next = (cache->next + 1) % UNIPRED_CACHE_SIZE;
+  }
+  unipred_cache_entry_t *entry = &cache->entries[cache->next];
+  cache->next  = (cache->next + 1) % UNIPRED_CACHE_SIZE;
+  cache->count = MIN(cache->count + 1, UNIPRED_CACHE_SIZE);
+
+  entry->ref_idx  = ref_idx;
+  entry->mv[0]    = mv[0];
+  entry->mv[1]    = mv[1];
+  entry->im_flags = kvz_inter_pred_unipred_luma(info->state,
+                                                info->state->frame->ref->images[ref_idx],
+                                                info->origin.x, info->origin.y,
+                                                info->width, info->height,
+                                                mv,
+                                                (kvz_pixel *)entry->buf,
+                                                entry->buf);
+  return entry;
+}
+
+
+/**
+ * \brief Calculate the SATD of the average of two unipred predictions.
+ *
+ * The average is written to lcu->rec.
+ */
+static uint32_t bipred_satd(const inter_search_info_t *info,
+                            lcu_t *lcu,
+                            const unipred_cache_entry_t *pred_L0,
+                            const unipred_cache_entry_t *pred_L1)
+{
+  const int x      = info->origin.x;
+  const int y      = info->origin.y;
+  const int width  = info->width;
+  const int height = info->height;
+
+  yuv_t px_L0 = { width * height, (kvz_pixel *)pred_L0->buf, NULL, NULL };
+  yuv_t px_L1 = { width * height, (kvz_pixel *)pred_L1->buf, NULL, NULL };
+  yuv_im_t im_L0 = { width * height, (kvz_pixel_im *)pred_L0->buf, NULL, NULL };
+  yuv_im_t im_L1 = { width * height, (kvz_pixel_im *)pred_L1->buf, NULL, NULL };
+
+  kvz_bipred_average(lcu, &px_L0, &px_L1, &im_L0, &im_L1,
+                     x, y, width, height,
+                     pred_L0->im_flags, pred_L1->im_flags,
+                     true, false);
+
+  const kvz_pixel *rec = &lcu->rec.y[SUB_SCU(y) * LCU_WIDTH + SUB_SCU(x)];
+  const kvz_pixel *src = &lcu->ref.y[SUB_SCU(y) * LCU_WIDTH + SUB_SCU(x)];
+  return kvz_satd_any_size(width, height, rec, LCU_WIDTH, src, LCU_WIDTH);
+}
+
+
+/**
+ * \brief Refine the motion vectors of a bipred PU one list at a time.
+ *
+ * The vector of one list is moved to the best of its eight neighbours at
+ * full, half and quarter pixel steps while the prediction from the other
+ * list is kept fixed. This is repeated cfg.bipred_refine times or until
+ * neither vector changes.
+ *
+ * The MV candidates of the PU are selected and the cost and bits are
+ * recalculated with the candidates of each list.
+ */
+static void refine_bipred(inter_search_info_t *info,
+                          lcu_t *lcu,
+                          cu_info_t *bipred_pu,
+                          rd_cost_t *cost_out,
+                          rd_bits_t *bits_out)
+{
+  static const int8_t neighbours[8][2] = {
+    { -1, -1 }, { 0, -1 }, { 1, -1 },
+    { -1,  0 },            { 1,  0 },
+    { -1,  1 }, { 0,  1 }, { 1,  1 },
+  };
+
+  encoder_state_t *state = info->state;
+  uint8_t (*ref_LX)[16] = state->frame->ref_LX;
+  int16_t (*mv)[2] = bipred_pu->inter.mv;
+
+  const int32_t ref_idx[2] = {
+    ref_LX[0][bipred_pu->inter.mv_ref[0]],
+    ref_LX[1][bipred_pu->inter.mv_ref[1]],
+  };
+  const rd_bits_t extra_bits =
+    RD_BITS(bipred_pu->inter.mv_ref[0] + bipred_pu->inter.mv_ref[1] + 2 /* mv dir cost */);
+  const rd_cost_t extra_cost = RD_COST_BITS_SQRT(state, extra_bits);
+
+  int16_t mv_cand[2][2][2];
+  rd_cost_t mv_cost[2];
+  rd_bits_t mv_bits[2];
+  for (int list = 0; list < 2; list++) {
+    kvz_inter_get_mv_cand(state, info->origin.x, info->origin.y, info->width, info->height,
+                          mv_cand[list], bipred_pu, lcu, list);
+    mv_cost[list] = info->mvd_cost_func(state, mv[list][0], mv[list][1], 0,
+                                        mv_cand[list], NULL, 0, 0, &mv_bits[list]);
+  }
+
+  const unipred_cache_entry_t *pred_L0 = get_unipred(info, ref_idx[0], mv[0], NULL);
+  const unipred_cache_entry_t *pred_L1 = get_unipred(info, ref_idx[1], mv[1], pred_L0);
+  rd_cost_t best_cost = RD_COST_DIST(bipred_satd(info, lcu, pred_L0, pred_L1)) +
+                        mv_cost[0] + mv_cost[1] + extra_cost;
+
+  for (int iter = 0; iter < state->encoder_control->cfg.bipred_refine; iter++) {
+    bool changed = false;
+
+    for (int list = 0; list < 2; list++) {
+      const unipred_cache_entry_t *fixed = get_unipred(info, ref_idx[!list], mv[!list], NULL);
+      const rd_cost_t fixed_cost = mv_cost[!list] + extra_cost;
+
+      for (int step = 4; step > 0; step >>= 1) {
+        const int16_t center[2] = { mv[list][0], mv[list][1] };
+
+        for (int i = 0; i < 8; i++) {
+          const int16_t cand[2] = {
+            center[0] + neighbours[i][0] * step,
+            center[1] + neighbours[i][1] * step,
+          };
+          if (!fracmv_within_ref(info, ref_idx[list], cand[0], cand[1])) continue;
+
+          rd_bits_t cand_bits = 0;
+          const rd_cost_t cand_mv_cost = info->mvd_cost_func(state, cand[0], cand[1], 0,
+                                                             mv_cand[list], NULL, 0, 0,
+                                                             &cand_bits);
+          if (cand_mv_cost + fixed_cost >= best_cost) continue;
+
+          const unipred_cache_entry_t *pred = get_unipred(info, ref_idx[list], cand, fixed);
+          const uint32_t satd = list == 0 ? bipred_satd(info, lcu, pred, fixed)
+                                          : bipred_satd(info, lcu, fixed, pred);
+          const rd_cost_t cost = RD_COST_DIST(satd) + cand_mv_cost + fixed_cost;
+
+          if (cost < best_cost) {
+            best_cost = cost;
+            mv[list][0] = cand[0];
+            mv[list][1] = cand[1];
+            mv_cost[list] = cand_mv_cost;
+            mv_bits[list] = cand_bits;
+            changed = true;
+          }
+        }
+      }
+    }
+
+    if (!changed) break;
+  }
+
+  for (int list = 0; list < 2; list++) {
+    int cu_mv_cand = select_mv_cand(state, mv_cand[list], mv[list][0], mv[list][1], NULL);
+    CU_SET_MV_CAND(bipred_pu, list, cu_mv_cand);
+  }
+
+  *cost_out = best_cost;
+  *bits_out = mv_bits[0] + mv_bits[1] + extra_bits;
+}
+
+
 /**
  * \brief Search bipred modes for a PU.
  */
@@ -1437,9 +1704,7 @@ static void search_pu_inter_bipred(inter_search_info_t *info,
                                    lcu_t *lcu,
                                    unit_stats_map_t *amvp_bipred)
 {
-  const image_list_t *const ref = info->state->frame->ref;
   uint8_t (*ref_LX)[16] = info->state->frame->ref_LX;
-  const videoframe_t * const frame = info->state->tile->frame;
   const int x         = info->origin.x;
   const int y         = info->origin.y;
   const int width     = info->width;
@@ -1470,7 +1735,7 @@ static void search_pu_inter_bipred(inter_search_info_t *info,
     cu_info_t *bipred_pu = &amvp_bipred->unit[amvp_bipred->size];
     *bipred_pu = *LCU_GET_CU_AT_PX(lcu, SUB_SCU(x), SUB_SCU(y));
 
-    bipred_pu->inter.mv_dir = 3;
+    bipred_pu->mv_dir = 3;
 
     bipred_pu->inter.mv_ref[0] = merge_cand[i].ref[0];
     bipred_pu->inter.mv_ref[1] = merge_cand[j].ref[1];
@@ -1489,29 +1754,19 @@ static void search_pu_inter_bipred(inter_search_info_t *info,
     }
 
     // Don't try merge candidates that don't satisfy mv constraints.
-    if (!fracmv_within_tile(info, mv[0][0], mv[0][1]) ||
-        !fracmv_within_tile(info, mv[1][0], mv[1][1]))
+    if (!fracmv_within_ref(info, ref_LX[0][merge_cand[i].ref[0]], mv[0][0], mv[0][1]) ||
+        !fracmv_within_ref(info, ref_LX[1][merge_cand[j].ref[1]], mv[1][0], mv[1][1]))
     {
       continue;
     }
 
-    kvz_inter_recon_bipred(info->state,
-                           ref->images[ref_LX[0][merge_cand[i].ref[0]]],
-                           ref->images[ref_LX[1][merge_cand[j].ref[1]]],
-                           x, y,
-                           width,
-                           height,
-                           mv,
-                           lcu,
-                           true,
-                           false);
-
-    const kvz_pixel *rec = &lcu->rec.y[SUB_SCU(y) * LCU_WIDTH + SUB_SCU(x)];
-    const kvz_pixel *src = &frame->source->y[x + y * frame->source->width];
-    double cost =
-      kvz_satd_any_size(width, height, rec, LCU_WIDTH, src, frame->source->width);
+    const unipred_cache_entry_t *pred_L0 =
+      get_unipred(info, ref_LX[0][merge_cand[i].ref[0]], mv[0], NULL);
+    const unipred_cache_entry_t *pred_L1 =
+      get_unipred(info, ref_LX[1][merge_cand[j].ref[1]], mv[1], pred_L0);
+    rd_cost_t cost = RD_COST_DIST(bipred_satd(info, lcu, pred_L0, pred_L1));
 
-    double bitcost[2] = { 0, 0 };
+    rd_bits_t bitcost[2] = { 0, 0 };
 
     cost += info->mvd_cost_func(info->state,
                                merge_cand[i].mv[0][0],
@@ -1533,7 +1788,7 @@ static void search_pu_inter_bipred(inter_search_info_t *info,
       merge_cand[j].ref[1]
     };
     const int extra_bits = mv_ref_coded[0] + mv_ref_coded[1] + 2 /* mv dir cost */;
-    cost += info->state->lambda_sqrt * extra_bits;
+    cost += RD_COST_BITS_SQRT(info->state, RD_BITS(extra_bits));
 
     // Each motion vector has its own candidate
     for (int reflist = 0; reflist < 2; reflist++) {
@@ -1549,7 +1804,7 @@ static void search_pu_inter_bipred(inter_search_info_t *info,
     bipred_pu->type = CU_INTER;
 
     amvp_bipred->cost[amvp_bipred->size] = cost;
-    amvp_bipred->bits[amvp_bipred->size] = bitcost[0] + bitcost[1] + extra_bits;
+    amvp_bipred->bits[amvp_bipred->size] = bitcost[0] + bitcost[1] + RD_BITS(extra_bits);
     amvp_bipred->keys[amvp_bipred->size] = amvp_bipred->size;
     amvp_bipred->size++;
   }
@@ -1586,6 +1841,123 @@ static bool merge_candidate_in_list(inter_merge_cand_t *all_cands,
   return found;
 }
 
+/**
+ * \brief Calculate the luma SATD of a merge candidate.
+ *
+ * Uses the costs cached for the 8x8 blocks of the PU when possible. Integer
+ * uniprediction candidates are compared to the reference picture directly
+ * without motion compensation.
+ *
+ * \param cur_pu   PU with the motion of the candidate
+ *
+ * \return SATD of the PU
+ */
+static uint32_t merge_cand_satd(const inter_search_info_t *info,
+                                lcu_t *lcu,
+                                int x_cu, int y_cu, int width_cu,
+                                int i_pu,
+                                const cu_info_t *cur_pu)
+{
+  const encoder_state_t *state = info->state;
+  merge_satd_cache_t *cache = state->merge_satd_cache;
+  const int x_local = SUB_SCU(info->origin.x);
+  const int y_local = SUB_SCU(info->origin.y);
+  const int width = info->width;
+  const int height = info->height;
+  const kvz_pixel *src = lcu->ref.y + y_local * LCU_WIDTH + x_local;
+
+  merge_satd_entry_t key;
+  FILL(key, 0);
+  key.dir = cur_pu->mv_dir;
+  for (int list = 0; list < 2; ++list) {
+    if (key.dir & (1 << list)) {
+      key.ref[list] = cur_pu->inter.mv_ref[list];
+      key.mv[list][0] = cur_pu->inter.mv[list][0];
+      key.mv[list][1] = cur_pu->inter.mv[list][1];
+    }
+  }
+
+  // With higher bit depths the sum is rounded as a whole, so the costs of
+  // the blocks can't be summed.
+  const bool cacheable = KVZ_BIT_DEPTH == 8 &&
+                         width % 8 == 0 && height % 8 == 0 &&
+                         x_local % 8 == 0 && y_local % 8 == 0;
+  const int blocks_w = width / 8;
+  const int blocks_h = height / 8;
+
+  if (cacheable) {
+    uint32_t satd = 0;
+    bool found_all = true;
+    for (int by = 0; by < blocks_h && found_all; ++by) {
+      for (int bx = 0; bx < blocks_w && found_all; ++bx) {
+        const int block = (y_local / 8 + by) * (LCU_WIDTH / 8) + x_local / 8 + bx;
+        found_all = false;
+        for (int i = 0; i < cache->count[block]; ++i) {
+          const merge_satd_entry_t *entry = &cache->entries[block][i];
+          if (entry->dir == key.dir &&
+              entry->ref[0] == key.ref[0] && entry->ref[1] == key.ref[1] &&
+              entry->mv[0][0] == key.mv[0][0] && entry->mv[0][1] == key.mv[0][1] &&
+              entry->mv[1][0] == key.mv[1][0] && entry->mv[1][1] == key.mv[1][1])
+          {
+            satd += entry->satd;
+            found_all = true;
+            break;
+          }
+        }
+      }
+    }
+    if (found_all) return satd;
+  }
+
+  // Find the prediction. With an integer MV inside the frame the prediction
+  // is a copy of the reference, so use the reference instead.
+  const kvz_pixel *pred = lcu->rec.y + y_local * LCU_WIDTH + x_local;
+  int pred_stride = LCU_WIDTH;
+  const int list = key.dir - 1;
+  bool predicted = false;
+  if (key.dir != 3 && !(key.mv[list][0] & 3) && !(key.mv[list][1] & 3)) {
+    const kvz_picture *ref =
+      state->frame->ref->images[state->frame->ref_LX[list][key.ref[list]]];
+    const int ref_x = state->tile->offset_x + info->origin.x + (key.mv[list][0] >> 2);
+    const int ref_y = state->tile->offset_y + info->origin.y + (key.mv[list][1] >> 2);
+    if (ref_x >= 0 && ref_y >= 0 &&
+        ref_x + width <= ref->width && ref_y + height <= ref->height)
+    {
+      pred = ref->y + ref_y * ref->stride + ref_x;
+      pred_stride = ref->stride;
+      predicted = true;
+    }
+  }
+  if (!predicted) {
+    kvz_inter_pred_pu(state, lcu, x_cu, y_cu, width_cu, true, false, i_pu);
+  }
+
+  if (!cacheable) {
+    return kvz_satd_any_size(width, height, pred, pred_stride, src, LCU_WIDTH);
+  }
+
+  uint32_t satd = 0;
+  for (int by = 0; by < blocks_h; ++by) {
+    for (int bx = 0; bx < blocks_w; ++bx) {
+      const int block = (y_local / 8 + by) * (LCU_WIDTH / 8) + x_local / 8 + bx;
+      key.satd = kvz_satd_any_size(8, 8,
+                                   pred + by * 8 * pred_stride + bx * 8, pred_stride,
+                                   src + by * 8 * LCU_WIDTH + bx * 8, LCU_WIDTH);
+      satd += key.satd;
+
+      int slot;
+      if (cache->count[block] < MERGE_SATD_CACHE_WAYS) {
+        slot = cache->count[block]++;
+      } else {
+        slot = cache->next[block];
+        cache->next[block] = (slot + 1) % MERGE_SATD_CACHE_WAYS;
+      }
+      cache->entries[block][slot] = key;
+    }
+  }
+  return satd;
+}
+
 /**
  * \brief Collect PU parameters and costs at this depth.
  *
@@ -1662,22 +2034,22 @@ static void search_pu_inter(encoder_state_t * const state,
   merge->size = 0;
   for (int i = 0; i < MRG_MAX_NUM_CANDS; ++i) {
     merge->keys[i] = -1;
-    merge->cost[i] = MAX_DOUBLE;
+    merge->cost[i] = RD_COST_MAX;
   }
 
-  const double merge_flag_cost = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_merge_flag_ext_model, 1);
+  const rd_bits_t merge_flag_cost = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_merge_flag_ext_model, 1);
 #ifdef COMPLETE_PRED_MODE_BITS
   // Technically counting these bits would be correct, however counting
   // them universally degrades quality so this block is disabled by default
-  const double no_skip_flag = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_skip_flag_model[kvz_get_skip_context(x, y, lcu, NULL)], 0);
+  const rd_bits_t no_skip_flag = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_skip_flag_model[kvz_get_skip_context(x, y, lcu, NULL)], 0);
 #else
-  const double no_skip_flag = 0;
+  const rd_bits_t no_skip_flag = 0;
 #endif
   // Check motion vector constraints and perform rough search
   for (int merge_idx = 0; merge_idx < info->num_merge_cand; ++merge_idx) {
 
     inter_merge_cand_t *cur_cand = &info->merge_cand[merge_idx];
-    cur_pu->inter.mv_dir = cur_cand->dir;
+    cur_pu->mv_dir = cur_cand->dir;
     cur_pu->inter.mv_ref[0] = cur_cand->ref[0];
     cur_pu->inter.mv_ref[1] = cur_cand->ref[1];
     cur_pu->inter.mv[0][0] = cur_cand->mv[0][0];
@@ -1687,39 +2059,39 @@ static void search_pu_inter(encoder_state_t * const state,
 
     // If bipred is not enabled, do not try candidates with mv_dir == 3.
     // Bipred is also forbidden for 4x8 and 8x4 blocks by the standard. 
-    if (cur_pu->inter.mv_dir == 3 && !state->encoder_control->cfg.bipred) continue;
-    if (cur_pu->inter.mv_dir == 3 && !(width + height > 12)) continue;
+    if (cur_pu->mv_dir == 3 && !state->encoder_control->cfg.bipred) continue;
+    if (cur_pu->mv_dir == 3 && !(width + height > 12)) continue;
 
     bool is_duplicate = merge_candidate_in_list(info->merge_cand, cur_cand, merge);
 
     // Don't try merge candidates that don't satisfy mv constraints.
     // Don't add duplicates to list
-    bool active_L0 = cur_pu->inter.mv_dir & 1;
-    bool active_L1 = cur_pu->inter.mv_dir & 2;
-    if ((active_L0 && !fracmv_within_tile(info, cur_pu->inter.mv[0][0], cur_pu->inter.mv[0][1])) ||
-        (active_L1 && !fracmv_within_tile(info, cur_pu->inter.mv[1][0], cur_pu->inter.mv[1][1])) ||
+    bool active_L0 = cur_pu->mv_dir & 1;
+    bool active_L1 = cur_pu->mv_dir & 2;
+    const uint8_t (*ref_LX)[16] = state->frame->ref_LX;
+    if ((active_L0 && !fracmv_within_ref(info, ref_LX[0][cur_pu->inter.mv_ref[0]], cur_pu->inter.mv[0][0], cur_pu->inter.mv[0][1])) ||
+        (active_L1 && !fracmv_within_ref(info, ref_LX[1][cur_pu->inter.mv_ref[1]], cur_pu->inter.mv[1][0], cur_pu->inter.mv[1][1])) ||
         is_duplicate)
     {
       continue;
     }
 
-    kvz_inter_pred_pu(state, lcu, x_cu, y_cu, width_cu, true, false, i_pu);
     merge->unit[merge->size] = *cur_pu;
     merge->unit[merge->size].type = CU_INTER;
     merge->unit[merge->size].merge_idx = merge_idx;
     merge->unit[merge->size].merged = true;
     merge->unit[merge->size].skipped = false;
 
-    double bits = merge_flag_cost + merge_idx + CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.cu_merge_idx_ext_model), merge_idx != 0);
+    rd_bits_t bits = merge_flag_cost + RD_BITS(merge_idx) + CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.cu_merge_idx_ext_model), merge_idx != 0);
     if(state->encoder_control->cfg.rdo >= 3 && cur_pu->part_size == SIZE_2Nx2N) {
+      kvz_inter_pred_pu(state, lcu, x_cu, y_cu, width_cu, true, false, i_pu);
       kvz_cu_cost_inter_rd2(state, x, y, depth, &merge->unit[merge->size], lcu, &merge->cost[merge->size], &bits);
     }
     else {
-      merge->cost[merge->size] = kvz_satd_any_size(width, height,
-        lcu->rec.y + y_local * LCU_WIDTH + x_local, LCU_WIDTH,
-        lcu->ref.y + y_local * LCU_WIDTH + x_local, LCU_WIDTH);
+      merge->cost[merge->size] = RD_COST_DIST(
+        merge_cand_satd(info, lcu, x_cu, y_cu, width_cu, i_pu, cur_pu));
       bits += no_skip_flag;
-      merge->cost[merge->size] += bits * info->state->lambda_sqrt;
+      merge->cost[merge->size] += RD_COST_BITS_SQRT(info->state, bits);
     }
     // Add cost of coding the merge index
     merge->bits[merge->size] = bits;
@@ -1752,7 +2124,7 @@ static void search_pu_inter(encoder_state_t * const state,
         // and chroma exists.
         // Early terminate if merge candidate with zero CBF is found.
         int merge_idx           = merge->unit[merge->keys[merge_key]].merge_idx;
-        cur_pu->inter.mv_dir    = info->merge_cand[merge_idx].dir;
+        cur_pu->mv_dir    = info->merge_cand[merge_idx].dir;
         cur_pu->inter.mv_ref[0] = info->merge_cand[merge_idx].ref[0];
         cur_pu->inter.mv_ref[1] = info->merge_cand[merge_idx].ref[1];
         cur_pu->inter.mv[0][0]  = info->merge_cand[merge_idx].mv[0][0];
@@ -1775,8 +2147,8 @@ static void search_pu_inter(encoder_state_t * const state,
             cur_pu->skipped = true;
 
             merge->size = 1;
-            merge->cost[0] = 0.0; // TODO: Check this
-            merge->bits[0] = merge_idx; // TODO: Check this
+            merge->cost[0] = 0; // TODO: Check this
+            merge->bits[0] = RD_BITS(merge_idx); // TODO: Check this
             merge->unit[0] = *cur_pu;
             return;
           }
@@ -1793,7 +2165,7 @@ static void search_pu_inter(encoder_state_t * const state,
 
   for (int mv_dir = 1; mv_dir < 4; ++mv_dir) {
     for (int i = 0; i < state->frame->ref->used_size; ++i) {
-      amvp[mv_dir - 1].cost[i] = MAX_DOUBLE;
+      amvp[mv_dir - 1].cost[i] = RD_COST_MAX;
     }
   }
 
@@ -1833,10 +2205,10 @@ static void search_pu_inter(encoder_state_t * const state,
 
     if (L0_ref_idx == L1_ref_idx) {
       // Invalidate the other based the list that has the 2nd best PU
-      double L0_2nd_cost = amvp[0].size > 1 ? amvp[0].cost[amvp[0].keys[1]] : MAX_DOUBLE;
-      double L1_2nd_cost = amvp[1].size > 1 ? amvp[1].cost[amvp[1].keys[1]] : MAX_DOUBLE;
+      rd_cost_t L0_2nd_cost = amvp[0].size > 1 ? amvp[0].cost[amvp[0].keys[1]] : RD_COST_MAX;
+      rd_cost_t L1_2nd_cost = amvp[1].size > 1 ? amvp[1].cost[amvp[1].keys[1]] : RD_COST_MAX;
       int list = (L0_2nd_cost <= L1_2nd_cost) ? 1 : 0;
-      amvp[list].cost[best_keys[list]] = MAX_DOUBLE;
+      amvp[list].cost[best_keys[list]] = RD_COST_MAX;
       kvz_sort_keys_by_cost(&amvp[list]);
       amvp[list].size--;
       best_keys[list]    =  amvp[list].keys[0];
@@ -1875,8 +2247,8 @@ static void search_pu_inter(encoder_state_t * const state,
           lcu,
           list);
 
-        double     frac_cost = MAX_DOUBLE;
-        double   frac_bits = MAX_INT;
+        rd_cost_t frac_cost = RD_COST_MAX;
+        rd_bits_t frac_bits = RD_BITS_MAX;
         vector2d_t frac_mv = { unipred_pu->inter.mv[list][0], unipred_pu->inter.mv[list][1] };
 
         search_frac(info, &frac_cost, &frac_bits, &frac_mv);
@@ -1884,8 +2256,8 @@ static void search_pu_inter(encoder_state_t * const state,
         uint8_t mv_ref_coded = LX_idx;
         int cu_mv_cand = select_mv_cand(info->state, info->mv_cand, frac_mv.x, frac_mv.y, NULL);
         const int extra_bits = list + mv_ref_coded; // TODO: check if mv_dir bits are missing
-        frac_cost += extra_bits * info->state->lambda_sqrt;
-        frac_bits += extra_bits;
+        frac_cost += RD_COST_BITS_SQRT(info->state, RD_BITS(extra_bits));
+        frac_bits += RD_BITS(extra_bits);
 
         bool valid_mv = fracmv_within_tile(info, frac_mv.x, frac_mv.y);
         if (valid_mv) {
@@ -1907,7 +2279,7 @@ static void search_pu_inter(encoder_state_t * const state,
       // TODO: Recalculate SAD costs with SATD for further processing.
       for (int i = n_best; i < amvp[list].size; ++i) {
         int key = amvp[list].keys[i];
-        amvp[list].cost[key] = MAX_DOUBLE;
+        amvp[list].cost[key] = RD_COST_MAX;
       }
     }
 
@@ -1928,20 +2300,21 @@ static void search_pu_inter(encoder_state_t * const state,
     && width + height >= 16; // 4x8 and 8x4 PBs are restricted to unipred
 
   if (can_use_bipred) {
+    state->unipred_cache->count = 0;
+    state->unipred_cache->next  = 0;
 
     cu_info_t *bipred_pu = &amvp[2].unit[0];
     *bipred_pu = *cur_pu;
-    double   best_bipred_cost = MAX_DOUBLE;
+    rd_cost_t best_bipred_cost = RD_COST_MAX;
 
     // Try biprediction from valid acquired unipreds.
     if (amvp[0].size > 0 && amvp[1].size > 0) {
 
       // TODO: logic is copy paste from search_pu_inter_bipred.
       // Get rid of duplicate code asap.
-      const image_list_t *const ref = info->state->frame->ref;
       uint8_t(*ref_LX)[16] = info->state->frame->ref_LX;
 
-      bipred_pu->inter.mv_dir = 3;
+      bipred_pu->mv_dir = 3;
 
       bipred_pu->inter.mv_ref[0] = best_unipred[0]->inter.mv_ref[0];
       bipred_pu->inter.mv_ref[1] = best_unipred[1]->inter.mv_ref[1];
@@ -1959,24 +2332,14 @@ static void search_pu_inter(encoder_state_t * const state,
         kvz_inter_get_mv_cand(info->state, x, y, width, height, info->mv_cand, bipred_pu, lcu, reflist);
       }
 
-      kvz_inter_recon_bipred(info->state,
-        ref->images[ref_LX[0][bipred_pu->inter.mv_ref[0]]],
-        ref->images[ref_LX[1][bipred_pu->inter.mv_ref[1]]],
-        x, y,
-        width,
-        height,
-        mv,
-        lcu,
-        true,
-        false);
-
-      const kvz_pixel *rec = &lcu->rec.y[SUB_SCU(y) * LCU_WIDTH + SUB_SCU(x)];
-      const kvz_pixel *src = &lcu->ref.y[SUB_SCU(y) * LCU_WIDTH + SUB_SCU(x)];
+      const unipred_cache_entry_t *pred_L0 =
+        get_unipred(info, ref_LX[0][bipred_pu->inter.mv_ref[0]], mv[0], NULL);
+      const unipred_cache_entry_t *pred_L1 =
+        get_unipred(info, ref_LX[1][bipred_pu->inter.mv_ref[1]], mv[1], pred_L0);
 
-      best_bipred_cost =
-        kvz_satd_any_size(width, height, rec, LCU_WIDTH, src, LCU_WIDTH);
+      best_bipred_cost = RD_COST_DIST(bipred_satd(info, lcu, pred_L0, pred_L1));
 
-      double bitcost[2] = { 0, 0 };
+      rd_bits_t bitcost[2] = { 0, 0 };
 
       best_bipred_cost += info->mvd_cost_func(info->state,
         bipred_pu->inter.mv[0][0],
@@ -1998,9 +2361,9 @@ static void search_pu_inter(encoder_state_t * const state,
         bipred_pu->inter.mv_ref[1]
       };
       const int extra_bits = mv_ref_coded[0] + mv_ref_coded[1] + 2 /* mv dir cost */;
-      best_bipred_cost += info->state->lambda_sqrt * extra_bits;
+      best_bipred_cost += RD_COST_BITS_SQRT(info->state, RD_BITS(extra_bits));
 
-      if (best_bipred_cost < MAX_DOUBLE) {
+      if (best_bipred_cost < RD_COST_MAX) {
 
         // Each motion vector has its own candidate
         for (int reflist = 0; reflist < 2; reflist++) {
@@ -2013,8 +2376,13 @@ static void search_pu_inter(encoder_state_t * const state,
           CU_SET_MV_CAND(bipred_pu, reflist, cu_mv_cand);
         }
 
+        rd_bits_t best_bipred_bits = bitcost[0] + bitcost[1] + RD_BITS(extra_bits);
+        if (cfg->bipred_refine > 0) {
+          refine_bipred(info, lcu, bipred_pu, &best_bipred_cost, &best_bipred_bits);
+        }
+
         amvp[2].cost[amvp[2].size] = best_bipred_cost;
-        amvp[2].bits[amvp[2].size] = bitcost[0] + bitcost[1] + extra_bits;
+        amvp[2].bits[amvp[2].size] = best_bipred_bits;
         amvp[2].keys[amvp[2].size] = amvp[2].size;
         amvp[2].size++;
       }
@@ -2030,17 +2398,17 @@ static void search_pu_inter(encoder_state_t * const state,
   }
   if(cfg->rdo < 2) {
     const int skip_contest = kvz_get_skip_context(x, y, lcu, NULL);
-    const double no_skip_flag = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_skip_flag_model[skip_contest], 0);
-    const double part_mode_bits = state->encoder_control->cfg.smp_enable || state->encoder_control->cfg.amp_enable ?
+    const rd_bits_t no_skip_flag = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_skip_flag_model[skip_contest], 0);
+    const rd_bits_t part_mode_bits = state->encoder_control->cfg.smp_enable || state->encoder_control->cfg.amp_enable ?
       CTX_ENTROPY_FBITS(&state->search_cabac.ctx.part_size_model[0], 1)
         : 0;
-    const double pred_mode_bits = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_pred_mode_model, 0);
-    const double total_bits = no_skip_flag + part_mode_bits + pred_mode_bits;
+    const rd_bits_t pred_mode_bits = CTX_ENTROPY_FBITS(&state->search_cabac.ctx.cu_pred_mode_model, 0);
+    const rd_bits_t total_bits = no_skip_flag + part_mode_bits + pred_mode_bits;
     for(int i = 0; i < 3; i++) {
       if(amvp[i].size > 0) {
         const uint8_t best_key = amvp[i].keys[0];
         amvp[i].bits[best_key] += total_bits;
-        amvp[i].cost[best_key] += (total_bits)* state->lambda_sqrt;
+        amvp[i].cost[best_key] += RD_COST_BITS_SQRT(state, total_bits);
       }
     }
   }
@@ -2069,8 +2437,8 @@ void kvz_cu_cost_inter_rd2(encoder_state_t * const state,
                            int x, int y, int depth,
                            cu_info_t* cur_cu,
                            lcu_t *lcu,
-                           double   *inter_cost,
-                           double* inter_bitcost){
+                           rd_cost_t *inter_cost,
+                           rd_bits_t *inter_bitcost){
   
   int tr_depth = MAX(1, depth);
   if (cur_cu->part_size != SIZE_2Nx2N) {
@@ -2092,21 +2460,21 @@ void kvz_cu_cost_inter_rd2(encoder_state_t * const state,
   kvz_inter_recon_cu(state, lcu, x, y, CU_WIDTH_FROM_DEPTH(depth), true, reconstruct_chroma);
 
   int index = y_px * LCU_WIDTH + x_px;
-  double ssd = kvz_pixels_calc_ssd(&lcu->ref.y[index], &lcu->rec.y[index],
-                                   LCU_WIDTH, LCU_WIDTH,
-                                   width) * KVZ_LUMA_MULT;
+  rd_cost_t ssd = RD_COST_WDIST(kvz_pixels_calc_ssd(&lcu->ref.y[index], &lcu->rec.y[index],
+                                                   LCU_WIDTH, LCU_WIDTH,
+                                                   width), KVZ_LUMA_MULT);
   if (reconstruct_chroma) {
     int index = y_px / 2 * LCU_WIDTH_C + x_px / 2;
-    double ssd_u = kvz_pixels_calc_ssd(&lcu->ref.u[index], &lcu->rec.u[index],
-                                       LCU_WIDTH_C, LCU_WIDTH_C,
-                                       width / 2);
-    double ssd_v = kvz_pixels_calc_ssd(&lcu->ref.v[index], &lcu->rec.v[index],
-                                       LCU_WIDTH_C, LCU_WIDTH_C,
-                                       width / 2);
-    ssd += (ssd_u + ssd_v) * KVZ_CHROMA_MULT;
-  }
-  double no_cbf_bits;
-  double bits = 0;
+    unsigned ssd_u = kvz_pixels_calc_ssd(&lcu->ref.u[index], &lcu->rec.u[index],
+                                         LCU_WIDTH_C, LCU_WIDTH_C,
+                                         width / 2);
+    unsigned ssd_v = kvz_pixels_calc_ssd(&lcu->ref.v[index], &lcu->rec.v[index],
+                                         LCU_WIDTH_C, LCU_WIDTH_C,
+                                         width / 2);
+    ssd += RD_COST_WDIST(ssd_u + ssd_v, KVZ_CHROMA_MULT);
+  }
+  rd_bits_t no_cbf_bits;
+  rd_bits_t bits = 0;
   const int skip_context = kvz_get_skip_context(x, y, lcu, NULL);
   if (cur_cu->merged && cur_cu->part_size == SIZE_2Nx2N) {
     no_cbf_bits = CTX_ENTROPY_FBITS(&state->cabac.ctx.cu_skip_flag_model[skip_context], 1) + *inter_bitcost;
@@ -2116,7 +2484,7 @@ void kvz_cu_cost_inter_rd2(encoder_state_t * const state,
     no_cbf_bits = kvz_mock_encode_coding_unit(state, &cabac_copy, x, y, depth, lcu, cur_cu);
     bits += no_cbf_bits - CTX_ENTROPY_FBITS(&cabac_copy.ctx.cu_qt_root_cbf_model, 0) + CTX_ENTROPY_FBITS(&cabac_copy.ctx.cu_qt_root_cbf_model, 1);
   }
-  double no_cbf_cost = ssd + no_cbf_bits * state->lambda;
+  rd_cost_t no_cbf_cost = ssd + RD_COST_BITS(state, no_cbf_bits);
 
   kvz_quantize_lcu_residual(state, true, reconstruct_chroma,
                             x, y, depth,
@@ -2140,7 +2508,7 @@ void kvz_cu_cost_inter_rd2(encoder_state_t * const state,
     return;
   }
   
-  *inter_cost += (bits)* state->lambda;
+  *inter_cost += RD_COST_BITS(state, bits);
   *inter_bitcost = bits;
 
   if(no_cbf_cost < *inter_cost) {
@@ -2172,14 +2540,14 @@ void kvz_cu_cost_inter_rd2(encoder_state_t * const state,
 void kvz_search_cu_inter(encoder_state_t * const state,
                          int x, int y, int depth,
                          lcu_t *lcu,
-                         double   *inter_cost,
-                         double* inter_bitcost)
+                         rd_cost_t *inter_cost,
+                         rd_bits_t *inter_bitcost)
 {
-  *inter_cost = MAX_DOUBLE;
-  *inter_bitcost = MAX_INT;
+  *inter_cost = RD_COST_MAX;
+  *inter_bitcost = RD_BITS_MAX;
 
   // Store information of L0, L1, and bipredictions.
-  // Best cost will be left at MAX_DOUBLE if no valid CU is found.
+  // Best cost will be left at RD_COST_MAX if no valid CU is found.
   // These will be initialized by the following function.
   unit_stats_map_t amvp[3];
   unit_stats_map_t merge;
@@ -2226,10 +2594,10 @@ void kvz_search_cu_inter(encoder_state_t * const state,
     *inter_bitcost =  0; // TODO: Check this
   }
 
-  if (*inter_cost == MAX_DOUBLE) {
+  if (*inter_cost == RD_COST_MAX) {
     // Could not find any motion vector.
-    *inter_cost = MAX_DOUBLE;
-    *inter_bitcost = MAX_INT;
+    *inter_cost = RD_COST_MAX;
+    *inter_bitcost = RD_BITS_MAX;
     return;
   }
 
@@ -2253,12 +2621,12 @@ void kvz_search_cu_inter(encoder_state_t * const state,
       true, state->encoder_control->chroma_format != KVZ_CSP_400);
   }
 
-  if (*inter_cost < MAX_DOUBLE && cur_pu->inter.mv_dir & 1) {
-    assert(fracmv_within_tile(&info, cur_pu->inter.mv[0][0], cur_pu->inter.mv[0][1]));
+  if (*inter_cost < RD_COST_MAX && cur_pu->mv_dir & 1) {
+    assert(fracmv_within_ref(&info, state->frame->ref_LX[0][cur_pu->inter.mv_ref[0]], cur_pu->inter.mv[0][0], cur_pu->inter.mv[0][1]));
   }
 
-  if (*inter_cost < MAX_DOUBLE && cur_pu->inter.mv_dir & 2) {
-    assert(fracmv_within_tile(&info, cur_pu->inter.mv[1][0], cur_pu->inter.mv[1][1]));
+  if (*inter_cost < RD_COST_MAX && cur_pu->mv_dir & 2) {
+    assert(fracmv_within_ref(&info, state->frame->ref_LX[1][cur_pu->inter.mv_ref[1]], cur_pu->inter.mv[1][0], cur_pu->inter.mv[1][1]));
   }
 }
 
@@ -2283,14 +2651,14 @@ void kvz_search_cu_smp(encoder_state_t* const state,
                        int depth,
                        part_mode_t part_mode,
                        lcu_t *lcu,
-                       double *inter_cost,
-                       double* inter_bitcost)
+                       rd_cost_t *inter_cost,
+                       rd_bits_t *inter_bitcost)
 {
-  *inter_cost = MAX_DOUBLE;
-  *inter_bitcost = MAX_INT;
+  *inter_cost = RD_COST_MAX;
+  *inter_bitcost = RD_BITS_MAX;
 
   // Store information of L0, L1, and bipredictions.
-  // Best cost will be left at MAX_DOUBLE if no valid CU is found.
+  // Best cost will be left at RD_COST_MAX if no valid CU is found.
   // These will be initialized by the following function.
   unit_stats_map_t amvp[3];
   unit_stats_map_t merge;
@@ -2310,8 +2678,8 @@ void kvz_search_cu_smp(encoder_state_t* const state,
     const int width_pu  = PU_GET_W(part_mode, width, i);
     const int height_pu = PU_GET_H(part_mode, width, i);
 
-    double cost    = MAX_DOUBLE;
-    double bitcost = MAX_INT;
+    rd_cost_t cost    = RD_COST_MAX;
+    rd_bits_t bitcost = RD_BITS_MAX;
 
     search_pu_inter(state, x, y, depth, part_mode, i, lcu, amvp, &merge, &info);
 
@@ -2341,10 +2709,10 @@ void kvz_search_cu_smp(encoder_state_t* const state,
       bitcost       =  0; // TODO: Check this
     }
 
-    if (cost == MAX_DOUBLE) {
+    if (cost == RD_COST_MAX) {
       // Could not find any motion vector.
-      *inter_cost = MAX_DOUBLE;
-      *inter_bitcost = MAX_INT;
+      *inter_cost = RD_COST_MAX;
+      *inter_bitcost = RD_BITS_MAX;
       return;
     }
 
@@ -2358,19 +2726,22 @@ void kvz_search_cu_smp(encoder_state_t* const state,
       for (int x = x_pu; x < x_pu + width_pu; x += SCU_WIDTH) {
         cu_info_t* scu = LCU_GET_CU_AT_PX(lcu, x, y);
         scu->type = CU_INTER;
+        scu->mv_dir = cur_pu->mv_dir;
+        scu->mv_cand0 = cur_pu->mv_cand0;
+        scu->mv_cand1 = cur_pu->mv_cand1;
         scu->inter = cur_pu->inter;
       }
     }
 
-    if (cost < MAX_DOUBLE && cur_pu->inter.mv_dir & 1) {
-      assert(fracmv_within_tile(&info, cur_pu->inter.mv[0][0], cur_pu->inter.mv[0][1]));
+    if (cost < RD_COST_MAX && cur_pu->mv_dir & 1) {
+      assert(fracmv_within_ref(&info, state->frame->ref_LX[0][cur_pu->inter.mv_ref[0]], cur_pu->inter.mv[0][0], cur_pu->inter.mv[0][1]));
     }
 
-    if (cost < MAX_DOUBLE && cur_pu->inter.mv_dir & 2) {
-      assert(fracmv_within_tile(&info, cur_pu->inter.mv[1][0], cur_pu->inter.mv[1][1]));
+    if (cost < RD_COST_MAX && cur_pu->mv_dir & 2) {
+      assert(fracmv_within_ref(&info, state->frame->ref_LX[1][cur_pu->inter.mv_ref[1]], cur_pu->inter.mv[1][0], cur_pu->inter.mv[1][1]));
     }
   }
-  double smp_extra_bits = 0;
+  rd_bits_t smp_extra_bits = 0;
   if (state->encoder_control->cfg.rdo < 2) {
     smp_extra_bits = kvz_encode_part_mode(
       state,
@@ -2383,7 +2754,7 @@ void kvz_search_cu_smp(encoder_state_t* const state,
 
     // The transform is split for SMP and AMP blocks so we need more bits for
     // coding the CBF.
-    smp_extra_bits += 6;
+    smp_extra_bits += RD_BITS(6);
 
     *inter_bitcost += smp_extra_bits;
   }
@@ -2397,6 +2768,6 @@ void kvz_search_cu_smp(encoder_state_t* const state,
                           inter_cost,
                           inter_bitcost);
   } else {
-    *inter_cost += state->lambda_sqrt * smp_extra_bits;
+    *inter_cost += RD_COST_BITS_SQRT(state, smp_extra_bits);
   }
 }
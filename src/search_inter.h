@@ -64,28 +64,87 @@ enum hpel_position {
   HPEL_POS_DIA = 2
 };
 
-typedef double kvz_mvd_cost_func(const encoder_state_t *state,
+#define MERGE_SATD_CACHE_WAYS 8
+
+/**
+ * \brief SATD of a merge candidate for one 8x8 luma block.
+ *
+ * Unused lists have zero MV and reference so that entries can be compared
+ * directly.
+ */
+typedef struct {
+  int16_t mv[2][2];
+  uint8_t dir;
+  uint8_t ref[2];
+  uint32_t satd;
+} merge_satd_entry_t;
+
+/**
+ * \brief SATDs of merge candidates for each 8x8 block of the current LCU.
+ *
+ * SATD is calculated in 8x8 blocks, so the cost of a PU aligned to the 8x8
+ * grid is the sum of the costs of its blocks. This lets CUs at other depths
+ * reuse the costs of merge candidates they share.
+ */
+typedef struct merge_satd_cache_t {
+  //! Number of valid entries for each block.
+  uint8_t count[LCU_WIDTH / 8 * LCU_WIDTH / 8];
+  //! Index of the entry to replace next for each block.
+  uint8_t next[LCU_WIDTH / 8 * LCU_WIDTH / 8];
+  merge_satd_entry_t entries[LCU_WIDTH / 8 * LCU_WIDTH / 8][MERGE_SATD_CACHE_WAYS];
+} merge_satd_cache_t;
+
+#define UNIPRED_CACHE_SIZE 16
+
+/**
+ * \brief Luma prediction of the current PU from a single reference.
+ */
+typedef struct {
+  //! Index of the reference picture in the reference picture list.
+  int32_t ref_idx;
+  int16_t mv[2];
+  //! Whether buf holds high precision samples or plain pixels.
+  unsigned im_flags;
+  //! Interpreted as kvz_pixel when im_flags is 0.
+  kvz_pixel_im buf[LCU_LUMA_SIZE];
+} unipred_cache_entry_t;
+
+/**
+ * \brief Unipred predictions of the current PU for bi-prediction search.
+ *
+ * Bi-prediction candidates share most of their unipred predictions, so
+ * each is interpolated only once per PU and the candidates are evaluated
+ * by averaging the cached predictions.
+ */
+typedef struct unipred_cache_t {
+  int count;
+  //! Index of the entry to replace next.
+  int next;
+  unipred_cache_entry_t entries[UNIPRED_CACHE_SIZE];
+} unipred_cache_t;
+
+typedef rd_cost_t kvz_mvd_cost_func(const encoder_state_t *state,
                                   int x, int y,
                                   int mv_shift,
                                   int16_t mv_cand[2][2],
                                   inter_merge_cand_t merge_cand[MRG_MAX_NUM_CANDS],
                                   int16_t num_cand,
                                   int32_t ref_idx,
-                                  double *bitcost);
+                                  rd_bits_t *bitcost);
 
 void kvz_search_cu_inter(encoder_state_t * const state,
                          int x, int y, int depth,
                          lcu_t *lcu,
-                         double *inter_cost,
-                         double* inter_bitcost);
+                         rd_cost_t *inter_cost,
+                         rd_bits_t* inter_bitcost);
 
 void kvz_search_cu_smp(encoder_state_t * const state,
                        int x, int y,
                        int depth,
                        part_mode_t part_mode,
                        lcu_t *lcu,
-                       double *inter_cost,
-                       double* inter_bitcost);
+                       rd_cost_t *inter_cost,
+                       rd_bits_t* inter_bitcost);
 
 
 unsigned kvz_inter_satd_cost(const encoder_state_t* state,
@@ -96,8 +155,8 @@ void kvz_cu_cost_inter_rd2(encoder_state_t* const state,
   int x, int y, int depth,
   cu_info_t* cur_cu,
   lcu_t* lcu,
-  double* inter_cost,
-  double* inter_bitcost);
+  rd_cost_t* inter_cost,
+  rd_bits_t* inter_bitcost);
 
 int kvz_get_skip_context(int x, int y, lcu_t* const lcu, cu_array_t* const cu_a);
 
@@ -33,6 +33,7 @@
 #include "search_intra.h"
 
 #include <limits.h>
+#include <string.h>
 
 #include "cabac.h"
 #include "encoder.h"
@@ -43,6 +44,7 @@
 #include "rdo.h"
 #include "search.h"
 #include "strategies/strategies-picture.h"
+#include "strategies/strategies-quant.h"
 #include "videoframe.h"
 
 
@@ -56,10 +58,10 @@
 /**
 * \brief Select mode with the smallest cost.
 */
-static INLINE uint8_t select_best_mode_index(const int8_t *modes, const double *costs, uint8_t length)
+static INLINE uint8_t select_best_mode_index(const int8_t *modes, const rd_cost_t *costs, uint8_t length)
 {
   uint8_t best_index = 0;
-  double best_cost = costs[0];
+  rd_cost_t best_cost = costs[0];
   
   for (uint8_t i = 1; i < length; ++i) {
     if (costs[i] < best_cost) {
@@ -84,13 +86,13 @@ static INLINE uint8_t select_best_mode_index(const int8_t *modes, const double *
  * \return  Estimated RD cost of the reconstruction and signaling the
  *     coefficients of the residual.
  */
-static double get_cost(encoder_state_t * const state, 
-                       kvz_pixel *pred, kvz_pixel *orig_block,
-                       cost_pixel_nxn_func *satd_func,
-                       cost_pixel_nxn_func *sad_func,
-                       int width)
+static rd_cost_t get_cost(encoder_state_t * const state, 
+                          kvz_pixel *pred, kvz_pixel *orig_block,
+                          cost_pixel_nxn_func *satd_func,
+                          cost_pixel_nxn_func *sad_func,
+                          int width)
 {
-  double satd_cost = satd_func(pred, orig_block);
+  rd_cost_t satd_cost = RD_COST_DIST(satd_func(pred, orig_block));
   if (TRSKIP_RATIO != 0 && width == 4 && state->encoder_control->cfg.trskip_enable) {
     // If the mode looks better with SAD than SATD it might be a good
     // candidate for transform skip. How much better SAD has to be is
@@ -99,14 +101,14 @@ static double get_cost(encoder_state_t * const state,
     // Add the offset bit costs of signaling 'luma and chroma use trskip',
     // versus signaling 'luma and chroma don't use trskip' to the SAD cost.
     const cabac_ctx_t *ctx = &state->search_cabac.ctx.transform_skip_model_luma;
-    double trskip_bits = CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0);
+    rd_bits_t trskip_bits = CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0);
 
     if (state->encoder_control->chroma_format != KVZ_CSP_400) {
       ctx = &state->search_cabac.ctx.transform_skip_model_chroma;
-      trskip_bits += 2.0 * (CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0));
+      trskip_bits += 2 * (CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0));
     }
 
-    double sad_cost = TRSKIP_RATIO * sad_func(pred, orig_block) + state->lambda_sqrt * trskip_bits;
+    rd_cost_t sad_cost = RD_COST_WDIST(sad_func(pred, orig_block), TRSKIP_RATIO) + RD_COST_BITS_SQRT(state, trskip_bits);
     if (sad_cost < satd_cost) {
       return sad_cost;
     }
@@ -126,13 +128,13 @@ static void get_cost_dual(encoder_state_t * const state,
                        const pred_buffer preds, const kvz_pixel *orig_block,
                        cost_pixel_nxn_multi_func *satd_twin_func,
                        cost_pixel_nxn_multi_func *sad_twin_func,
-                       int width, double *costs_out)
+                       int width, rd_cost_t *costs_out)
 {
   #define PARALLEL_BLKS 2
   unsigned satd_costs[PARALLEL_BLKS] = { 0 };
   satd_twin_func(preds, orig_block, PARALLEL_BLKS, satd_costs);
-  costs_out[0] = (double)satd_costs[0];
-  costs_out[1] = (double)satd_costs[1];
+  costs_out[0] = RD_COST_DIST(satd_costs[0]);
+  costs_out[1] = RD_COST_DIST(satd_costs[1]);
 
   if (TRSKIP_RATIO != 0 && width == 4 && state->encoder_control->cfg.trskip_enable) {
     // If the mode looks better with SAD than SATD it might be a good
@@ -142,19 +144,19 @@ static void get_cost_dual(encoder_state_t * const state,
     // Add the offset bit costs of signaling 'luma and chroma use trskip',
     // versus signaling 'luma and chroma don't use trskip' to the SAD cost.
     const cabac_ctx_t *ctx = &state->cabac.ctx.transform_skip_model_luma;
-    double trskip_bits = CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0);
+    rd_bits_t trskip_bits = CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0);
 
     if (state->encoder_control->chroma_format != KVZ_CSP_400) {
       ctx = &state->cabac.ctx.transform_skip_model_chroma;
-      trskip_bits += 2.0 * (CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0));
+      trskip_bits += 2 * (CTX_ENTROPY_FBITS(ctx, 1) - CTX_ENTROPY_FBITS(ctx, 0));
     }
 
     unsigned unsigned_sad_costs[PARALLEL_BLKS] = { 0 };
-    double sad_costs[PARALLEL_BLKS] = { 0 };
+    rd_cost_t sad_costs[PARALLEL_BLKS] = { 0 };
     sad_twin_func(preds, orig_block, PARALLEL_BLKS, unsigned_sad_costs);
     for (int i = 0; i < PARALLEL_BLKS; ++i) {
-      sad_costs[i] = TRSKIP_RATIO * (double)unsigned_sad_costs[i] + state->lambda_sqrt * trskip_bits;
-      if (sad_costs[i] < (double)satd_costs[i]) {
+      sad_costs[i] = RD_COST_WDIST(unsigned_sad_costs[i], TRSKIP_RATIO) + RD_COST_BITS_SQRT(state, trskip_bits);
+      if (sad_costs[i] < RD_COST_DIST(satd_costs[i])) {
         costs_out[i] = sad_costs[i];
       }
     }
@@ -175,9 +177,9 @@ static void get_cost_dual(encoder_state_t * const state,
 * \param intra_mode  Intra prediction mode.
 * \param cost_treshold  RD cost at which search can be stopped.
 */
-static double search_intra_trdepth(encoder_state_t * const state,
-                                   int x_px, int y_px, int depth, int max_depth,
-                                   int intra_mode, int cost_treshold,
+static rd_cost_t search_intra_trdepth(encoder_state_t * const state,
+                                      int x_px, int y_px, int depth, int max_depth,
+                                      int intra_mode, rd_cost_t cost_treshold,
                                    cu_info_t *const pred_cu,
                                    lcu_t *const lcu)
 {
@@ -199,14 +201,14 @@ static double search_intra_trdepth(encoder_state_t * const state,
   } nosplit_pixels;
   uint16_t nosplit_cbf = 0;
 
-  double split_cost = INT32_MAX;
-  double nosplit_cost = INT32_MAX;
+  rd_cost_t split_cost = RD_COST_DIST(INT32_MAX);
+  rd_cost_t nosplit_cost = RD_COST_DIST(INT32_MAX);
 
   if (depth > 0) {
     tr_cu->tr_depth = depth;
     pred_cu->tr_depth = depth;
 
-    nosplit_cost = 0.0;
+    nosplit_cost = 0;
 
     cbf_clear(&pred_cu->cbf, depth, COLOR_Y);
     if (reconstruct_chroma) {
@@ -248,21 +250,22 @@ static double search_intra_trdepth(encoder_state_t * const state,
   //     max_depth.
   // - Min transform size hasn't been reached (MAX_PU_DEPTH).
   if (depth < max_depth && depth < MAX_PU_DEPTH) {
+    const rd_cost_t threshold = RD_COST_TRUNC(nosplit_cost);
     split_cost = 0;
 
-    split_cost += search_intra_trdepth(state, x_px, y_px, depth + 1, max_depth, intra_mode, nosplit_cost, pred_cu, lcu);
+    split_cost += search_intra_trdepth(state, x_px, y_px, depth + 1, max_depth, intra_mode, threshold, pred_cu, lcu);
     if (split_cost < nosplit_cost) {
-      split_cost += search_intra_trdepth(state, x_px + offset, y_px, depth + 1, max_depth, intra_mode, nosplit_cost, pred_cu, lcu);
+      split_cost += search_intra_trdepth(state, x_px + offset, y_px, depth + 1, max_depth, intra_mode, threshold, pred_cu, lcu);
     }
     if (split_cost < nosplit_cost) {
-      split_cost += search_intra_trdepth(state, x_px, y_px + offset, depth + 1, max_depth, intra_mode, nosplit_cost, pred_cu, lcu);
+      split_cost += search_intra_trdepth(state, x_px, y_px + offset, depth + 1, max_depth, intra_mode, threshold, pred_cu, lcu);
     }
     if (split_cost < nosplit_cost) {
-      split_cost += search_intra_trdepth(state, x_px + offset, y_px + offset, depth + 1, max_depth, intra_mode, nosplit_cost, pred_cu, lcu);
+      split_cost += search_intra_trdepth(state, x_px + offset, y_px + offset, depth + 1, max_depth, intra_mode, threshold, pred_cu, lcu);
     }
 
-    double tr_split_bit = 0.0;
-    double cbf_bits = 0.0;
+    rd_bits_t tr_split_bit = 0;
+    rd_bits_t cbf_bits = 0;
 
     // Add bits for split_transform_flag = 1, because transform depth search bypasses
     // the normal recursion in the cost functions.
@@ -289,8 +292,8 @@ static double search_intra_trdepth(encoder_state_t * const state,
       }
     }
 
-    double bits = tr_split_bit + cbf_bits;
-    split_cost += bits * state->lambda;
+    rd_bits_t bits = tr_split_bit + cbf_bits;
+    split_cost += RD_COST_BITS(state, bits);
   } else {
     assert(width <= TR_MAX_WIDTH);
   }
@@ -320,7 +323,7 @@ static void search_intra_chroma_rough(encoder_state_t * const state,
                                       const kvz_pixel *orig_u, const kvz_pixel *orig_v, int16_t origstride,
                                       kvz_intra_references *refs_u, kvz_intra_references *refs_v,
                                       int8_t luma_mode,
-                                      int8_t modes[5], double costs[5])
+                                      int8_t modes[5], rd_cost_t costs[5])
 {
   assert(!(x_px & 4 || y_px & 4));
 
@@ -345,7 +348,7 @@ static void search_intra_chroma_rough(encoder_state_t * const state,
     if (modes[i] == luma_mode) continue;
     kvz_intra_predict(refs_u, log2_width_c, modes[i], COLOR_U, pred, false);
     //costs[i] += get_cost(encoder_state, pred, orig_block, satd_func, sad_func, width);
-    costs[i] += satd_func(pred, orig_block);
+    costs[i] += RD_COST_DIST(satd_func(pred, orig_block));
   }
 
   kvz_pixels_blit(orig_v, orig_block, width, width, origstride, width);
@@ -353,7 +356,7 @@ static void search_intra_chroma_rough(encoder_state_t * const state,
     if (modes[i] == luma_mode) continue;
     kvz_intra_predict(refs_v, log2_width_c, modes[i], COLOR_V, pred, false);
     //costs[i] += get_cost(encoder_state, pred, orig_block, satd_func, sad_func, width);
-    costs[i] += satd_func(pred, orig_block);
+    costs[i] += RD_COST_DIST(satd_func(pred, orig_block));
   }
 
   kvz_sort_modes(modes, costs, 5);
@@ -394,7 +397,7 @@ static int8_t search_intra_rough(encoder_state_t * const state,
                                  kvz_pixel *orig, int32_t origstride,
                                  kvz_intra_references *refs,
                                  int log2_width, int8_t *intra_preds,
-                                 int8_t modes[35], double costs[35])
+                                 int8_t modes[35], rd_cost_t costs[35])
 {
   #define PARALLEL_BLKS 2 // TODO: use 4 for AVX-512 in the future?
   assert(log2_width >= 2 && log2_width <= 5);
@@ -419,8 +422,8 @@ static int8_t search_intra_rough(encoder_state_t * const state,
 
   int8_t modes_selected = 0;
   // Note: get_cost and get_cost_dual may return negative costs.
-  int32_t min_cost = INT_MAX;
-  int32_t max_cost = INT_MIN;
+  rd_cost_t min_cost = RD_COST_MAX;
+  rd_cost_t max_cost = -RD_COST_MAX;
   
   // Initial offset decides how many modes are tried before moving on to the
   // recursive search.
@@ -436,7 +439,7 @@ static int8_t search_intra_rough(encoder_state_t * const state,
   // the recursive search.
   for (int mode = 2; mode <= 34; mode += PARALLEL_BLKS * offset) {
     
-    double costs_out[PARALLEL_BLKS] = { 0 };
+    rd_cost_t costs_out[PARALLEL_BLKS] = { 0 };
     for (int i = 0; i < PARALLEL_BLKS; ++i) {
       if (mode + i * offset <= 34) {
         kvz_intra_predict(refs, log2_width, mode + i * offset, COLOR_Y, preds[i], filter_boundary);
@@ -450,15 +453,15 @@ static int8_t search_intra_rough(encoder_state_t * const state,
       if (mode + i * offset <= 34) {
         costs[modes_selected] = costs_out[i];
         modes[modes_selected] = mode + i * offset;
-        min_cost = MIN(min_cost, costs[modes_selected]);
-        max_cost = MAX(max_cost, costs[modes_selected]);
+        min_cost = MIN(min_cost, RD_COST_TRUNC(costs[modes_selected]));
+        max_cost = MAX(max_cost, RD_COST_TRUNC(costs[modes_selected]));
         ++modes_selected;
       }
     }
   }
 
   int8_t best_mode = modes[select_best_mode_index(modes, costs, modes_selected)];
-  double best_cost = min_cost;
+  rd_cost_t best_cost = min_cost;
   
   // Skip recursive search if all modes have the same cost.
   if (min_cost != max_cost) {
@@ -470,7 +473,7 @@ static int8_t search_intra_rough(encoder_state_t * const state,
       int8_t center_node = best_mode;
       int8_t test_modes[] = { center_node - offset, center_node + offset };
 
-      double costs_out[PARALLEL_BLKS] = { 0 };
+      rd_cost_t costs_out[PARALLEL_BLKS] = { 0 };
       char mode_in_range = 0;
 
       for (int i = 0; i < PARALLEL_BLKS; ++i) mode_in_range |= (test_modes[i] >= 2 && test_modes[i] <= 34);
@@ -525,7 +528,7 @@ static int8_t search_intra_rough(encoder_state_t * const state,
   // Add prediction mode coding cost as the last thing. We don't want this
   // affecting the halving search.
   for (int mode_i = 0; mode_i < modes_selected; ++mode_i) {
-    costs[mode_i] += state->lambda_sqrt * kvz_luma_mode_bits(state, modes[mode_i], intra_preds);
+    costs[mode_i] += RD_COST_BITS_SQRT(state, kvz_luma_mode_bits(state, modes[mode_i], intra_preds));
   }
 
   #undef PARALLEL_BLKS
@@ -533,6 +536,48 @@ static int8_t search_intra_rough(encoder_state_t * const state,
   return modes_selected;
 }
 
+/**
+ * \brief Estimate the deepest transform split worth searching for a mode.
+ *
+ * The whole block is predicted once and every transform size is evaluated
+ * against that prediction. The real split search predicts each child from
+ * the reconstruction of its siblings, so this is only an estimate, and it
+ * is only used to skip the split search when not splitting looks best.
+ *
+ * \return depth if no split is estimated to be best, otherwise max_depth.
+ */
+static int estimate_intra_tr_depth(encoder_state_t * const state,
+                                   int depth, int max_depth,
+                                   const kvz_pixel *orig_block,
+                                   kvz_intra_references *refs,
+                                   int intra_mode)
+{
+  const kvz_config *cfg = &state->encoder_control->cfg;
+  const int log2_width = LOG2_LCU_WIDTH - depth;
+  const int width = 1 << log2_width;
+  const int num_levels = MIN(max_depth - depth, log2_width - 2) + 1;
+  const bool filter_boundary = !(cfg->lossless && cfg->implicit_rdpcm);
+
+  kvz_pixel _pred[TR_MAX_WIDTH * TR_MAX_WIDTH + SIMD_ALIGNMENT];
+  kvz_pixel *pred = ALIGNED_POINTER(_pred, SIMD_ALIGNMENT);
+  tr_cost_t tr_costs[MAX_PU_DEPTH + 1];
+
+  kvz_intra_predict(refs, log2_width, intra_mode, COLOR_Y, pred, filter_boundary);
+  kvz_tr_split_costs(state, width, COLOR_Y, CU_INTRA, num_levels,
+                     orig_block, pred, width, tr_costs);
+
+  const rd_cost_t nosplit_cost = RD_COST_DIST(tr_costs[0].ssd) +
+                                 RD_COST_BITS(state, RD_BITS_FROM_DOUBLE(tr_costs[0].bits));
+  for (int level = 1; level < num_levels; ++level) {
+    if (RD_COST_DIST(tr_costs[level].ssd) +
+        RD_COST_BITS(state, RD_BITS_FROM_DOUBLE(tr_costs[level].bits)) < nosplit_cost) {
+      return max_depth;
+    }
+  }
+  return depth;
+}
+
+
 /**
  * \brief  Find best intra mode out of the ones listed in parameter modes.
  *
@@ -564,7 +609,7 @@ static int8_t search_intra_rdo(encoder_state_t * const state,
                              kvz_pixel *orig, int32_t origstride,
                              int8_t *intra_preds,
                              int modes_to_check,
-                             int8_t modes[35], double costs[35],
+                             int8_t modes[35], rd_cost_t costs[35],
                              lcu_t *lcu)
 {
   const int tr_depth = CLIP(1, MAX_PU_DEPTH, depth + state->encoder_control->cfg.tr_depth_intra);
@@ -574,6 +619,20 @@ static int8_t search_intra_rdo(encoder_state_t * const state,
 
   kvz_pixels_blit(orig, orig_block, width, width, origstride, width);
 
+  // Maximum transform depth to search for each intra mode.
+  int8_t mode_tr_depth[35];
+  memset(mode_tr_depth, tr_depth, sizeof(mode_tr_depth));
+
+  const bool fast_tr_split = state->encoder_control->cfg.fast_tr_split &&
+                             !state->encoder_control->cfg.lossless &&
+                             tr_depth > depth && width <= TR_MAX_WIDTH;
+  kvz_intra_references refs;
+  if (fast_tr_split) {
+    const vector2d_t luma_px = { x_px, y_px };
+    const vector2d_t pic_px = { state->tile->frame->width, state->tile->frame->height };
+    kvz_intra_build_reference(LOG2_LCU_WIDTH - depth, COLOR_Y, &luma_px, &pic_px, lcu, &refs);
+  }
+
   // Check that the predicted modes are in the RDO mode list
   if (modes_to_check < 35) {
     for (int pred_mode = 0; pred_mode < 3; pred_mode++) {
@@ -593,8 +652,8 @@ static int8_t search_intra_rdo(encoder_state_t * const state,
   }
 
   for(int rdo_mode = 0; rdo_mode < modes_to_check; rdo_mode ++) {
-    double rdo_bitcost = kvz_luma_mode_bits(state, modes[rdo_mode], intra_preds);
-    costs[rdo_mode] = rdo_bitcost * state->lambda;
+    rd_bits_t rdo_bitcost = kvz_luma_mode_bits(state, modes[rdo_mode], intra_preds);
+    costs[rdo_mode] = RD_COST_BITS(state, rdo_bitcost);
 
     // Perform transform split search and save mode RD cost for the best one.
     cu_info_t pred_cu;
@@ -609,8 +668,13 @@ static int8_t search_intra_rdo(encoder_state_t * const state,
 
     // Reset transform split data in lcu.cu for this area.
     kvz_lcu_fill_trdepth(lcu, x_px, y_px, depth, depth);
+
+    if (fast_tr_split) {
+      mode_tr_depth[modes[rdo_mode]] = estimate_intra_tr_depth(state, depth, tr_depth, orig_block,
+                                                               &refs, modes[rdo_mode]);
+    }
     
-    double mode_cost = search_intra_trdepth(state, x_px, y_px, depth, tr_depth, modes[rdo_mode], MAX_INT, &pred_cu, lcu);
+    rd_cost_t mode_cost = search_intra_trdepth(state, x_px, y_px, depth, mode_tr_depth[modes[rdo_mode]], modes[rdo_mode], RD_COST_DIST(MAX_INT), &pred_cu, lcu);
     costs[rdo_mode] += mode_cost;
 
     // Early termination if no coefficients has to be coded
@@ -627,7 +691,7 @@ static int8_t search_intra_rdo(encoder_state_t * const state,
   // The best transform split hierarchy is not saved anywhere, so to get the
   // transform split hierarchy the search has to be performed again with the
   // best mode.
-  if (tr_depth != depth) {
+  if (mode_tr_depth[modes[0]] != depth) {
     cu_info_t pred_cu;
     pred_cu.depth = depth;
     pred_cu.type = CU_INTRA;
@@ -635,17 +699,17 @@ static int8_t search_intra_rdo(encoder_state_t * const state,
     pred_cu.intra.mode = modes[0];
     pred_cu.intra.mode_chroma = modes[0];
     FILL(pred_cu.cbf, 0);
-    search_intra_trdepth(state, x_px, y_px, depth, tr_depth, modes[0], MAX_INT, &pred_cu, lcu);
+    search_intra_trdepth(state, x_px, y_px, depth, mode_tr_depth[modes[0]], modes[0], RD_COST_DIST(MAX_INT), &pred_cu, lcu);
   }
 
   return modes_to_check;
 }
 
 
-double kvz_luma_mode_bits(const encoder_state_t *state, int8_t luma_mode, const int8_t *intra_preds)
+rd_bits_t kvz_luma_mode_bits(const encoder_state_t *state, int8_t luma_mode, const int8_t *intra_preds)
 {
   cabac_data_t* cabac = (cabac_data_t *)&state->search_cabac;
-  double mode_bits = 0;
+  rd_bits_t mode_bits = 0;
 
   bool mode_in_preds = false;
   for (int i = 0; i < 3; ++i) {
@@ -671,24 +735,24 @@ double kvz_luma_mode_bits(const encoder_state_t *state, int8_t luma_mode, const
   }
 
   if (mode_in_preds) {
-    mode_bits += ((luma_mode == intra_preds[0]) ? 1 : 2);
+    mode_bits += RD_BITS((luma_mode == intra_preds[0]) ? 1 : 2);
   } else {
-    mode_bits += 5;
+    mode_bits += RD_BITS(5);
   }
 
   return mode_bits;
 }
 
 
-double kvz_chroma_mode_bits(const encoder_state_t *state, int8_t chroma_mode, int8_t luma_mode)
+rd_bits_t kvz_chroma_mode_bits(const encoder_state_t *state, int8_t chroma_mode, int8_t luma_mode)
 {
   cabac_data_t* cabac = (cabac_data_t*)&state->search_cabac;
   cabac_ctx_t *ctx = &(cabac->ctx.chroma_pred_model[0]);
 
-  double mode_bits = 0;
+  rd_bits_t mode_bits = 0;
   CABAC_FBITS_UPDATE(cabac, ctx, chroma_mode != luma_mode, mode_bits, "intra_chroma_pred_mode");
   if (chroma_mode != luma_mode) {
-    mode_bits += 2.0;
+    mode_bits += RD_BITS(2);
   }
 
   if(cabac->update) {
@@ -715,12 +779,12 @@ int8_t kvz_search_intra_chroma_rdo(encoder_state_t * const state,
     cu_info_t *const tr_cu = LCU_GET_CU_AT_PX(lcu, lcu_px.x, lcu_px.y);
 
     struct {
-      double cost;
+      rd_cost_t cost;
       int8_t mode;
     } chroma, best_chroma;
 
     best_chroma.mode = 0;
-    best_chroma.cost = MAX_INT;
+    best_chroma.cost = RD_COST_DIST(MAX_INT);
 
     for (int8_t chroma_mode_i = 0; chroma_mode_i < num_modes; ++chroma_mode_i) {
       chroma.mode = modes[chroma_mode_i];
@@ -730,12 +794,12 @@ int8_t kvz_search_intra_chroma_rdo(encoder_state_t * const state,
                          depth,
                          -1, chroma.mode, // skip luma
                          NULL, lcu);
-      double bits = 0;
+      rd_bits_t bits = 0;
       chroma.cost = kvz_cu_rd_cost_chroma(state, lcu_px.x, lcu_px.y, depth, tr_cu, lcu);
 
-      double mode_bits = kvz_chroma_mode_bits(state, chroma.mode, intra_mode);
+      rd_bits_t mode_bits = kvz_chroma_mode_bits(state, chroma.mode, intra_mode);
       bits += mode_bits;
-      chroma.cost += mode_bits * state->lambda;
+      chroma.cost += RD_COST_BITS(state, mode_bits);
 
       if (chroma.cost < best_chroma.cost) {
         best_chroma = chroma;
@@ -758,7 +822,7 @@ int8_t kvz_search_cu_intra_chroma(encoder_state_t * const state,
   cu_info_t *cur_pu = LCU_GET_CU_AT_PX(lcu, lcu_px.x, lcu_px.y);
   int8_t intra_mode = cur_pu->intra.mode;
 
-  double costs[5];
+  rd_cost_t costs[5];
   int8_t modes[5] = { 0, 26, 10, 1, 34 };
   if (intra_mode != 0 && intra_mode != 26 && intra_mode != 10 && intra_mode != 1) {
     modes[4] = intra_mode;
@@ -816,7 +880,7 @@ int8_t kvz_search_cu_intra_chroma(encoder_state_t * const state,
 void kvz_search_cu_intra(encoder_state_t * const state,
                          const int x_px, const int y_px,
                          const int depth, lcu_t *lcu,
-                         int8_t *mode_out, double *cost_out)
+                         int8_t *mode_out, rd_cost_t *cost_out)
 {
   const vector2d_t lcu_px = { SUB_SCU(x_px), SUB_SCU(y_px) };
   const int_fast8_t log2_width = LOG2_LCU_WIDTH - depth;
@@ -847,7 +911,7 @@ void kvz_search_cu_intra(encoder_state_t * const state,
   }
 
   int8_t modes[35];
-  double costs[35];
+  rd_cost_t costs[35];
 
   // Find best intra mode for 2Nx2N.
   kvz_pixel *ref_pixels = &lcu->ref.y[lcu_px.x + lcu_px.y * LCU_WIDTH];
@@ -864,7 +928,7 @@ void kvz_search_cu_intra(encoder_state_t * const state,
     number_of_modes = 35;
     for (int i = 0; i < number_of_modes; ++i) {
       modes[i] = i;
-      costs[i] = MAX_INT;
+      costs[i] = RD_COST_DIST(MAX_INT);
     }
   }
 
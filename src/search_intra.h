@@ -43,10 +43,10 @@
 #include "global.h" // IWYU pragma: keep
 
 
-double kvz_luma_mode_bits(const encoder_state_t *state, 
+rd_bits_t kvz_luma_mode_bits(const encoder_state_t *state, 
                       int8_t luma_mode, const int8_t *intra_preds);
                        
-double kvz_chroma_mode_bits(const encoder_state_t *state,
+rd_bits_t kvz_chroma_mode_bits(const encoder_state_t *state,
                         int8_t chroma_mode, int8_t luma_mode);
 
 int8_t kvz_search_cu_intra_chroma(encoder_state_t * const state,
@@ -56,6 +56,6 @@ int8_t kvz_search_cu_intra_chroma(encoder_state_t * const state,
 void kvz_search_cu_intra(encoder_state_t * const state,
                          const int x_px, const int y_px,
                          const int depth, lcu_t *lcu,
-                         int8_t *mode_out, double *cost_out);
+                         int8_t *mode_out, rd_cost_t *cost_out);
 
 #endif // SEARCH_INTRA_H_
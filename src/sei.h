@@ -39,8 +39,10 @@
 
 #include "global.h" // IWYU pragma: keep
 
+#define SEI_PAYLOAD_TYPE_BUFFERING_PERIOD 0
 #define SEI_PAYLOAD_TYPE_PIC_TIMING 1
 #define SEI_PAYLOAD_TYPE_USER_DATA_UNREGISTERED 5
+#define SEI_PAYLOAD_TYPE_RECOVERY_POINT 6
 #define SEI_PAYLOAD_TYPE_DECODED_PICTURE_HASH 132
 
 // Flag value used for length / value extension.
@@ -809,10 +809,17 @@ static void matrix_dct_16x16_avx2(int8_t bitdepth, const int16_t *input, int16_t
 // 32x32 matrix multiplication with value clipping.
 // Parameters: Two 32x32 matrices containing 16-bit values in consecutive addresses,
 //             destination for the result and the shift value for clipping.
-static void mul_clip_matrix_32x32_avx2(const int16_t *left,
-                                       const int16_t *right,
-                                             int16_t *dst,
-                                       const int32_t  shift)
+//             Only the first left_rows rows of the left matrix, the first
+//             right_rows rows of the right matrix and the first right_cols
+//             (16 or 32) columns of the right matrix are used, the rest of
+//             the result is zero.
+static INLINE void mul_clip_matrix_32x32_part_avx2(const int16_t *left,
+                                                   const int16_t *right,
+                                                         int16_t *dst,
+                                                   const int32_t  shift,
+                                                   const int32_t  left_rows,
+                                                   const int32_t  right_rows,
+                                                   const int32_t  right_cols)
 {
   const int32_t add    = 1 << (shift - 1);
   const __m256i debias = _mm256_set1_epi32(add);
@@ -824,7 +831,7 @@ static void mul_clip_matrix_32x32_avx2(const int16_t *left,
   __m256i accu[128] = {_mm256_setzero_si256()};
   size_t i, j;
 
-  for (j = 0; j < 64; j += 4) {
+  for (j = 0; j < (size_t)right_rows * 2; j += 4) {
     const __m256i r0 = r_v[j + 0];
     const __m256i r1 = r_v[j + 1];
     const __m256i r2 = r_v[j + 2];
@@ -841,7 +848,7 @@ static void mul_clip_matrix_32x32_avx2(const int16_t *left,
     __m256i r13_07 = _mm256_permute2x128_si256(r13l, r13h, 0x20);
     __m256i r13_8f = _mm256_permute2x128_si256(r13l, r13h, 0x31);
 
-    for (i = 0; i < 32; i += 2) {
+    for (i = 0; i < (size_t)left_rows; i += 2) {
       size_t acc_base = i << 2;
 
       uint32_t curr_e    = l_32[(i + 0) * (32 / 2) + (j >> 2)];
@@ -852,23 +859,29 @@ static void mul_clip_matrix_32x32_avx2(const int16_t *left,
 
       __m256i p_e0       = _mm256_madd_epi16(even, r02_07);
       __m256i p_e1       = _mm256_madd_epi16(even, r02_8f);
-      __m256i p_e2       = _mm256_madd_epi16(even, r13_07);
-      __m256i p_e3       = _mm256_madd_epi16(even, r13_8f);
 
       __m256i p_o0       = _mm256_madd_epi16(odd,  r02_07);
       __m256i p_o1       = _mm256_madd_epi16(odd,  r02_8f);
-      __m256i p_o2       = _mm256_madd_epi16(odd,  r13_07);
-      __m256i p_o3       = _mm256_madd_epi16(odd,  r13_8f);
 
       accu[acc_base + 0] = _mm256_add_epi32 (p_e0, accu[acc_base + 0]);
       accu[acc_base + 1] = _mm256_add_epi32 (p_e1, accu[acc_base + 1]);
-      accu[acc_base + 2] = _mm256_add_epi32 (p_e2, accu[acc_base + 2]);
-      accu[acc_base + 3] = _mm256_add_epi32 (p_e3, accu[acc_base + 3]);
 
       accu[acc_base + 4] = _mm256_add_epi32 (p_o0, accu[acc_base + 4]);
       accu[acc_base + 5] = _mm256_add_epi32 (p_o1, accu[acc_base + 5]);
-      accu[acc_base + 6] = _mm256_add_epi32 (p_o2, accu[acc_base + 6]);
-      accu[acc_base + 7] = _mm256_add_epi32 (p_o3, accu[acc_base + 7]);
+
+      if (right_cols > 16) {
+        __m256i p_e2       = _mm256_madd_epi16(even, r13_07);
+        __m256i p_e3       = _mm256_madd_epi16(even, r13_8f);
+
+        __m256i p_o2       = _mm256_madd_epi16(odd,  r13_07);
+        __m256i p_o3       = _mm256_madd_epi16(odd,  r13_8f);
+
+        accu[acc_base + 2] = _mm256_add_epi32 (p_e2, accu[acc_base + 2]);
+        accu[acc_base + 3] = _mm256_add_epi32 (p_e3, accu[acc_base + 3]);
+
+        accu[acc_base + 6] = _mm256_add_epi32 (p_o2, accu[acc_base + 6]);
+        accu[acc_base + 7] = _mm256_add_epi32 (p_o3, accu[acc_base + 7]);
+      }
     }
   }
 
@@ -892,6 +905,14 @@ static void mul_clip_matrix_32x32_avx2(const int16_t *left,
   }
 }
 
+static void mul_clip_matrix_32x32_avx2(const int16_t *left,
+                                       const int16_t *right,
+                                             int16_t *dst,
+                                       const int32_t  shift)
+{
+  mul_clip_matrix_32x32_part_avx2(left, right, dst, shift, 32, 32, 32);
+}
+
 // Macro that generates 2D transform functions with clipping values.
 // Sets correct shift values and matrices according to transform type and
 // block size. Performs matrix multiplication horizontally and vertically.
@@ -938,6 +959,35 @@ static void matrix_i ## type ## _## n ## x ## n ## _avx2(int8_t bitdepth, const
 TRANSFORM(dct, 32);
 ITRANSFORM(dct, 32);
 
+static void matrix_dct_32x32_lowfreq_avx2(int8_t bitdepth, const int16_t *input, int16_t *output)
+{
+  int32_t shift_1st = kvz_g_convert_to_bit[32] + 1 + (bitdepth - 8);
+  int32_t shift_2nd = kvz_g_convert_to_bit[32] + 8;
+  ALIGNED(64) int16_t tmp[32 * 32];
+  const int16_t *tdct = &kvz_g_dct_32_t[0][0];
+  const int16_t *dct = &kvz_g_dct_32[0][0];
+
+  // Only the first 16 columns of the first product are needed for the
+  // first 16 rows and columns of the result.
+  mul_clip_matrix_32x32_part_avx2(input, tdct, tmp, shift_1st, 32, 32, 16);
+  mul_clip_matrix_32x32_part_avx2(dct, tmp, output, shift_2nd, 16, 32, 16);
+}
+
+static void matrix_idct_32x32_partial_avx2(int8_t bitdepth, const int16_t *input, int16_t *output,
+                                           int32_t num_rows, int32_t num_cols)
+{
+  int32_t shift_1st = 7;
+  int32_t shift_2nd = 12 - (bitdepth - 8);
+  ALIGNED(64) int16_t tmp[32 * 32];
+  const int16_t *tdct = &kvz_g_dct_32_t[0][0];
+  const int16_t *dct = &kvz_g_dct_32[0][0];
+
+  // Rows of the input beyond num_rows are zero, and so are the columns of
+  // tmp beyond num_cols.
+  mul_clip_matrix_32x32_part_avx2(tdct, input, tmp, shift_1st, 32, num_rows, num_cols > 16 ? 32 : 16);
+  mul_clip_matrix_32x32_part_avx2(tmp, dct, output, shift_2nd, 32, num_cols, 32);
+}
+
 #endif // KVZ_BIT_DEPTH == 8
 #endif //COMPILE_INTEL_AVX2
 
@@ -960,6 +1010,9 @@ int kvz_strategy_register_dct_avx2(void* opaque, uint8_t bitdepth)
     success &= kvz_strategyselector_register(opaque, "idct_8x8", "avx2", 40, &matrix_idct_8x8_avx2);
     success &= kvz_strategyselector_register(opaque, "idct_16x16", "avx2", 40, &matrix_idct_16x16_avx2);
     success &= kvz_strategyselector_register(opaque, "idct_32x32", "avx2", 40, &matrix_idct_32x32_avx2);
+
+    success &= kvz_strategyselector_register(opaque, "dct_32x32_lowfreq", "avx2", 40, &matrix_dct_32x32_lowfreq_avx2);
+    success &= kvz_strategyselector_register(opaque, "idct_32x32_partial", "avx2", 40, &matrix_idct_32x32_partial_avx2);
   }
 #endif // KVZ_BIT_DEPTH == 8
 #endif //COMPILE_INTEL_AVX2  
@@ -253,7 +253,7 @@ void kvz_encode_coeff_nxn_avx2(encoder_state_t * const state,
                                uint8_t type,
                                int8_t scan_mode,
                                int8_t tr_skip,
-                               double* bits_out)
+                               rd_bits_t* bits_out)
 {
   const encoder_control_t * const encoder = state->encoder_control;
   int c1 = 1;
@@ -261,7 +261,7 @@ void kvz_encode_coeff_nxn_avx2(encoder_state_t * const state,
   uint8_t last_coeff_y = 0;
   int32_t i;
   uint32_t sig_coeffgroup_nzs[8 * 8] = { 0 };
-  double bits = 0;
+  rd_bits_t bits = 0;
 
   int8_t be_valid = encoder->cfg.signhide_enable;
   int32_t scan_pos_sig;
@@ -544,7 +544,7 @@ void kvz_encode_coeff_nxn_avx2(encoder_state_t * const state,
         }
       }
       CABAC_BINS_EP(cabac, coeff_signs, nnz, "coeff_sign_flag");
-      if (cabac->only_count) bits += nnz;
+      if (cabac->only_count) bits += RD_BITS(nnz);
 
       if (c1 == 0 || num_non_zero > C1FLAG_NUMBER) {
 
@@ -585,7 +585,7 @@ void kvz_encode_coeff_nxn_avx2(encoder_state_t * const state,
             if (!cabac->only_count && (encoder->cfg.crypto_features & KVZ_CRYPTO_TRANSF_COEFFS)) {
               kvz_cabac_write_coeff_remain_encry(state, cabac, level_diff, go_rice_param, base_level);
             } else {
-              bits += kvz_cabac_write_coeff_remain(cabac, level_diff, go_rice_param);
+              bits += RD_BITS(kvz_cabac_write_coeff_remain(cabac, level_diff, go_rice_param));
             }
 
             if (curr_abs_coeff > 3 * (1 << go_rice_param)) {
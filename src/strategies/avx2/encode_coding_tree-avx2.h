@@ -48,7 +48,7 @@ void kvz_encode_coeff_nxn_avx2(encoder_state_t * const state,
                                uint8_t type,
                                int8_t scan_mode,
                                int8_t tr_skip,
-                               double* bits_out);
+                               rd_bits_t* bits_out);
 
 int kvz_strategy_register_encode_avx2(void* opaque, uint8_t bitdepth);
 
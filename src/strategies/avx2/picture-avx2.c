@@ -1709,6 +1709,110 @@ static double pixel_var_avx2(const uint8_t *buf, const uint32_t len)
 
 #endif // !INACCURATE_VARIANCE_CALCULATION
 
+static void ssim_4x4_stats_avx2(const uint8_t *ref, int ref_stride,
+                                const uint8_t *rec, int rec_stride,
+                                int blocks, int32_t sums[][4])
+{
+  const __m256i ones = _mm256_set1_epi16(1);
+  int i = 0;
+
+  // Four blocks at a time. Each 128-bit lane holds two blocks.
+  for (; i + 4 <= blocks; i += 4) {
+    __m256i s1  = _mm256_setzero_si256();
+    __m256i s2  = _mm256_setzero_si256();
+    __m256i ss  = _mm256_setzero_si256();
+    __m256i s12 = _mm256_setzero_si256();
+
+    for (int y = 0; y < 4; ++y) {
+      __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&ref[i * 4 + y * ref_stride]));
+      __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&rec[i * 4 + y * rec_stride]));
+
+      s1  = _mm256_add_epi32(s1,  _mm256_madd_epi16(a, ones));
+      s2  = _mm256_add_epi32(s2,  _mm256_madd_epi16(b, ones));
+      ss  = _mm256_add_epi32(ss,  _mm256_add_epi32(_mm256_madd_epi16(a, a),
+                                                   _mm256_madd_epi16(b, b)));
+      s12 = _mm256_add_epi32(s12, _mm256_madd_epi16(a, b));
+    }
+
+    // Reduce pairs to blocks and transpose to [s1 s2 ss s12] per block.
+    __m256i s1_ss  = _mm256_hadd_epi32(s1, ss);
+    __m256i s2_s12 = _mm256_hadd_epi32(s2, s12);
+    __m256i lo     = _mm256_unpacklo_epi32(s1_ss, s2_s12);
+    __m256i hi     = _mm256_unpackhi_epi32(s1_ss, s2_s12);
+    __m256i even   = _mm256_unpacklo_epi64(lo, hi);
+    __m256i odd    = _mm256_unpackhi_epi64(lo, hi);
+
+    _mm256_storeu_si256((__m256i *)sums[i],     _mm256_permute2x128_si256(even, odd, 0x20));
+    _mm256_storeu_si256((__m256i *)sums[i + 2], _mm256_permute2x128_si256(even, odd, 0x31));
+  }
+
+  for (; i < blocks; ++i) {
+    int32_t s1 = 0, s2 = 0, ss = 0, s12 = 0;
+    for (int y = 0; y < 4; ++y) {
+      for (int x = 0; x < 4; ++x) {
+        const int32_t a = ref[i * 4 + x + y * ref_stride];
+        const int32_t b = rec[i * 4 + x + y * rec_stride];
+        s1  += a;
+        s2  += b;
+        ss  += a * a + b * b;
+        s12 += a * b;
+      }
+    }
+    sums[i][0] = s1;
+    sums[i][1] = s2;
+    sums[i][2] = ss;
+    sums[i][3] = s12;
+  }
+}
+
+static void pixel_4x4_sums_avx2(const uint8_t *buf, int stride,
+                                int blocks, int32_t sums[][2])
+{
+  const __m256i ones_8  = _mm256_set1_epi8(1);
+  const __m256i ones_16 = _mm256_set1_epi16(1);
+  const __m256i zero    = _mm256_setzero_si256();
+  int i = 0;
+
+  // Eight blocks at a time, each 128-bit lane holds four blocks in order.
+  for (; i + 8 <= blocks; i += 8) {
+    __m256i s  = _mm256_setzero_si256();
+    __m256i ss = _mm256_setzero_si256();
+
+    for (int y = 0; y < 4; ++y) {
+      __m256i a    = _mm256_loadu_si256((const __m256i *)&buf[i * 4 + y * stride]);
+      __m256i a_lo = _mm256_unpacklo_epi8(a, zero);
+      __m256i a_hi = _mm256_unpackhi_epi8(a, zero);
+
+      __m256i pairs = _mm256_maddubs_epi16(a, ones_8);
+      __m256i sq    = _mm256_hadd_epi32(_mm256_madd_epi16(a_lo, a_lo),
+                                        _mm256_madd_epi16(a_hi, a_hi));
+
+      s  = _mm256_add_epi32(s,  _mm256_madd_epi16(pairs, ones_16));
+      ss = _mm256_add_epi32(ss, sq);
+    }
+
+    // Interleave to [sum sq_sum] per block.
+    __m256i lo = _mm256_unpacklo_epi32(s, ss);
+    __m256i hi = _mm256_unpackhi_epi32(s, ss);
+
+    _mm256_storeu_si256((__m256i *)sums[i],     _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *)sums[i + 4], _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+
+  for (; i < blocks; ++i) {
+    int32_t sum = 0, sq_sum = 0;
+    for (int y = 0; y < 4; ++y) {
+      for (int x = 0; x < 4; ++x) {
+        const int32_t a = buf[i * 4 + x + y * stride];
+        sum    += a;
+        sq_sum += a * a;
+      }
+    }
+    sums[i][0] = sum;
+    sums[i][1] = sq_sum;
+  }
+}
+
 #endif // KVZ_BIT_DEPTH == 8
 #endif //COMPILE_INTEL_AVX2
 
@@ -1750,6 +1854,8 @@ int kvz_strategy_register_picture_avx2(void* opaque, uint8_t bitdepth)
     success &= kvz_strategyselector_register(opaque, "hor_sad", "avx2", 40, &hor_sad_avx2);
 
     success &= kvz_strategyselector_register(opaque, "pixel_var", "avx2", 40, &pixel_var_avx2);
+    success &= kvz_strategyselector_register(opaque, "ssim_4x4_stats", "avx2", 40, &ssim_4x4_stats_avx2);
+    success &= kvz_strategyselector_register(opaque, "pixel_4x4_sums", "avx2", 40, &pixel_4x4_sums_avx2);
 
   }
 #endif // KVZ_BIT_DEPTH == 8
@@ -39,8 +39,10 @@
 #if COMPILE_INTEL_AVX2 && defined X86_64
 #include <immintrin.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "avx2_common_functions.h"
+#include "context.h"
 #include "cu.h"
 #include "encoder.h"
 #include "encoderstate.h"
@@ -48,6 +50,7 @@
 #include "rdo.h"
 #include "scalinglist.h"
 #include "strategies/generic/quant-generic.h"
+#include "strategies/strategies-dct.h"
 #include "strategies/strategies-quant.h"
 #include "strategyselector.h"
 #include "tables.h"
@@ -665,17 +668,20 @@ int kvz_quantize_residual_avx2(encoder_state_t *const state,
     kvz_transformskip(state->encoder_control, residual, coeff, width);
   }
   else {
-    kvz_transform2d(state->encoder_control, residual, coeff, width, color, cur_cu->type);
+    kvz_transform2d(state, residual, coeff, width, color, cur_cu->type);
   }
 
   // Quantize coeffs. (coeff -> coeff_out)
-  if (state->encoder_control->cfg.rdoq_enable &&
-      (width > 4 || !state->encoder_control->cfg.rdoq_skip))
+  const enum kvz_quant_mode quant_mode = kvz_select_quant_mode(state->encoder_control, width);
+  if (quant_mode == KVZ_QUANT_RDOQ)
   {
     int8_t tr_depth = cur_cu->tr_depth - cur_cu->depth;
     tr_depth += (cur_cu->part_size == SIZE_NxN ? 1 : 0);
     kvz_rdoq(state, coeff, coeff_out, width, width, (color == COLOR_Y ? 0 : 2),
       scan_order, cur_cu->type, tr_depth);
+  } else if (quant_mode == KVZ_QUANT_APPROX) {
+    kvz_quant_approx(state, coeff, coeff_out, width, width, (color == COLOR_Y ? 0 : 2),
+      scan_order, cur_cu->type);
   } else {
     kvz_quant(state, coeff, coeff_out, width, width, (color == COLOR_Y ? 0 : 2),
       scan_order, cur_cu->type);
@@ -863,6 +869,592 @@ static double fast_coeff_cost_avx2(const coeff_t *coeff, int32_t width, uint64_t
   return (double)(temp) / 256.0;
 }
 
+#if KVZ_BIT_DEPTH == 8
+
+/**
+ * \brief Load 16 pixels that are contiguous in a width x width block.
+ *
+ * Those are 4 rows of a 4x4 block, 2 rows of an 8x8 block or 16 pixels of
+ * one row of a larger block.
+ */
+static INLINE __m256i load_16_pixels_avx2(const uint8_t *src, int stride, int width)
+{
+  __m128i pixels;
+  if (width == 4) {
+    pixels = _mm_setr_epi32(*(int32_t*)&src[0 * stride], *(int32_t*)&src[1 * stride],
+                            *(int32_t*)&src[2 * stride], *(int32_t*)&src[3 * stride]);
+  } else if (width == 8) {
+    pixels = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i*)&src[0]),
+                                _mm_loadl_epi64((__m128i*)&src[stride]));
+  } else {
+    pixels = _mm_loadu_si128((__m128i*)src);
+  }
+  return _mm256_cvtepu8_epi16(pixels);
+}
+
+/**
+ * \brief Reconstruct a block from the residual and return its SSD.
+ */
+static INLINE uint64_t recon_ssd_avx2(const int16_t *residual, const uint8_t *ref,
+                                      const uint8_t *pred, int stride, int width)
+{
+  const __m256i max_pixel = _mm256_set1_epi16(PIXEL_MAX);
+  const int rows_per_load = MAX(1, 16 / width);
+  __m256i sum = _mm256_setzero_si256();
+
+  for (int y = 0; y < width; y += rows_per_load) {
+    for (int x = 0; x < width; x += 16) {
+      __m256i v_pred = load_16_pixels_avx2(&pred[x + y * stride], stride, width);
+      __m256i v_ref = load_16_pixels_avx2(&ref[x + y * stride], stride, width);
+      __m256i v_res = _mm256_loadu_si256((__m256i*)&residual[x + y * width]);
+
+      __m256i v_rec = _mm256_adds_epi16(v_pred, v_res);
+      v_rec = _mm256_min_epi16(_mm256_max_epi16(v_rec, _mm256_setzero_si256()), max_pixel);
+
+      __m256i v_diff = _mm256_sub_epi16(v_ref, v_rec);
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v_diff, v_diff));
+    }
+  }
+
+  return (uint64_t)hsum32_8x32i(sum);
+}
+
+/**
+ * \brief Estimate the cost of a block with each transform size.
+ *
+ * AVX2 version of tr_split_costs_generic. Every transform block is taken
+ * through the whole chain while it is in cache, and the reconstruction is
+ * only used for the SSD and never written out.
+ */
+static void tr_split_costs_avx2(encoder_state_t *const state,
+  const int width, const color_t color, const cu_type_t type, const int num_levels,
+  const kvz_pixel *const ref_in, const kvz_pixel *const pred_in, const int stride,
+  tr_cost_t *costs_out)
+{
+  ALIGNED(64) int16_t residual[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  ALIGNED(64) coeff_t coeff[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  ALIGNED(64) coeff_t quant_coeff[TR_MAX_WIDTH * TR_MAX_WIDTH];
+
+  const encoder_control_t *const encoder = state->encoder_control;
+  const uint64_t weights = kvz_fast_coeff_get_weights(state);
+
+  assert(width <= TR_MAX_WIDTH);
+  assert((width >> (num_levels - 1)) >= TR_MIN_WIDTH);
+
+  for (int level = 0; level < num_levels; ++level) {
+    const int tr_width = width >> level;
+    dct_func *const dct = kvz_get_dct_func(tr_width, color, type);
+    dct_func *const idct = kvz_get_idct_func(tr_width, color, type);
+    uint64_t ssd = 0;
+    double bits = 0;
+
+    for (int y0 = 0; y0 < width; y0 += tr_width) {
+      for (int x0 = 0; x0 < width; x0 += tr_width) {
+        const kvz_pixel *const ref = &ref_in[x0 + y0 * stride];
+        const kvz_pixel *const pred = &pred_in[x0 + y0 * stride];
+
+        get_residual_avx2(ref, pred, residual, tr_width, stride);
+        dct(encoder->bitdepth, residual, coeff);
+        kvz_quant_avx2(state, coeff, quant_coeff, tr_width, tr_width, (color == COLOR_Y ? 0 : 2),
+          SCAN_DIAG, type);
+        bits += fast_coeff_cost_avx2(quant_coeff, tr_width, weights);
+
+        int has_coeffs = 0;
+        for (int i = 0; i < tr_width * tr_width; i += 8) {
+          __m128i v_quant_coeff = _mm_loadu_si128((__m128i*)&quant_coeff[i]);
+          if (!_mm_testz_si128(v_quant_coeff, v_quant_coeff)) {
+            has_coeffs = 1;
+            break;
+          }
+        }
+
+        if (has_coeffs) {
+          kvz_dequant_avx2(state, quant_coeff, coeff, tr_width, tr_width,
+            (color == COLOR_Y ? 0 : (color == COLOR_U ? 2 : 3)), type);
+          idct(encoder->bitdepth, coeff, residual);
+        } else {
+          memset(residual, 0, tr_width * tr_width * sizeof(residual[0]));
+        }
+
+        ssd += recon_ssd_avx2(residual, ref, pred, stride, tr_width);
+      }
+    }
+
+    costs_out[level].ssd = ssd;
+    costs_out[level].bits = bits;
+  }
+}
+
+#endif // KVZ_BIT_DEPTH == 8
+
+#define SCAN_SET_SIZE 16
+
+/**
+ * \brief Distortions of the candidate levels of a coefficient group.
+ *
+ * All arrays are indexed by the scan position in the group.
+ */
+typedef struct {
+  int32_t level_double[16];
+  uint32_t max_abs_level[16];
+  //! Distortion when the level is 0.
+  double cost0[16];
+  //! Distortion when the level is max_abs_level.
+  double cost_max[16];
+  //! Distortion when the level is max_abs_level - 1.
+  double cost_max_m1[16];
+} rdoq_cg_dist_t;
+
+/**
+ * \brief Compute the scaled and quantized levels of a coefficient group.
+ *
+ * \param coef          coefficients
+ * \param scan          raster positions of the 16 coefficients
+ * \param quant_coeff   quantization scales
+ * \param q_bits        quantization shift
+ * \param level_double  returns the scaled absolute values of the coefficients
+ * \param max_abs_level returns the rounded quantized levels
+ */
+static INLINE void rdoq_cg_levels_avx2(const coeff_t *coef,
+                                       const uint32_t *scan,
+                                       const int32_t *quant_coeff,
+                                       const int32_t q_bits,
+                                       __m256i level_double[2],
+                                       __m256i max_abs_level[2])
+{
+  int32_t coef_scan[16];
+  for (int i = 0; i < 16; ++i) {
+    coef_scan[i] = coef[scan[i]];
+  }
+
+  const __m256i half = _mm256_set1_epi32(1 << (q_bits - 1));
+  const __m256i max_level = _mm256_set1_epi32(MAX_INT - (1 << (q_bits - 1)));
+  const __m128i shift = _mm_cvtsi32_si128(q_bits);
+
+  for (int i = 0; i < 2; ++i) {
+    const __m256i idx = _mm256_loadu_si256((const __m256i *)&scan[8 * i]);
+    const __m256i c = _mm256_loadu_si256((const __m256i *)&coef_scan[8 * i]);
+    const __m256i q = _mm256_i32gather_epi32(quant_coeff, idx, 4);
+
+    level_double[i] = _mm256_min_epi32(_mm256_mullo_epi32(_mm256_abs_epi32(c), q), max_level);
+    max_abs_level[i] = _mm256_sra_epi32(_mm256_add_epi32(level_double[i], half), shift);
+  }
+}
+
+/**
+ * \brief Compute the distortions of the candidate levels of a coefficient
+ * group.
+ *
+ * The operations are the same as in kvz_rdoq_generic, so that the results
+ * are bit-exact.
+ */
+static INLINE void rdoq_cg_dist_avx2(const coeff_t *coef,
+                                     const uint32_t *scan,
+                                     const int32_t *quant_coeff,
+                                     const double *err_scale,
+                                     const int32_t q_bits,
+                                     rdoq_cg_dist_t *out)
+{
+  __m256i level_double[2];
+  __m256i max_abs_level[2];
+  rdoq_cg_levels_avx2(coef, scan, quant_coeff, q_bits, level_double, max_abs_level);
+
+  const __m128i shift = _mm_cvtsi32_si128(q_bits);
+  const __m256i one_level = _mm256_set1_epi32(1 << q_bits);
+
+  for (int i = 0; i < 2; ++i) {
+    _mm256_storeu_si256((__m256i *)&out->level_double[8 * i], level_double[i]);
+    _mm256_storeu_si256((__m256i *)&out->max_abs_level[8 * i], max_abs_level[i]);
+
+    const __m256i err_max = _mm256_sub_epi32(level_double[i], _mm256_sll_epi32(max_abs_level[i], shift));
+    const __m256i err_max_m1 = _mm256_add_epi32(err_max, one_level);
+
+    for (int j = 0; j < 2; ++j) {
+      const int pos = 8 * i + 4 * j;
+      const __m128i idx = _mm_loadu_si128((const __m128i *)&scan[pos]);
+      const __m256d temp = _mm256_i32gather_pd(err_scale, idx, 8);
+
+      const __m256d e = _mm256_cvtepi32_pd(j ? _mm256_extracti128_si256(level_double[i], 1)
+                                             : _mm256_castsi256_si128(level_double[i]));
+      const __m256d e_max = _mm256_cvtepi32_pd(j ? _mm256_extracti128_si256(err_max, 1)
+                                                 : _mm256_castsi256_si128(err_max));
+      const __m256d e_max_m1 = _mm256_cvtepi32_pd(j ? _mm256_extracti128_si256(err_max_m1, 1)
+                                                    : _mm256_castsi256_si128(err_max_m1));
+
+      _mm256_storeu_pd(&out->cost0[pos], _mm256_mul_pd(_mm256_mul_pd(e, e), temp));
+      _mm256_storeu_pd(&out->cost_max[pos], _mm256_mul_pd(_mm256_mul_pd(e_max, e_max), temp));
+      _mm256_storeu_pd(&out->cost_max_m1[pos], _mm256_mul_pd(_mm256_mul_pd(e_max_m1, e_max_m1), temp));
+    }
+  }
+}
+
+/**
+ * \brief Get the best level in RD sense using precomputed distortions.
+ *
+ * Same as kvz_get_coded_level.
+ */
+static INLINE uint32_t rdoq_coded_level_avx2(encoder_state_t * const state,
+                                             double *coded_cost, double coded_cost0, double *coded_cost_sig,
+                                             uint32_t max_abs_level, double cost_max, double cost_max_m1,
+                                             uint16_t ctx_num_sig, uint16_t ctx_num_one, uint16_t ctx_num_abs,
+                                             uint16_t abs_go_rice,
+                                             uint32_t c1_idx, uint32_t c2_idx,
+                                             int8_t last, int8_t type)
+{
+  cabac_data_t * const cabac = &state->cabac;
+  double cur_cost_sig = 0;
+  uint32_t best_abs_level = 0;
+  cabac_ctx_t* base_sig_model = type ? (cabac->ctx.cu_sig_model_chroma) : (cabac->ctx.cu_sig_model_luma);
+
+  if (!last && max_abs_level < 3) {
+    *coded_cost_sig = state->lambda * CTX_ENTROPY_BITS(&base_sig_model[ctx_num_sig], 0);
+    *coded_cost     = coded_cost0 + *coded_cost_sig;
+    if (max_abs_level == 0) return best_abs_level;
+  } else {
+    *coded_cost = MAX_DOUBLE;
+  }
+
+  if (!last) {
+    cur_cost_sig = state->lambda * CTX_ENTROPY_BITS(&base_sig_model[ctx_num_sig], 1);
+  }
+
+  const uint32_t min_abs_level = (max_abs_level > 1 ? max_abs_level - 1 : 1);
+  for (uint32_t abs_level = max_abs_level; abs_level >= min_abs_level; abs_level--) {
+    double cur_cost = (abs_level == max_abs_level ? cost_max : cost_max_m1) + state->lambda *
+                      kvz_get_ic_rate(state, abs_level, ctx_num_one, ctx_num_abs,
+                                      abs_go_rice, c1_idx, c2_idx, type);
+    cur_cost += cur_cost_sig;
+
+    if (cur_cost < *coded_cost) {
+      best_abs_level  = abs_level;
+      *coded_cost     = cur_cost;
+      *coded_cost_sig = cur_cost_sig;
+    }
+  }
+
+  return best_abs_level;
+}
+
+/**
+ * \brief RDOQ with the levels and distortions of each coefficient group
+ * computed at once.
+ *
+ * Makes exactly the same decisions as kvz_rdoq_generic. The level decisions
+ * depend on the context state left by the previous coefficient, so they
+ * are still made one coefficient at a time.
+ */
+static void rdoq_avx2(encoder_state_t * const state, coeff_t *coef, coeff_t *dest_coeff, int32_t width,
+                      int32_t height, int8_t type, int8_t scan_mode, int8_t block_type, int8_t tr_depth)
+{
+  const encoder_control_t * const encoder = state->encoder_control;
+  cabac_data_t * const cabac = &state->cabac;
+  const uint32_t log2_block_size = kvz_g_convert_to_bit[width] + 2;
+  const int32_t transform_shift = MAX_TR_DYNAMIC_RANGE - encoder->bitdepth - log2_block_size;
+  const int32_t scalinglist_type = (block_type == CU_INTRA ? 0 : 3) + (int8_t)("\0\3\1\2"[type]);
+  const int32_t qp_scaled = kvz_get_scaled_qp(type, state->qp, (encoder->bitdepth - 8) * 6);
+  const int32_t q_bits = QUANT_SHIFT + qp_scaled / 6 + transform_shift;
+
+  const int32_t *quant_coeff = encoder->scaling_list.quant_coeff[log2_block_size - 2][scalinglist_type][qp_scaled % 6];
+  const double *err_scale    = encoder->scaling_list.error_scale[log2_block_size - 2][scalinglist_type][qp_scaled % 6];
+
+  const uint32_t *scan_cg = g_sig_last_scan_cg[log2_block_size - 2][scan_mode];
+  const uint32_t *scan = kvz_g_sig_last_scan[scan_mode][log2_block_size - 1];
+  const uint32_t num_blk_side = width >> 2;
+  const int32_t cg_num = width * height >> 4;
+
+  double cost_coeff [32 * 32];
+  double cost_sig   [32 * 32];
+  double cost_coeff0[32 * 32];
+  double cost_coeffgroup_sig[64];
+  uint32_t sig_coeffgroup_flag[64];
+  struct sh_rates_t sh_rates;
+
+  double block_uncoded_cost = 0;
+  double base_cost = 0;
+  uint16_t go_rice_param = 0;
+  uint16_t ctx_set = 0;
+  int16_t c1 = 1;
+  int16_t c2 = 0;
+  uint32_t c1_idx = 0;
+  uint32_t c2_idx = 0;
+
+  FILL_ARRAY(sig_coeffgroup_flag, 0, cg_num);
+
+  cabac_ctx_t *base_coeff_group_ctx = &(cabac->ctx.cu_sig_coeff_group_model[type]);
+  cabac_ctx_t *base_sig_ctx = (type == 0) ? &(cabac->ctx.cu_sig_model_luma[0]) : &(cabac->ctx.cu_sig_model_chroma[0]);
+  cabac_ctx_t *base_one_ctx = (type == 0) ? &(cabac->ctx.cu_one_model_luma[0]) : &(cabac->ctx.cu_one_model_chroma[0]);
+
+  // Find the last coefficient group with a non-zero level and the last
+  // non-zero level in it.
+  int32_t cg_last_scanpos = -1;
+  int32_t last_scanpos = -1;
+  for (int32_t cg_scanpos = cg_num - 1; cg_scanpos >= 0; cg_scanpos--) {
+    const uint32_t *cg_scan = &scan[cg_scanpos * SCAN_SET_SIZE];
+    __m256i level_double[2];
+    __m256i max_abs_level[2];
+    rdoq_cg_levels_avx2(coef, cg_scan, quant_coeff, q_bits, level_double, max_abs_level);
+
+    const __m256i zero = _mm256_setzero_si256();
+    const uint32_t zero_lo = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(max_abs_level[0], zero)));
+    const uint32_t zero_hi = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(max_abs_level[1], zero)));
+    const uint32_t nonzero = ~(zero_lo | (zero_hi << 8)) & 0xffff;
+
+    const int32_t last_in_cg = nonzero ? 31 - _lzcnt_u32(nonzero) : -1;
+    for (int32_t i = SCAN_SET_SIZE - 1; i > last_in_cg; i--) {
+      dest_coeff[cg_scan[i]] = 0;
+    }
+    if (nonzero) {
+      cg_last_scanpos = cg_scanpos;
+      last_scanpos = cg_scanpos * SCAN_SET_SIZE + last_in_cg;
+      ctx_set = (last_scanpos > 0 && type == 0) ? 2 : 0;
+      sh_rates.sig_coeff_inc[scan[last_scanpos]] = 0;
+      break;
+    }
+  }
+
+  if (last_scanpos == -1) {
+    return;
+  }
+
+  for (int32_t cg_scanpos = cg_last_scanpos; cg_scanpos >= 0; cg_scanpos--) {
+    cost_coeffgroup_sig[cg_scanpos] = 0;
+  }
+
+  int32_t last_x_bits[32], last_y_bits[32];
+  kvz_calc_last_bits(state, width, height, type, last_x_bits, last_y_bits);
+
+  for (int32_t cg_scanpos = cg_last_scanpos; cg_scanpos >= 0; cg_scanpos--) {
+    const uint32_t cg_blkpos = scan_cg[cg_scanpos];
+    const uint32_t cg_pos_y = cg_blkpos / num_blk_side;
+    const uint32_t cg_pos_x = cg_blkpos - (cg_pos_y * num_blk_side);
+
+    const int32_t pattern_sig_ctx = kvz_context_calc_pattern_sig_ctx(sig_coeffgroup_flag,
+                                                                      cg_pos_x, cg_pos_y, width);
+
+    ALIGNED(32) rdoq_cg_dist_t dist;
+    rdoq_cg_dist_avx2(coef, &scan[cg_scanpos * SCAN_SET_SIZE], quant_coeff, err_scale, q_bits, &dist);
+
+    struct {
+      double coded_level_and_dist;
+      double uncoded_dist;
+      double sig_cost;
+      double sig_cost_0;
+      int32_t nnz_before_pos0;
+    } rd_stats;
+    FILL(rd_stats, 0);
+
+    for (int32_t scanpos_in_cg = SCAN_SET_SIZE - 1; scanpos_in_cg >= 0; scanpos_in_cg--) {
+      const int32_t scanpos = cg_scanpos * SCAN_SET_SIZE + scanpos_in_cg;
+      if (scanpos > last_scanpos) continue;
+      const uint32_t blkpos = scan[scanpos];
+      const int32_t level_double = dist.level_double[scanpos_in_cg];
+      const uint32_t max_abs_level = dist.max_abs_level[scanpos_in_cg];
+
+      cost_coeff0[scanpos] = dist.cost0[scanpos_in_cg];
+      block_uncoded_cost += cost_coeff0[scanpos];
+
+      //===== coefficient level estimation =====
+      int32_t level;
+      const uint16_t one_ctx = 4 * ctx_set + c1;
+      const uint16_t abs_ctx = ctx_set + c2;
+
+      if (scanpos == last_scanpos) {
+        level = rdoq_coded_level_avx2(state, &cost_coeff[scanpos], cost_coeff0[scanpos], &cost_sig[scanpos],
+                                      max_abs_level, dist.cost_max[scanpos_in_cg], dist.cost_max_m1[scanpos_in_cg],
+                                      0, one_ctx, abs_ctx, go_rice_param, c1_idx, c2_idx, 1, type);
+      } else {
+        const uint32_t pos_y = blkpos >> log2_block_size;
+        const uint32_t pos_x = blkpos - (pos_y << log2_block_size);
+        const uint16_t ctx_sig = (uint16_t)kvz_context_get_sig_ctx_inc(pattern_sig_ctx, scan_mode, pos_x, pos_y,
+                                                                       log2_block_size, type);
+        level = rdoq_coded_level_avx2(state, &cost_coeff[scanpos], cost_coeff0[scanpos], &cost_sig[scanpos],
+                                      max_abs_level, dist.cost_max[scanpos_in_cg], dist.cost_max_m1[scanpos_in_cg],
+                                      ctx_sig, one_ctx, abs_ctx, go_rice_param, c1_idx, c2_idx, 0, type);
+        if (encoder->cfg.signhide_enable) {
+          int greater_than_zero = CTX_ENTROPY_BITS(&base_sig_ctx[ctx_sig], 1);
+          int zero = CTX_ENTROPY_BITS(&base_sig_ctx[ctx_sig], 0);
+          sh_rates.sig_coeff_inc[blkpos] = greater_than_zero - zero;
+        }
+      }
+
+      if (encoder->cfg.signhide_enable) {
+        sh_rates.quant_delta[blkpos] = (level_double - level * (1 << q_bits)) >> (q_bits - 8);
+        if (level > 0) {
+          int32_t rate_now  = kvz_get_ic_rate(state, level, one_ctx, abs_ctx, go_rice_param, c1_idx, c2_idx, type);
+          int32_t rate_up   = kvz_get_ic_rate(state, level + 1, one_ctx, abs_ctx, go_rice_param, c1_idx, c2_idx, type);
+          int32_t rate_down = kvz_get_ic_rate(state, level - 1, one_ctx, abs_ctx, go_rice_param, c1_idx, c2_idx, type);
+          sh_rates.inc[blkpos] = rate_up - rate_now;
+          sh_rates.dec[blkpos] = rate_down - rate_now;
+        } else {
+          sh_rates.inc[blkpos] = CTX_ENTROPY_BITS(&base_one_ctx[one_ctx], 0);
+        }
+      }
+      dest_coeff[blkpos] = (coeff_t)level;
+      base_cost += cost_coeff[scanpos];
+
+      const int32_t base_level = (c1_idx < C1FLAG_NUMBER) ? (2 + (c2_idx < C2FLAG_NUMBER)) : 1;
+      if (level >= base_level && level > 3 * (1 << go_rice_param)) {
+        go_rice_param = MIN(go_rice_param + 1, 4);
+      }
+      if (level >= 1) c1_idx++;
+
+      //===== update bin model =====
+      if (level > 1) {
+        c1 = 0;
+        c2 += (c2 < 2);
+        c2_idx++;
+      } else if ((c1 < 3) && (c1 > 0) && level) {
+        c1++;
+      }
+
+      //===== context set update =====
+      if ((scanpos % SCAN_SET_SIZE == 0) && scanpos > 0) {
+        c2 = 0;
+        go_rice_param = 0;
+        c1_idx = 0;
+        c2_idx = 0;
+        ctx_set = (scanpos == SCAN_SET_SIZE || type != 0) ? 0 : 2;
+        if (c1 == 0) {
+          ctx_set++;
+        }
+        c1 = 1;
+      }
+
+      rd_stats.sig_cost += cost_sig[scanpos];
+      if (scanpos_in_cg == 0) {
+        rd_stats.sig_cost_0 = cost_sig[scanpos];
+      }
+      if (dest_coeff[blkpos]) {
+        sig_coeffgroup_flag[cg_blkpos] = 1;
+        rd_stats.coded_level_and_dist += cost_coeff[scanpos] - cost_sig[scanpos];
+        rd_stats.uncoded_dist         += cost_coeff0[scanpos];
+        if (scanpos_in_cg != 0) {
+          rd_stats.nnz_before_pos0++;
+        }
+      }
+    }
+
+    if (cg_scanpos) {
+      if (sig_coeffgroup_flag[cg_blkpos] == 0) {
+        uint32_t ctx_sig = kvz_context_get_sig_coeff_group(sig_coeffgroup_flag, cg_pos_x,
+                                                           cg_pos_y, width);
+        cost_coeffgroup_sig[cg_scanpos] = state->lambda * CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig], 0);
+        base_cost += cost_coeffgroup_sig[cg_scanpos] - rd_stats.sig_cost;
+      } else if (cg_scanpos < cg_last_scanpos) {
+        if (rd_stats.nnz_before_pos0 == 0) {
+          base_cost -= rd_stats.sig_cost_0;
+          rd_stats.sig_cost -= rd_stats.sig_cost_0;
+        }
+        // rd-cost if SigCoeffGroupFlag = 0, initialization
+        double cost_zero_cg = base_cost;
+
+        // add SigCoeffGroupFlag cost to total cost
+        uint32_t ctx_sig = kvz_context_get_sig_coeff_group(sig_coeffgroup_flag, cg_pos_x,
+                                                           cg_pos_y, width);
+
+        cost_coeffgroup_sig[cg_scanpos] = state->lambda * CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig], 1);
+        base_cost += cost_coeffgroup_sig[cg_scanpos];
+        cost_zero_cg += state->lambda * CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig], 0);
+
+        // try to convert the current coeff group from non-zero to all-zero
+        cost_zero_cg += rd_stats.uncoded_dist;
+        cost_zero_cg -= rd_stats.coded_level_and_dist;
+        cost_zero_cg -= rd_stats.sig_cost;
+
+        // if we can save cost, change this block to all-zero block
+        if (cost_zero_cg < base_cost) {
+          sig_coeffgroup_flag[cg_blkpos] = 0;
+          base_cost = cost_zero_cg;
+
+          cost_coeffgroup_sig[cg_scanpos] = state->lambda * CTX_ENTROPY_BITS(&base_coeff_group_ctx[ctx_sig], 0);
+
+          // reset coeffs to 0 in this block
+          for (int32_t scanpos_in_cg = SCAN_SET_SIZE - 1; scanpos_in_cg >= 0; scanpos_in_cg--) {
+            const int32_t scanpos = cg_scanpos * SCAN_SET_SIZE + scanpos_in_cg;
+            const uint32_t blkpos = scan[scanpos];
+            if (dest_coeff[blkpos]) {
+              dest_coeff[blkpos] = 0;
+              cost_coeff[scanpos] = cost_coeff0[scanpos];
+              cost_sig[scanpos] = 0;
+            }
+          }
+        }
+      }
+    } else {
+      sig_coeffgroup_flag[cg_blkpos] = 1;
+    }
+  }
+
+  //===== estimate last position =====
+  double best_cost = 0;
+  int32_t best_last_idx_p1 = 0;
+  bool found_last = false;
+
+  if (block_type != CU_INTRA && !type) {
+    best_cost  = block_uncoded_cost + state->lambda * CTX_ENTROPY_BITS(&(cabac->ctx.cu_qt_root_cbf_model), 0);
+    base_cost += state->lambda * CTX_ENTROPY_BITS(&(cabac->ctx.cu_qt_root_cbf_model), 1);
+  } else {
+    cabac_ctx_t *base_cbf_model = type ? (cabac->ctx.qt_cbf_model_chroma) : (cabac->ctx.qt_cbf_model_luma);
+    const int32_t ctx_cbf = (type ? tr_depth : !tr_depth);
+    best_cost  = block_uncoded_cost + state->lambda * CTX_ENTROPY_BITS(&base_cbf_model[ctx_cbf], 0);
+    base_cost += state->lambda * CTX_ENTROPY_BITS(&base_cbf_model[ctx_cbf], 1);
+  }
+
+  for (int32_t cg_scanpos = cg_last_scanpos; cg_scanpos >= 0 && !found_last; cg_scanpos--) {
+    const uint32_t cg_blkpos = scan_cg[cg_scanpos];
+    base_cost -= cost_coeffgroup_sig[cg_scanpos];
+
+    if (!sig_coeffgroup_flag[cg_blkpos]) continue;
+
+    for (int32_t scanpos_in_cg = SCAN_SET_SIZE - 1; scanpos_in_cg >= 0; scanpos_in_cg--) {
+      const int32_t scanpos = cg_scanpos * SCAN_SET_SIZE + scanpos_in_cg;
+      if (scanpos > last_scanpos) continue;
+      const uint32_t blkpos = scan[scanpos];
+
+      if (dest_coeff[blkpos]) {
+        const uint32_t pos_y = blkpos >> log2_block_size;
+        const uint32_t pos_x = blkpos - (pos_y << log2_block_size);
+
+        double cost_last = (scan_mode == SCAN_VER) ?
+          kvz_get_rate_last(state, pos_y, pos_x, last_x_bits, last_y_bits) :
+          kvz_get_rate_last(state, pos_x, pos_y, last_x_bits, last_y_bits);
+        double total_cost = base_cost + cost_last - cost_sig[scanpos];
+
+        if (total_cost < best_cost) {
+          best_last_idx_p1 = scanpos + 1;
+          best_cost        = total_cost;
+        }
+        if (dest_coeff[blkpos] > 1) {
+          found_last = true;
+          break;
+        }
+        base_cost -= cost_coeff[scanpos];
+        base_cost += cost_coeff0[scanpos];
+      } else {
+        base_cost -= cost_sig[scanpos];
+      }
+    }
+  }
+
+  uint32_t abs_sum = 0;
+  for (int32_t scanpos = 0; scanpos < best_last_idx_p1; scanpos++) {
+    const int32_t blkpos = scan[scanpos];
+    const int32_t level = dest_coeff[blkpos];
+    abs_sum += level;
+    dest_coeff[blkpos] = (coeff_t)((coef[blkpos] < 0) ? -level : level);
+  }
+  //===== clean uncoded coefficients =====
+  for (int32_t scanpos = best_last_idx_p1; scanpos <= last_scanpos; scanpos++) {
+    dest_coeff[scan[scanpos]] = 0;
+  }
+
+  if (encoder->cfg.signhide_enable && abs_sum >= 2) {
+    kvz_rdoq_sign_hiding(state, qp_scaled, scan, &sh_rates, best_last_idx_p1, coef, dest_coeff);
+  }
+}
+
+#undef SCAN_SET_SIZE
+
 #endif //COMPILE_INTEL_AVX2 && defined X86_64
 
 int kvz_strategy_register_quant_avx2(void* opaque, uint8_t bitdepth)
@@ -874,11 +1466,13 @@ int kvz_strategy_register_quant_avx2(void* opaque, uint8_t bitdepth)
   if (bitdepth == 8) {
     success &= kvz_strategyselector_register(opaque, "quantize_residual", "avx2", 40, &kvz_quantize_residual_avx2);
     success &= kvz_strategyselector_register(opaque, "dequant", "avx2", 40, &kvz_dequant_avx2);
+    success &= kvz_strategyselector_register(opaque, "tr_split_costs", "avx2", 40, &tr_split_costs_avx2);
   }
 #endif // KVZ_BIT_DEPTH == 8
   success &= kvz_strategyselector_register(opaque, "quant", "avx2", 40, &kvz_quant_avx2);
   success &= kvz_strategyselector_register(opaque, "coeff_abs_sum", "avx2", 0, &coeff_abs_sum_avx2);
   success &= kvz_strategyselector_register(opaque, "fast_coeff_cost", "avx2", 40, &fast_coeff_cost_avx2);
+  success &= kvz_strategyselector_register(opaque, "rdoq", "avx2", 40, &rdoq_avx2);
 #endif //COMPILE_INTEL_AVX2 && defined X86_64
 
   return success;
@@ -84,18 +84,6 @@ static __m256i FIX_W32 calc_eo_cat(const __m256i a,
   return                     _mm256_shuffle_epi8(idx_to_cat, eo_idx);
 }
 
-static INLINE __m256i srli_epi8(const __m256i  v,
-                                const uint32_t shift)
-{
-  const uint8_t hibit_mask     = 0xff >> shift;
-  const __m256i hibit_mask_256 = _mm256_set1_epi8(hibit_mask);
-
-  __m256i v_shifted = _mm256_srli_epi32(v,         shift);
-  __m256i v_masked  = _mm256_and_si256 (v_shifted, hibit_mask_256);
-
-  return v_masked;
-}
-
 static INLINE void cvt_epu8_epi16(const __m256i  v,
                                         __m256i *res_lo,
                                         __m256i *res_hi)
@@ -105,16 +93,6 @@ static INLINE void cvt_epu8_epi16(const __m256i  v,
              *res_hi  = _mm256_unpackhi_epi8(v, zero);
 }
 
-static INLINE void cvt_epi8_epi16(const __m256i  v,
-                                        __m256i *res_lo,
-                                        __m256i *res_hi)
-{
-  const __m256i zero  = _mm256_setzero_si256();
-        __m256i signs = _mm256_cmpgt_epi8   (zero, v);
-             *res_lo  = _mm256_unpacklo_epi8(v,    signs);
-             *res_hi  = _mm256_unpackhi_epi8(v,    signs);
-}
-
 static INLINE void diff_epi8_epi16(const __m256i  a,
                                    const __m256i  b,
                                          __m256i *res_lo,
@@ -164,15 +142,6 @@ static INLINE uint16_t epi32v_fits_in_epi8s(const __m128i v)
   return             _mm_movemask_epi8(ok_i32s);
 }
 
-static INLINE __m128i truncate_epi32_epi8(const __m128i v)
-{
-  // LSBs of each dword, the values values must fit in 8 bits anyway for
-  // what this intended for (use epi32v_fits_in_epi8s to check if needed)
-  const __m128i trunc_shufmask = _mm_set1_epi32  (0x0c080400);
-        __m128i sbs_8          = _mm_shuffle_epi8(v, trunc_shufmask);
-  return        sbs_8;
-}
-
 // Read 0-3 bytes (pixels) into uint32_t
 static INLINE uint32_t load_border_bytes(const uint8_t *buf,
                                          const int32_t  start_pos,
@@ -199,18 +168,6 @@ static INLINE void store_border_bytes(      uint8_t  *buf,
   }
 }
 
-// Mask all inexistent bytes to 0xFF for functions that count particular byte
-// values, so they won't count anywhere
-static INLINE __m256i gen_badbyte_mask(const __m256i db4_mask,
-                                       const int32_t width_rest)
-{
-  const __m256i zero    = _mm256_setzero_si256();
-
-  uint32_t last_badbytes = 0xffffffff << (width_rest << 3);
-  __m256i  badbyte_mask  = _mm256_cmpeq_epi8  (db4_mask,     zero);
-  return                   _mm256_insert_epi32(badbyte_mask, last_badbytes, 7);
-}
-
 // Ok, so the broadcast si128->si256 instruction only works with a memory
 // source operand..
 static INLINE __m256i broadcast_xmm2ymm(const __m128i v)
@@ -219,289 +176,6 @@ static INLINE __m256i broadcast_xmm2ymm(const __m128i v)
   return        _mm256_inserti128_si256(res, v, 1);
 }
 
-// Used for edge_ddistortion and band_ddistortion
-static __m256i FIX_W32 calc_diff_off_delta(const __m256i diff_lo,
-                                           const __m256i diff_hi,
-                                           const __m256i offsets,
-                                           const __m256i orig)
-{
-  const __m256i zero          = _mm256_setzero_si256();
-  const __m256i negate_hiword = _mm256_set1_epi32(0xffff0001);
-
-  __m256i orig_lo, orig_hi, offsets_lo, offsets_hi;
-
-  cvt_epu8_epi16(orig,    &orig_lo,    &orig_hi);
-  cvt_epi8_epi16(offsets, &offsets_lo, &offsets_hi);
-
-  __m256i offsets_0_lo = _mm256_cmpeq_epi16   (offsets_lo,   zero);
-  __m256i offsets_0_hi = _mm256_cmpeq_epi16   (offsets_hi,   zero);
-
-  __m256i delta_lo     = _mm256_sub_epi16     (diff_lo,      offsets_lo);
-  __m256i delta_hi     = _mm256_sub_epi16     (diff_hi,      offsets_hi);
-
-  __m256i diff_lo_m    = _mm256_andnot_si256  (offsets_0_lo, diff_lo);
-  __m256i diff_hi_m    = _mm256_andnot_si256  (offsets_0_hi, diff_hi);
-  __m256i delta_lo_m   = _mm256_andnot_si256  (offsets_0_lo, delta_lo);
-  __m256i delta_hi_m   = _mm256_andnot_si256  (offsets_0_hi, delta_hi);
-
-  __m256i dd0_lo       = _mm256_unpacklo_epi16(delta_lo_m,   diff_lo_m);
-  __m256i dd0_hi       = _mm256_unpackhi_epi16(delta_lo_m,   diff_lo_m);
-  __m256i dd1_lo       = _mm256_unpacklo_epi16(delta_hi_m,   diff_hi_m);
-  __m256i dd1_hi       = _mm256_unpackhi_epi16(delta_hi_m,   diff_hi_m);
-
-  __m256i dd0_lo_n     = _mm256_sign_epi16    (dd0_lo,       negate_hiword);
-  __m256i dd0_hi_n     = _mm256_sign_epi16    (dd0_hi,       negate_hiword);
-  __m256i dd1_lo_n     = _mm256_sign_epi16    (dd1_lo,       negate_hiword);
-  __m256i dd1_hi_n     = _mm256_sign_epi16    (dd1_hi,       negate_hiword);
-
-  __m256i sum0_lo      = _mm256_madd_epi16    (dd0_lo,       dd0_lo_n);
-  __m256i sum0_hi      = _mm256_madd_epi16    (dd0_hi,       dd0_hi_n);
-  __m256i sum1_lo      = _mm256_madd_epi16    (dd1_lo,       dd1_lo_n);
-  __m256i sum1_hi      = _mm256_madd_epi16    (dd1_hi,       dd1_hi_n);
-
-  __m256i sum0         = _mm256_add_epi32     (sum0_lo,      sum0_hi);
-  __m256i sum1         = _mm256_add_epi32     (sum1_lo,      sum1_hi);
-  return                 _mm256_add_epi32     (sum0,         sum1);
-}
-
-static INLINE __m256i FIX_W32 do_one_edge_ymm(const __m256i a,
-                                              const __m256i b,
-                                              const __m256i c,
-                                              const __m256i orig,
-                                              const __m256i badbyte_mask,
-                                              const __m256i offsets_256)
-{
-  __m256i eo_cat = calc_eo_cat(a, b, c);
-          eo_cat = _mm256_or_si256    (eo_cat,      badbyte_mask);
-  __m256i offset = _mm256_shuffle_epi8(offsets_256, eo_cat);
-
-  __m256i offset_lo, offset_hi;
-  cvt_epi8_epi16(offset, &offset_lo, &offset_hi);
-
-  __m256i diff_lo, diff_hi;
-  diff_epi8_epi16(orig, c, &diff_lo, &diff_hi);
-
-  return calc_diff_off_delta(diff_lo, diff_hi, offset, orig);
-}
-
-static int32_t sao_edge_ddistortion_avx2(const uint8_t *orig_data,
-                                         const uint8_t *rec_data,
-                                               int32_t  block_width,
-                                               int32_t  block_height,
-                                               int32_t  eo_class,
-                                         const int32_t  offsets[NUM_SAO_EDGE_CATEGORIES])
-{
-  int32_t y, x;
-  vector2d_t a_ofs = g_sao_edge_offsets[eo_class][0];
-  vector2d_t b_ofs = g_sao_edge_offsets[eo_class][1];
-
-   int32_t scan_width = block_width -   2;
-  uint32_t width_db32 = scan_width  & ~31;
-  uint32_t width_db4  = scan_width  &  ~3;
-  uint32_t width_rest = scan_width  &   3;
-
-  // Form the load&store mask
-  const __m256i wdb4_256      = _mm256_set1_epi32 (width_db4 & 31);
-  const __m256i indexes       = _mm256_setr_epi32 (3, 7, 11, 15, 19, 23, 27, 31);
-  const __m256i db4_mask      = _mm256_cmpgt_epi32(wdb4_256, indexes);
-
-  const __m256i zero          = _mm256_setzero_si256();
-
-  __m128i offsets03 = _mm_loadu_si128((const __m128i *)offsets);
-  __m128i offsets4  = _mm_cvtsi32_si128(offsets[4]);
-
-  uint16_t offsets_ok = epi32v_fits_in_epi8s(offsets03) &
-                        epi32v_fits_in_epi8s(offsets4);
-
-  assert(NUM_SAO_EDGE_CATEGORIES == 5);
-
-  if (offsets_ok != 0xffff) {
-    return sao_edge_ddistortion_generic(orig_data,
-                                        rec_data,
-                                        block_width,
-                                        block_height,
-                                        eo_class,
-                                        offsets);
-  }
-
-  __m128i offsets03_8b = truncate_epi32_epi8(offsets03);
-  __m128i offsets4_8b  = truncate_epi32_epi8(offsets4);
-  __m128i offsets_8b   = _mm_unpacklo_epi32 (offsets03_8b, offsets4_8b);
-  __m256i offsets_256  = broadcast_xmm2ymm  (offsets_8b);
-
-  __m256i sum = _mm256_setzero_si256();
-  for (y = 1; y < block_height - 1; y++) {
-    for (x = 1; x < width_db32 + 1; x += 32) {
-      uint32_t c_pos =  y            * block_width + x;
-      uint32_t a_pos = (y + a_ofs.y) * block_width + x + a_ofs.x;
-      uint32_t b_pos = (y + b_ofs.y) * block_width + x + b_ofs.x;
-
-      __m256i a      = _mm256_loadu_si256((const __m256i *)(rec_data  + a_pos));
-      __m256i b      = _mm256_loadu_si256((const __m256i *)(rec_data  + b_pos));
-      __m256i c      = _mm256_loadu_si256((const __m256i *)(rec_data  + c_pos));
-      __m256i orig   = _mm256_loadu_si256((const __m256i *)(orig_data + c_pos));
-
-      __m256i curr   = do_one_edge_ymm(a, b, c, orig, zero, offsets_256);
-              sum    = _mm256_add_epi32(sum, curr);
-    }
-    if (scan_width > width_db32) {
-      const uint32_t curr_cpos   =  y            * block_width + x;
-      const uint32_t rest_cpos   =  y            * block_width + width_db4 + 1;
-
-      const  int32_t curr_apos   = (y + a_ofs.y) * block_width + x + a_ofs.x;
-      const  int32_t rest_apos   = (y + a_ofs.y) * block_width + width_db4 + a_ofs.x + 1;
-
-      const  int32_t curr_bpos   = (y + b_ofs.y) * block_width + x + b_ofs.x;
-      const  int32_t rest_bpos   = (y + b_ofs.y) * block_width + width_db4 + b_ofs.x + 1;
-
-      // Same trick to read a narrow line as there is in the band SAO routine
-      uint32_t a_last         = load_border_bytes(rec_data,  rest_apos, width_rest);
-      uint32_t b_last         = load_border_bytes(rec_data,  rest_bpos, width_rest);
-      uint32_t c_last         = load_border_bytes(rec_data,  rest_cpos, width_rest);
-      uint32_t orig_last      = load_border_bytes(orig_data, rest_cpos, width_rest);
-
-      const int32_t *a_ptr    = (const int32_t *)(rec_data  + curr_apos);
-      const int32_t *b_ptr    = (const int32_t *)(rec_data  + curr_bpos);
-      const int32_t *c_ptr    = (const int32_t *)(rec_data  + curr_cpos);
-      const int32_t *orig_ptr = (const int32_t *)(orig_data + curr_cpos);
-
-      __m256i a    = _mm256_maskload_epi32(a_ptr,    db4_mask);
-      __m256i b    = _mm256_maskload_epi32(b_ptr,    db4_mask);
-      __m256i c    = _mm256_maskload_epi32(c_ptr,    db4_mask);
-      __m256i orig = _mm256_maskload_epi32(orig_ptr, db4_mask);
-
-              a    = _mm256_insert_epi32  (a,        a_last,    7);
-              b    = _mm256_insert_epi32  (b,        b_last,    7);
-              c    = _mm256_insert_epi32  (c,        c_last,    7);
-              orig = _mm256_insert_epi32  (orig,     orig_last, 7);
-
-      // Mask all unused bytes to 0xFF, so they won't count anywhere
-      __m256i badbyte_mask = gen_badbyte_mask(db4_mask, width_rest);
-
-      __m256i curr  = do_one_edge_ymm(a, b, c, orig, badbyte_mask, offsets_256);
-              sum   = _mm256_add_epi32(sum, curr);
-    }
-  }
-  return hsum_8x32b(sum);
-}
-
-static void FIX_W32 calc_edge_dir_one_ymm(const __m256i  a,
-                                          const __m256i  b,
-                                          const __m256i  c,
-                                          const __m256i  orig,
-                                          const __m256i  badbyte_mask,
-                                                __m256i *diff_accum,
-                                                int32_t *hit_cnt)
-{
-  const __m256i ones_16 = _mm256_set1_epi16(1);
-        __m256i eo_cat  = calc_eo_cat      (a, b, c);
-                eo_cat  = _mm256_or_si256  (eo_cat, badbyte_mask);
-
-  __m256i diffs_lo, diffs_hi;
-  diff_epi8_epi16(orig, c, &diffs_lo, &diffs_hi);
-
-  for (uint32_t i = 0; i < 5; i++) {
-    __m256i  curr_id       = _mm256_set1_epi8    (i);
-    __m256i  eoc_mask      = _mm256_cmpeq_epi8   (eo_cat, curr_id);
-    uint32_t eoc_bits      = _mm256_movemask_epi8(eoc_mask);
-    uint32_t eoc_hits      = _mm_popcnt_u32      (eoc_bits);
-
-    __m256i  eoc_mask_lo   = _mm256_unpacklo_epi8(eoc_mask,      eoc_mask);
-    __m256i  eoc_mask_hi   = _mm256_unpackhi_epi8(eoc_mask,      eoc_mask);
-
-    __m256i  eoc_diffs_lo  = _mm256_and_si256    (diffs_lo,      eoc_mask_lo);
-    __m256i  eoc_diffs_hi  = _mm256_and_si256    (diffs_hi,      eoc_mask_hi);
-
-    __m256i  eoc_diffs_16  = _mm256_add_epi16    (eoc_diffs_lo,  eoc_diffs_hi);
-    __m256i  eoc_diffs_32  = _mm256_madd_epi16   (eoc_diffs_16,  ones_16);
-
-             diff_accum[i] = _mm256_add_epi32    (diff_accum[i], eoc_diffs_32);
-             hit_cnt[i]   += eoc_hits;
-  }
-}
-
-static void calc_sao_edge_dir_avx2(const uint8_t *orig_data,
-                                   const uint8_t *rec_data,
-                                         int32_t  eo_class,
-                                         int32_t  block_width,
-                                         int32_t  block_height,
-                                         int32_t  cat_sum_cnt[2][NUM_SAO_EDGE_CATEGORIES])
-{
-  vector2d_t a_ofs = g_sao_edge_offsets[eo_class][0];
-  vector2d_t b_ofs = g_sao_edge_offsets[eo_class][1];
-
-  int32_t *diff_sum   = cat_sum_cnt[0];
-  int32_t *hit_cnt    = cat_sum_cnt[1];
-
-  int32_t scan_width  = block_width -   2;
-  int32_t width_db32  = scan_width  & ~31;
-  int32_t width_db4   = scan_width  &  ~3;
-  int32_t width_rest  = scan_width  &   3;
-
-  const __m256i zero          = _mm256_setzero_si256();
-
-  // Form the load&store mask
-  const __m256i wdb4_256      = _mm256_set1_epi32 (width_db4 & 31);
-  const __m256i indexes       = _mm256_setr_epi32 (3, 7, 11, 15, 19, 23, 27, 31);
-  const __m256i db4_mask      = _mm256_cmpgt_epi32(wdb4_256, indexes);
-
-  __m256i diff_accum[5] = { _mm256_setzero_si256() };
-
-  int32_t y, x;
-  for (y = 1; y < block_height - 1; y++) {
-    for (x = 1; x < width_db32 + 1; x += 32) {
-      const uint32_t a_off = (y + a_ofs.y) * block_width + x + a_ofs.x;
-      const uint32_t b_off = (y + b_ofs.y) * block_width + x + b_ofs.x;
-      const uint32_t c_off =  y            * block_width + x;
-
-      __m256i a      = _mm256_loadu_si256((const __m256i *)(rec_data  + a_off));
-      __m256i b      = _mm256_loadu_si256((const __m256i *)(rec_data  + b_off));
-      __m256i c      = _mm256_loadu_si256((const __m256i *)(rec_data  + c_off));
-      __m256i orig   = _mm256_loadu_si256((const __m256i *)(orig_data + c_off));
-
-      calc_edge_dir_one_ymm(a, b, c, orig, zero, diff_accum, hit_cnt);
-    }
-    if (scan_width > width_db32) {
-      const uint32_t curr_cpos   =  y            * block_width + x;
-      const uint32_t rest_cpos   =  y            * block_width + width_db4 + 1;
-
-      const  int32_t curr_apos   = (y + a_ofs.y) * block_width + x + a_ofs.x;
-      const  int32_t rest_apos   = (y + a_ofs.y) * block_width + width_db4 + a_ofs.x + 1;
-
-      const  int32_t curr_bpos   = (y + b_ofs.y) * block_width + x + b_ofs.x;
-      const  int32_t rest_bpos   = (y + b_ofs.y) * block_width + width_db4 + b_ofs.x + 1;
-
-            uint32_t a_last      = load_border_bytes(rec_data,  rest_apos, width_rest);
-            uint32_t b_last      = load_border_bytes(rec_data,  rest_bpos, width_rest);
-            uint32_t c_last      = load_border_bytes(rec_data,  rest_cpos, width_rest);
-            uint32_t orig_last   = load_border_bytes(orig_data, rest_cpos, width_rest);
-
-      const int32_t *a_ptr       = (const int32_t *)(rec_data  + curr_apos);
-      const int32_t *b_ptr       = (const int32_t *)(rec_data  + curr_bpos);
-      const int32_t *c_ptr       = (const int32_t *)(rec_data  + curr_cpos);
-      const int32_t *orig_ptr    = (const int32_t *)(orig_data + curr_cpos);
-
-      __m256i a    = _mm256_maskload_epi32(a_ptr,    db4_mask);
-      __m256i b    = _mm256_maskload_epi32(b_ptr,    db4_mask);
-      __m256i c    = _mm256_maskload_epi32(c_ptr,    db4_mask);
-      __m256i orig = _mm256_maskload_epi32(orig_ptr, db4_mask);
-
-              a    = _mm256_insert_epi32  (a,        a_last,    7);
-              b    = _mm256_insert_epi32  (b,        b_last,    7);
-              c    = _mm256_insert_epi32  (c,        c_last,    7);
-              orig = _mm256_insert_epi32  (orig,     orig_last, 7);
-
-      __m256i badbyte_mask = gen_badbyte_mask(db4_mask, width_rest);
-
-      calc_edge_dir_one_ymm(a, b, c, orig, badbyte_mask, diff_accum, hit_cnt);
-    }
-  }
-  for (uint32_t i = 0; i < 5; i++) {
-    int32_t sum = hsum_8x32b(diff_accum[i]);
-    diff_sum[i] += sum;
-  }
-}
-
 /*
  * Calculate an array of intensity correlations for each intensity value.
  * Return array as 16 YMM vectors, each containing 2x16 unsigned bytes
@@ -813,88 +487,177 @@ static void sao_reconstruct_color_avx2(const encoder_control_t *encoder,
   }
 }
 
-static int32_t sao_band_ddistortion_avx2(const encoder_state_t *state,
-                                         const uint8_t         *orig_data,
-                                         const uint8_t         *rec_data,
-                                               int32_t          block_width,
-                                               int32_t          block_height,
-                                               int32_t          band_pos,
-                                         const int32_t          sao_bands[4])
+// Accumulate the differences and hit counts of categories 1...4 of one
+// edge class, category 0 is derived from the totals afterwards
+static void FIX_W32 calc_stats_one_class_ymm(const __m256i  eo_cat,
+                                             const __m256i  diffs_lo,
+                                             const __m256i  diffs_hi,
+                                                   __m256i *diff_accum,
+                                                   int32_t *hit_cnt)
 {
-  const uint32_t bitdepth = 8;
-  const uint32_t shift    = bitdepth - 5;
-
-  // Clamp band_pos to 32 from above. It'll be subtracted from the shifted
-  // rec_data values, which in 8-bit depth will always be clamped to [0, 31],
-  // so if it ever exceeds 32, all the band values will be negative and
-  // ignored. Ditto for less than -4.
-  __m128i bp_128   = _mm_cvtsi32_si128    (band_pos);
-  __m128i hilimit  = _mm_cvtsi32_si128    (32);
-  __m128i lolimit  = _mm_cvtsi32_si128    (-4);
-
-          bp_128   = _mm_min_epi8         (bp_128, hilimit);
-          bp_128   = _mm_max_epi8         (bp_128, lolimit);
-
-  __m256i bp_256  = _mm256_broadcastb_epi8(bp_128);
-
-  __m128i sbs_32   = _mm_loadu_si128((const __m128i *)sao_bands);
-  __m128i sbs_8    = truncate_epi32_epi8(sbs_32);
-  __m256i sb_256   = broadcast_xmm2ymm  (sbs_8);
-
-  // These should trigger like, never, at least the later condition of block
-  // not being a multiple of 32 wide. Rather safe than sorry though, huge SAO
-  // bands are more tricky of these two because the algorithm needs a complete
-  // reimplementation to work on 16-bit values.
-  if (epi32v_fits_in_epi8s(sbs_32) != 0xffff)
-    goto use_generic;
-
-  // If VVC or something will start using SAO on blocks with width a multiple
-  // of 16, feel free to implement a XMM variant of this algorithm
-  if ((block_width & 31) != 0)
-    goto use_generic;
-
-  const __m256i zero          = _mm256_setzero_si256();
-  const __m256i threes        = _mm256_set1_epi8 (3);
-
-  __m256i sum = _mm256_setzero_si256();
-  for (uint32_t y = 0; y < block_height; y++) {
-    for (uint32_t x = 0; x < block_width; x += 32) {
-      const int32_t curr_pos = y * block_width + x;
+  const __m256i ones_16 = _mm256_set1_epi16(1);
 
-      __m256i   rd = _mm256_loadu_si256((const __m256i *)( rec_data + curr_pos));
-      __m256i orig = _mm256_loadu_si256((const __m256i *)(orig_data + curr_pos));
+  for (uint32_t i = SAO_EO_CAT1; i <= SAO_EO_CAT4; i++) {
+    __m256i  curr_id       = _mm256_set1_epi8    (i);
+    __m256i  eoc_mask      = _mm256_cmpeq_epi8   (eo_cat, curr_id);
+    uint32_t eoc_bits      = _mm256_movemask_epi8(eoc_mask);
+    uint32_t eoc_hits      = _mm_popcnt_u32      (eoc_bits);
 
-      __m256i orig_lo, orig_hi, rd_lo, rd_hi;
-      cvt_epu8_epi16(orig, &orig_lo, &orig_hi);
-      cvt_epu8_epi16(rd,   &rd_lo,   &rd_hi);
+    __m256i  eoc_mask_lo   = _mm256_unpacklo_epi8(eoc_mask,      eoc_mask);
+    __m256i  eoc_mask_hi   = _mm256_unpackhi_epi8(eoc_mask,      eoc_mask);
 
-      __m256i diff_lo      = _mm256_sub_epi16     (orig_lo,      rd_lo);
-      __m256i diff_hi      = _mm256_sub_epi16     (orig_hi,      rd_hi);
+    __m256i  eoc_diffs_lo  = _mm256_and_si256    (diffs_lo,      eoc_mask_lo);
+    __m256i  eoc_diffs_hi  = _mm256_and_si256    (diffs_hi,      eoc_mask_hi);
 
-      // The shift will clamp band to 0...31; band_pos on the other
-      // hand is always between 0...32, so band will be -1...31. Anything
-      // below zero is ignored, so we can clamp band_pos to 32.
-      __m256i rd_divd      = srli_epi8           (rd,            shift);
-      __m256i band         = _mm256_sub_epi8     (rd_divd,       bp_256);
+    __m256i  eoc_diffs_16  = _mm256_add_epi16    (eoc_diffs_lo,  eoc_diffs_hi);
+    __m256i  eoc_diffs_32  = _mm256_madd_epi16   (eoc_diffs_16,  ones_16);
 
-      // Force all <0 or >3 bands to 0xff, which will zero the shuffle result
-      __m256i band_lt_0    = _mm256_cmpgt_epi8   (zero,          band);
-      __m256i band_gt_3    = _mm256_cmpgt_epi8   (band,          threes);
-      __m256i band_inv     = _mm256_or_si256     (band_lt_0,     band_gt_3);
+             diff_accum[i] = _mm256_add_epi32    (diff_accum[i], eoc_diffs_32);
+             hit_cnt[i]   += eoc_hits;
+  }
+}
 
-              band         = _mm256_or_si256     (band,          band_inv);
+// Edge statistics of the inner pixels of one row, used where the vector
+// loads would read past the end of the block
+static void calc_edge_stats_row_scalar(const uint8_t     *orig_data,
+                                       const uint8_t     *rec_data,
+                                             int32_t      block_width,
+                                             int32_t      y,
+                                             sao_stats_t *stats)
+{
+  for (int32_t x = 1; x < block_width - 1; x++) {
+    const int32_t pos  = y * block_width + x;
+    const uint8_t c    = rec_data[pos];
+    const int32_t diff = orig_data[pos] - c;
+
+    for (int32_t eo_class = SAO_EO0; eo_class < SAO_NUM_EO; eo_class++) {
+      vector2d_t a_ofs = g_sao_edge_offsets[eo_class][0];
+      vector2d_t b_ofs = g_sao_edge_offsets[eo_class][1];
+      uint8_t    a     = rec_data[pos + a_ofs.y * block_width + a_ofs.x];
+      uint8_t    b     = rec_data[pos + b_ofs.y * block_width + b_ofs.x];
+
+      int32_t eo_cat = sao_calc_eo_cat(a, b, c);
+      stats->edge[eo_class][0][eo_cat] += diff;
+      stats->edge[eo_class][1][eo_cat] += 1;
+    }
+  }
+}
 
-      __m256i offsets      = _mm256_shuffle_epi8 (sb_256,        band);
+static void calc_sao_stats_avx2(const encoder_control_t *encoder,
+                                const uint8_t           *orig_data,
+                                const uint8_t           *rec_data,
+                                      int32_t            block_width,
+                                      int32_t            block_height,
+                                      sao_stats_t       *stats)
+{
+  const uint32_t shift      = 8 - 5;
+  const  int32_t last_x     = block_width - 1;
+
+  const __m256i  lane_idx   = _mm256_setr_epi8( 0,  1,  2,  3,  4,  5,  6,  7,
+                                                8,  9, 10, 11, 12, 13, 14, 15,
+                                               16, 17, 18, 19, 20, 21, 22, 23,
+                                               24, 25, 26, 27, 28, 29, 30, 31);
+
+  __m256i diff_accum[SAO_NUM_EO][NUM_SAO_EDGE_CATEGORIES];
+  int32_t hit_cnt   [SAO_NUM_EO][NUM_SAO_EDGE_CATEGORIES];
+  int32_t inner_sum = 0;
+
+  for (int32_t i = 0; i < SAO_NUM_EO; i++) {
+    for (int32_t j = 0; j < NUM_SAO_EDGE_CATEGORIES; j++) {
+      diff_accum[i][j] = _mm256_setzero_si256();
+      hit_cnt   [i][j] = 0;
+    }
+  }
+
+  FILL(*stats, 0);
+
+  for (int32_t y = 0; y < block_height; y++) {
+    const uint8_t *orig_row = orig_data + y * block_width;
+    const uint8_t *rec_row  = rec_data  + y * block_width;
+
+    // Band statistics for every pixel of the row
+    int32_t row_sum = 0;
+    for (int32_t x = 0; x < block_width; x++) {
+      int32_t diff = orig_row[x] - rec_row[x];
+      int32_t band = rec_row[x] >> shift;
+      stats->band[0][band] += diff;
+      stats->band[1][band] += 1;
+      row_sum              += diff;
+    }
 
-      __m256i curr_sum     = calc_diff_off_delta (diff_lo, diff_hi, offsets, orig);
-              sum          = _mm256_add_epi32    (sum,          curr_sum);
+    if (y == 0 || y == block_height - 1 || block_width < 3) {
+      continue;
     }
+    inner_sum += row_sum - (orig_row[0]      - rec_row[0])
+                         - (orig_row[last_x] - rec_row[last_x]);
+
+    // Narrow blocks are handled with a single vector per row, which reads
+    // up to 34 - block_width bytes past the row below. Do the rows where
+    // that would run off the block in scalar.
+    if ((y + 1) * block_width + 34 > block_height * block_width) {
+      calc_edge_stats_row_scalar(orig_data, rec_data, block_width, y, stats);
+      continue;
+    }
+
+    // Cover the inner pixels [1, last_x) with 32-wide vectors, the last one
+    // overlapping the previous one and masking out the pixels already done
+    int32_t covered = 1;
+    while (covered < last_x) {
+      int32_t x = covered;
+      if (x + 32 > last_x && block_width >= 34) {
+        x = last_x - 32;
+      }
+
+      __m256i lo_lim  = _mm256_set1_epi8   (covered - x);
+      __m256i hi_lim  = _mm256_set1_epi8   (last_x - x - 1);
+      __m256i below   = _mm256_cmpgt_epi8  (lo_lim,   lane_idx);
+      __m256i above   = _mm256_cmpgt_epi8  (lane_idx, hi_lim);
+      __m256i invalid = _mm256_or_si256    (below,    above);
+      covered = x + 32;
+
+      const int32_t c_pos = y * block_width + x;
+      __m256i c       = _mm256_loadu_si256((const __m256i *)(rec_data  + c_pos));
+      __m256i orig    = _mm256_loadu_si256((const __m256i *)(orig_data + c_pos));
+
+      __m256i diffs_lo, diffs_hi;
+      diff_epi8_epi16(orig, c, &diffs_lo, &diffs_hi);
+
+      for (int32_t eo_class = SAO_EO0; eo_class < SAO_NUM_EO; eo_class++) {
+        vector2d_t a_ofs = g_sao_edge_offsets[eo_class][0];
+        vector2d_t b_ofs = g_sao_edge_offsets[eo_class][1];
+
+        const int32_t a_pos = c_pos + a_ofs.y * block_width + a_ofs.x;
+        const int32_t b_pos = c_pos + b_ofs.y * block_width + b_ofs.x;
+
+        __m256i a      = _mm256_loadu_si256((const __m256i *)(rec_data + a_pos));
+        __m256i b      = _mm256_loadu_si256((const __m256i *)(rec_data + b_pos));
+
+        __m256i eo_cat = calc_eo_cat    (a, b, c);
+                eo_cat = _mm256_or_si256(eo_cat, invalid);
+
+        calc_stats_one_class_ymm(eo_cat, diffs_lo, diffs_hi,
+                                 diff_accum[eo_class], hit_cnt[eo_class]);
+      }
+    }
+  }
+
+  if (block_width < 3 || block_height < 3) {
+    return;
   }
-  return hsum_8x32b(sum);
 
-use_generic:
-  return sao_band_ddistortion_generic(state, orig_data, rec_data, block_width,
-      block_height, band_pos, sao_bands);
+  // Category 0 gets whatever is left of the inner pixels
+  const int32_t inner_cnt = (block_width - 2) * (block_height - 2);
+  for (int32_t eo_class = SAO_EO0; eo_class < SAO_NUM_EO; eo_class++) {
+    int *sums   = stats->edge[eo_class][0];
+    int *counts = stats->edge[eo_class][1];
+
+    for (int32_t i = SAO_EO_CAT1; i <= SAO_EO_CAT4; i++) {
+      sums  [i] += hsum_8x32b(diff_accum[eo_class][i]);
+      counts[i] += hit_cnt[eo_class][i];
+    }
+    sums  [SAO_EO_CAT0] = inner_sum - sums  [1] - sums  [2] - sums  [3] - sums  [4];
+    counts[SAO_EO_CAT0] = inner_cnt - counts[1] - counts[2] - counts[3] - counts[4];
+  }
 }
 
 #endif // KVZ_BIT_DEPTH == 8
@@ -906,10 +669,8 @@ int kvz_strategy_register_sao_avx2(void* opaque, uint8_t bitdepth)
 #if COMPILE_INTEL_AVX2
 #if KVZ_BIT_DEPTH == 8
   if (bitdepth == 8) {
-    success &= kvz_strategyselector_register(opaque, "sao_edge_ddistortion", "avx2", 40, &sao_edge_ddistortion_avx2);
-    success &= kvz_strategyselector_register(opaque, "calc_sao_edge_dir", "avx2", 40, &calc_sao_edge_dir_avx2);
     success &= kvz_strategyselector_register(opaque, "sao_reconstruct_color", "avx2", 40, &sao_reconstruct_color_avx2);
-    success &= kvz_strategyselector_register(opaque, "sao_band_ddistortion", "avx2", 40, &sao_band_ddistortion_avx2);
+    success &= kvz_strategyselector_register(opaque, "calc_sao_stats", "avx2", 40, &calc_sao_stats_avx2);
   }
 #endif // KVZ_BIT_DEPTH == 8
 #endif //COMPILE_INTEL_AVX2
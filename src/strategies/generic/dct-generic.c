@@ -32,6 +32,8 @@
 
 #include "strategies/generic/dct-generic.h"
 
+#include <string.h>
+
 #include "strategyselector.h"
 #include "tables.h"
 
@@ -576,6 +578,135 @@ static void partial_butterfly_inverse_32_generic(const int16_t *src, int16_t *ds
   }
 }
 
+/**
+ * \brief Forward 32-point transform that only computes the first 16 outputs.
+ *
+ * Processes num_lines lines of input and leaves the rest of the output
+ * lines and the high frequency half of each line zero.
+ */
+static void partial_butterfly_32_low_generic(const short *src, short *dst,
+  int32_t shift, int32_t num_lines)
+{
+  int32_t j, k;
+  int32_t e[16], o[16];
+  int32_t ee[8], eo[8];
+  int32_t eee[4], eeo[4];
+  int32_t eeee[2], eeeo[2];
+  int32_t add = 1 << (shift - 1);
+  const int32_t line = 32;
+
+  memset(dst, 0, 32 * 32 * sizeof(*dst));
+
+  for (j = 0; j < num_lines; j++) {
+    for (k = 0; k < 16; k++) {
+      e[k] = src[k] + src[31 - k];
+      o[k] = src[k] - src[31 - k];
+    }
+    for (k = 0; k < 8; k++) {
+      ee[k] = e[k] + e[15 - k];
+      eo[k] = e[k] - e[15 - k];
+    }
+    for (k = 0; k < 4; k++) {
+      eee[k] = ee[k] + ee[7 - k];
+      eeo[k] = ee[k] - ee[7 - k];
+    }
+    eeee[0] = eee[0] + eee[3];
+    eeeo[0] = eee[0] - eee[3];
+    eeee[1] = eee[1] + eee[2];
+    eeeo[1] = eee[1] - eee[2];
+
+    dst[0] = (short)((kvz_g_dct_32[0][0] * eeee[0] + kvz_g_dct_32[0][1] * eeee[1] + add) >> shift);
+    dst[8 * line] = (short)((kvz_g_dct_32[8][0] * eeeo[0] + kvz_g_dct_32[8][1] * eeeo[1] + add) >> shift);
+    for (k = 4; k < 16; k += 8) {
+      int32_t sum = 0;
+      for (int32_t i = 0; i < 4; i++) sum += kvz_g_dct_32[k][i] * eeo[i];
+      dst[k*line] = (short)((sum + add) >> shift);
+    }
+    for (k = 2; k < 16; k += 4) {
+      int32_t sum = 0;
+      for (int32_t i = 0; i < 8; i++) sum += kvz_g_dct_32[k][i] * eo[i];
+      dst[k*line] = (short)((sum + add) >> shift);
+    }
+    for (k = 1; k < 16; k += 2) {
+      int32_t sum = 0;
+      for (int32_t i = 0; i < 16; i++) sum += kvz_g_dct_32[k][i] * o[i];
+      dst[k*line] = (short)((sum + add) >> shift);
+    }
+    src += 32;
+    dst++;
+  }
+}
+
+
+/**
+ * \brief Inverse 32-point transform of lines with only a few non-zero inputs.
+ *
+ * Only the first num_inputs inputs of the first num_lines lines can be
+ * non-zero. The rest of the output lines are set to zero.
+ */
+static void partial_butterfly_inverse_32_partial_generic(const int16_t *src, int16_t *dst,
+  int32_t shift, int32_t num_lines, int32_t num_inputs)
+{
+  int32_t j, k, i;
+  int32_t e[16], o[16];
+  int32_t ee[8], eo[8];
+  int32_t eee[4], eeo[4];
+  int32_t eeee[2], eeeo[2];
+  int32_t add = 1 << (shift - 1);
+  const int32_t line = 32;
+
+  memset(dst + num_lines * line, 0, (32 - num_lines) * line * sizeof(*dst));
+
+  for (j = 0; j < num_lines; j++) {
+    for (k = 0; k < 16; k++) {
+      o[k] = 0;
+      for (i = 1; i < num_inputs; i += 2) o[k] += kvz_g_dct_32[i][k] * src[i * line];
+    }
+    for (k = 0; k < 8; k++) {
+      eo[k] = 0;
+      for (i = 2; i < num_inputs; i += 4) eo[k] += kvz_g_dct_32[i][k] * src[i * line];
+    }
+    for (k = 0; k < 4; k++) {
+      eeo[k] = 0;
+      for (i = 4; i < num_inputs; i += 8) eeo[k] += kvz_g_dct_32[i][k] * src[i * line];
+    }
+    eeeo[0] = eeeo[1] = 0;
+    eeee[0] = kvz_g_dct_32[0][0] * src[0];
+    eeee[1] = kvz_g_dct_32[0][1] * src[0];
+    if (num_inputs > 8) {
+      eeeo[0] = kvz_g_dct_32[8][0] * src[8 * line];
+      eeeo[1] = kvz_g_dct_32[8][1] * src[8 * line];
+    }
+    if (num_inputs > 16) {
+      eeee[0] += kvz_g_dct_32[16][0] * src[16 * line];
+      eeee[1] += kvz_g_dct_32[16][1] * src[16 * line];
+    }
+    if (num_inputs > 24) {
+      eeeo[0] += kvz_g_dct_32[24][0] * src[24 * line];
+      eeeo[1] += kvz_g_dct_32[24][1] * src[24 * line];
+    }
+
+    eee[0] = eeee[0] + eeeo[0];
+    eee[3] = eeee[0] - eeeo[0];
+    eee[1] = eeee[1] + eeeo[1];
+    eee[2] = eeee[1] - eeeo[1];
+    for (k = 0; k < 4; k++) {
+      ee[k] = eee[k] + eeo[k];
+      ee[k + 4] = eee[3 - k] - eeo[3 - k];
+    }
+    for (k = 0; k < 8; k++) {
+      e[k] = ee[k] + eo[k];
+      e[k + 8] = ee[7 - k] - eo[7 - k];
+    }
+    for (k = 0; k<16; k++) {
+      dst[k] = (short)MAX(-32768, MIN(32767, (e[k] + o[k] + add) >> shift));
+      dst[k + 16] = (short)MAX(-32768, MIN(32767, (e[15 - k] - o[15 - k] + add) >> shift));
+    }
+    src++;
+    dst += 32;
+  }
+}
+
 #define DCT_NXN_GENERIC(n) \
 static void dct_ ## n ## x ## n ## _generic(int8_t bitdepth, const int16_t *input, int16_t *output) { \
 \
@@ -608,6 +739,27 @@ IDCT_NXN_GENERIC(8);
 IDCT_NXN_GENERIC(16);
 IDCT_NXN_GENERIC(32);
 
+static void dct_32x32_lowfreq_generic(int8_t bitdepth, const int16_t *input, int16_t *output)
+{
+  int16_t tmp[32 * 32];
+  int32_t shift_1st = kvz_g_convert_to_bit[32] + 1 + (bitdepth - 8);
+  int32_t shift_2nd = kvz_g_convert_to_bit[32] + 8;
+
+  partial_butterfly_32_low_generic(input, tmp, shift_1st, 32);
+  partial_butterfly_32_low_generic(tmp, output, shift_2nd, 16);
+}
+
+static void idct_32x32_partial_generic(int8_t bitdepth, const int16_t *input, int16_t *output,
+                                       int32_t num_rows, int32_t num_cols)
+{
+  int16_t tmp[32 * 32];
+  int32_t shift_1st = 7;
+  int32_t shift_2nd = 12 - (bitdepth - 8);
+
+  partial_butterfly_inverse_32_partial_generic(input, tmp, shift_1st, num_cols, num_rows);
+  partial_butterfly_inverse_32_partial_generic(tmp, output, shift_2nd, 32, num_cols);
+}
+
 static void fast_forward_dst_4x4_generic(int8_t bitdepth, const int16_t *input, int16_t *output)
 {
   int16_t tmp[4*4]; 
@@ -645,5 +797,8 @@ int kvz_strategy_register_dct_generic(void* opaque, uint8_t bitdepth)
   success &= kvz_strategyselector_register(opaque, "idct_8x8", "generic", 0, &idct_8x8_generic);
   success &= kvz_strategyselector_register(opaque, "idct_16x16", "generic", 0, &idct_16x16_generic);
   success &= kvz_strategyselector_register(opaque, "idct_32x32", "generic", 0, &idct_32x32_generic);
+
+  success &= kvz_strategyselector_register(opaque, "dct_32x32_lowfreq", "generic", 0, &dct_32x32_lowfreq_generic);
+  success &= kvz_strategyselector_register(opaque, "idct_32x32_partial", "generic", 0, &idct_32x32_partial_generic);
   return success;
 }
@@ -44,10 +44,10 @@ void kvz_encode_coeff_nxn_generic(encoder_state_t * const state,
                                   uint8_t type,
                                   int8_t scan_mode,
                                   int8_t tr_skip,
-                                  double* bits_out)
+                                  rd_bits_t* bits_out)
 {
   const encoder_control_t * const encoder = state->encoder_control;
-  double bits = 0;
+  rd_bits_t bits = 0;
   int c1 = 1;
   uint8_t last_coeff_x = 0;
   uint8_t last_coeff_y = 0;
@@ -244,13 +244,13 @@ void kvz_encode_coeff_nxn_generic(encoder_state_t * const state,
             coeff_signs = coeff_signs ^ kvz_crypto_get_key(state->crypto_hdl, num_non_zero-1);
           }
         CABAC_BINS_EP(cabac, coeff_signs , (num_non_zero - 1), "coeff_sign_flag");
-        if (cabac->only_count) bits += num_non_zero - 1;
+        if (cabac->only_count) bits += RD_BITS(num_non_zero - 1);
       } else {
         if (!cabac->only_count)
           if (encoder->cfg.crypto_features & KVZ_CRYPTO_TRANSF_COEFF_SIGNS)
             coeff_signs = coeff_signs ^ kvz_crypto_get_key(state->crypto_hdl, num_non_zero);
         CABAC_BINS_EP(cabac, coeff_signs, num_non_zero, "coeff_sign_flag");
-        if (cabac->only_count) bits += num_non_zero;
+        if (cabac->only_count) bits += RD_BITS(num_non_zero);
       }
 
       if (c1 == 0 || num_non_zero > C1FLAG_NUMBER) {
@@ -264,9 +264,9 @@ void kvz_encode_coeff_nxn_generic(encoder_state_t * const state,
               if (encoder->cfg.crypto_features & KVZ_CRYPTO_TRANSF_COEFFS)
                 kvz_cabac_write_coeff_remain_encry(state, cabac, abs_coeff[idx] - base_level, go_rice_param, base_level);
               else
-                bits += kvz_cabac_write_coeff_remain(cabac, abs_coeff[idx] - base_level, go_rice_param);
+                bits += RD_BITS(kvz_cabac_write_coeff_remain(cabac, abs_coeff[idx] - base_level, go_rice_param));
             } else
-              bits += kvz_cabac_write_coeff_remain(cabac, abs_coeff[idx] - base_level, go_rice_param);
+              bits += RD_BITS(kvz_cabac_write_coeff_remain(cabac, abs_coeff[idx] - base_level, go_rice_param));
 
             if (abs_coeff[idx] > 3 * (1 << go_rice_param)) {
               go_rice_param = MIN(go_rice_param + 1, 4);
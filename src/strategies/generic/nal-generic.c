@@ -38,148 +38,189 @@
 #include "strategyselector.h"
 
 
-static void array_md5_generic(const kvz_pixel* data,
-                              const int height, const int width,
-                              const int stride,
-                              unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth)
+// CRC-16 with the polynomial x^16 + x^12 + x^5 + 1 of the decoded picture
+// hash SEI. Entry h is h * x^16 modulo the polynomial.
+static const uint16_t crc_table[256] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+  0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+  0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+  0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+  0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+  0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+  0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+  0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+  0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+  0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+  0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+  0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+  0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+  0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+  0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+  0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+  0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+  0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+  0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+  0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+  0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+  0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+  0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+// Table of x ^ y for the bytes of 4 or 8 consecutive pixels of 8-bit
+// checksum, indexed by [x / 4 + 64 * y] or [x / 8 + 32 * y].
+static uint32_t ckmap[64*256];
+
+static void array_md5_generic(const int count,
+                              const kvz_pixel *const data[],
+                              const uint32_t length[],
+                              unsigned char checksum_out[][SEI_HASH_MAX_LENGTH])
 {
   assert(SEI_HASH_MAX_LENGTH >= 16);
 
-  context_md5_t md5_ctx;
-  kvz_md5_init(&md5_ctx);
-  
-  unsigned bytes = width * height * sizeof(kvz_pixel);
-  kvz_md5_update(&md5_ctx, (const unsigned char *)data, bytes);
+  for (int i = 0; i < count; ++i) {
+    context_md5_t md5_ctx;
+    kvz_md5_init(&md5_ctx);
+
+    unsigned bytes = length[i] * sizeof(kvz_pixel);
+    kvz_md5_update(&md5_ctx, (const unsigned char *)data[i], bytes);
 
-  kvz_md5_final(checksum_out, &md5_ctx);
+    kvz_md5_final(checksum_out[i], &md5_ctx);
+  }
 }
 
-static void array_checksum_generic(const kvz_pixel* data,
-                                   const int height, const int width,
-                                   const int stride,
-                                   unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth) {
-  int x, y;
-  int checksum = 0;
-  
-  assert(SEI_HASH_MAX_LENGTH >= 4);
-  
-  for (y = 0; y < height; ++y) {
-    for (x = 0; x < width; ++x) {
+static uint16_t array_crc_generic(uint16_t crc,
+                                  const kvz_pixel *data,
+                                  const int width)
+{
+  for (int x = 0; x < width; ++x) {
+#if KVZ_BIT_DEPTH > 8
+    crc = (uint16_t)(crc << 8) ^ (data[x] & 0xff) ^ crc_table[crc >> 8];
+    crc = (uint16_t)(crc << 8) ^ (data[x] >> 8) ^ crc_table[crc >> 8];
+#else
+    crc = (uint16_t)(crc << 8) ^ data[x] ^ crc_table[crc >> 8];
+#endif
+  }
+  return crc;
+}
+
+static uint32_t array_checksum_generic(const kvz_pixel* data,
+                                       const int height, const int width,
+                                       const int stride,
+                                       const int x0, const int y0,
+                                       const uint8_t bitdepth) {
+  uint32_t checksum = 0;
+
+  for (int y = y0; y < y0 + height; ++y) {
+    const kvz_pixel *row = &data[(y - y0) * stride - x0];
+    for (int x = x0; x < x0 + width; ++x) {
       const uint8_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
-      checksum += (data[(y * stride) + x] & 0xff) ^ mask;
+      checksum += (row[x] & 0xff) ^ mask;
 #if KVZ_BIT_DEPTH > 8
-      checksum += ((data[(y * stride) + x] >> 8) & 0xff) ^ mask;
+      checksum += ((row[x] >> 8) & 0xff) ^ mask;
 #endif
     }
   }
 
-  // Unpack uint into byte-array.
-  checksum_out[0] = (checksum >> 24) & 0xff;
-  checksum_out[1] = (checksum >> 16) & 0xff;
-  checksum_out[2] = (checksum >> 8) & 0xff;
-  checksum_out[3] = (checksum) & 0xff;
+  return checksum;
 }
 
-static void array_checksum_generic4(const kvz_pixel* data,
-                                   const int height, const int width,
-                                   const int stride,
-                                   unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth) {
+// Checksum of the pixels between x_begin and x_end on row y.
+static uint32_t row_checksum_scalar(const kvz_pixel *row, int y, int x_begin, int x_end)
+{
+  uint32_t checksum = 0;
+  for (int x = x_begin; x < x_end; ++x) {
+    uint8_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
+    checksum += (row[x] & 0xff) ^ mask;
+  }
+  return checksum;
+}
+
+static uint32_t array_checksum_generic4(const kvz_pixel* data,
+                                        const int height, const int width,
+                                        const int stride,
+                                        const int x0, const int y0,
+                                        const uint8_t bitdepth) {
   uint32_t checksum = 0;
-  int y, x, xp;
-  
-  static uint8_t ckmap_initialized = 0;
-  static uint32_t ckmap[64*256];
 
   //TODO: add 10-bit support
   if(bitdepth != 8) {
-    array_checksum_generic(data, height, width, stride,checksum_out, bitdepth);
-    return;
-  }
-  if (!ckmap_initialized) {
-    uint8_t * const ckmap_uint8 = (uint8_t*)&ckmap;
-    int x, y;
-    for (y = 0; y < 256; ++y) {
-      for (x = 0; x < 256; ++x) {
-        ckmap_uint8[y*256+x] = x^y;
-      }
-    }
-    ckmap_initialized = 1;
+    return array_checksum_generic(data, height, width, stride, x0, y0, bitdepth);
   }
 
-  assert(SEI_HASH_MAX_LENGTH >= 4);
+  // Process aligned groups of 4 pixels so that the mask can be looked up.
+  const int x_begin = MIN(x0 + width, (x0 + 3) & ~3);
+  const int x_end = MAX(x_begin, (x0 + width) & ~3);
 
-  for (y = 0; y < height; ++y) {
-    for (xp = 0; xp < width/4; ++xp) {
-      const int x = xp * 4;
+  for (int y = y0; y < y0 + height; ++y) {
+    const kvz_pixel *row = &data[(y - y0) * stride - x0];
+    checksum += row_checksum_scalar(row, y, x0, x_begin);
+    for (int x = x_begin; x < x_end; x += 4) {
+      const int xp = x / 4;
       const uint32_t mask = ckmap[(xp&63)+64*(y&255)] ^ (((x >> 8) ^ (y >> 8)) * 0x1010101);
-      const uint32_t cksumbytes = (*((uint32_t*)(&data[(y * stride) + x]))) ^ mask;
+      const uint32_t cksumbytes = (*((uint32_t*)(&row[x]))) ^ mask;
       checksum += ((cksumbytes >> 24) & 0xff) + ((cksumbytes >> 16) & 0xff) + ((cksumbytes >> 8) & 0xff) + (cksumbytes & 0xff);
     }
-    for (x = xp*4; x < width; ++x) {
-      uint8_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
-      checksum += (data[(y * stride) + x] & 0xff) ^ mask;
-    }
+    checksum += row_checksum_scalar(row, y, x_end, x0 + width);
   }
 
-  // Unpack uint into byte-array.
-  checksum_out[0] = (checksum >> 24) & 0xff;
-  checksum_out[1] = (checksum >> 16) & 0xff;
-  checksum_out[2] = (checksum >> 8) & 0xff;
-  checksum_out[3] = (checksum) & 0xff;
+  return checksum;
 }
 
-static void array_checksum_generic8(const kvz_pixel* data,
-                                   const int height, const int width,
-                                   const int stride,
-                                   unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth) {
+static uint32_t array_checksum_generic8(const kvz_pixel* data,
+                                        const int height, const int width,
+                                        const int stride,
+                                        const int x0, const int y0,
+                                        const uint8_t bitdepth) {
   uint32_t checksum = 0;
-  int y, x, xp;
-  
-  static uint8_t ckmap_initialized = 0;
-  static uint64_t ckmap[32*256];
-  
+  const uint64_t *const ckmap64 = (const uint64_t*)ckmap;
+
   //TODO: add 10-bit support
   if(bitdepth != 8) {
-    array_checksum_generic(data, height, width, stride,checksum_out, bitdepth);
-    return;
-  }
-  if (!ckmap_initialized) {
-    uint8_t * const ckmap_uint8 = (uint8_t*)&ckmap;
-    int x, y;
-    for (y = 0; y < 256; ++y) {
-      for (x = 0; x < 256; ++x) {
-        ckmap_uint8[y*256+x] = x^y;
-      }
-    }
-    ckmap_initialized = 1;
+    return array_checksum_generic(data, height, width, stride, x0, y0, bitdepth);
   }
 
-  assert(SEI_HASH_MAX_LENGTH >= 4);
-
-  for (y = 0; y < height; ++y) {
-    for (xp = 0; xp < width/8; ++xp) {
-      const int x = xp * 8;
-      const uint64_t mask = ckmap[(xp&31)+32*(y&255)] ^ ((uint64_t)((x >> 8) ^ (y >> 8)) * 0x101010101010101);
-      const uint64_t cksumbytes = (*((uint64_t*)(&data[(y * stride) + x]))) ^ mask;
+  // Process aligned groups of 8 pixels so that the mask can be looked up.
+  const int x_begin = MIN(x0 + width, (x0 + 7) & ~7);
+  const int x_end = MAX(x_begin, (x0 + width) & ~7);
+
+  for (int y = y0; y < y0 + height; ++y) {
+    const kvz_pixel *row = &data[(y - y0) * stride - x0];
+    checksum += row_checksum_scalar(row, y, x0, x_begin);
+    for (int x = x_begin; x < x_end; x += 8) {
+      const int xp = x / 8;
+      const uint64_t mask = ckmap64[(xp&31)+32*(y&255)] ^ ((uint64_t)((x >> 8) ^ (y >> 8)) * 0x101010101010101);
+      const uint64_t cksumbytes = (*((uint64_t*)(&row[x]))) ^ mask;
       checksum += ((cksumbytes >> 56) & 0xff) + ((cksumbytes >> 48) & 0xff) + ((cksumbytes >> 40) & 0xff) + ((cksumbytes >> 32) & 0xff) + ((cksumbytes >> 24) & 0xff) + ((cksumbytes >> 16) & 0xff) + ((cksumbytes >> 8) & 0xff) + (cksumbytes & 0xff);
     }
-    for (x = xp*8; x < width; ++x) {
-      uint8_t mask = (uint8_t)((x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8));
-      checksum += (data[(y * stride) + x] & 0xff) ^ mask;
-    }
+    checksum += row_checksum_scalar(row, y, x_end, x0 + width);
   }
 
-  // Unpack uint into byte-array.
-  checksum_out[0] = (checksum >> 24) & 0xff;
-  checksum_out[1] = (checksum >> 16) & 0xff;
-  checksum_out[2] = (checksum >> 8) & 0xff;
-  checksum_out[3] = (checksum) & 0xff;
+  return checksum;
 }
 
 int kvz_strategy_register_nal_generic(void* opaque, uint8_t bitdepth) {
   bool success = true;
 
+  // Fill the table here instead of on first use, because the checksums of
+  // different LCUs are computed in parallel.
+  uint8_t * const ckmap_uint8 = (uint8_t*)ckmap;
+  for (int y = 0; y < 256; ++y) {
+    for (int x = 0; x < 256; ++x) {
+      ckmap_uint8[y*256+x] = x^y;
+    }
+  }
+
   success &= kvz_strategyselector_register(opaque, "array_md5", "generic", 0, &array_md5_generic);
+  success &= kvz_strategyselector_register(opaque, "array_crc", "generic", 0, &array_crc_generic);
   success &= kvz_strategyselector_register(opaque, "array_checksum", "generic", 0, &array_checksum_generic);
   success &= kvz_strategyselector_register(opaque, "array_checksum", "generic4", 1, &array_checksum_generic4);
   success &= kvz_strategyselector_register(opaque, "array_checksum", "generic8", 2, &array_checksum_generic8);
@@ -774,6 +774,46 @@ static double pixel_var_generic(const kvz_pixel *arr, const uint32_t len)
   return var;
 }
 
+static void ssim_4x4_stats_generic(const kvz_pixel *ref, int ref_stride,
+                                   const kvz_pixel *rec, int rec_stride,
+                                   int blocks, int32_t sums[][4])
+{
+  for (int i = 0; i < blocks; ++i) {
+    int32_t s1 = 0, s2 = 0, ss = 0, s12 = 0;
+    for (int y = 0; y < 4; ++y) {
+      for (int x = 0; x < 4; ++x) {
+        const int32_t a = ref[i * 4 + x + y * ref_stride];
+        const int32_t b = rec[i * 4 + x + y * rec_stride];
+        s1  += a;
+        s2  += b;
+        ss  += a * a + b * b;
+        s12 += a * b;
+      }
+    }
+    sums[i][0] = s1;
+    sums[i][1] = s2;
+    sums[i][2] = ss;
+    sums[i][3] = s12;
+  }
+}
+
+static void pixel_4x4_sums_generic(const kvz_pixel *buf, int stride,
+                                   int blocks, int32_t sums[][2])
+{
+  for (int i = 0; i < blocks; ++i) {
+    int32_t sum = 0, sq_sum = 0;
+    for (int y = 0; y < 4; ++y) {
+      for (int x = 0; x < 4; ++x) {
+        const int32_t a = buf[i * 4 + x + y * stride];
+        sum    += a;
+        sq_sum += a * a;
+      }
+    }
+    sums[i][0] = sum;
+    sums[i][1] = sq_sum;
+  }
+}
+
 int kvz_strategy_register_picture_generic(void* opaque, uint8_t bitdepth)
 {
   bool success = true;
@@ -814,6 +854,8 @@ int kvz_strategy_register_picture_generic(void* opaque, uint8_t bitdepth)
   success &= kvz_strategyselector_register(opaque, "hor_sad", "generic", 0, &hor_sad_generic);
 
   success &= kvz_strategyselector_register(opaque, "pixel_var", "generic", 0, &pixel_var_generic);
+  success &= kvz_strategyselector_register(opaque, "ssim_4x4_stats", "generic", 0, &ssim_4x4_stats_generic);
+  success &= kvz_strategyselector_register(opaque, "pixel_4x4_sums", "generic", 0, &pixel_4x4_sums_generic);
 
   return success;
 }
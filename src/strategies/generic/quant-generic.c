@@ -33,22 +33,34 @@
 #include "strategies/generic/quant-generic.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "encoder.h"
 #include "rdo.h"
 #include "scalinglist.h"
+#include "strategies/strategies-dct.h"
 #include "strategies/strategies-quant.h"
 #include "strategyselector.h"
 #include "transform.h"
 #include "fast_coeff_cost.h"
+#include "fast_rdoq.h"
 
 #define QUANT_SHIFT 14
+
+static INLINE int32_t quant_level(int64_t scaled, int32_t add, int32_t add_dz, int32_t q_bits)
+{
+  if ((scaled + add_dz) >> q_bits == 0) return 0;
+  return (int32_t)MAX(1, (scaled + add) >> q_bits);
+}
+
 /**
 * \brief quantize transformed coefficents
 *
+* \param offset     rounding offset in 1/512 of a quantization step
+* \param dz_offset  rounding offset used to decide between levels 0 and 1
 */
-void kvz_quant_generic(const encoder_state_t * const state, coeff_t *coef, coeff_t *q_coef, int32_t width,
-  int32_t height, int8_t type, int8_t scan_idx, int8_t block_type)
+static INLINE void quant_with_offsets(const encoder_state_t * const state, const coeff_t *coef, coeff_t *q_coef, int32_t width,
+  int32_t height, int8_t type, int8_t scan_idx, int8_t block_type, int32_t offset, int32_t dz_offset)
 {
   const encoder_control_t * const encoder = state->encoder_control;
   const uint32_t log2_block_size = kvz_g_convert_to_bit[width] + 2;
@@ -60,7 +72,8 @@ void kvz_quant_generic(const encoder_state_t * const state, coeff_t *coef, coeff
   const int32_t *quant_coeff = encoder->scaling_list.quant_coeff[log2_tr_size - 2][scalinglist_type][qp_scaled % 6];
   const int32_t transform_shift = MAX_TR_DYNAMIC_RANGE - encoder->bitdepth - log2_tr_size; //!< Represents scaling through forward transform
   const int32_t q_bits = QUANT_SHIFT + qp_scaled / 6 + transform_shift;
-  const int32_t add = ((state->frame->slicetype == KVZ_SLICE_I) ? 171 : 85) << (q_bits - 9);
+  const int32_t add = offset << (q_bits - 9);
+  const int32_t add_dz = dz_offset << (q_bits - 9);
   const int32_t q_bits8 = q_bits - 8;
 
   uint32_t ac_sum = 0;
@@ -73,7 +86,7 @@ void kvz_quant_generic(const encoder_state_t * const state, coeff_t *coef, coeff
     sign = (level < 0 ? -1 : 1);
 
     int32_t curr_quant_coeff = quant_coeff[n];
-    level = (abs_level * curr_quant_coeff + add) >> q_bits;
+    level = quant_level(abs_level * curr_quant_coeff, add, add_dz, q_bits);
     ac_sum += level;
 
     level *= sign;
@@ -90,7 +103,7 @@ void kvz_quant_generic(const encoder_state_t * const state, coeff_t *coef, coeff
     int64_t abs_level = (int64_t)abs(level);
     int32_t curr_quant_coeff = quant_coeff[n];
 
-    level = (abs_level * curr_quant_coeff + add) >> q_bits;
+    level = quant_level(abs_level * curr_quant_coeff, add, add_dz, q_bits);
     delta_u[n] = (int32_t)((abs_level * curr_quant_coeff - (level << q_bits)) >> q_bits8);
   }
 
@@ -179,6 +192,27 @@ void kvz_quant_generic(const encoder_state_t * const state, coeff_t *coef, coeff
   }
 }
 
+void kvz_quant_generic(const encoder_state_t * const state, coeff_t *coef, coeff_t *q_coef, int32_t width,
+  int32_t height, int8_t type, int8_t scan_idx, int8_t block_type)
+{
+  const int32_t offset = (state->frame->slicetype == KVZ_SLICE_I) ? 171 : 85;
+  quant_with_offsets(state, coef, q_coef, width, height, type, scan_idx, block_type, offset, offset);
+}
+
+/**
+* \brief Approximate RDOQ by quantizing with deadzone and rounding offsets
+* from the fast RDOQ table.
+*/
+void kvz_quant_approx_generic(const encoder_state_t * const state, coeff_t *coef, coeff_t *q_coef, int32_t width,
+  int32_t height, int8_t type, int8_t scan_idx, int8_t block_type)
+{
+  const fast_rdoq_table_t *table = &state->encoder_control->fast_rdoq_table;
+  const int32_t qp = CLIP(0, MAX_FAST_RDOQ_QP - 1, state->qp);
+  const int32_t size = kvz_g_convert_to_bit[width];
+  quant_with_offsets(state, coef, q_coef, width, height, type, scan_idx, block_type,
+                     table->rounding[qp][size], table->deadzone[qp][size]);
+}
+
 /**
 * \brief Quantize residual and get both the reconstruction and coeffs.
 *
@@ -227,17 +261,20 @@ int kvz_quantize_residual_generic(encoder_state_t *const state,
     kvz_transformskip(state->encoder_control, residual, coeff, width);
   }
   else {
-    kvz_transform2d(state->encoder_control, residual, coeff, width, color, cur_cu->type);
+    kvz_transform2d(state, residual, coeff, width, color, cur_cu->type);
   }
 
   // Quantize coeffs. (coeff -> coeff_out)
-  if (state->encoder_control->cfg.rdoq_enable &&
-      (width > 4 || !state->encoder_control->cfg.rdoq_skip))
+  const enum kvz_quant_mode quant_mode = kvz_select_quant_mode(state->encoder_control, width);
+  if (quant_mode == KVZ_QUANT_RDOQ)
   {
     int8_t tr_depth = cur_cu->tr_depth - cur_cu->depth;
     tr_depth += (cur_cu->part_size == SIZE_NxN ? 1 : 0);
     kvz_rdoq(state, coeff, coeff_out, width, width, (color == COLOR_Y ? 0 : 2),
       scan_order, cur_cu->type, tr_depth);
+  } else if (quant_mode == KVZ_QUANT_APPROX) {
+    kvz_quant_approx(state, coeff, coeff_out, width, width, (color == COLOR_Y ? 0 : 2),
+      scan_order, cur_cu->type);
   } else {
     kvz_quant(state, coeff, coeff_out, width, width, (color == COLOR_Y ? 0 : 2),
       scan_order, cur_cu->type);
@@ -356,6 +393,80 @@ static INLINE void get_coeff_weights(uint64_t wts_packed, uint16_t *weights)
   weights[3] = (wts_packed >> 48) & 0xffff;
 }
 
+/**
+ * \brief Estimate the cost of a block with each transform size.
+ *
+ * Every transform block is taken through residual, transform, quant,
+ * coefficient cost estimate, dequant, inverse transform and SSD before
+ * moving on to the next one, so the intermediate data stays in cache.
+ *
+ * \param width       Width of the block.
+ * \param num_levels  Number of transform sizes to evaluate, starting from
+ *                    width and halving the transform width for each level.
+ * \param stride      Stride of ref_in and pred_in.
+ * \param costs_out   Cost for each level.
+ */
+static void tr_split_costs_generic(encoder_state_t *const state,
+  const int width, const color_t color, const cu_type_t type, const int num_levels,
+  const kvz_pixel *const ref_in, const kvz_pixel *const pred_in, const int stride,
+  tr_cost_t *costs_out)
+{
+  ALIGNED(64) int16_t residual[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  ALIGNED(64) coeff_t coeff[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  ALIGNED(64) coeff_t quant_coeff[TR_MAX_WIDTH * TR_MAX_WIDTH];
+
+  const encoder_control_t *const encoder = state->encoder_control;
+  const uint64_t weights = kvz_fast_coeff_get_weights(state);
+
+  assert(width <= TR_MAX_WIDTH);
+  assert((width >> (num_levels - 1)) >= TR_MIN_WIDTH);
+
+  for (int level = 0; level < num_levels; ++level) {
+    const int tr_width = width >> level;
+    dct_func *const dct = kvz_get_dct_func(tr_width, color, type);
+    dct_func *const idct = kvz_get_idct_func(tr_width, color, type);
+    uint64_t ssd = 0;
+    double bits = 0;
+
+    for (int y0 = 0; y0 < width; y0 += tr_width) {
+      for (int x0 = 0; x0 < width; x0 += tr_width) {
+        const kvz_pixel *const ref = &ref_in[x0 + y0 * stride];
+        const kvz_pixel *const pred = &pred_in[x0 + y0 * stride];
+
+        for (int y = 0; y < tr_width; ++y) {
+          for (int x = 0; x < tr_width; ++x) {
+            residual[x + y * tr_width] = (int16_t)(ref[x + y * stride] - pred[x + y * stride]);
+          }
+        }
+
+        dct(encoder->bitdepth, residual, coeff);
+        kvz_quant(state, coeff, quant_coeff, tr_width, tr_width, (color == COLOR_Y ? 0 : 2),
+          SCAN_DIAG, type);
+        bits += kvz_fast_coeff_cost(quant_coeff, tr_width, weights);
+
+        if (kvz_coeff_abs_sum(quant_coeff, tr_width * tr_width) > 0) {
+          kvz_dequant(state, quant_coeff, coeff, tr_width, tr_width,
+            (color == COLOR_Y ? 0 : (color == COLOR_U ? 2 : 3)), type);
+          idct(encoder->bitdepth, coeff, residual);
+        } else {
+          memset(residual, 0, tr_width * tr_width * sizeof(residual[0]));
+        }
+
+        for (int y = 0; y < tr_width; ++y) {
+          for (int x = 0; x < tr_width; ++x) {
+            const int rec = CLIP(0, PIXEL_MAX, residual[x + y * tr_width] + pred[x + y * stride]);
+            const int diff = ref[x + y * stride] - rec;
+            ssd += diff * diff;
+          }
+        }
+      }
+    }
+
+    costs_out[level].ssd = ssd;
+    costs_out[level].bits = bits;
+  }
+}
+
 static double fast_coeff_cost_generic(const coeff_t *coeff, int32_t width, uint64_t weights)
 {
   uint32_t sum = 0;
@@ -383,6 +494,9 @@ int kvz_strategy_register_quant_generic(void* opaque, uint8_t bitdepth)
   success &= kvz_strategyselector_register(opaque, "dequant", "generic", 0, &kvz_dequant_generic);
   success &= kvz_strategyselector_register(opaque, "coeff_abs_sum", "generic", 0, &coeff_abs_sum_generic);
   success &= kvz_strategyselector_register(opaque, "fast_coeff_cost", "generic", 0, &fast_coeff_cost_generic);
+  success &= kvz_strategyselector_register(opaque, "rdoq", "generic", 0, &kvz_rdoq_generic);
+  success &= kvz_strategyselector_register(opaque, "quant_approx", "generic", 0, &kvz_quant_approx_generic);
+  success &= kvz_strategyselector_register(opaque, "tr_split_costs", "generic", 0, &tr_split_costs_generic);
 
   return success;
 }
@@ -42,39 +42,44 @@
 
 
 /**
- * \param orig_data  Original pixel data. 64x64 for luma, 32x32 for chroma.
- * \param rec_data  Reconstructed pixel data. 64x64 for luma, 32x32 for chroma.
- * \param dir_offsets
- * \param is_chroma  0 for luma, 1 for chroma. Indicates
+ * \brief Gather the edge statistics of all four classes and the band
+ *        statistics of a block in a single pass.
  */
-static void calc_sao_edge_dir_generic(const kvz_pixel *orig_data,
-                                      const kvz_pixel *rec_data,
-                                      int eo_class,
-                                      int block_width,
-                                      int block_height,
-                                      int cat_sum_cnt[2][NUM_SAO_EDGE_CATEGORIES])
+static void calc_sao_stats_generic(const encoder_control_t * const encoder,
+                                   const kvz_pixel *orig_data,
+                                   const kvz_pixel *rec_data,
+                                   int block_width,
+                                   int block_height,
+                                   sao_stats_t *stats)
 {
-  int y, x;
-  vector2d_t a_ofs = g_sao_edge_offsets[eo_class][0];
-  vector2d_t b_ofs = g_sao_edge_offsets[eo_class][1];
-  // Arrays orig_data and rec_data are quarter size for chroma.
+  const int shift = encoder->bitdepth - 5;
+
+  FILL(*stats, 0);
 
-  // Don't sample the edge pixels because this function doesn't have access to
-  // their neighbours.
+  for (int y = 0; y < block_height; ++y) {
+    const bool inner_row = y > 0 && y < block_height - 1;
 
-  
+    for (int x = 0; x < block_width; ++x) {
+      const int pos = y * block_width + x;
+      const kvz_pixel c = rec_data[pos];
+      const int diff = orig_data[pos] - c;
 
-  for (y = 1; y < block_height - 1; ++y) {
-    for (x = 1; x < block_width - 1; ++x) {
-      const kvz_pixel *c_data = &rec_data[y * block_width + x];
-      kvz_pixel a = c_data[a_ofs.y * block_width + a_ofs.x];
-      kvz_pixel c = c_data[0];
-      kvz_pixel b = c_data[b_ofs.y * block_width + b_ofs.x];
+      const int band = c >> shift;
+      stats->band[0][band] += diff;
+      stats->band[1][band] += 1;
 
-      int eo_cat = sao_calc_eo_cat(a, b, c);
+      if (!inner_row || x == 0 || x == block_width - 1) continue;
 
-      cat_sum_cnt[0][eo_cat] += orig_data[y * block_width + x] - c;
-      cat_sum_cnt[1][eo_cat] += 1;
+      for (int eo_class = SAO_EO0; eo_class < SAO_NUM_EO; ++eo_class) {
+        const vector2d_t a_ofs = g_sao_edge_offsets[eo_class][0];
+        const vector2d_t b_ofs = g_sao_edge_offsets[eo_class][1];
+        const kvz_pixel a = rec_data[pos + a_ofs.y * block_width + a_ofs.x];
+        const kvz_pixel b = rec_data[pos + b_ofs.y * block_width + b_ofs.x];
+
+        const int eo_cat = sao_calc_eo_cat(a, b, c);
+        stats->edge[eo_class][0][eo_cat] += diff;
+        stats->edge[eo_class][1][eo_cat] += 1;
+      }
     }
   }
 }
@@ -128,10 +133,8 @@ int kvz_strategy_register_sao_generic(void* opaque, uint8_t bitdepth)
 {
   bool success = true;
 
-  success &= kvz_strategyselector_register(opaque, "sao_edge_ddistortion", "generic", 0, &sao_edge_ddistortion_generic);
-  success &= kvz_strategyselector_register(opaque, "calc_sao_edge_dir", "generic", 0, &calc_sao_edge_dir_generic);
   success &= kvz_strategyselector_register(opaque, "sao_reconstruct_color", "generic", 0, &sao_reconstruct_color_generic);
-  success &= kvz_strategyselector_register(opaque, "sao_band_ddistortion", "generic", 0, &sao_band_ddistortion_generic);
+  success &= kvz_strategyselector_register(opaque, "calc_sao_stats", "generic", 0, &calc_sao_stats_generic);
 
   return success;
 }
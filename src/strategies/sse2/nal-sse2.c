@@ -0,0 +1,227 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * INCLUDING NEGLIGENCE OR OTHERWISE ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "strategies/sse2/nal-sse2.h"
+
+#if COMPILE_INTEL_SSE2
+#include <immintrin.h>
+#include <string.h>
+
+#include "extras/libmd5.h"
+#include "kvazaar.h"
+#include "nal.h"
+#include "strategyselector.h"
+
+
+#define MD5_F1(x, y, z) _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z)))
+#define MD5_F2(x, y, z) MD5_F1(z, x, y)
+#define MD5_F3(x, y, z) _mm_xor_si128(_mm_xor_si128(x, y), z)
+#define MD5_F4(x, y, z) _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, _mm_set1_epi32(-1))))
+
+#define MD5_STEP(f, w, x, y, z, data, k, s) do { \
+    w = _mm_add_epi32(w, _mm_add_epi32(f(x, y, z), _mm_add_epi32(data, _mm_set1_epi32(k)))); \
+    w = _mm_or_si128(_mm_slli_epi32(w, s), _mm_srli_epi32(w, 32 - (s))); \
+    w = _mm_add_epi32(w, x); \
+  } while (0)
+
+/**
+ * \brief Run the MD5 transform on 4 independent streams at once.
+ *
+ * Lane i of the state vectors holds the state of stream i.
+ *
+ * \param state   MD5 state a, b, c and d of the streams
+ * \param data    beginning of each stream
+ * \param blocks  number of 64 byte blocks to process from each stream
+ */
+static void md5_transform_x4(__m128i state[4],
+                             const unsigned char *const data[4],
+                             const uint32_t blocks)
+{
+  for (uint32_t blk = 0; blk < blocks; ++blk) {
+    __m128i in[16];
+
+    // Transpose 4x4 words so that in[j] holds word j of every stream.
+    for (int j = 0; j < 16; j += 4) {
+      const __m128i r0 = _mm_loadu_si128((const __m128i*)&data[0][blk * 64 + j * 4]);
+      const __m128i r1 = _mm_loadu_si128((const __m128i*)&data[1][blk * 64 + j * 4]);
+      const __m128i r2 = _mm_loadu_si128((const __m128i*)&data[2][blk * 64 + j * 4]);
+      const __m128i r3 = _mm_loadu_si128((const __m128i*)&data[3][blk * 64 + j * 4]);
+      const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+      const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+      const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+      const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+      in[j + 0] = _mm_unpacklo_epi64(t0, t1);
+      in[j + 1] = _mm_unpackhi_epi64(t0, t1);
+      in[j + 2] = _mm_unpacklo_epi64(t2, t3);
+      in[j + 3] = _mm_unpackhi_epi64(t2, t3);
+    }
+
+    __m128i a = state[0];
+    __m128i b = state[1];
+    __m128i c = state[2];
+    __m128i d = state[3];
+
+    MD5_STEP(MD5_F1, a, b, c, d, in[0], 0xd76aa478, 7);
+    MD5_STEP(MD5_F1, d, a, b, c, in[1], 0xe8c7b756, 12);
+    MD5_STEP(MD5_F1, c, d, a, b, in[2], 0x242070db, 17);
+    MD5_STEP(MD5_F1, b, c, d, a, in[3], 0xc1bdceee, 22);
+    MD5_STEP(MD5_F1, a, b, c, d, in[4], 0xf57c0faf, 7);
+    MD5_STEP(MD5_F1, d, a, b, c, in[5], 0x4787c62a, 12);
+    MD5_STEP(MD5_F1, c, d, a, b, in[6], 0xa8304613, 17);
+    MD5_STEP(MD5_F1, b, c, d, a, in[7], 0xfd469501, 22);
+    MD5_STEP(MD5_F1, a, b, c, d, in[8], 0x698098d8, 7);
+    MD5_STEP(MD5_F1, d, a, b, c, in[9], 0x8b44f7af, 12);
+    MD5_STEP(MD5_F1, c, d, a, b, in[10], 0xffff5bb1, 17);
+    MD5_STEP(MD5_F1, b, c, d, a, in[11], 0x895cd7be, 22);
+    MD5_STEP(MD5_F1, a, b, c, d, in[12], 0x6b901122, 7);
+    MD5_STEP(MD5_F1, d, a, b, c, in[13], 0xfd987193, 12);
+    MD5_STEP(MD5_F1, c, d, a, b, in[14], 0xa679438e, 17);
+    MD5_STEP(MD5_F1, b, c, d, a, in[15], 0x49b40821, 22);
+
+    MD5_STEP(MD5_F2, a, b, c, d, in[1], 0xf61e2562, 5);
+    MD5_STEP(MD5_F2, d, a, b, c, in[6], 0xc040b340, 9);
+    MD5_STEP(MD5_F2, c, d, a, b, in[11], 0x265e5a51, 14);
+    MD5_STEP(MD5_F2, b, c, d, a, in[0], 0xe9b6c7aa, 20);
+    MD5_STEP(MD5_F2, a, b, c, d, in[5], 0xd62f105d, 5);
+    MD5_STEP(MD5_F2, d, a, b, c, in[10], 0x02441453, 9);
+    MD5_STEP(MD5_F2, c, d, a, b, in[15], 0xd8a1e681, 14);
+    MD5_STEP(MD5_F2, b, c, d, a, in[4], 0xe7d3fbc8, 20);
+    MD5_STEP(MD5_F2, a, b, c, d, in[9], 0x21e1cde6, 5);
+    MD5_STEP(MD5_F2, d, a, b, c, in[14], 0xc33707d6, 9);
+    MD5_STEP(MD5_F2, c, d, a, b, in[3], 0xf4d50d87, 14);
+    MD5_STEP(MD5_F2, b, c, d, a, in[8], 0x455a14ed, 20);
+    MD5_STEP(MD5_F2, a, b, c, d, in[13], 0xa9e3e905, 5);
+    MD5_STEP(MD5_F2, d, a, b, c, in[2], 0xfcefa3f8, 9);
+    MD5_STEP(MD5_F2, c, d, a, b, in[7], 0x676f02d9, 14);
+    MD5_STEP(MD5_F2, b, c, d, a, in[12], 0x8d2a4c8a, 20);
+
+    MD5_STEP(MD5_F3, a, b, c, d, in[5], 0xfffa3942, 4);
+    MD5_STEP(MD5_F3, d, a, b, c, in[8], 0x8771f681, 11);
+    MD5_STEP(MD5_F3, c, d, a, b, in[11], 0x6d9d6122, 16);
+    MD5_STEP(MD5_F3, b, c, d, a, in[14], 0xfde5380c, 23);
+    MD5_STEP(MD5_F3, a, b, c, d, in[1], 0xa4beea44, 4);
+    MD5_STEP(MD5_F3, d, a, b, c, in[4], 0x4bdecfa9, 11);
+    MD5_STEP(MD5_F3, c, d, a, b, in[7], 0xf6bb4b60, 16);
+    MD5_STEP(MD5_F3, b, c, d, a, in[10], 0xbebfbc70, 23);
+    MD5_STEP(MD5_F3, a, b, c, d, in[13], 0x289b7ec6, 4);
+    MD5_STEP(MD5_F3, d, a, b, c, in[0], 0xeaa127fa, 11);
+    MD5_STEP(MD5_F3, c, d, a, b, in[3], 0xd4ef3085, 16);
+    MD5_STEP(MD5_F3, b, c, d, a, in[6], 0x04881d05, 23);
+    MD5_STEP(MD5_F3, a, b, c, d, in[9], 0xd9d4d039, 4);
+    MD5_STEP(MD5_F3, d, a, b, c, in[12], 0xe6db99e5, 11);
+    MD5_STEP(MD5_F3, c, d, a, b, in[15], 0x1fa27cf8, 16);
+    MD5_STEP(MD5_F3, b, c, d, a, in[2], 0xc4ac5665, 23);
+
+    MD5_STEP(MD5_F4, a, b, c, d, in[0], 0xf4292244, 6);
+    MD5_STEP(MD5_F4, d, a, b, c, in[7], 0x432aff97, 10);
+    MD5_STEP(MD5_F4, c, d, a, b, in[14], 0xab9423a7, 15);
+    MD5_STEP(MD5_F4, b, c, d, a, in[5], 0xfc93a039, 21);
+    MD5_STEP(MD5_F4, a, b, c, d, in[12], 0x655b59c3, 6);
+    MD5_STEP(MD5_F4, d, a, b, c, in[3], 0x8f0ccc92, 10);
+    MD5_STEP(MD5_F4, c, d, a, b, in[10], 0xffeff47d, 15);
+    MD5_STEP(MD5_F4, b, c, d, a, in[1], 0x85845dd1, 21);
+    MD5_STEP(MD5_F4, a, b, c, d, in[8], 0x6fa87e4f, 6);
+    MD5_STEP(MD5_F4, d, a, b, c, in[15], 0xfe2ce6e0, 10);
+    MD5_STEP(MD5_F4, c, d, a, b, in[6], 0xa3014314, 15);
+    MD5_STEP(MD5_F4, b, c, d, a, in[13], 0x4e0811a1, 21);
+    MD5_STEP(MD5_F4, a, b, c, d, in[4], 0xf7537e82, 6);
+    MD5_STEP(MD5_F4, d, a, b, c, in[11], 0xbd3af235, 10);
+    MD5_STEP(MD5_F4, c, d, a, b, in[2], 0x2ad7d2bb, 15);
+    MD5_STEP(MD5_F4, b, c, d, a, in[9], 0xeb86d391, 21);
+
+    state[0] = _mm_add_epi32(state[0], a);
+    state[1] = _mm_add_epi32(state[1], b);
+    state[2] = _mm_add_epi32(state[2], c);
+    state[3] = _mm_add_epi32(state[3], d);
+  }
+}
+
+/**
+ * \brief Calculate md5 of up to 4 arrays with 4-way multi-buffer MD5.
+ *
+ * The blocks that all of the arrays have are hashed in parallel and the
+ * rest of each array is finished with the scalar implementation.
+ */
+static void array_md5_sse2(const int count,
+                           const kvz_pixel *const data[],
+                           const uint32_t length[],
+                           unsigned char checksum_out[][SEI_HASH_MAX_LENGTH])
+{
+  assert(count >= 1 && count <= 4);
+
+  const unsigned char *lane_data[4];
+  uint32_t common_blocks = UINT32_MAX;
+  for (int i = 0; i < 4; ++i) {
+    // Unused lanes repeat the last array.
+    const int src = MIN(i, count - 1);
+    lane_data[i] = (const unsigned char *)data[src];
+    common_blocks = MIN(common_blocks, length[src] * sizeof(kvz_pixel) / 64);
+  }
+
+  __m128i state[4] = {
+    _mm_set1_epi32(0x67452301),
+    _mm_set1_epi32(0xefcdab89),
+    _mm_set1_epi32(0x98badcfe),
+    _mm_set1_epi32(0x10325476),
+  };
+  md5_transform_x4(state, lane_data, common_blocks);
+
+  uint32_t lanes[4][4];
+  for (int j = 0; j < 4; ++j) {
+    _mm_storeu_si128((__m128i*)lanes[j], state[j]);
+  }
+
+  for (int i = 0; i < count; ++i) {
+    const uint64_t done_bytes = (uint64_t)common_blocks * 64;
+    context_md5_t md5_ctx;
+    kvz_md5_init(&md5_ctx);
+    for (int j = 0; j < 4; ++j) {
+      md5_ctx.buf[j] = lanes[j][i];
+    }
+    md5_ctx.bits[0] = (uint32_t)(done_bytes << 3);
+    md5_ctx.bits[1] = (uint32_t)(done_bytes >> 29);
+
+    kvz_md5_update(&md5_ctx, lane_data[i] + done_bytes,
+                   (unsigned)(length[i] * sizeof(kvz_pixel) - done_bytes));
+    kvz_md5_final(checksum_out[i], &md5_ctx);
+  }
+}
+
+#endif //COMPILE_INTEL_SSE2
+
+int kvz_strategy_register_nal_sse2(void* opaque, uint8_t bitdepth) {
+  bool success = true;
+#if COMPILE_INTEL_SSE2
+  success &= kvz_strategyselector_register(opaque, "array_md5", "sse2", 10, &array_md5_sse2);
+#endif
+  return success;
+}
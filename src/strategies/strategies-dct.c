@@ -52,6 +52,9 @@ dct_func * kvz_idct_8x8= 0;
 dct_func * kvz_idct_16x16 = 0;
 dct_func * kvz_idct_32x32 = 0;
 
+dct_func * kvz_dct_32x32_lowfreq = 0;
+idct_partial_func * kvz_idct_32x32_partial = 0;
+
 
 int kvz_strategy_register_dct(void* opaque, uint8_t bitdepth) {
   bool success = true;
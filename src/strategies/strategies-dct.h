@@ -43,6 +43,15 @@
 
 typedef void (dct_func)(int8_t bitdepth, const int16_t *input, int16_t *output);
 
+/**
+ * \brief Inverse transform of a block with non-zero coefficients only in
+ *        the top-left num_cols x num_rows region.
+ *
+ * num_rows and num_cols must be multiples of 4.
+ */
+typedef void (idct_partial_func)(int8_t bitdepth, const int16_t *input, int16_t *output,
+                                 int32_t num_rows, int32_t num_cols);
+
 
 // Declare function pointers.
 extern dct_func * kvz_fast_forward_dst_4x4;
@@ -59,6 +68,10 @@ extern dct_func * kvz_idct_8x8;
 extern dct_func * kvz_idct_16x16;
 extern dct_func * kvz_idct_32x32;
 
+// Forward transform that only outputs the low frequency 16x16 coefficients.
+extern dct_func * kvz_dct_32x32_lowfreq;
+extern idct_partial_func * kvz_idct_32x32_partial;
+
 
 int kvz_strategy_register_dct(void* opaque, uint8_t bitdepth);
 dct_func * kvz_get_dct_func(int8_t width, color_t color, cu_type_t type);
@@ -80,6 +93,9 @@ dct_func * kvz_get_idct_func(int8_t width, color_t color, cu_type_t type);
   {"idct_8x8", (void**)&kvz_idct_8x8}, \
   {"idct_16x16", (void**)&kvz_idct_16x16}, \
   {"idct_32x32", (void**)&kvz_idct_32x32}, \
+  \
+  {"dct_32x32_lowfreq", (void**)&kvz_dct_32x32_lowfreq}, \
+  {"idct_32x32_partial", (void**)&kvz_idct_32x32_partial}, \
 
 
 
@@ -53,7 +53,7 @@ typedef void (encode_coeff_nxn_func)(encoder_state_t * const state,
                                          uint8_t type,
                                          int8_t scan_mode,
                                          int8_t tr_skip,
-                                         double *bits_out);
+                                         rd_bits_t *bits_out);
 
 // Declare function pointers.
 extern encode_coeff_nxn_func *kvz_encode_coeff_nxn;
@@ -33,22 +33,23 @@
 #include "strategies/strategies-nal.h"
 
 #include "strategies/generic/nal-generic.h"
+#include "strategies/sse2/nal-sse2.h"
+#include "strategyselector.h"
 
 
-void (*kvz_array_checksum)(const kvz_pixel* data,
-                       const int height, const int width,
-                       const int stride,
-                       unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth);
-void (*kvz_array_md5)(const kvz_pixel* data,
-                      const int height, const int width,
-                      const int stride,
-                      unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth);
+array_checksum_func kvz_array_checksum;
+array_md5_func kvz_array_md5;
+array_crc_func kvz_array_crc;
 
 
 int kvz_strategy_register_nal(void* opaque, uint8_t bitdepth) {
   bool success = true;
 
   success &= kvz_strategy_register_nal_generic(opaque, bitdepth);
+
+  if (kvz_g_hardware_flags.intel_flags.sse2) {
+    success &= kvz_strategy_register_nal_sse2(opaque, bitdepth);
+  }
   
   return success;
 }
@@ -45,18 +45,53 @@
 
 //Function pointer to kvz_array_checksum
 /**
- * \brief Calculate checksum for one color of the picture.
- * \param data Beginning of the pixel data for the picture.
- * \param height Height of the picture.
- * \param width Width of the picture.
+ * \brief Calculate checksum for a rectangle of one color of the picture.
+ *
+ * The checksum of the picture is the sum of the checksums of rectangles
+ * that cover it.
+ *
+ * \param data Top-left pixel of the rectangle.
+ * \param height Height of the rectangle.
+ * \param width Width of the rectangle.
  * \param stride Width of one row in the pixel array.
+ * \param x0 Horizontal position of the rectangle in the picture.
+ * \param y0 Vertical position of the rectangle in the picture.
+ */
+typedef uint32_t (*array_checksum_func)(const kvz_pixel* data,
+                                        const int height, const int width,
+                                        const int stride,
+                                        const int x0, const int y0,
+                                        const uint8_t bitdepth);
+
+/**
+ * \brief Calculate md5 for several colors of the picture at once.
+ * \param count Number of pixel arrays, at most 3.
+ * \param data Beginning of the pixel data of each array.
+ * \param length Number of pixels in each array.
+ * \param checksum_out Result for each array.
  */
-typedef void (*array_checksum_func)(const kvz_pixel* data,
-                                    const int height, const int width,
-                                    const int stride,
-                                    unsigned char checksum_out[SEI_HASH_MAX_LENGTH], const uint8_t bitdepth);
+typedef void (*array_md5_func)(const int count,
+                               const kvz_pixel *const data[],
+                               const uint32_t length[],
+                               unsigned char checksum_out[][SEI_HASH_MAX_LENGTH]);
+
+/**
+ * \brief Update a CRC of the decoded picture hash with a row of pixels.
+ *
+ * Pixels of more than 8 bits are processed as two bytes, the low byte
+ * first.
+ *
+ * \param crc CRC of the preceding pixels.
+ * \param data Pixels to add.
+ * \param width Number of pixels.
+ */
+typedef uint16_t (*array_crc_func)(uint16_t crc,
+                                   const kvz_pixel *data,
+                                   const int width);
+
 extern array_checksum_func kvz_array_checksum;
-extern array_checksum_func kvz_array_md5;
+extern array_md5_func kvz_array_md5;
+extern array_crc_func kvz_array_crc;
 
 
 int kvz_strategy_register_nal(void* opaque, uint8_t bitdepth);
@@ -64,6 +99,7 @@ int kvz_strategy_register_nal(void* opaque, uint8_t bitdepth);
 
 #define STRATEGIES_NAL_EXPORTS \
   {"array_checksum", (void**) &kvz_array_checksum},\
-  {"array_md5", (void**) &kvz_array_md5},
+  {"array_md5", (void**) &kvz_array_md5},\
+  {"array_crc", (void**) &kvz_array_crc},
 
 #endif //STRATEGIES_NAL_H_
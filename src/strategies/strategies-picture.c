@@ -81,6 +81,9 @@ hor_sad_func *kvz_hor_sad = 0;
 
 pixel_var_func *kvz_pixel_var = 0;
 
+ssim_4x4_stats_func *kvz_ssim_4x4_stats = 0;
+pixel_4x4_sums_func *kvz_pixel_4x4_sums = 0;
+
 
 int kvz_strategy_register_picture(void* opaque, uint8_t bitdepth) {
   bool success = true;
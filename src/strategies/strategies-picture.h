@@ -149,6 +149,16 @@ typedef void (inter_recon_bipred_func)(lcu_t * const lcu,
 
 typedef double (pixel_var_func)(const kvz_pixel *buf, const uint32_t len);
 
+/**
+ * \brief Calculate SSIM statistics of a horizontal run of 4x4 blocks.
+ *
+ * For each block, sums[i] receives the sum of ref, the sum of rec, the sum
+ * of ref^2 + rec^2 and the sum of ref * rec, in that order.
+ */
+typedef void (ssim_4x4_stats_func)(const kvz_pixel *ref, int ref_stride,
+                                   const kvz_pixel *rec, int rec_stride,
+                                   int blocks, int32_t sums[][4]);
+
 // Declare function pointers.
 extern reg_sad_func * kvz_reg_sad;
 
@@ -183,12 +193,24 @@ extern pixels_calc_ssd_func *kvz_pixels_calc_ssd;
 
 extern inter_recon_bipred_func * kvz_bipred_average;
 
+/**
+ * \brief Calculate the pixel sums of a horizontal run of 4x4 blocks.
+ *
+ * For each block, sums[i] receives the sum of the pixels and the sum of
+ * their squares, in that order.
+ */
+typedef void (pixel_4x4_sums_func)(const kvz_pixel *buf, int stride,
+                                   int blocks, int32_t sums[][2]);
+
 extern get_optimized_sad_func *kvz_get_optimized_sad;
 extern ver_sad_func *kvz_ver_sad;
 extern hor_sad_func *kvz_hor_sad;
 
 extern pixel_var_func *kvz_pixel_var;
 
+extern ssim_4x4_stats_func *kvz_ssim_4x4_stats;
+extern pixel_4x4_sums_func *kvz_pixel_4x4_sums;
+
 int kvz_strategy_register_picture(void* opaque, uint8_t bitdepth);
 cost_pixel_nxn_func * kvz_pixels_get_satd_func(unsigned n);
 cost_pixel_nxn_func * kvz_pixels_get_sad_func(unsigned n);
@@ -225,6 +247,8 @@ cost_pixel_nxn_multi_func * kvz_pixels_get_sad_dual_func(unsigned n);
   {"ver_sad", (void**) &kvz_ver_sad}, \
   {"hor_sad", (void**) &kvz_hor_sad}, \
   {"pixel_var", (void**) &kvz_pixel_var}, \
+  {"ssim_4x4_stats", (void**) &kvz_ssim_4x4_stats}, \
+  {"pixel_4x4_sums", (void**) &kvz_pixel_4x4_sums}, \
 
 
 
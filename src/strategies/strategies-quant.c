@@ -39,10 +39,13 @@
 
 // Define function pointers.
 quant_func *kvz_quant;
+quant_func *kvz_quant_approx;
 quant_residual_func *kvz_quantize_residual;
 dequant_func *kvz_dequant;
 coeff_abs_sum_func *kvz_coeff_abs_sum;
 fast_coeff_cost_func *kvz_fast_coeff_cost;
+rdoq_func *kvz_rdoq;
+tr_split_costs_func *kvz_tr_split_costs;
 
 
 int kvz_strategy_register_quant(void* opaque, uint8_t bitdepth) {
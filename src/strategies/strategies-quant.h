@@ -60,22 +60,44 @@ typedef double (fast_coeff_cost_func)(const coeff_t *coeff, int32_t width, uint6
 
 typedef uint32_t (coeff_abs_sum_func)(const coeff_t *coeffs, size_t length);
 
+/**
+ * \brief Estimated cost of coding a block with one transform size.
+ */
+typedef struct {
+  uint64_t ssd;  //!< \brief SSD between the reconstruction and reference
+  double bits;   //!< \brief Estimated bits of the coefficients
+} tr_cost_t;
+
+typedef void (tr_split_costs_func)(encoder_state_t *const state,
+  const int width, const color_t color, const cu_type_t type, const int num_levels,
+  const kvz_pixel *const ref_in, const kvz_pixel *const pred_in, const int stride,
+  tr_cost_t *costs_out);
+
+typedef void (rdoq_func)(encoder_state_t *const state, coeff_t *coef, coeff_t *dest_coeff, int32_t width,
+  int32_t height, int8_t type, int8_t scan_mode, int8_t block_type, int8_t tr_depth);
+
 // Declare function pointers.
 extern quant_func * kvz_quant;
+extern quant_func * kvz_quant_approx;
 extern quant_residual_func * kvz_quantize_residual;
 extern dequant_func *kvz_dequant;
 extern coeff_abs_sum_func *kvz_coeff_abs_sum;
 extern fast_coeff_cost_func *kvz_fast_coeff_cost;
+extern rdoq_func *kvz_rdoq;
+extern tr_split_costs_func *kvz_tr_split_costs;
 
 int kvz_strategy_register_quant(void* opaque, uint8_t bitdepth);
 
 
 #define STRATEGIES_QUANT_EXPORTS \
   {"quant", (void**) &kvz_quant}, \
+  {"quant_approx", (void**) &kvz_quant_approx}, \
   {"quantize_residual", (void**) &kvz_quantize_residual}, \
   {"dequant", (void**) &kvz_dequant}, \
   {"coeff_abs_sum", (void**) &kvz_coeff_abs_sum}, \
   {"fast_coeff_cost", (void**) &kvz_fast_coeff_cost}, \
+  {"rdoq", (void**) &kvz_rdoq}, \
+  {"tr_split_costs", (void**) &kvz_tr_split_costs}, \
 
 
 
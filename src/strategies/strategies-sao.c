@@ -37,10 +37,8 @@
 
 
 // Define function pointers.
-sao_edge_ddistortion_func * kvz_sao_edge_ddistortion;
-calc_sao_edge_dir_func * kvz_calc_sao_edge_dir;
 sao_reconstruct_color_func * kvz_sao_reconstruct_color;
-sao_band_ddistortion_func * kvz_sao_band_ddistortion;
+calc_sao_stats_func * kvz_calc_sao_stats;
 
 
 int kvz_strategy_register_sao(void* opaque, uint8_t bitdepth) {
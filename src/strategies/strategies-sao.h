@@ -46,14 +46,6 @@
 
 
 // Declare function pointers.
-typedef int (sao_edge_ddistortion_func)(const kvz_pixel *orig_data, const kvz_pixel *rec_data,
-  int block_width, int block_height,
-  int eo_class, int offsets[NUM_SAO_EDGE_CATEGORIES]);
-
-typedef void (calc_sao_edge_dir_func)(const kvz_pixel *orig_data, const kvz_pixel *rec_data,
-  int eo_class, int block_width, int block_height,
-  int cat_sum_cnt[2][NUM_SAO_EDGE_CATEGORIES]);
-
 typedef void (sao_reconstruct_color_func)(const encoder_control_t * const encoder,
   const kvz_pixel *rec_data, kvz_pixel *new_rec_data,
   const sao_info_t *sao,
@@ -61,24 +53,21 @@ typedef void (sao_reconstruct_color_func)(const encoder_control_t * const encode
   int block_width, int block_height,
   color_t color_i);
 
-typedef int (sao_band_ddistortion_func)(const encoder_state_t * const state, const kvz_pixel *orig_data, const kvz_pixel *rec_data,
+typedef void (calc_sao_stats_func)(const encoder_control_t * const encoder,
+  const kvz_pixel *orig_data, const kvz_pixel *rec_data,
   int block_width, int block_height,
-  int band_pos, const int sao_bands[4]);
+  sao_stats_t *stats);
 
 // Declare function pointers.
-extern sao_edge_ddistortion_func * kvz_sao_edge_ddistortion;
-extern calc_sao_edge_dir_func * kvz_calc_sao_edge_dir;
 extern sao_reconstruct_color_func * kvz_sao_reconstruct_color;
-extern sao_band_ddistortion_func * kvz_sao_band_ddistortion;
+extern calc_sao_stats_func * kvz_calc_sao_stats;
 
 int kvz_strategy_register_sao(void* opaque, uint8_t bitdepth);
 
 
 #define STRATEGIES_SAO_EXPORTS \
-  {"sao_edge_ddistortion", (void**) &kvz_sao_edge_ddistortion}, \
-  {"calc_sao_edge_dir", (void**) &kvz_calc_sao_edge_dir}, \
   {"sao_reconstruct_color", (void**) &kvz_sao_reconstruct_color}, \
-  {"sao_band_ddistortion", (void**) &kvz_sao_band_ddistortion}, \
+  {"calc_sao_stats", (void**) &kvz_calc_sao_stats}, \
 
 
 
@@ -172,6 +172,11 @@ struct threadqueue_job_t {
    */
   struct threadqueue_job_t *next;
 
+  /**
+   * \brief Time when the job was added to the queue of ready jobs.
+   */
+  KVZ_CLOCK_T ready_time;
+
 };
 
 
@@ -221,6 +226,94 @@ struct threadqueue_queue_t {
    * \brief Pointer to the last ready job
    */
   threadqueue_job_t *last;
+
+  /**
+   * \brief Total time worker threads have spent waiting for jobs, in seconds.
+   */
+  double idle_time;
+
+  /**
+   * \brief Total time jobs have spent in the ready queue, in seconds.
+   */
+  double ready_wait_time;
+
+  /**
+   * \brief Total time worker threads have spent running jobs, in seconds.
+   */
+  double busy_time;
+};
+
+
+/**
+ * \brief Job waiting for a progress counter to reach a value.
+ */
+typedef struct {
+  threadqueue_job_t *job;
+  int32_t value;
+} threadqueue_waiter_t;
+
+
+/**
+ * \brief Jobs waiting for a single progress counter.
+ *
+ * Sorted by the value they are waiting for, so that publishing a new value
+ * only needs to look at the beginning of the list.
+ */
+typedef struct {
+  threadqueue_waiter_t *items;
+
+  /**
+   * \brief Index of the first waiting job in items.
+   */
+  int first;
+
+  /**
+   * \brief Index one past the last waiting job in items.
+   */
+  int last;
+
+  /**
+   * \brief Allocated size of items.
+   */
+  int size;
+} threadqueue_waiters_t;
+
+
+/**
+ * \brief Monotonically increasing counters for signalling progress.
+ *
+ * Used for publishing how many CTUs of each CTU row of a frame have been
+ * reconstructed, so that other frames can see how much of a reference
+ * picture is already final. Jobs can depend on a counter reaching a value
+ * in the same way as they depend on other jobs.
+ */
+struct threadqueue_progress_t {
+  /**
+   * \brief Lock for the waiter lists.
+   *
+   * The values can be read without locking.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * \brief Reference count
+   */
+  int32_t refcount;
+
+  /**
+   * \brief Number of counters
+   */
+  int count;
+
+  /**
+   * \brief Counter values
+   */
+  int32_t *values;
+
+  /**
+   * \brief Jobs waiting for each counter
+   */
+  threadqueue_waiters_t *waiters;
 };
 
 
@@ -235,6 +328,7 @@ static void threadqueue_push_job(threadqueue_queue_t * threadqueue,
 {
   assert(job->ndepends == 0);
   job->state = THREADQUEUE_JOB_STATE_READY;
+  KVZ_GET_TIME(&job->ready_time);
 
   if (threadqueue->first == NULL) {
     threadqueue->first = job;
@@ -279,9 +373,15 @@ static void* threadqueue_worker(void* threadqueue_opaque)
   PTHREAD_LOCK(&threadqueue->lock);
 
   for (;;) {
-    while (!threadqueue->stop && threadqueue->first == NULL) {
-      // Wait until there is something to do in the queue.
-      PTHREAD_COND_WAIT(&threadqueue->job_available, &threadqueue->lock);
+    if (!threadqueue->stop && threadqueue->first == NULL) {
+      KVZ_CLOCK_T idle_start, idle_stop;
+      KVZ_GET_TIME(&idle_start);
+      while (!threadqueue->stop && threadqueue->first == NULL) {
+        // Wait until there is something to do in the queue.
+        PTHREAD_COND_WAIT(&threadqueue->job_available, &threadqueue->lock);
+      }
+      KVZ_GET_TIME(&idle_stop);
+      threadqueue->idle_time += KVZ_CLOCK_T_DIFF(idle_start, idle_stop);
     }
 
     if (threadqueue->stop) {
@@ -291,6 +391,10 @@ static void* threadqueue_worker(void* threadqueue_opaque)
     // Get a job and remove it from the queue.
     threadqueue_job_t *job = threadqueue_pop_job(threadqueue);
 
+    KVZ_CLOCK_T job_start, job_stop;
+    KVZ_GET_TIME(&job_start);
+    threadqueue->ready_wait_time += KVZ_CLOCK_T_DIFF(job->ready_time, job_start);
+
     PTHREAD_LOCK(&job->lock);
     assert(job->state == THREADQUEUE_JOB_STATE_READY);
     job->state = THREADQUEUE_JOB_STATE_RUNNING;
@@ -299,7 +403,10 @@ static void* threadqueue_worker(void* threadqueue_opaque)
 
     job->fptr(job->arg);
 
+    KVZ_GET_TIME(&job_stop);
+
     PTHREAD_LOCK(&threadqueue->lock);
+    threadqueue->busy_time += KVZ_CLOCK_T_DIFF(job_start, job_stop);
     PTHREAD_LOCK(&job->lock);
     assert(job->state == THREADQUEUE_JOB_STATE_RUNNING);
     job->state = THREADQUEUE_JOB_STATE_DONE;
@@ -389,6 +496,10 @@ threadqueue_queue_t * kvz_threadqueue_init(int thread_count)
   threadqueue->first              = NULL;
   threadqueue->last               = NULL;
 
+  threadqueue->idle_time          = 0.0;
+  threadqueue->ready_wait_time    = 0.0;
+  threadqueue->busy_time          = 0.0;
+
   // Lock the queue before creating threads, to ensure they all have correct information.
   PTHREAD_LOCK(&threadqueue->lock);
   for (int i = 0; i < thread_count; i++) {
@@ -570,6 +681,33 @@ int kvz_threadqueue_waitfor(threadqueue_queue_t * threadqueue, threadqueue_job_t
 }
 
 
+/**
+ * \brief Get accumulated timing statistics of the worker threads.
+ *
+ * All times are totals over all worker threads since the queue was
+ * initialized.
+ *
+ * \param idle_time         time spent waiting for jobs
+ * \param ready_wait_time   time jobs spent waiting for a free thread
+ * \param busy_time         time spent running jobs
+ *
+ * \return 1 on success, 0 on failure
+ */
+int kvz_threadqueue_get_times(threadqueue_queue_t * threadqueue,
+                              double *idle_time,
+                              double *ready_wait_time,
+                              double *busy_time)
+{
+  PTHREAD_LOCK(&threadqueue->lock);
+  *idle_time       = threadqueue->idle_time;
+  *ready_wait_time = threadqueue->ready_wait_time;
+  *busy_time       = threadqueue->busy_time;
+  PTHREAD_UNLOCK(&threadqueue->lock);
+
+  return 1;
+}
+
+
 /**
  * \brief Stop all threads after they finish the current jobs.
  *
@@ -641,3 +779,233 @@ void kvz_threadqueue_free(threadqueue_queue_t *threadqueue)
 
   FREE_POINTER(threadqueue);
 }
+
+
+/**
+ * \brief Create a set of progress counters initialized to zero.
+ *
+ * \param count   number of counters
+ * \return pointer to the counters, or NULL on failure
+ */
+threadqueue_progress_t * kvz_threadqueue_progress_create(int count)
+{
+  threadqueue_progress_t *progress = MALLOC(threadqueue_progress_t, 1);
+  if (!progress) {
+    fprintf(stderr, "Could not alloc progress!\n");
+    return NULL;
+  }
+
+  progress->values  = calloc(count, sizeof(int32_t));
+  progress->waiters = calloc(count, sizeof(threadqueue_waiters_t));
+  if (!progress->values || !progress->waiters) {
+    fprintf(stderr, "Could not alloc progress!\n");
+    FREE_POINTER(progress->values);
+    FREE_POINTER(progress->waiters);
+    FREE_POINTER(progress);
+    return NULL;
+  }
+
+  if (pthread_mutex_init(&progress->lock, NULL) != 0) {
+    fprintf(stderr, "pthread_mutex_init(progress) failed!\n");
+    FREE_POINTER(progress->values);
+    FREE_POINTER(progress->waiters);
+    FREE_POINTER(progress);
+    return NULL;
+  }
+
+  progress->refcount = 1;
+  progress->count    = count;
+
+  return progress;
+}
+
+
+/**
+ * \brief Get a new pointer to progress counters.
+ *
+ * Increment reference count and return the counters.
+ */
+threadqueue_progress_t * kvz_threadqueue_progress_copy_ref(threadqueue_progress_t *progress)
+{
+  int32_t new_refcount = KVZ_ATOMIC_INC(&progress->refcount);
+  // The caller should have had another reference and we added one
+  // reference so refcount should be at least 2.
+  assert(new_refcount >= 2);
+  return progress;
+}
+
+
+/**
+ * \brief Free progress counters.
+ *
+ * Decrement reference count and deallocate the counters if no references
+ * exist any more. Sets the pointer to NULL.
+ */
+void kvz_threadqueue_progress_free(threadqueue_progress_t **progress_ptr)
+{
+  threadqueue_progress_t *progress = *progress_ptr;
+  if (progress == NULL) return;
+  *progress_ptr = NULL;
+
+  int32_t new_refcount = KVZ_ATOMIC_DEC(&progress->refcount);
+  if (new_refcount > 0) return;
+
+  assert(new_refcount == 0);
+
+  for (int i = 0; i < progress->count; i++) {
+    threadqueue_waiters_t *waiters = &progress->waiters[i];
+    for (int j = waiters->first; j < waiters->last; j++) {
+      kvz_threadqueue_free_job(&waiters->items[j].job);
+    }
+    FREE_POINTER(waiters->items);
+  }
+
+  FREE_POINTER(progress->waiters);
+  FREE_POINTER(progress->values);
+  pthread_mutex_destroy(&progress->lock);
+  FREE_POINTER(progress);
+}
+
+
+/**
+ * \brief Add a dependency from a job to a progress counter.
+ *
+ * The job is not run before the counter has reached the given value.
+ *
+ * \param job       job that should be executed after the progress
+ * \param progress  progress counters
+ * \param index     index of the counter
+ * \param value     value the counter must reach before the job can run
+ *
+ * \return 1 on success, 0 on failure
+ */
+int kvz_threadqueue_job_dep_add_progress(threadqueue_job_t *job,
+                                         threadqueue_progress_t *progress,
+                                         int index,
+                                         int32_t value)
+{
+  assert(index >= 0 && index < progress->count);
+
+  // Lock the progress first and then the job depending on it.
+  // This must be the same order as in kvz_threadqueue_progress_publish.
+  PTHREAD_LOCK(&progress->lock);
+
+  if (progress->values[index] >= value) {
+    // The counter has reached the value already so there is nothing to do.
+    PTHREAD_UNLOCK(&progress->lock);
+    return 1;
+  }
+
+  threadqueue_waiters_t *waiters = &progress->waiters[index];
+  if (waiters->first == waiters->last) {
+    waiters->first = 0;
+    waiters->last  = 0;
+  }
+  if (waiters->last >= waiters->size) {
+    size_t bytes = (waiters->size + THREADQUEUE_LIST_REALLOC_SIZE) * sizeof(threadqueue_waiter_t);
+    threadqueue_waiter_t *items = realloc(waiters->items, bytes);
+    if (!items) {
+      fprintf(stderr, "Could not realloc progress waiters!\n");
+      PTHREAD_UNLOCK(&progress->lock);
+      return 0;
+    }
+    waiters->items = items;
+    waiters->size += THREADQUEUE_LIST_REALLOC_SIZE;
+  }
+
+  PTHREAD_LOCK(&job->lock);
+  job->ndepends++;
+  PTHREAD_UNLOCK(&job->lock);
+
+  // Keep the list sorted. Jobs are usually added in the order of the
+  // values they wait for so this rarely moves anything.
+  int pos = waiters->last++;
+  while (pos > waiters->first && waiters->items[pos - 1].value > value) {
+    waiters->items[pos] = waiters->items[pos - 1];
+    pos--;
+  }
+  waiters->items[pos].job   = kvz_threadqueue_copy_ref(job);
+  waiters->items[pos].value = value;
+
+  PTHREAD_UNLOCK(&progress->lock);
+
+  return 1;
+}
+
+
+/**
+ * \brief Publish a new value for a counter.
+ *
+ * Everything written by the calling thread before the call is visible to
+ * threads that read the new value with kvz_threadqueue_progress_get.
+ * Jobs waiting for the counter to reach the value are moved to the queue
+ * of jobs ready to run. Values must not decrease.
+ *
+ * \return 1 on success, 0 on failure
+ */
+int kvz_threadqueue_progress_publish(threadqueue_queue_t *threadqueue,
+                                     threadqueue_progress_t *progress,
+                                     int index,
+                                     int32_t value)
+{
+  assert(index >= 0 && index < progress->count);
+  assert(value >= progress->values[index]);
+
+  PTHREAD_LOCK(&progress->lock);
+  KVZ_ATOMIC_STORE_RELEASE(&progress->values[index], value);
+
+  threadqueue_waiters_t *waiters = &progress->waiters[index];
+  if (waiters->first == waiters->last ||
+      waiters->items[waiters->first].value > value)
+  {
+    // Nobody is waiting for this value.
+    PTHREAD_UNLOCK(&progress->lock);
+    return 1;
+  }
+
+  PTHREAD_LOCK(&threadqueue->lock);
+
+  int num_new_jobs = 0;
+  while (waiters->first < waiters->last &&
+         waiters->items[waiters->first].value <= value)
+  {
+    threadqueue_job_t *depjob = waiters->items[waiters->first].job;
+    waiters->first++;
+
+    PTHREAD_LOCK(&depjob->lock);
+
+    assert(depjob->state == THREADQUEUE_JOB_STATE_WAITING ||
+           depjob->state == THREADQUEUE_JOB_STATE_PAUSED);
+    assert(depjob->ndepends > 0);
+    depjob->ndepends--;
+
+    if (depjob->ndepends == 0 && depjob->state == THREADQUEUE_JOB_STATE_WAITING) {
+      // Move the job to ready jobs.
+      threadqueue_push_job(threadqueue, kvz_threadqueue_copy_ref(depjob));
+      num_new_jobs++;
+    }
+
+    PTHREAD_UNLOCK(&depjob->lock);
+    kvz_threadqueue_free_job(&depjob);
+  }
+
+  for (int i = 0; i < num_new_jobs; i++) {
+    pthread_cond_signal(&threadqueue->job_available);
+  }
+
+  PTHREAD_UNLOCK(&threadqueue->lock);
+  PTHREAD_UNLOCK(&progress->lock);
+
+  return 1;
+}
+
+
+/**
+ * \brief Get the latest published value of a counter.
+ */
+int32_t kvz_threadqueue_progress_get(const threadqueue_progress_t *progress,
+                                     int index)
+{
+  assert(index >= 0 && index < progress->count);
+  return KVZ_ATOMIC_LOAD_ACQUIRE(&progress->values[index]);
+}
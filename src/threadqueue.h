@@ -44,6 +44,7 @@
 
 typedef struct threadqueue_job_t threadqueue_job_t;
 typedef struct threadqueue_queue_t threadqueue_queue_t;
+typedef struct threadqueue_progress_t threadqueue_progress_t;
 
 threadqueue_queue_t * kvz_threadqueue_init(int thread_count);
 
@@ -57,7 +58,24 @@ threadqueue_job_t *kvz_threadqueue_copy_ref(threadqueue_job_t *job);
 void kvz_threadqueue_free_job(threadqueue_job_t **job_ptr);
 
 int kvz_threadqueue_waitfor(threadqueue_queue_t * threadqueue, threadqueue_job_t * job);
+int kvz_threadqueue_get_times(threadqueue_queue_t * threadqueue,
+                              double *idle_time,
+                              double *ready_wait_time,
+                              double *busy_time);
 int kvz_threadqueue_stop(threadqueue_queue_t * threadqueue);
 void kvz_threadqueue_free(threadqueue_queue_t * threadqueue);
 
+threadqueue_progress_t * kvz_threadqueue_progress_create(int count);
+threadqueue_progress_t * kvz_threadqueue_progress_copy_ref(threadqueue_progress_t *progress);
+void kvz_threadqueue_progress_free(threadqueue_progress_t **progress_ptr);
+int kvz_threadqueue_job_dep_add_progress(threadqueue_job_t *job,
+                                         threadqueue_progress_t *progress,
+                                         int index,
+                                         int32_t value);
+int kvz_threadqueue_progress_publish(threadqueue_queue_t *threadqueue,
+                                     threadqueue_progress_t *progress,
+                                     int index,
+                                     int32_t value);
+int32_t kvz_threadqueue_progress_get(const threadqueue_progress_t *progress, int index);
+
 #endif // THREADQUEUE_H_
@@ -67,6 +67,10 @@
 
 #define KVZ_ATOMIC_INC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, 1)
 #define KVZ_ATOMIC_DEC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, -1)
+#define KVZ_ATOMIC_STORE_RELEASE(ptr, val)      __atomic_store_n((volatile int32_t*)ptr, (val), __ATOMIC_RELEASE)
+#define KVZ_ATOMIC_LOAD_ACQUIRE(ptr)            __atomic_load_n((volatile int32_t*)ptr, __ATOMIC_ACQUIRE)
+#define KVZ_ATOMIC_STORE_RELEASE64(ptr, val)    __atomic_store_n((volatile int64_t*)ptr, (val), __ATOMIC_RELEASE)
+#define KVZ_ATOMIC_LOAD_ACQUIRE64(ptr)          __atomic_load_n((volatile int64_t*)ptr, __ATOMIC_ACQUIRE)
 
 #else //__GNUC__
 //TODO: we assume !GCC => Windows... this may be bad
@@ -81,6 +85,10 @@
 
 #define KVZ_ATOMIC_INC(ptr)                     InterlockedIncrement((volatile LONG*)ptr)
 #define KVZ_ATOMIC_DEC(ptr)                     InterlockedDecrement((volatile LONG*)ptr)
+#define KVZ_ATOMIC_STORE_RELEASE(ptr, val)      InterlockedExchange((volatile LONG*)ptr, (val))
+#define KVZ_ATOMIC_LOAD_ACQUIRE(ptr)            InterlockedCompareExchange((volatile LONG*)ptr, 0, 0)
+#define KVZ_ATOMIC_STORE_RELEASE64(ptr, val)    InterlockedExchange64((volatile LONG64*)ptr, (val))
+#define KVZ_ATOMIC_LOAD_ACQUIRE64(ptr)          InterlockedCompareExchange64((volatile LONG64*)ptr, 0, 0)
 
 #endif //__GNUC__
 
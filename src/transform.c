@@ -32,6 +32,8 @@
 
 #include "transform.h"
 
+#include <string.h>
+
 #include "image.h"
 #include "kvazaar.h"
 #include "rdo.h"
@@ -40,6 +42,8 @@
 #include "strategies/strategies-picture.h"
 #include "tables.h"
 
+#define QUANT_SHIFT 14
+
 /**
  * \brief RDPCM direction.
  */
@@ -193,19 +197,115 @@ void kvz_itransformskip(const encoder_control_t * const encoder, int16_t *block,
   }
 }
 
+/**
+ * \brief Find the region of a 32x32 block that can have non-zero coefficients.
+ *
+ * Coefficient groups after the last significant one in diagonal scan order
+ * are all zero, so the non-zero coefficients are inside the bounding box of
+ * the coefficient groups up to the last significant one.
+ *
+ * \param num_rows  Returns the number of rows that can be non-zero.
+ * \param num_cols  Returns the number of columns that can be non-zero.
+ */
+static void get_coeff_region_32x32(const coeff_t *coeff, int32_t *num_rows, int32_t *num_cols)
+{
+  const uint32_t *scan_cg = g_sig_last_scan_cg[3][SCAN_DIAG];
+
+  int last_cg = 0;
+  for (int i = 63; i > 0; --i) {
+    const coeff_t *cg = &coeff[(scan_cg[i] >> 3) * 4 * 32 + (scan_cg[i] & 7) * 4];
+    uint64_t rows[4];
+    for (int y = 0; y < 4; ++y) {
+      memcpy(&rows[y], &cg[y * 32], sizeof(rows[y]));
+    }
+    if (rows[0] | rows[1] | rows[2] | rows[3]) {
+      last_cg = i;
+      break;
+    }
+  }
+
+  uint32_t max_x = 0;
+  uint32_t max_y = 0;
+  for (int i = 0; i <= last_cg; ++i) {
+    max_x = MAX(max_x, scan_cg[i] & 7);
+    max_y = MAX(max_y, scan_cg[i] >> 3);
+  }
+
+  *num_rows = (max_y + 1) * 4;
+  *num_cols = (max_x + 1) * 4;
+}
+
+/**
+ * \brief Predict whether the coefficients of a 32x32 residual outside the
+ *        low frequency 16x16 quarter would all quantize to zero.
+ *
+ * The energy of the residual that is left after removing 2x2 averages
+ * approximates the energy of the high frequency coefficients. If that
+ * energy is smaller than the square of the smallest level that quantizes
+ * to something else than zero, no single high frequency coefficient can
+ * be large enough either.
+ */
+static bool high_freqs_quantize_to_zero(const encoder_state_t * const state,
+                                        const int16_t *residual,
+                                        color_t color,
+                                        cu_type_t type)
+{
+  const encoder_control_t * const encoder = state->encoder_control;
+  const int8_t quant_type = (color == COLOR_Y ? 0 : 2);
+  const int32_t qp_scaled = kvz_get_scaled_qp(quant_type, state->qp, (encoder->bitdepth - 8) * 6);
+  const int32_t scalinglist_type = (type == CU_INTRA ? 0 : 3) + (int8_t)("\0\3\1\2"[quant_type]);
+  const int32_t transform_shift = MAX_TR_DYNAMIC_RANGE - encoder->bitdepth - 5;
+  const int32_t q_bits = QUANT_SHIFT + qp_scaled / 6 + transform_shift;
+  const int32_t offset = (state->frame->slicetype == KVZ_SLICE_I) ? 171 : 85;
+
+  // The largest quantization coefficient is at DC, so this is the smallest
+  // threshold for any coefficient.
+  const int32_t quant_coeff = encoder->scaling_list.quant_coeff[3][scalinglist_type][qp_scaled % 6][0];
+  const double threshold = ((double)(1 << q_bits) - (offset << (q_bits - 9))) / quant_coeff;
+
+  // Four times the energy of the residual around the 2x2 averages.
+  int64_t detail = 0;
+  for (int y = 0; y < 32; y += 2) {
+    for (int x = 0; x < 32; x += 2) {
+      const int32_t a = residual[y * 32 + x];
+      const int32_t b = residual[y * 32 + x + 1];
+      const int32_t c = residual[(y + 1) * 32 + x];
+      const int32_t d = residual[(y + 1) * 32 + x + 1];
+      const int32_t sum = a + b + c + d;
+      detail += 4 * (a * a + b * b + c * c + d * d) - sum * sum;
+    }
+  }
+
+  // The forward 32x32 transform scales an orthonormal transform by
+  // 4 >> (bitdepth - 8).
+  const double scale = 4.0 / (1 << (encoder->bitdepth - 8));
+  const double energy = detail / 4.0 * scale * scale;
+
+  return energy < threshold * threshold;
+}
+
 /**
  * \brief forward transform (2D)
  * \param block input residual
  * \param coeff transform coefficients
  * \param block_size width of transform
  */
-void kvz_transform2d(const encoder_control_t * const encoder,
+void kvz_transform2d(const encoder_state_t * const state,
                      int16_t *block,
                      int16_t *coeff,
                      int8_t block_size,
                      color_t color,
                      cu_type_t type)
 {
+  const encoder_control_t * const encoder = state->encoder_control;
+
+  if (block_size == 32 && encoder->cfg.dct32_lowfreq &&
+      high_freqs_quantize_to_zero(state, block, color, type))
+  {
+    kvz_dct_32x32_lowfreq(encoder->bitdepth, block, coeff);
+    return;
+  }
+
   dct_func *dct_func = kvz_get_dct_func(block_size, color, type);
   dct_func(encoder->bitdepth, block, coeff);
 }
@@ -217,6 +317,14 @@ void kvz_itransform2d(const encoder_control_t * const encoder,
                       color_t color,
                       cu_type_t type)
 {
+  if (block_size == 32) {
+    int32_t num_rows;
+    int32_t num_cols;
+    get_coeff_region_32x32(coeff, &num_rows, &num_cols);
+    kvz_idct_32x32_partial(encoder->bitdepth, coeff, block, num_rows, num_cols);
+    return;
+  }
+
   dct_func *idct_func = kvz_get_idct_func(block_size, color, type);
   idct_func(encoder->bitdepth, coeff, block);
 }
@@ -250,7 +358,7 @@ int kvz_quantize_residual_trskip(
   struct {
     kvz_pixel rec[4*4];
     coeff_t coeff[4*4];
-    double cost;
+    rd_cost_t cost;
     int has_coeffs;
   } skip, noskip, *best;
   
@@ -258,15 +366,15 @@ int kvz_quantize_residual_trskip(
       state, cur_cu, width, color, scan_order,
       0, in_stride, 4,
       ref_in, pred_in, noskip.rec, noskip.coeff, false);
-  noskip.cost = kvz_pixels_calc_ssd(ref_in, noskip.rec, in_stride, 4, 4);
-  noskip.cost += kvz_get_coeff_cost(state, noskip.coeff, 4, 0, scan_order) * state->lambda;
+  noskip.cost = RD_COST_DIST(kvz_pixels_calc_ssd(ref_in, noskip.rec, in_stride, 4, 4));
+  noskip.cost += RD_COST_BITS(state, kvz_get_coeff_cost(state, noskip.coeff, 4, 0, scan_order));
 
   skip.has_coeffs = kvz_quantize_residual(
     state, cur_cu, width, color, scan_order,
     1, in_stride, 4,
     ref_in, pred_in, skip.rec, skip.coeff, false);
-  skip.cost = kvz_pixels_calc_ssd(ref_in, skip.rec, in_stride, 4, 4);
-  skip.cost += kvz_get_coeff_cost(state, skip.coeff, 4, 0, scan_order) * state->lambda;
+  skip.cost = RD_COST_DIST(kvz_pixels_calc_ssd(ref_in, skip.rec, in_stride, 4, 4));
+  skip.cost += RD_COST_BITS(state, kvz_get_coeff_cost(state, skip.coeff, 4, 0, scan_order));
 
   if (noskip.cost <= skip.cost) {
     *trskip_out = 0;
@@ -49,7 +49,7 @@ extern const int16_t kvz_g_inv_quant_scales[6];
 void kvz_transformskip(const encoder_control_t *encoder, int16_t *block,int16_t *coeff, int8_t block_size);
 void kvz_itransformskip(const encoder_control_t *encoder, int16_t *block,int16_t *coeff, int8_t block_size);
 
-void kvz_transform2d(const encoder_control_t * const encoder,
+void kvz_transform2d(const encoder_state_t * const state,
                      int16_t *block,
                      int16_t *coeff,
                      int8_t block_size,
@@ -74,6 +74,7 @@ int kvz_videoframe_free(videoframe_t * const frame)
   frame->source = NULL;
   kvz_image_free(frame->rec);
   frame->rec = NULL;
+  kvz_threadqueue_progress_free(&frame->rec_progress);
 
   kvz_cu_array_free(&frame->cu_array);
 
@@ -41,6 +41,7 @@
 #include "cu.h"
 #include "global.h" // IWYU pragma: keep
 #include "kvazaar.h"
+#include "threadqueue.h"
 
 
 /**
@@ -50,6 +51,7 @@ typedef struct videoframe
 {
   kvz_picture *source;         //!< \brief Source image.
   kvz_picture *rec;            //!< \brief Reconstructed image.
+  threadqueue_progress_t *rec_progress; //!< \brief Reconstructed CTUs of each CTU row, NULL if not tracked.
 
   int32_t width;          //!< \brief Luma pixel array width.
   int32_t height;         //!< \brief Luma pixel array height.
@@ -55,6 +55,8 @@ static int16_t * dct_actual_bufs[NUM_TESTS] = { 0 }; // pointers returned by mal
 static int16_t dct_result[NUM_SIZES][LCU_WIDTH*LCU_WIDTH] = { { 0 } };
 static int16_t idct_result[NUM_SIZES][LCU_WIDTH*LCU_WIDTH] = { { 0 } };
 
+static dct_func *idct_32x32_generic = NULL;
+
 static struct test_env_t {
   int log_width; // for selecting dim from bufs
   dct_func * tested_func;
@@ -141,6 +143,15 @@ static void setup_tests()
       ++block;
     }
   }
+
+  for (int s = 0; s < strategies.count; ++s) {
+    strategy_t *strat = &strategies.strategies[s];
+    if (strcmp(strat->type, "idct_32x32") == 0 &&
+        strcmp(strat->strategy_name, "generic") == 0)
+    {
+      idct_32x32_generic = strat->fptr;
+    }
+  }
 }
 
 static void tear_down_tests()
@@ -188,6 +199,52 @@ TEST idct(void)
 }
 
 
+TEST dct_lowfreq(void)
+{
+  int16_t *buf = dct_bufs[4];
+  ALIGNED(32) int16_t test_result[32 * 32] = { 0 };
+
+  test_env.tested_func(KVZ_BIT_DEPTH, buf, test_result);
+
+  for (int y = 0; y < 32; ++y) {
+    for (int x = 0; x < 32; ++x) {
+      int16_t expected = (x < 16 && y < 16) ? dct_result[4][y * 32 + x] : 0;
+      ASSERT_EQ(expected, test_result[y * 32 + x]);
+    }
+  }
+
+  PASS();
+}
+
+TEST idct_partial(void)
+{
+  idct_partial_func *tested_func = (idct_partial_func *)test_env.strategy->fptr;
+
+  for (int num_rows = 4; num_rows <= 32; num_rows += 4) {
+    for (int num_cols = 4; num_cols <= 32; num_cols += 4) {
+      ALIGNED(32) int16_t coeff[32 * 32] = { 0 };
+      ALIGNED(32) int16_t expected[32 * 32];
+      ALIGNED(32) int16_t test_result[32 * 32];
+
+      for (int y = 0; y < num_rows; ++y) {
+        for (int x = 0; x < num_cols; ++x) {
+          coeff[y * 32 + x] = dct_result[4][y * 32 + x];
+        }
+      }
+
+      idct_32x32_generic(KVZ_BIT_DEPTH, coeff, expected);
+      tested_func(KVZ_BIT_DEPTH, coeff, test_result, num_rows, num_cols);
+
+      for (int i = 0; i < 32 * 32; ++i) {
+        ASSERT_EQ(expected[i], test_result[i]);
+      }
+    }
+  }
+
+  PASS();
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // TEST FIXTURES
 SUITE(dct_tests)
@@ -242,7 +299,13 @@ SUITE(dct_tests)
 
     // Call different tests depending on type of function.
     // This allows for selecting a subset of tests with -t parameter.
-   if (strncmp(strategy->type, "dct_", 4) == 0 ||
+    if (strcmp(strategy->type, "dct_32x32_lowfreq") == 0) {
+      RUN_TEST(dct_lowfreq);
+    }
+    else if (strcmp(strategy->type, "idct_32x32_partial") == 0) {
+      RUN_TEST(idct_partial);
+    }
+    else if (strncmp(strategy->type, "dct_", 4) == 0 ||
       strcmp(strategy->type, "fast_forward_dst_4x4") == 0)
     {
       RUN_TEST(dct);
@@ -0,0 +1,204 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "test_strategies.h"
+
+#include "src/ml_intra_cu_depth_pred.h"
+
+#include <string.h>
+
+#define NUM_PATTERNS 8
+#define NUM_QPS 3
+
+static const int8_t test_qps[NUM_QPS] = { 22, 32, 42 };
+
+/**
+ * \brief Depth intervals given by the ML intra depth prediction before it
+ *        was rewritten to use block sums and table-driven trees.
+ *
+ * For each pattern and QP, the minimum and the maximum depth of each 8x8
+ * block of the CTU in raster order.
+ */
+static const char *const expected_depths[NUM_PATTERNS * NUM_QPS][2] = {
+  // Flat
+  { "0000000000000000000000000000000000000000000000000000000000000000",
+    "1111111111111111111111111111111111111111111111111111111111111111" },
+  { "0000000000000000000000000000000000000000000000000000000000000000",
+    "1111111111111111111111111111111111111111111111111111111111111111" },
+  { "0000000000000000000000000000000000000000000000000000000000000000",
+    "1111111111111111111111111111111111111111111111111111111111111111" },
+  // Horizontal ramp
+  { "0000000000000000000000000000000000000000000000000000000000000000",
+    "2222222222222222222222222222222222222222222222222222222222222222" },
+  { "0000000000000000000000000000000000000000000000000000000000000000",
+    "2222222222222222222222222222222222222222222222222222222222222222" },
+  { "0000000000000000000000000000000000000000000000000000000000000000",
+    "2222222222222222222222222222222222222222222222222222222222222222" },
+  // 8x8 checkerboard
+  { "1111111111111111111111111111111111111111111111111111111111111111",
+    "3333333333333333333333333333333333333333333333333333333333333333" },
+  { "1111111111111111111111111111111111111111111111111111111111111111",
+    "3333333333333333333333333333333333333333333333333333333333333333" },
+  { "1111111111111111111111111111111111111111111111111111111111111111",
+    "3333333333333333333333333333333333333333333333333333333333333333" },
+  // Noise
+  { "2222222222222222222222222222222222222222222222222222222222222222",
+    "4444444444444444444444444444444444444444444444444444444444444444" },
+  { "2222222222222222222222222222222222222222222222222222222222222222",
+    "4444444444444444444444444444444444444444444444444444444444444444" },
+  { "2222222222222222222222222222222222222222222222222222222222222222",
+    "4444444444444444444444444444444444444444444444444444444444444444" },
+  // Flat left half, noise growing downwards on the right
+  { "1111222211112222111122221111222211112222111122221111222211112222",
+    "2222444422224444222244442222444422224444222244442222444422224444" },
+  { "1111222211112222111122221111222211112222111122221111222211112222",
+    "2222444422224444222244442222444422224444222244442222444422224444" },
+  { "1111222211112222111122221111222211112222111122221111222211112222",
+    "2222333322223333222244442222444422224444222244442222444422224444" },
+  // Flat, ramp, weak noise and noise quadrants
+  { "1111111111111111111111111111111111112222111122221111222211112222",
+    "2222222222222222222222222222222222224444222244442222444422224444" },
+  { "1111111111111111111111111111111111112222111122221111222211112222",
+    "2222222222222222222222222222222222224444222244442222444422224444" },
+  { "1111111111111111111111111111111111112222111122221111222211112222",
+    "2222222222222222222222222222222222224444222244442222444422224444" },
+  // Diagonal edge
+  { "2222111122221111222211112222111111112222111122221111222211112222",
+    "4433222244332222334422223344222222224433222244332222334422223344" },
+  { "2222111122221111222211112222111111112222111122221111222211112222",
+    "4433222244332222334422223344222222224433222244332222334422223344" },
+  { "2222111122221111222211112222111111112222111122221111222211112222",
+    "4433222244332222334422223344222222224433222244332222334422223344" },
+  // Noise with a different amplitude in each 16x16 block
+  { "2222222222222222222222222222222222222222222222222222222222222222",
+    "3333334433333344444444444444444444444444444444444444444444444444" },
+  { "2222222222222222222222222222222222222222222222222222222222222222",
+    "3333334433333344444444444444444444444444444444444444444444444444" },
+  { "2222222222222222222222222222222222222222222222222222222222222222",
+    "3333333333333333444444444444444444444444444444444444444444444444" }
+};
+
+static ml_intra_ctu_pred_t *ml_intra_depth_ctu;
+
+static kvz_pixel lcu[LCU_WIDTH * LCU_WIDTH];
+
+/**
+ * \brief Fill an LCU with one of the test patterns.
+ */
+static void fill_lcu(int pattern, kvz_pixel *buf)
+{
+  uint32_t seed = 12345 + pattern;
+  for (int y = 0; y < LCU_WIDTH; ++y) {
+    for (int x = 0; x < LCU_WIDTH; ++x) {
+      seed = seed * 1103515245u + 12345u;
+      const int noise = (seed >> 16) & 0xff;
+      int value;
+      switch (pattern) {
+        case 0: value = 128; break;
+        case 1: value = 4 * x + y / 8; break;
+        case 2: value = ((x >> 3) ^ (y >> 3)) & 1 ? 200 : 50; break;
+        case 3: value = noise; break;
+        case 4: value = x < 32 ? 100 : 100 + (noise - 128) * y / 64; break;
+        case 5:
+          if (x < 32 && y < 32) value = 90;
+          else if (y < 32) value = 60 + 2 * x + y;
+          else if (x < 32) value = 120 + noise % 17 - 8;
+          else value = noise;
+          break;
+        case 6: value = x > y ? 30 : 220; break;
+        default: value = 128 + (noise - 128) * ((x >> 4) + (y >> 4) * 4) / 15; break;
+      }
+      buf[x + y * LCU_WIDTH] = (kvz_pixel)CLIP(0, PIXEL_MAX, value);
+    }
+  }
+}
+
+static void setup(void)
+{
+  // Use the built-in decision trees.
+  ml_intra_depth_ctu = kvz_init_ml_intra_depth_const(NULL, 1920 * 1080);
+}
+
+static void tear_down(void)
+{
+  kvz_end_ml_intra_depth_const(ml_intra_depth_ctu);
+}
+
+TEST depth_pred_matches_reference(void)
+{
+  ml_intra_ctu_sums_t sums;
+  char upper[LCU_DEPTH_MAT_SIZE + 1];
+  char lower[LCU_DEPTH_MAT_SIZE + 1];
+
+  for (int pattern = 0; pattern < NUM_PATTERNS; ++pattern) {
+    fill_lcu(pattern, lcu);
+    kvz_lcu_luma_sums(lcu, &sums);
+
+    for (int q = 0; q < NUM_QPS; ++q) {
+      kvz_lcu_luma_depth_pred(ml_intra_depth_ctu, &sums, test_qps[q]);
+
+      for (int i = 0; i < LCU_DEPTH_MAT_SIZE; ++i) {
+        upper[i] = '0' + ml_intra_depth_ctu->_mat_upper_depth[i];
+        lower[i] = '0' + ml_intra_depth_ctu->_mat_lower_depth[i];
+      }
+      upper[LCU_DEPTH_MAT_SIZE] = '\0';
+      lower[LCU_DEPTH_MAT_SIZE] = '\0';
+
+      ASSERT_STR_EQ(expected_depths[pattern * NUM_QPS + q][0], upper);
+      ASSERT_STR_EQ(expected_depths[pattern * NUM_QPS + q][1], lower);
+    }
+  }
+
+  PASS();
+}
+
+SUITE(ml_intra_depth_tests)
+{
+  setup();
+
+  // kvz_lcu_luma_sums calls the strategy through the global pointer.
+  pixel_4x4_sums_func *const orig_pixel_4x4_sums = kvz_pixel_4x4_sums;
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "pixel_4x4_sums") != 0) {
+      continue;
+    }
+
+    kvz_pixel_4x4_sums = strategies.strategies[i].fptr;
+    RUN_TEST(depth_pred_matches_reference);
+  }
+
+  kvz_pixel_4x4_sums = orig_pixel_4x4_sums;
+  tear_down();
+}
@@ -0,0 +1,204 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "test_strategies.h"
+
+#include "src/encoderstate.h"
+#include "src/fast_rdoq.h"
+#include "src/scalinglist.h"
+#include "src/strategies/generic/quant-generic.h"
+#include "src/strategies/strategies-quant.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_QPS 5
+
+static const int8_t test_qps[NUM_QPS] = { 12, 22, 32, 42, 51 };
+
+static encoder_control_t *encoder;
+static encoder_state_config_frame_t frame;
+static encoder_state_t state;
+
+static quant_func *tested_quant_approx;
+
+static coeff_t coeff_in[32 * 32];
+
+/**
+ * \brief Fill a block with coefficients resembling transform output.
+ */
+static void fill_coeffs(coeff_t *coeff, int width, unsigned seed)
+{
+  srand(seed);
+  for (int y = 0; y < width; ++y) {
+    for (int x = 0; x < width; ++x) {
+      int range = 4096 / (1 + x + y);
+      int value = rand() % (2 * range + 1) - range;
+      if (rand() % (2 + x + y) > 3) value = 0;
+      coeff[x + y * width] = (coeff_t)value;
+    }
+  }
+}
+
+/**
+ * \brief Set every deadzone and rounding offset of the fast RDOQ table.
+ */
+static void set_offsets(uint16_t deadzone, uint16_t rounding)
+{
+  for (int qp = 0; qp < MAX_FAST_RDOQ_QP; ++qp) {
+    for (int size = 0; size < 4; ++size) {
+      encoder->fast_rdoq_table.deadzone[qp][size] = deadzone;
+      encoder->fast_rdoq_table.rounding[qp][size] = rounding;
+    }
+  }
+}
+
+static void setup(void)
+{
+  encoder = calloc(1, sizeof(encoder_control_t));
+  encoder->bitdepth = KVZ_BIT_DEPTH;
+  kvz_scalinglist_init(&encoder->scaling_list);
+  kvz_scalinglist_process(&encoder->scaling_list, encoder->bitdepth);
+
+  memset(&frame, 0, sizeof(frame));
+  memset(&state, 0, sizeof(state));
+  state.encoder_control = encoder;
+  state.frame = &frame;
+}
+
+static void tear_down(void)
+{
+  kvz_scalinglist_destroy(&encoder->scaling_list);
+  free(encoder);
+}
+
+/**
+ * \brief With equal deadzone and rounding offsets the approximate quantizer
+ * must give exactly the same result as kvz_quant with that offset.
+ */
+TEST quant_approx_matches_quant(void)
+{
+  coeff_t expected[32 * 32];
+  coeff_t actual[32 * 32];
+
+  for (int sign_hide = 0; sign_hide <= 1; ++sign_hide) {
+    encoder->cfg.signhide_enable = sign_hide;
+
+    for (int q = 0; q < NUM_QPS; ++q) {
+      state.qp = test_qps[q];
+      frame.slicetype = (q & 1) ? KVZ_SLICE_P : KVZ_SLICE_I;
+      const uint16_t offset = frame.slicetype == KVZ_SLICE_I ? 171 : 85;
+      set_offsets(offset, offset);
+
+      for (int log2_width = 2; log2_width <= 5; ++log2_width) {
+        const int width = 1 << log2_width;
+        for (int8_t type = 0; type <= 2; type += 2) {
+          if (type != 0 && width == 32) continue;
+          for (int8_t block_type = CU_INTRA; block_type <= CU_INTER; ++block_type) {
+            fill_coeffs(coeff_in, width, q * 1000 + log2_width * 10 + type);
+
+            memset(expected, 0, sizeof(expected));
+            memset(actual, 0, sizeof(actual));
+            kvz_quant_generic(&state, coeff_in, expected, width, width,
+                              type, 0, block_type);
+            tested_quant_approx(&state, coeff_in, actual, width, width,
+                                type, 0, block_type);
+
+            for (int i = 0; i < width * width; ++i) {
+              ASSERT_EQ(expected[i], actual[i]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  PASS();
+}
+
+/**
+ * \brief A zero deadzone offset may only turn levels of one into zero and
+ * must leave all other levels as they are.
+ */
+TEST quant_approx_deadzone(void)
+{
+  coeff_t expected[32 * 32];
+  coeff_t actual[32 * 32];
+
+  encoder->cfg.signhide_enable = 0;
+
+  for (int q = 0; q < NUM_QPS; ++q) {
+    state.qp = test_qps[q];
+    frame.slicetype = (q & 1) ? KVZ_SLICE_P : KVZ_SLICE_I;
+
+    for (int log2_width = 2; log2_width <= 5; ++log2_width) {
+      const int width = 1 << log2_width;
+      fill_coeffs(coeff_in, width, q * 1000 + log2_width * 10);
+
+      set_offsets(256, 256);
+      tested_quant_approx(&state, coeff_in, expected, width, width,
+                          0, 0, CU_INTRA);
+      set_offsets(0, 256);
+      tested_quant_approx(&state, coeff_in, actual, width, width,
+                          0, 0, CU_INTRA);
+
+      for (int i = 0; i < width * width; ++i) {
+        if (abs(expected[i]) == 1) {
+          ASSERT(actual[i] == expected[i] || actual[i] == 0);
+        } else {
+          ASSERT_EQ(expected[i], actual[i]);
+        }
+      }
+    }
+  }
+
+  PASS();
+}
+
+SUITE(quant_approx_tests)
+{
+  setup();
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "quant_approx") != 0) {
+      continue;
+    }
+
+    tested_quant_approx = strategies.strategies[i].fptr;
+    RUN_TEST(quant_approx_matches_quant);
+    RUN_TEST(quant_approx_deadzone);
+  }
+
+  tear_down();
+}
@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "test_strategies.h"
+
+#include "src/context.h"
+#include "src/encoderstate.h"
+#include "src/rdo.h"
+#include "src/scalinglist.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_QPS 4
+
+static const int8_t test_qps[NUM_QPS] = { 12, 22, 32, 42 };
+
+static encoder_control_t *encoder;
+static encoder_state_t state;
+
+static rdoq_func *tested_rdoq;
+
+static coeff_t coeff_in[32 * 32];
+
+/**
+ * \brief Fill a block with coefficients resembling transform output.
+ *
+ * Magnitudes fall off with distance from the DC position and most of the
+ * high frequencies are zero, so that all coefficient groups, last position
+ * and sign hiding paths get exercised.
+ */
+static void fill_coeffs(coeff_t *coeff, int width, unsigned seed)
+{
+  srand(seed);
+  for (int y = 0; y < width; ++y) {
+    for (int x = 0; x < width; ++x) {
+      int range = 4096 / (1 + x + y);
+      int value = rand() % (2 * range + 1) - range;
+      if (rand() % (2 + x + y) > 3) value = 0;
+      coeff[x + y * width] = (coeff_t)value;
+    }
+  }
+}
+
+static void setup(void)
+{
+  encoder = calloc(1, sizeof(encoder_control_t));
+  encoder->bitdepth = KVZ_BIT_DEPTH;
+  kvz_scalinglist_init(&encoder->scaling_list);
+  kvz_scalinglist_process(&encoder->scaling_list, encoder->bitdepth);
+
+  memset(&state, 0, sizeof(state));
+  state.encoder_control = encoder;
+}
+
+static void tear_down(void)
+{
+  kvz_scalinglist_destroy(&encoder->scaling_list);
+  free(encoder);
+}
+
+TEST rdoq_matches_generic(void)
+{
+  coeff_t expected[32 * 32];
+  coeff_t actual[32 * 32];
+
+  for (int sign_hide = 0; sign_hide <= 1; ++sign_hide) {
+    encoder->cfg.signhide_enable = sign_hide;
+
+    for (int q = 0; q < NUM_QPS; ++q) {
+      state.qp = test_qps[q];
+      state.lambda = 0.57 * pow(2.0, (state.qp - 12) / 3.0);
+      kvz_init_contexts(&state, state.qp, (q & 1) ? KVZ_SLICE_P : KVZ_SLICE_I);
+
+      for (int log2_width = 2; log2_width <= 5; ++log2_width) {
+        const int width = 1 << log2_width;
+        for (int8_t type = 0; type <= 2; type += 2) {
+          if (type != 0 && width == 32) continue;
+          // Horizontal and vertical scans are only used up to 8x8.
+          const int8_t max_scan_mode = width <= 8 ? 2 : 0;
+          for (int8_t scan_mode = 0; scan_mode <= max_scan_mode; ++scan_mode) {
+            for (int8_t block_type = CU_INTRA; block_type <= CU_INTER; ++block_type) {
+              fill_coeffs(coeff_in, width, q * 1000 + log2_width * 10 + scan_mode);
+
+              memset(expected, 0, sizeof(expected));
+              memset(actual, 0, sizeof(actual));
+              kvz_rdoq_generic(&state, coeff_in, expected, width, width,
+                               type, scan_mode, block_type, 0);
+              tested_rdoq(&state, coeff_in, actual, width, width,
+                          type, scan_mode, block_type, 0);
+
+              for (int i = 0; i < width * width; ++i) {
+                ASSERT_EQ(expected[i], actual[i]);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  PASS();
+}
+
+SUITE(rdoq_tests)
+{
+  setup();
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "rdoq") != 0) {
+      continue;
+    }
+
+    tested_rdoq = strategies.strategies[i].fptr;
+    RUN_TEST(rdoq_matches_generic);
+  }
+
+  tear_down();
+}
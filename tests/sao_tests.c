@@ -0,0 +1,150 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "test_strategies.h"
+
+#include "src/encoder.h"
+#include "src/sao.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_WIDTH 66
+
+static const int test_heights[] = { 1, 2, 3, 4, 5, 8, 17, 32, 33, 64, 66 };
+
+static encoder_control_t *encoder;
+
+static calc_sao_stats_func *generic_calc_sao_stats;
+static calc_sao_stats_func *tested_calc_sao_stats;
+
+/**
+ * \brief Fill a block with a reconstruction and an original.
+ *
+ * The reconstruction has flat areas, ramps and noise so that every edge
+ * category gets hits, and the original differs from it by small and large
+ * amounts in both directions.
+ */
+static void fill_block(kvz_pixel *orig, kvz_pixel *rec, int width, int height, unsigned seed)
+{
+  srand(seed);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      int value;
+      switch ((x / 4 + y / 3) % 3) {
+        case 0:  value = 128; break;
+        case 1:  value = 4 * x + 3 * y; break;
+        default: value = rand() % 256; break;
+      }
+      value = CLIP(0, 255, value + rand() % 5 - 2);
+      rec[x + y * width] = (kvz_pixel)value;
+
+      int diff = rand() % 4 ? rand() % 9 - 4 : rand() % 129 - 64;
+      orig[x + y * width] = (kvz_pixel)CLIP(0, 255, value + diff);
+    }
+  }
+}
+
+static void setup(void)
+{
+  encoder = calloc(1, sizeof(encoder_control_t));
+  encoder->bitdepth = KVZ_BIT_DEPTH;
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "calc_sao_stats") == 0 &&
+        strcmp(strategies.strategies[i].strategy_name, "generic") == 0) {
+      generic_calc_sao_stats = strategies.strategies[i].fptr;
+    }
+  }
+}
+
+static void tear_down(void)
+{
+  free(encoder);
+}
+
+TEST calc_sao_stats_matches_generic(void)
+{
+  const int num_heights = sizeof(test_heights) / sizeof(test_heights[0]);
+
+  for (int h = 0; h < num_heights; ++h) {
+    const int height = test_heights[h];
+
+    for (int width = 1; width <= MAX_WIDTH; ++width) {
+      // Exactly sized buffers, so that reads past the block are caught by
+      // memory checkers.
+      kvz_pixel *orig = malloc(width * height * sizeof(kvz_pixel));
+      kvz_pixel *rec = malloc(width * height * sizeof(kvz_pixel));
+      fill_block(orig, rec, width, height, width * 100 + height);
+
+      sao_stats_t expected;
+      sao_stats_t actual;
+      memset(&actual, 0x55, sizeof(actual));
+      generic_calc_sao_stats(encoder, orig, rec, width, height, &expected);
+      tested_calc_sao_stats(encoder, orig, rec, width, height, &actual);
+
+      free(orig);
+      free(rec);
+
+      for (int eo_class = 0; eo_class < SAO_NUM_EO; ++eo_class) {
+        for (int i = 0; i < NUM_SAO_EDGE_CATEGORIES; ++i) {
+          ASSERT_EQ(expected.edge[eo_class][0][i], actual.edge[eo_class][0][i]);
+          ASSERT_EQ(expected.edge[eo_class][1][i], actual.edge[eo_class][1][i]);
+        }
+      }
+      for (int band = 0; band < 32; ++band) {
+        ASSERT_EQ(expected.band[0][band], actual.band[0][band]);
+        ASSERT_EQ(expected.band[1][band], actual.band[1][band]);
+      }
+    }
+  }
+
+  PASS();
+}
+
+SUITE(sao_tests)
+{
+  setup();
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "calc_sao_stats") != 0) {
+      continue;
+    }
+
+    tested_calc_sao_stats = strategies.strategies[i].fptr;
+    RUN_TEST(calc_sao_stats_matches_generic);
+  }
+
+  tear_down();
+}
@@ -314,6 +314,85 @@ TEST dct_speed(const int width)
 }
 
 
+/**
+ * \brief Run a 32x32 inverse transform on blocks that only have non-zero
+ *        coefficients in the top-left corner.
+ *
+ * Most 32x32 blocks only have a few low frequency coefficients left after
+ * quantization, so the region size is varied between 4x4 and 16x16.
+ */
+static double idct_partial_calls_per_sec(dct_func *full_func, idct_partial_func *partial_func)
+{
+  uint64_t call_cnt = 0;
+
+  KVZ_CLOCK_T clock_now;
+  KVZ_GET_TIME(&clock_now);
+  double test_end = KVZ_CLOCK_T_AS_DOUBLE(clock_now) + TIME_PER_TEST;
+
+  int16_t _tmp_coeffs[32 * 32 + SIMD_ALIGNMENT];
+  int16_t _tmp_residual[32 * 32 + SIMD_ALIGNMENT];
+  int16_t *tmp_coeffs = ALIGNED_POINTER(_tmp_coeffs, SIMD_ALIGNMENT);
+  int16_t *tmp_residual = ALIGNED_POINTER(_tmp_residual, SIMD_ALIGNMENT);
+
+  // Loop until time allocated for test has passed.
+  for (unsigned i = 0;
+    test_end > KVZ_CLOCK_T_AS_DOUBLE(clock_now);
+    ++i)
+  {
+    int test = i % NUM_TESTS;
+    for (int chunk = 1; chunk < NUM_CHUNKS; ++chunk) {
+      const int num_rows = 4 + 4 * (chunk % 4);
+      const int num_cols = 4 + 4 * ((chunk / 4) % 4);
+      kvz_pixel * buf1 = &bufs[test][0];
+      kvz_pixel * buf2 = &bufs[test][chunk * 32 * 32];
+
+      memset(tmp_coeffs, 0, 32 * 32 * sizeof(int16_t));
+      for (int y = 0; y < num_rows; ++y) {
+        for (int x = 0; x < num_cols; ++x) {
+          tmp_coeffs[y * 32 + x] = (int16_t)(buf1[y * 32 + x] - buf2[y * 32 + x]);
+        }
+      }
+
+      if (partial_func) {
+        partial_func(8, tmp_coeffs, tmp_residual, num_rows, num_cols);
+      } else {
+        full_func(8, tmp_coeffs, tmp_residual);
+      }
+      ++call_cnt;
+    }
+
+    KVZ_GET_TIME(&clock_now)
+  }
+
+  double test_time = TIME_PER_TEST + KVZ_CLOCK_T_AS_DOUBLE(clock_now) - test_end;
+  return (double)call_cnt / 1000000.0 / test_time;
+}
+
+
+TEST idct_partial(void)
+{
+  dct_func *full_func = NULL;
+  for (unsigned i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "idct_32x32") == 0 &&
+        strcmp(strategies.strategies[i].strategy_name, test_env.strategy->strategy_name) == 0)
+    {
+      full_func = strategies.strategies[i].fptr;
+    }
+  }
+  ASSERT(full_func != NULL);
+
+  double partial_speed = idct_partial_calls_per_sec(NULL, test_env.tested_func);
+  double full_speed = idct_partial_calls_per_sec(full_func, NULL);
+
+  sprintf(test_env.msg, "%.3fM x %s:%s (%.2fx idct_32x32)",
+    partial_speed,
+    test_env.strategy->type,
+    test_env.strategy->strategy_name,
+    partial_speed / full_speed);
+  PASSm(test_env.msg);
+}
+
+
 TEST intra_sad(void)
 {
   return test_intra_speed(test_env.width);
@@ -424,6 +503,8 @@ SUITE(speed_tests)
         RUN_TEST(inter_sad);
       }
 
+    } else if (strcmp(strategy->type, "idct_32x32_partial") == 0) {
+      RUN_TEST(idct_partial);
     } else if (strncmp(strategy->type, "dct_", 4) == 0 ||
                strcmp(strategy->type, "fast_forward_dst_4x4") == 0)
     {
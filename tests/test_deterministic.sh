@@ -0,0 +1,41 @@
+#!/bin/sh
+
+# Test that --deterministic produces the same bitstream regardless of the
+# number of threads.
+
+set -eu
+. "${0%/*}/util.sh"
+
+reference="$(mktemp)"
+trap 'cleanup; rm -f "${reference}"' EXIT
+
+deterministic_test() {
+    dimensions="$1"
+    shift
+    frames="$1"
+    shift
+
+    prepare "${dimensions}" "${frames}"
+
+    for threads in 0 1 2 4 8; do
+        print_and_run \
+            ../libtool execute \
+                ../src/kvazaar -i "${yuvfile}" "--input-res=${dimensions}" -o "${hevcfile}" \
+                --deterministic "--threads=${threads}" "$@"
+        if [ "${threads}" -eq 0 ]; then
+            cp "${hevcfile}" "${reference}"
+        else
+            cmp "${reference}" "${hevcfile}"
+        fi
+    done
+
+    cleanup
+}
+
+common_args='-p4 --rd=0 --no-rdoq --no-signhide --subme=0 --owf=2'
+deterministic_test 264x130 8 $common_args --wpp
+deterministic_test 264x130 8 $common_args --rc-algorithm=oba --bitrate=500000
+deterministic_test 264x130 8 $common_args --rc-algorithm=oba --bitrate=500000 --intra-bits
+deterministic_test 264x130 8 $common_args --rc-algorithm=lambda --bitrate=500000 --vbv-bufsize=200000 --vbv-maxrate=500000
+deterministic_test 512x512 3 $common_args --rc-algorithm=oba --bitrate=500000 --tiles=2x2 --no-wpp
+deterministic_test 264x130 8 $common_args --slices=0,7 --no-wpp
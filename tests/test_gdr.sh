@@ -0,0 +1,25 @@
+#!/bin/sh
+
+# Test gradual decoding refresh.
+
+set -eu
+. "${0%/*}/util.sh"
+
+common_args='264x130 14 -p0 -r1 --rd=0 --no-rdoq --no-signhide --subme=0'
+valgrind_test $common_args --gdr=4
+valgrind_test $common_args --gdr=4 --threads=2 --wpp --owf=1
+valgrind_test $common_args --gdr=5 --gop=lp-g4d3t1 --vps-period=1
+
+# Cut the stream at the second recovery point and check that the rest
+# decodes. The parameter sets are re-sent with every recovery point.
+prepare 264x130 14
+print_and_run \
+    ../libtool execute \
+        ../src/kvazaar -i "${yuvfile}" --input-res=264x130 -o "${hevcfile}" \
+            --preset=ultrafast -p0 --gdr=4 --vps-period=1
+offset="$(LC_ALL=C grep -obUaP '\x00\x00\x01\x40\x01' "${hevcfile}" | sed -n 3p | cut -d: -f1)"
+[ -n "${offset}" ]
+# The input is no longer needed so the cut stream goes to its file.
+tail -c "+$((offset + 1))" "${hevcfile}" > "${yuvfile}"
+print_and_run \
+    ffmpeg -xerror -f hevc -i "${yuvfile}" -f null -
@@ -0,0 +1,16 @@
+#!/bin/sh
+
+# Test --latency-budget. The budget selects OWF and splits the frames into
+# slices, so try budgets that give one and several slices with and without
+# WPP and threads.
+
+set -eu
+. "${0%/*}/util.sh"
+
+common_args='-p4 --rd=0 --no-rdoq --no-signhide --subme=0 --input-fps=25'
+valgrind_test 256x192 10 $common_args --latency-budget=40 --threads=0 --wpp
+valgrind_test 256x192 10 $common_args --latency-budget=40 --threads=4 --wpp
+valgrind_test 256x192 10 $common_args --latency-budget=40 --threads=2 --no-wpp
+valgrind_test 264x130 10 $common_args --latency-budget=100 --threads=2 --wpp
+valgrind_test 264x130 10 $common_args --latency-budget=20 --threads=2 --wpp
+valgrind_test 264x130 10 $common_args --latency-budget=20 --threads=2 --wpp --tiles=2x1
@@ -5,4 +5,5 @@ set -eu
 
 valgrind_test 512x256 10 --threads=2 --owf=1 --preset=ultrafast --tiles=2x2 --slices=tiles
 valgrind_test 264x130 10 --threads=2 --owf=1 --preset=ultrafast --slices=wpp
+valgrind_test 256x192 4 --threads=2 --owf=1 --preset=ultrafast --slices=0,4 --wpp
 if [ ! -z ${GITLAB_CI+x} ];then valgrind_test 264x130 20 --threads=2 --owf=1 --preset=fast --slices=wpp --no-open-gop; fi
@@ -62,4 +62,9 @@ void init_test_strategies()
     fprintf(stderr, "strategy_register_quant failed!\n");
     return;
   }
+
+  if (!kvz_strategy_register_sao(&strategies, KVZ_BIT_DEPTH)) {
+    fprintf(stderr, "strategy_register_sao failed!\n");
+    return;
+  }
 }
@@ -45,6 +45,11 @@ extern SUITE(dct_tests);
 
 extern SUITE(coeff_sum_tests);
 extern SUITE(mv_cand_tests);
+extern SUITE(quant_approx_tests);
+extern SUITE(rdoq_tests);
+extern SUITE(sao_tests);
+extern SUITE(tr_split_tests);
+extern SUITE(ml_intra_depth_tests);
 extern SUITE(inter_recon_bipred_tests);
 
 int main(int argc, char **argv)
@@ -71,6 +76,16 @@ int main(int argc, char **argv)
 
   RUN_SUITE(mv_cand_tests);
 
+  RUN_SUITE(quant_approx_tests);
+
+  RUN_SUITE(rdoq_tests);
+
+  RUN_SUITE(sao_tests);
+
+  RUN_SUITE(tr_split_tests);
+
+  RUN_SUITE(ml_intra_depth_tests);
+
   // Doesn't work in git
   //RUN_SUITE(inter_recon_bipred_tests);
 
@@ -0,0 +1,162 @@
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "test_strategies.h"
+
+#include "src/encoderstate.h"
+#include "src/fast_coeff_cost.h"
+#include "src/scalinglist.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_QPS 5
+#define MAX_LEVELS 4
+#define STRIDE 64
+
+static const int8_t test_qps[NUM_QPS] = { 12, 22, 32, 42, 51 };
+
+static encoder_control_t *encoder;
+static encoder_state_config_frame_t frame;
+static encoder_state_t state;
+
+static tr_split_costs_func *generic_tr_split_costs;
+static tr_split_costs_func *tested_tr_split_costs;
+
+static kvz_pixel ref[STRIDE * STRIDE];
+static kvz_pixel pred[STRIDE * STRIDE];
+
+/**
+ * \brief Fill the reference and prediction blocks.
+ *
+ * The prediction is a smooth ramp and the reference differs from it by an
+ * amount that grows along the rows, so that the higher QPs quantize some
+ * of the transform blocks to zero and some not.
+ */
+static void fill_blocks(int width, unsigned seed)
+{
+  srand(seed);
+  for (int y = 0; y < width; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const int value = 40 + 3 * x + 2 * y;
+      const int noise = 1 + y * 4;
+      pred[x + y * STRIDE] = (kvz_pixel)value;
+      ref[x + y * STRIDE] = (kvz_pixel)CLIP(0, PIXEL_MAX, value + rand() % (2 * noise + 1) - noise);
+    }
+  }
+}
+
+static void setup(void)
+{
+  encoder = calloc(1, sizeof(encoder_control_t));
+  encoder->bitdepth = KVZ_BIT_DEPTH;
+  kvz_scalinglist_init(&encoder->scaling_list);
+  kvz_scalinglist_process(&encoder->scaling_list, encoder->bitdepth);
+  kvz_fast_coeff_use_default_table(&encoder->fast_coeff_table);
+
+  memset(&frame, 0, sizeof(frame));
+  memset(&state, 0, sizeof(state));
+  state.encoder_control = encoder;
+  state.frame = &frame;
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "tr_split_costs") == 0 &&
+        strcmp(strategies.strategies[i].strategy_name, "generic") == 0) {
+      generic_tr_split_costs = strategies.strategies[i].fptr;
+    }
+  }
+}
+
+static void tear_down(void)
+{
+  kvz_scalinglist_destroy(&encoder->scaling_list);
+  free(encoder);
+}
+
+TEST tr_split_costs_matches_generic(void)
+{
+  tr_cost_t expected[MAX_LEVELS];
+  tr_cost_t actual[MAX_LEVELS];
+
+  for (int sign_hide = 0; sign_hide <= 1; ++sign_hide) {
+    encoder->cfg.signhide_enable = sign_hide;
+
+    for (int q = 0; q < NUM_QPS; ++q) {
+      state.qp = test_qps[q];
+      frame.slicetype = (q & 1) ? KVZ_SLICE_P : KVZ_SLICE_I;
+
+      for (int log2_width = 2; log2_width <= 5; ++log2_width) {
+        const int width = 1 << log2_width;
+        const int num_levels = log2_width - 1;
+
+        for (color_t color = COLOR_Y; color <= COLOR_U; ++color) {
+          if (color != COLOR_Y && width == 32) continue;
+          for (cu_type_t type = CU_INTRA; type <= CU_INTER; ++type) {
+            fill_blocks(width, q * 1000 + log2_width * 10 + color);
+
+            memset(expected, 0, sizeof(expected));
+            memset(actual, 0, sizeof(actual));
+            generic_tr_split_costs(&state, width, color, type, num_levels,
+                                   ref, pred, STRIDE, expected);
+            tested_tr_split_costs(&state, width, color, type, num_levels,
+                                  ref, pred, STRIDE, actual);
+
+            for (int level = 0; level < num_levels; ++level) {
+              ASSERT_EQ(expected[level].ssd, actual[level].ssd);
+              ASSERT_EQ(expected[level].bits, actual[level].bits);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  PASS();
+}
+
+SUITE(tr_split_tests)
+{
+  setup();
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "tr_split_costs") != 0) {
+      continue;
+    }
+
+    tested_tr_split_costs = strategies.strategies[i].fptr;
+    RUN_TEST(tr_split_costs_matches_generic);
+  }
+
+  tear_down();
+}
@@ -0,0 +1,118 @@
+"""
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+"""
+
+"""
+Compare the speed and BD-rate of the quantizers selectable with
+--quant-modes.
+
+Usage: bench-quant-modes.py <kvazaar> <input> <kvazaar options...>
+
+Every mode is encoded at QPs 22, 27, 32 and 37 with the given options.
+The BD-rate of each mode is reported against full RDOQ for all block sizes.
+"""
+
+import math, re, subprocess, sys
+
+QPS = [22, 27, 32, 37]
+
+MODES = [
+  "rdoq",
+  "rdoq,rdoq,rdoq,approx",
+  "rdoq,rdoq,approx,approx",
+  "approx,rdoq,rdoq,rdoq",
+  "approx",
+  "plain,approx,approx,approx",
+  "plain",
+]
+
+def encode(kvazaar, inp, opts, qp, mode):
+  # Presets override earlier options so the given options go first.
+  cmd = [kvazaar, "-i", inp, "-o", "/dev/null"] + opts + [
+         "--qp", str(qp), "--rdoq", "--quant-modes", mode]
+  out = subprocess.run(cmd, stderr=subprocess.PIPE, universal_newlines=True,
+                       check=True).stderr
+  bits = int(re.search(r"Processed \d+ frames,\s+(\d+) bits", out).group(1))
+  psnr = [float(x) for x in re.search(
+      r"AVG PSNR Y ([\d.]+) U ([\d.]+) V ([\d.]+)", out).groups()]
+  time = float(re.search(r"Total CPU time: ([\d.]+) s", out).group(1))
+  return bits, (6 * psnr[0] + psnr[1] + psnr[2]) / 8, time
+
+def polyfit3(xs, ys):
+  # Least squares fit of a cubic polynomial with normal equations.
+  n = 4
+  a = [[sum(x ** (i + j) for x in xs) for j in range(n)] for i in range(n)]
+  b = [sum(y * x ** i for x, y in zip(xs, ys)) for i in range(n)]
+  for col in range(n):
+    piv = max(range(col, n), key=lambda r: abs(a[r][col]))
+    a[col], a[piv] = a[piv], a[col]
+    b[col], b[piv] = b[piv], b[col]
+    for r in range(n):
+      if r != col:
+        f = a[r][col] / a[col][col]
+        a[r] = [v - f * w for v, w in zip(a[r], a[col])]
+        b[r] -= f * b[col]
+  return [b[i] / a[i][i] for i in range(n)]
+
+def integrate(p, lo, hi):
+  return sum(c / (i + 1) * (hi ** (i + 1) - lo ** (i + 1)) for i, c in enumerate(p))
+
+def bd_rate(ref, test):
+  ref_p = polyfit3([q for _, q in ref], [math.log10(r) for r, _ in ref])
+  test_p = polyfit3([q for _, q in test], [math.log10(r) for r, _ in test])
+  lo = max(min(q for _, q in ref), min(q for _, q in test))
+  hi = min(max(q for _, q in ref), max(q for _, q in test))
+  diff = (integrate(test_p, lo, hi) - integrate(ref_p, lo, hi)) / (hi - lo)
+  return (10 ** diff - 1) * 100
+
+def main():
+  if len(sys.argv) < 3:
+    print(__doc__.strip())
+    sys.exit(1)
+  kvazaar, inp, opts = sys.argv[1], sys.argv[2], sys.argv[3:]
+
+  results = {}
+  for mode in MODES:
+    results[mode] = [encode(kvazaar, inp, opts, qp, mode) for qp in QPS]
+
+  ref = results[MODES[0]]
+  ref_time = sum(t for _, _, t in ref)
+  print("%-28s %10s %10s" % ("quant-modes", "BD-rate", "time"))
+  for mode in MODES:
+    res = results[mode]
+    time = sum(t for _, _, t in res)
+    bdr = bd_rate([(r, q) for r, q, _ in ref], [(r, q) for r, q, _ in res])
+    print("%-28s %9.2f%% %9.1f%%" % (mode, bdr, 100 * time / ref_time))
+
+if __name__ == "__main__":
+  main()
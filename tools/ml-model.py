@@ -0,0 +1,266 @@
+"""
+/*****************************************************************************
+ * This file is part of Kvazaar HEVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+"""
+
+"""
+Train, inspect and combine decision tree models for --ml-model.
+
+Usage:
+  ml-model.py train [options] -o <model> <samples.csv>...
+  ml-model.py dump <model>
+  ml-model.py merge -o <model> <model>...
+
+train builds the inter split termination trees used by --ml-pu-depth-inter
+from the samples written with --ml-inter-samples. One tree is trained for
+each CU depth. A leaf predicts that the split is not worth searching when
+the share of split CUs in it is below the threshold of the depth.
+
+Options of train:
+  --max-depth <int>          maximum depth of the trees [4]
+  --min-leaf <int>           minimum number of samples in a leaf [40]
+  --thresholds <a,b,c>       split share thresholds for CU depths 0-2
+                             [0.1,0.08,0.06]
+  --qp <min>-<max>           only use the models for these QPs and train
+                             them with the samples of these QPs [0-255]
+  --area <min>-<max>         only use the models for pictures whose luma
+                             area is in this range [0-4294967295]
+
+merge concatenates the models of several files. The encoder uses the first
+model that matches, so more specific models should be given first.
+
+See src/ml_model.h for the file format.
+"""
+
+import csv, struct, sys
+
+MAGIC = b"KVZM"
+VERSION = 1
+
+KINDS = ["intra_merge", "intra_split", "inter_split"]
+INTER_SPLIT = 2
+
+# Order of the features in ml_inter_cu_depth_pred.c
+INTER_FEATURES = ["sad", "cost", "variance", "neigh_depth", "col_depth",
+                  "mv_coherence", "cbf", "skipped", "qp"]
+
+def read_models(path):
+  with open(path, "rb") as f:
+    data = f.read()
+  magic, version, num_models = struct.unpack_from("<4sHH", data, 0)
+  if magic != MAGIC or version != VERSION:
+    sys.exit("%s is not a version %d model file" % (path, VERSION))
+  pos = 8
+  models = []
+  for _ in range(num_models):
+    kind, depth, qp_min, qp_max, area_min, area_max, num_trees = \
+        struct.unpack_from("<BBBBIIH", data, pos)
+    pos += 14
+    trees = []
+    for _ in range(num_trees):
+      num_nodes, = struct.unpack_from("<H", data, pos)
+      pos += 2
+      nodes = []
+      for _ in range(num_nodes):
+        nodes.append(struct.unpack_from("<Bbhhf", data, pos))
+        pos += 10
+      trees.append(nodes)
+    models.append((kind, depth, qp_min, qp_max, area_min, area_max, trees))
+  return models
+
+def write_models(path, models):
+  out = [struct.pack("<4sHH", MAGIC, VERSION, len(models))]
+  for kind, depth, qp_min, qp_max, area_min, area_max, trees in models:
+    out.append(struct.pack("<BBBBIIH", kind, depth, qp_min, qp_max,
+                           area_min, area_max, len(trees)))
+    for nodes in trees:
+      out.append(struct.pack("<H", len(nodes)))
+      for node in nodes:
+        out.append(struct.pack("<Bbhhf", *node))
+  with open(path, "wb") as f:
+    f.write(b"".join(out))
+
+def gini(pos, n):
+  if n == 0:
+    return 0.0
+  p = pos / n
+  return n * (1 - p * p - (1 - p) * (1 - p))
+
+def build_tree(samples, depth, max_depth, min_leaf):
+  """Grow a CART classification tree. Samples are (features, split)."""
+  n = len(samples)
+  pos = sum(s[1] for s in samples)
+  node = {"n": n, "pos": pos}
+  if depth >= max_depth or n < 2 * min_leaf or pos in (0, n):
+    return node
+
+  best = None
+  for f in range(len(INTER_FEATURES)):
+    ordered = sorted(samples, key=lambda s: s[0][f])
+    left_pos = 0
+    for i in range(n - 1):
+      left_pos += ordered[i][1]
+      if ordered[i][0][f] == ordered[i + 1][0][f]:
+        continue
+      left_n = i + 1
+      if left_n < min_leaf or n - left_n < min_leaf:
+        continue
+      cost = gini(left_pos, left_n) + gini(pos - left_pos, n - left_n)
+      if best is None or cost < best[0]:
+        best = (cost, f, (ordered[i][0][f] + ordered[i + 1][0][f]) / 2)
+
+  if best is None or best[0] >= gini(pos, n) - 1e-9:
+    return node
+  _, f, threshold = best
+  node["feature"] = f
+  node["threshold"] = threshold
+  node["le"] = build_tree([s for s in samples if s[0][f] <= threshold],
+                          depth + 1, max_depth, min_leaf)
+  node["gt"] = build_tree([s for s in samples if s[0][f] > threshold],
+                          depth + 1, max_depth, min_leaf)
+  return node
+
+def leaf_value(node, share):
+  return 1 if node["pos"] / node["n"] < share else 0
+
+def prune(node, share):
+  """Replace inner nodes whose leaves predict the same with a leaf."""
+  if "feature" not in node:
+    return
+  prune(node["le"], share)
+  prune(node["gt"], share)
+  le, gt = node["le"], node["gt"]
+  if "feature" not in le and "feature" not in gt and \
+      leaf_value(le, share) == leaf_value(gt, share):
+    value = leaf_value(le, share)
+    for key in ("feature", "threshold", "le", "gt"):
+      del node[key]
+    node["pos"] = 0 if value else node["n"]
+
+def flatten(node, share):
+  """Store the tree as an array of nodes, root first."""
+  nodes = []
+  def visit(node):
+    index = len(nodes)
+    nodes.append(None)
+    if "feature" not in node:
+      nodes[index] = (0, leaf_value(node, share), index, index, 0.0)
+    else:
+      le = visit(node["le"])
+      gt = visit(node["gt"])
+      nodes[index] = (node["feature"], 0, le, gt, node["threshold"])
+    return index
+  visit(node)
+  return nodes
+
+def parse_range(text):
+  lo, hi = text.split("-")
+  return int(lo), int(hi)
+
+def train(args):
+  max_depth, min_leaf = 4, 40
+  shares = [0.1, 0.08, 0.06]
+  qp_range, area_range = (0, 255), (0, 2 ** 32 - 1)
+  output, inputs = None, []
+  while args:
+    arg = args.pop(0)
+    if arg == "--max-depth":
+      max_depth = int(args.pop(0))
+    elif arg == "--min-leaf":
+      min_leaf = int(args.pop(0))
+    elif arg == "--thresholds":
+      shares = [float(x) for x in args.pop(0).split(",")]
+    elif arg == "--qp":
+      qp_range = parse_range(args.pop(0))
+    elif arg == "--area":
+      area_range = parse_range(args.pop(0))
+    elif arg == "-o":
+      output = args.pop(0)
+    else:
+      inputs.append(arg)
+  if not output or not inputs:
+    sys.exit(__doc__.strip())
+
+  samples = {}
+  for path in inputs:
+    with open(path) as f:
+      for row in csv.DictReader(f):
+        if not qp_range[0] <= float(row["qp"]) <= qp_range[1]:
+          continue
+        features = [float(row[name]) for name in INTER_FEATURES]
+        samples.setdefault(int(row["depth"]), []).append(
+            (features, int(row["split"])))
+
+  models = []
+  for depth in sorted(samples):
+    if depth >= len(shares):
+      continue
+    tree = build_tree(samples[depth], 0, max_depth, min_leaf)
+    prune(tree, shares[depth])
+    nodes = flatten(tree, shares[depth])
+    models.append((INTER_SPLIT, depth, qp_range[0], qp_range[1],
+                   area_range[0], area_range[1], [nodes]))
+    print("depth %d: %d samples, %d nodes" %
+          (depth, len(samples[depth]), len(nodes)))
+  write_models(output, models)
+
+def dump(args):
+  for kind, depth, qp_min, qp_max, area_min, area_max, trees in \
+      read_models(args[0]):
+    print("%s depth=%d qp=%d-%d area=%d-%d" %
+          (KINDS[kind], depth, qp_min, qp_max, area_min, area_max))
+    for t, nodes in enumerate(trees):
+      print("  tree %d" % t)
+      for i, (feature, value, le, gt, threshold) in enumerate(nodes):
+        if le == i and gt == i:
+          print("    %3d leaf %d" % (i, value))
+        else:
+          name = INTER_FEATURES[feature] if kind == INTER_SPLIT else feature
+          print("    %3d %s <= %g ? %d : %d" % (i, name, threshold, le, gt))
+
+def merge(args):
+  if len(args) < 3 or args[0] != "-o":
+    sys.exit(__doc__.strip())
+  models = []
+  for path in args[2:]:
+    models += read_models(path)
+  write_models(args[1], models)
+
+def main():
+  commands = {"train": train, "dump": dump, "merge": merge}
+  if len(sys.argv) < 3 or sys.argv[1] not in commands:
+    print(__doc__.strip())
+    sys.exit(1)
+  commands[sys.argv[1]](sys.argv[2:])
+
+if __name__ == "__main__":
+  main()